@@ -6,6 +6,8 @@
 #include <iomanip>
 #include <sstream>
 #include <atomic>
+#include <fstream>
+#include <iterator>
 #include <signal.h>
 
 #include "scene.h"
@@ -14,14 +16,20 @@
 #include "artifacts.h"
 #include "constants.h"
 #include "rng.h"
+#include "Sampler.h"
 #include "AmbientOcclusion.h"
 #include "timer.h"
 #include "argparse.h"
 #include "Renderer.h"
+#include "WavefrontRenderer.h"
 #include "Logger.h"
+#include "PathStatistics.h"
+#include "PerfCounters.h"
 #include "LatLonEnvironmentMap.h"
 #include "filesystem.h"
 #include "build_info.h"
+#include "ThreadPool.h"
+#include "hash.h"
 
 std::atomic<bool> flushImmediate(false); // Flush the color output as soon as possible
 
@@ -56,15 +64,34 @@ int main(int argc, char ** argv)
         bool annotate = false;
         unsigned int flushTimeout = 0;
         unsigned int numThreads = 1;
+        bool pinThreads = false;
         unsigned int samplesPerPixel = 1;
+        unsigned int seed = 0;
+        std::string sampler = "random";
         float epsilon = Renderer::DEFAULT_EPSILON_ADDITIVE;
         unsigned int maxDepth = Renderer::DEFAULT_MAX_DEPTH;
         float sensorScaleFactor = 1.0f;
         bool noMonteCarloRefraction = false;
-        float russianRouletteChance = 0.1f;
+        float russianRouletteChance = Renderer::DEFAULT_RUSSIAN_ROULETTE_CHANCE;
         bool noSampleCosineLobe = false;
         bool noSampleSpecularLobe = false;
+        unsigned int numLightSamples = Renderer::DEFAULT_NUM_LIGHT_SAMPLES;
         std::string renderOrder = "default";
+        unsigned int tileSize = 8;
+        std::string tileOrder = "spiral";
+        std::string integrator = "recursive";
+        std::string checkpoint;             // empty for none
+        std::string perfJSON;               // empty for none
+        bool resume = false;
+        bool meshCache = false;
+        std::string meshCacheDirectory;
+        unsigned int textureCacheMB = 0;    // 0 keeps all textures in memory
+        bool noMipMaps = false;
+        struct {
+            unsigned int minSamplesPerPixel = 16;
+            float errorTarget = 0.02f;
+            float timeBudget = 0.0f;    // seconds, 0 for none
+        } adaptive;
         struct {
             bool compute = false;
             bool sampleCosineLobe = false;
@@ -82,17 +109,36 @@ int main(int argc, char ** argv)
     argParser.addFlag('A', "annotate", options.annotate);
     argParser.addArgument('f', "flushtimeout", options.flushTimeout);
     argParser.addArgument('t', "threads", options.numThreads);
+    argParser.addFlag('P', "pinthreads", options.pinThreads);
     argParser.addArgument('s', "spp", options.samplesPerPixel);
+    argParser.addArgument('z', "seed", options.seed);
+    argParser.addArgument('m', "sampler", options.sampler);
     argParser.addArgument('e', "epsilon", options.epsilon);
     argParser.addArgument('d', "maxdepth", options.maxDepth);
     argParser.addArgument('p', "sensorscale", options.sensorScaleFactor);
     argParser.addArgument('r', "rr", options.russianRouletteChance);
     argParser.addFlag('R', "nomontecarlorefraction", options.noMonteCarloRefraction);
     argParser.addArgument('o', "renderorder", options.renderOrder);
+    argParser.addArgument('T', "tilesize", options.tileSize);
+    argParser.addArgument('O', "tileorder", options.tileOrder);
+    argParser.addArgument('I', "integrator", options.integrator);
+    argParser.addArgument('k', "checkpoint", options.checkpoint);
+    argParser.addFlag('u', "resume", options.resume);
+    argParser.addArgument('J', "perfjson", options.perfJSON);
+    argParser.addFlag('M', "meshcache", options.meshCache);
+    argParser.addArgument('D', "meshcachedir", options.meshCacheDirectory);
+    argParser.addArgument('x', "texturecachemb", options.textureCacheMB);
+    argParser.addFlag('L', "nomipmaps", options.noMipMaps);
+
+    // Adaptive sampling (-o adaptive)
+    argParser.addArgument('n', "minspp", options.adaptive.minSamplesPerPixel);
+    argParser.addArgument('N', "errortarget", options.adaptive.errorTarget);
+    argParser.addArgument('b', "timebudget", options.adaptive.timeBudget);
 
     // Sampling
     argParser.addFlag('C', "nosamplecosine", options.noSampleCosineLobe);
     argParser.addFlag('X', "nosamplespecular", options.noSampleSpecularLobe);
+    argParser.addArgument('l', "lightsamples", options.numLightSamples);
 
     // Ambient Occlusion
     argParser.addFlag('a', "ao", options.ambientOcclusion.compute);
@@ -128,18 +174,44 @@ int main(int argc, char ** argv)
 
     printf("Flush timeout: %d sec\n", options.flushTimeout);
     printf("Samples per pixel: %d\n", options.samplesPerPixel);
+    printf("Seed: %u\n", options.seed);
+    printf("Sampler: %s\n", options.sampler.c_str());
     printf("Epsilon: %f\n", options.epsilon);
-    printf("Number of threads: %d\n", options.numThreads);
+    printf("Number of threads: %d%s\n", options.numThreads, options.pinThreads ? " (pinned)" : "");
+    printf("Tile size: %u order: %s\n", options.tileSize, options.tileOrder.c_str());
+    printf("Integrator: %s\n", options.integrator.c_str());
+
+    if(options.integrator != "recursive" && options.integrator != "wavefront") {
+        std::cerr << "Unrecognized integrator '" + options.integrator + "'\n";
+        return EXIT_FAILURE;
+    }
+    const bool wavefront = options.integrator == "wavefront";
+
+    // Resuming without a checkpoint file name uses the default one
+    if(options.resume && options.checkpoint.empty()) {
+        options.checkpoint = "trace_checkpoint.bin";
+    }
+
+    // Shared by scene loading, rendering and artifact output
+    setThreadPoolSize(std::max(options.numThreads, 1u), options.pinThreads);
 
     printf("====[ Loading Scene ]====\n");
     std::string sceneFile = arguments[0];
     auto sceneLoadTimer = WallClockTimer::makeRunningTimer();
     Scene scene;
+    // Binary mesh cache, next to the mesh files unless a directory is given
+    scene.meshDataCache.diskCache = options.meshCache || !options.meshCacheDirectory.empty();
+    scene.meshDataCache.diskCacheDirectory = options.meshCacheDirectory;
+    // Page textures through a tile cache of bounded size
+    if(options.textureCacheMB > 0) {
+        scene.textureCache.setTileCacheBudget(size_t(options.textureCacheMB) * 1024 * 1024);
+    }
     if(!loadSceneFromFile(scene, sceneFile)) {
         std::cerr << "Error loading scene\n";
         return EXIT_FAILURE;
     }
     double sceneLoadTime = sceneLoadTimer.elapsed();
+    perf::recordPhase(perf::LoadPhase, sceneLoadTime);
 
     printf("Scene loaded in %s\n", hoursMinutesSeconds(sceneLoadTime).c_str());
 
@@ -184,12 +256,18 @@ int main(int argc, char ** argv)
 
     const float minDistance = 0.0f;
 
-    RNG rng[options.numThreads];
-
-    // Jitter offsets (applied the same to all corresponding pixel samples)
-    vec2 jitter[options.samplesPerPixel];
-    //std::generate(jitter, jitter + options.samplesPerPixel, [&]() { return rng[0].uniformRectangle(-0.5f, 0.5f, -0.5f, 0.5f); });
-    std::generate(jitter, jitter + options.samplesPerPixel, [&]() { return rng[0].gaussian2D(0.5f); });
+    // One sampler per thread. Sample values depend only on the pixel sample,
+    // so the image does not depend on the number of threads or the order
+    // pixels are traced.
+    auto samplerPrototype = makeSampler(options.sampler, options.seed);
+    if(!samplerPrototype) {
+        std::cerr << "Unrecognized sampler '" + options.sampler + "'\n";
+        return EXIT_FAILURE;
+    }
+    std::vector<std::unique_ptr<Sampler>> samplers(options.numThreads);
+    for(auto & sampler : samplers) {
+        sampler = samplerPrototype->clone();
+    }
 
     Renderer renderer;
     renderer.epsilon = options.epsilon;
@@ -198,84 +276,343 @@ int main(int argc, char ** argv)
     renderer.russianRouletteChance = options.russianRouletteChance;
     renderer.shadeDiffuseParams.sampleCosineLobe = !options.noSampleCosineLobe;
     renderer.shadeSpecularParams.samplePhongLobe = !options.noSampleSpecularLobe;
+    renderer.numLightSamples = options.numLightSamples;
+
+    // Texture MIP levels follow the angle between the rays through
+    // neighboring pixels at the center of the image
+    if(!options.noMipMaps) {
+        const vec2 center(0.5f * scene.sensor.pixelwidth, 0.5f * scene.sensor.pixelheight);
+        const vec2 noBlur(0.0f, 0.0f);
+        auto a = scene.camera->rayThroughStandardImagePlane(scene.sensor.pixelStandardImageLocation(center), noBlur);
+        auto b = scene.camera->rayThroughStandardImagePlane(scene.sensor.pixelStandardImageLocation(center + vec2(1.0f, 0.0f)), noBlur);
+        renderer.pixelSpreadAngle = std::acos(clamp(dot(a.direction.normalized(), b.direction.normalized()), -1.0f, 1.0f));
+    }
 
-    auto tracePixelRay = [&](size_t x, size_t y, size_t threadIndex, uint32_t sampleIndex) {
+    WavefrontRenderer wavefrontRenderer(renderer);
+
+    // Identifies everything the traced samples depend on, so a checkpoint is
+    // only resumed with the same scene and settings. Files included by the
+    // scene are not hashed.
+    const uint64_t sceneHash = [&]() {
+        std::ifstream file(sceneFile, std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::ostringstream settings;
+        settings << scene.sensor.pixelwidth << ' ' << scene.sensor.pixelheight
+                 << ' ' << options.sampler << ' ' << options.seed << ' ' << options.integrator
+                 << ' ' << options.epsilon << ' ' << options.maxDepth << ' ' << options.russianRouletteChance
+                 << ' ' << options.noMonteCarloRefraction << ' ' << options.noSampleCosineLobe
+                 << ' ' << options.noSampleSpecularLobe << ' ' << options.numLightSamples
+                 << ' ' << options.noMipMaps
+                 << ' ' << options.envmap.latLonOverride << ' ' << options.envmap.scaleFactor;
+        return fnv1a64(settings.str(), fnv1a64(contents));
+    }();
+
+    if(options.resume) {
+        try {
+            artifacts.readCheckpoint(options.checkpoint, sceneHash);
+        }
+        catch(std::exception & e) {
+            std::cerr << "Error resuming from checkpoint: " << e.what() << '\n';
+            return EXIT_FAILURE;
+        }
+        printf("Resuming from checkpoint %s\n", options.checkpoint.c_str());
+        logger->normal() << "Resuming from checkpoint " << options.checkpoint;
+    }
+
+    auto writeCheckpoint = [&](const Artifacts & snapshot) {
+        if(options.checkpoint.empty()) {
+            return;
+        }
+        try {
+            snapshot.writeCheckpoint(options.checkpoint, sceneHash);
+            printf("Checkpoint written to %s\n", options.checkpoint.c_str());
+        }
+        catch(std::exception & e) {
+            std::cerr << "WARNING: " << e.what() << '\n';
+        }
+    };
+
+    // Called from the flush hook (SIGUSR1 or flush timeout). Tracing carries
+    // on while the files are written, so they are written from a snapshot
+    // taken between tile merges.
+    auto flushArtifacts = [&]() {
+        Artifacts snapshot = artifacts.snapshot();
+        snapshot.writeAll();
+        writeCheckpoint(snapshot);
+        resetFlushTimer();
+    };
+
+    // Uses the camera dimensions of the sampler's current pixel sample
+    auto pixelCameraRay = [&](size_t x, size_t y, Sampler & sampler) {
         const vec2 pixelCenter = vec2(x, y) + vec2(0.5f, 0.5f);
-        vec2 jitteredPixel = pixelCenter + jitter[sampleIndex];
+        vec2 jitteredPixel = pixelCenter + RNG::gaussian2D(sampler.get2D(), 0.5f);
         auto standardPixel = scene.sensor.pixelStandardImageLocation(jitteredPixel);
 
-        vec2 randomBlurCoord = rng[threadIndex].uniformUnitCircle();
-        auto ray = scene.camera->rayThroughStandardImagePlane(standardPixel, randomBlurCoord);
+        vec2 randomBlurCoord = RNG::uniformUnitCircle(sampler.get2D());
+        return scene.camera->rayThroughStandardImagePlane(standardPixel, randomBlurCoord);
+    };
+
+    // Each thread accumulates the tile it is tracing into a film of its
+    // own, and merges it into the image when the tile is done
+    std::vector<FilmTile> films(options.numThreads);
+
+    // Path lengths and Russian roulette terminations, counted per thread
+    std::vector<PathStatistics> pathStatistics(options.numThreads);
+
+    auto tracePixelRay = [&](size_t x, size_t y, size_t threadIndex, uint32_t sampleIndex) {
+        Sampler & sampler = *samplers[threadIndex];
+        sampler.startPixelSample(PixelSample{ uint32_t(x), uint32_t(y), sampleIndex });
+        auto ray = pixelCameraRay(x, y, sampler);
 
         RayIntersection intersection;
         RadianceRGB pixelRadiance;
-        bool hit = renderer.traceCameraRay(scene, rng[threadIndex], ray, minDistance, 1, { VaccuumMedium }, intersection, pixelRadiance);
-        artifacts.accumPixelRadiance(x, y, pixelRadiance);
+        bool hit = renderer.traceCameraRay(scene, sampler, ray, minDistance, 1, { VaccuumMedium }, intersection, pixelRadiance,
+                                           &pathStatistics[threadIndex]);
+        films[threadIndex].accumPixelRadiance(x, y, pixelRadiance);
         if(hit) {
             artifacts.setIntersection(x, y, minDistance, scene, intersection);
         }
     };
 
-    auto renderPixelAllSamples = [&](size_t x, size_t y, size_t threadIndex) {
-        ProcessorTimer pixelTimer = ProcessorTimer::makeRunningTimer();
-        for(unsigned int sampleIndex = 0; sampleIndex < options.samplesPerPixel; ++sampleIndex) {
-            tracePixelRay(x, y, threadIndex, sampleIndex);
+    // Trace samples [firstSample, lastSample) of every pixel in a tile
+    auto renderTileRecursive = [&](const Sensor::Tile & tile, ThreadIndex threadIndex,
+                                   uint32_t firstSample, uint32_t lastSample) {
+        auto & film = films[threadIndex];
+        film.reset(tile);
+
+        for(size_t y = tile.ymin; y < tile.ymax; ++y) {
+            for(size_t x = tile.xmin; x < tile.xmax; ++x) {
+                ThreadTimer pixelTimer = ThreadTimer::makeRunningTimer();
+                // Samples already in the image were resumed from a checkpoint
+                const uint32_t startSample = std::max(firstSample, artifacts.numSamples(x, y));
+                for(uint32_t sampleIndex = startSample; sampleIndex < lastSample; ++sampleIndex) {
+                    tracePixelRay(x, y, threadIndex, sampleIndex);
+                }
+                film.accumTime(x, y, pixelTimer.elapsed());
+            }
         }
-        artifacts.setTime(x, y, pixelTimer.elapsed());
 
-        if(flushImmediate.exchange(false)) {
-            artifacts.writeAll();
-            resetFlushTimer();
+        artifacts.mergeTile(film);
+    };
+
+    // Wavefront: trace samples [firstSample, lastSample) of every pixel in
+    // a tile as one batch
+    std::vector<WavefrontRenderer::CameraRayBatch> batches(options.numThreads);
+
+    auto renderTileWavefront = [&](const Sensor::Tile & tile, ThreadIndex threadIndex,
+                                   uint32_t firstSample, uint32_t lastSample) {
+        ThreadTimer tileTimer = ThreadTimer::makeRunningTimer();
+        auto & batch = batches[threadIndex];
+        auto & film = films[threadIndex];
+        Sampler & sampler = *samplers[threadIndex];
+        batch.clear();
+
+        for(size_t y = tile.ymin; y < tile.ymax; ++y) {
+            for(size_t x = tile.xmin; x < tile.xmax; ++x) {
+                // Samples already in the image were resumed from a checkpoint
+                const uint32_t startSample = std::max(firstSample, artifacts.numSamples(x, y));
+                for(uint32_t sampleIndex = startSample; sampleIndex < lastSample; ++sampleIndex) {
+                    PixelSample pixelSample{ uint32_t(x), uint32_t(y), sampleIndex };
+                    sampler.startPixelSample(pixelSample);
+                    batch.rays.push_back(pixelCameraRay(x, y, sampler));
+                    batch.pixelSamples.push_back(pixelSample);
+                }
+            }
+        }
+
+        if(batch.rays.empty()) {
+            return;
+        }
+
+        wavefrontRenderer.traceCameraRays(scene, sampler, minDistance, 1, { VaccuumMedium }, batch,
+                                          &pathStatistics[threadIndex]);
+
+        film.reset(tile);
+        for(size_t rayIndex = 0; rayIndex < batch.rays.size(); ++rayIndex) {
+            const auto & pixelSample = batch.pixelSamples[rayIndex];
+            film.accumPixelRadiance(pixelSample.x, pixelSample.y, batch.radiance[rayIndex]);
+            if(batch.hit[rayIndex]) {
+                artifacts.setIntersection(pixelSample.x, pixelSample.y, minDistance, scene, batch.intersections[rayIndex]);
+            }
+        }
+
+        // Spread the tile time evenly over its pixels
+        const size_t numPixels = size_t(tile.xmax - tile.xmin) * (tile.ymax - tile.ymin);
+        const double pixelTime = tileTimer.elapsed() / numPixels;
+        for(size_t y = tile.ymin; y < tile.ymax; ++y) {
+            for(size_t x = tile.xmin; x < tile.xmax; ++x) {
+                film.accumTime(x, y, pixelTime);
+            }
+        }
+
+        artifacts.mergeTile(film);
+    };
+
+    auto renderTile = [&](const Sensor::Tile & tile, ThreadIndex threadIndex,
+                          uint32_t firstSample, uint32_t lastSample) {
+        if(wavefront) {
+            renderTileWavefront(tile, threadIndex, firstSample, lastSample);
+        }
+        else {
+            renderTileRecursive(tile, threadIndex, firstSample, lastSample);
         }
     };
 
-    renderer.logConfiguration(*logger);
-    renderer.printConfiguration();
+    if(wavefront) {
+        wavefrontRenderer.logConfiguration(*logger);
+        wavefrontRenderer.printConfiguration();
+    }
+    else {
+        renderer.logConfiguration(*logger);
+        renderer.printConfiguration();
+    }
     printf("====[ Tracing Scene ]====\n");
 
     resetFlushTimer();
 
     auto traceTimer = WallClockTimer::makeRunningTimer();
-    uint32_t tileSize = 8;
+    uint32_t tileSize = std::max(options.tileSize, 1u);
+    Sensor::TileOrder tileOrder;
+
+    if(!Sensor::parseTileOrder(options.tileOrder, tileOrder)) {
+        std::cerr << "Unrecognized tile order '" + options.tileOrder + "'\n";
+        return EXIT_FAILURE;
+    }
 
     if(options.renderOrder == "default") {
         options.renderOrder = "tiled";
     }
 
-    if(options.renderOrder == "raster") {
-        // Raster order
-        scene.sensor.forEachPixelThreaded(renderPixelAllSamples, options.numThreads);
-    }
-    else if(options.renderOrder == "tiled") {
-        // Tiled
-        scene.sensor.forEachPixelTiledThreaded(renderPixelAllSamples, tileSize, options.numThreads);
-    }
-    else if(options.renderOrder == "progressive") {
-        // Progressive
-        for(unsigned int sampleIndex = 0; sampleIndex < options.samplesPerPixel; ++sampleIndex) {
-            auto renderPixelOneSample = [&](size_t x, size_t y, size_t threadIndex) {
-                ProcessorTimer pixelTimer = ProcessorTimer::makeRunningTimer();
-                tracePixelRay(x, y, threadIndex, sampleIndex);
-                artifacts.accumTime(x, y, pixelTimer.elapsed());
+    if(options.renderOrder == "adaptive") {
+        // Adaptive: every pixel gets the minimum number of samples, then the
+        // tiles whose relative error is still above the target get that many
+        // more per pass, until every tile meets the target, reaches the
+        // maximum (-s) or the time budget runs out. All tiles still being
+        // refined have the same number of samples, so the sample indices
+        // stay consecutive for the sampler.
+        const uint32_t minSamples = std::max(options.adaptive.minSamplesPerPixel, 2u);
+        const uint32_t maxSamples = std::max(options.samplesPerPixel, minSamples);
+        const float timeBudget = options.adaptive.timeBudget;
+        printf("Adaptive: %u to %u spp, error target %f, time budget %s\n",
+               minSamples, maxSamples, options.adaptive.errorTarget,
+               timeBudget > 0.0f ? hoursMinutesSeconds(timeBudget).c_str() : "none");
+
+        auto activeTiles = scene.sensor.tiles(tileSize, tileOrder);
+        const size_t numTiles = activeTiles.size();
+        uint32_t numSamples = 0;
+
+        while(!activeTiles.empty()) {
+            const uint32_t firstSample = numSamples;
+            const uint32_t lastSample = std::min(numSamples + minSamples, maxSamples);
+            // The first pass always completes, so every pixel has an estimate
+            const bool budgeted = firstSample > 0 && timeBudget > 0.0f;
+
+            auto renderTilePass = [&](const Sensor::Tile & tile, ThreadIndex threadIndex) {
+                if(budgeted && traceTimer.elapsed() > timeBudget) {
+                    return;
+                }
+                renderTile(tile, threadIndex, firstSample, lastSample);
 
                 if(flushImmediate.exchange(false)) {
-                    artifacts.writeAll();
-                    printf("Progress: %.2f %%\n", 100.0f * (float) sampleIndex / (options.samplesPerPixel - 1));
-                    resetFlushTimer();
+                    flushArtifacts();
                 }
             };
-            scene.sensor.forEachPixelTiledThreaded(renderPixelOneSample, tileSize, options.numThreads);
+            Sensor::forEachTileThreaded(activeTiles, renderTilePass, options.numThreads);
+            numSamples = lastSample;
+
+            std::vector<Sensor::Tile> noisyTiles;
+            for(const auto & tile : activeTiles) {
+                if(artifacts.relativeError(tile.xmin, tile.ymin, tile.xmax, tile.ymax) > options.adaptive.errorTarget) {
+                    noisyTiles.push_back(tile);
+                }
+            }
+            printf("Adaptive pass: %u spp, %zu of %zu tiles above error target\n",
+                   numSamples, noisyTiles.size(), numTiles);
+            activeTiles.swap(noisyTiles);
+
+            if(numSamples >= maxSamples) {
+                break;
+            }
+            if(timeBudget > 0.0f && traceTimer.elapsed() > timeBudget) {
+                printf("Adaptive: time budget reached\n");
+                break;
+            }
         }
     }
     else {
-        std::cerr << "Unrecognized render order '" + options.renderOrder + "'\n";
-        return EXIT_FAILURE;
+        if(options.renderOrder == "raster") {
+            tileOrder = Sensor::TileOrder::Raster;
+        }
+        else if(options.renderOrder != "tiled" && options.renderOrder != "progressive") {
+            std::cerr << "Unrecognized render order '" + options.renderOrder + "'\n";
+            return EXIT_FAILURE;
+        }
+
+        auto tiles = scene.sensor.tiles(tileSize, tileOrder);
+
+        if(options.renderOrder == "progressive") {
+            // Progressive
+            for(unsigned int sampleIndex = 0; sampleIndex < options.samplesPerPixel; ++sampleIndex) {
+                auto renderTileOneSample = [&](const Sensor::Tile & tile, ThreadIndex threadIndex) {
+                    renderTile(tile, threadIndex, sampleIndex, sampleIndex + 1);
+
+                    if(flushImmediate.exchange(false)) {
+                        flushArtifacts();
+                        printf("Progress: %.2f %%\n", 100.0f * (float) sampleIndex / (options.samplesPerPixel - 1));
+                    }
+                };
+                Sensor::forEachTileThreaded(tiles, renderTileOneSample, options.numThreads);
+            }
+        }
+        else {
+            // Raster or tiled
+            auto renderTileAllSamples = [&](const Sensor::Tile & tile, ThreadIndex threadIndex) {
+                renderTile(tile, threadIndex, 0, options.samplesPerPixel);
+
+                if(flushImmediate.exchange(false)) {
+                    flushArtifacts();
+                }
+            };
+            Sensor::forEachTileThreaded(tiles, renderTileAllSamples, options.numThreads);
+        }
     }
 
     double traceTime = traceTimer.elapsed();
+    perf::recordPhase(perf::TracePhase, traceTime);
     printf("Scene traced in %s\n", hoursMinutesSeconds(traceTime).c_str());
 
+    const auto & invalid = artifacts.invalidSamples;
+    if(invalid.total() > 0) {
+        printf("WARNING: %llu invalid samples replaced with black (%llu NaN, %llu Inf, %llu negative)\n",
+               (unsigned long long) invalid.total(), (unsigned long long) invalid.nan,
+               (unsigned long long) invalid.inf, (unsigned long long) invalid.negative);
+    }
+    logger->normalf("Invalid samples: %llu NaN, %llu Inf, %llu negative",
+                    (unsigned long long) invalid.nan, (unsigned long long) invalid.inf,
+                    (unsigned long long) invalid.negative);
+
+    PathStatistics totalPathStatistics;
+    for(const auto & statistics : pathStatistics) {
+        totalPathStatistics += statistics;
+    }
+    totalPathStatistics.log(*logger);
+
+    auto outputTimer = WallClockTimer::makeRunningTimer();
     artifacts.writeAll();
+    // Lets a finished render be continued to more samples per pixel
+    writeCheckpoint(artifacts);
+    perf::recordPhase(perf::OutputPhase, outputTimer.elapsed());
+
+    const auto perfReport = perf::report();
+    perfReport.print();
+    perfReport.log(*logger);
+    if(!options.perfJSON.empty()) {
+        std::ofstream perfFile(options.perfJSON);
+        perfFile << perfReport.json();
+        if(!perfFile) {
+            std::cerr << "WARNING: Could not write " << options.perfJSON << '\n';
+        }
+    }
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "TriangleMesh.h"
+#include "TriangleMeshBVH.h"
+#include "TriangleMeshOctree.h"
+#include "TraceableKDTree.h"
+#include "Logger.h"
+#include "SyntheticMeshes.h"
+
+// Mesh accelerators compared on synthetic meshes of 1K to 10M triangles:
+// build time and memory, and closest hit and any hit queries per second
+// for coherent and incoherent rays. Benchmarks run mesh by mesh, so each
+// mesh and its accelerators are made once. Filter by mesh, size or
+// accelerator with --benchmark_filter, eg: --benchmark_filter=/sphere/1000000/
+
+enum class Shape { Soup, Sphere, Slivers };
+enum class Accelerator { BruteForce, Octree, KDTree, BVH };
+
+static const std::vector<std::pair<Shape, const char *>> shapes = {
+    { Shape::Soup, "soup" },
+    { Shape::Sphere, "sphere" },
+    { Shape::Slivers, "slivers" }
+};
+static const std::vector<std::pair<Accelerator, const char *>> accelerators = {
+    { Accelerator::BruteForce, "bruteforce" },
+    { Accelerator::Octree, "octree" },
+    { Accelerator::KDTree, "kdtree" },
+    { Accelerator::BVH, "bvh" }
+};
+static const std::vector<size_t> meshSizes = { 1000, 10000, 100000, 1000000, 10000000 };
+
+// Testing every triangle takes too long on larger meshes
+static const size_t maxBruteForceQueryTriangles = 1000000;
+
+// Every sliver crosses much of the mesh, so queries slow down with the
+// count, and octree nodes reference each sliver many times over
+static const size_t maxSliverTriangles = 1000000;
+static const size_t maxOctreeSliverTriangles = 100000;
+
+// Rays traced per iteration of a query benchmark
+static const uint32_t raysPerQuery = 1024;
+
+// TraceableKDTree holds objects rather than triangles, so it is given the
+// mesh split into small meshes of nearby triangles
+static const uint32_t kdTreeTrianglesPerChunk = 64;
+
+static std::shared_ptr<TriangleMesh> makeMesh(Shape shape, size_t numTriangles)
+{
+    switch(shape) {
+        case Shape::Soup:    return makeRandomSoup(numTriangles, randomSoupTriangleSize(numTriangles));
+        case Shape::Sphere:  return makeTessellatedSphere(numTriangles, Position3(0.0f, 0.0f, 0.0f), 1.0f);
+        case Shape::Slivers: return makeLongThinTriangles(numTriangles);
+    }
+    return nullptr;
+}
+
+static size_t meshSizeInBytes(const TriangleMesh & mesh)
+{
+    const auto & data = *mesh.meshData;
+    return data.vertices.size() * sizeof(Position3)
+        + data.normals.size() * sizeof(Direction3)
+        + (data.indices.vertex.size() + data.indices.normal.size() + data.indices.texcoord.size()) * sizeof(uint32_t)
+        + data.faces.material.size() * sizeof(MaterialID);
+}
+
+// Spread the bits of a 10 bit value three apart
+static uint32_t spreadBits(uint32_t v)
+{
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v <<  8)) & 0x0300F00F;
+    v = (v | (v <<  4)) & 0x030C30C3;
+    v = (v | (v <<  2)) & 0x09249249;
+    return v;
+}
+
+// Split a mesh into meshes of up to trianglesPerChunk triangles, taken in
+// the Morton order of their centroids so each chunk is compact
+static std::vector<TraceablePtr> splitMesh(const TriangleMesh & mesh, uint32_t trianglesPerChunk)
+{
+    const uint32_t numTriangles = uint32_t(mesh.numTriangles());
+    const Slab & bounds = mesh.meshData->bounds;
+    const vec3 lower(bounds.xmin, bounds.ymin, bounds.zmin);
+    const vec3 extent(std::max(bounds.xmax - bounds.xmin, 1.0e-6f),
+                      std::max(bounds.ymax - bounds.ymin, 1.0e-6f),
+                      std::max(bounds.zmax - bounds.zmin, 1.0e-6f));
+
+    std::vector<std::pair<uint32_t, uint32_t>> codes(numTriangles);
+    for(uint32_t tri = 0; tri < numTriangles; ++tri) {
+        const vec3 centroid = (vec3(mesh.triangleVertex(tri, 0)) + vec3(mesh.triangleVertex(tri, 1))
+                               + vec3(mesh.triangleVertex(tri, 2))) / 3.0f;
+        auto cell = [&](float p, float low, float size) {
+            return std::min(uint32_t((p - low) / size * 1024.0f), 1023u);
+        };
+        codes[tri].first = (spreadBits(cell(centroid.x, lower.x, extent.x)) << 2)
+                         | (spreadBits(cell(centroid.y, lower.y, extent.y)) << 1)
+                         |  spreadBits(cell(centroid.z, lower.z, extent.z));
+        codes[tri].second = tri;
+    }
+    std::sort(codes.begin(), codes.end());
+
+    std::vector<TraceablePtr> chunks;
+    for(uint32_t first = 0; first < numTriangles; first += trianglesPerChunk) {
+        const uint32_t last = std::min(first + trianglesPerChunk, numTriangles);
+        auto chunk = std::make_shared<TriangleMesh>();
+        auto & data = *chunk->meshData;
+        for(uint32_t ci = first; ci < last; ++ci) {
+            for(uint32_t i = 0; i < 3; ++i) {
+                data.indices.vertex.push_back(uint32_t(data.vertices.size()));
+                data.vertices.push_back(mesh.triangleVertex(codes[ci].second, i));
+            }
+        }
+        finishSyntheticMesh(*chunk);
+        chunk->buildPackets();
+        chunks.push_back(chunk);
+    }
+    return chunks;
+}
+
+// A built accelerator and the memory it takes, apart from the mesh
+struct BuiltAccelerator {
+    TraceablePtr traceable;
+    size_t bytes = 0;
+};
+
+static BuiltAccelerator buildAccelerator(Accelerator accelerator, std::shared_ptr<TriangleMesh> & mesh)
+{
+    BuiltAccelerator built;
+    switch(accelerator) {
+        case Accelerator::BruteForce: {
+            // A copy shares the mesh data, but has packets of its own
+            auto packed = std::make_shared<TriangleMesh>(*mesh);
+            packed->buildPackets();
+            built.bytes = packed->packets.size() * sizeof(TrianglePacket);
+            built.traceable = packed;
+            break;
+        }
+        case Accelerator::Octree: {
+            auto octree = std::make_shared<TriangleMeshOctree>(mesh);
+            octree->build();
+            built.bytes = octree->sizeInBytes();
+            built.traceable = octree;
+            break;
+        }
+        case Accelerator::KDTree: {
+            auto chunks = splitMesh(*mesh, kdTreeTrianglesPerChunk);
+            auto kdtree = std::make_shared<TraceableKDTree>();
+            kdtree->build(chunks);
+            built.bytes = kdtree->sizeInBytes();
+            for(const auto & chunk : chunks) {
+                const auto & chunkMesh = static_cast<const TriangleMesh &>(*chunk);
+                built.bytes += meshSizeInBytes(chunkMesh) + chunkMesh.packets.size() * sizeof(TrianglePacket);
+            }
+            built.traceable = kdtree;
+            break;
+        }
+        case Accelerator::BVH: {
+            auto bvh = std::make_shared<TriangleMeshBVH>(mesh);
+            bvh->build();
+            built.bytes = bvh->bvh.sizeInBytes() + bvh->packets.size() * sizeof(TrianglePacket);
+            built.traceable = bvh;
+            break;
+        }
+    }
+    return built;
+}
+
+// Rays toward a mesh from three times its bounding radius away
+//   coherent:   through a grid over the mesh from one point, in raster order
+//   incoherent: from random points around the mesh toward random points in it
+static std::vector<Ray> makeRays(const Slab & bounds, bool coherent, uint32_t numRays)
+{
+    const Position3 center = bounds.midpoint();
+    const float radius = 0.5f * Direction3(bounds.xmax - bounds.xmin,
+                                           bounds.ymax - bounds.ymin,
+                                           bounds.zmax - bounds.zmin).magnitude();
+    std::vector<Ray> rays;
+    rays.reserve(numRays);
+
+    if(coherent) {
+        const uint32_t side = uint32_t(std::ceil(std::sqrt(float(numRays))));
+        const Position3 eye = center + Direction3(0.0f, 0.0f, 3.0f * radius);
+        for(uint32_t ri = 0; ri < numRays; ++ri) {
+            const float x = ((ri % side) + 0.5f) / side * 2.0f - 1.0f;
+            const float y = ((ri / side) + 0.5f) / side * 2.0f - 1.0f;
+            const Position3 target = center + Direction3(x * radius, y * radius, 0.0f);
+            rays.emplace_back(eye, (target - eye).normalized());
+        }
+        return rays;
+    }
+
+    std::mt19937 engine(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    for(uint32_t ri = 0; ri < numRays; ++ri) {
+        Direction3 away(randomVec3(engine, unit));
+        while(away.magnitude() < 1.0e-3f) {
+            away = Direction3(randomVec3(engine, unit));
+        }
+        const Position3 origin = center + away.normalized() * (3.0f * radius);
+        const vec3 u = randomVec3(engine, unit);
+        const Position3 target(center.x + u.x * 0.5f * (bounds.xmax - bounds.xmin),
+                               center.y + u.y * 0.5f * (bounds.ymax - bounds.ymin),
+                               center.z + u.z * 0.5f * (bounds.zmax - bounds.zmin));
+        rays.emplace_back(origin, (target - origin).normalized());
+    }
+    return rays;
+}
+
+// The mesh being benchmarked and its accelerators, built on first use
+struct MeshFixture {
+    Shape shape;
+    size_t numTriangles;
+    std::shared_ptr<TriangleMesh> mesh;
+    std::map<Accelerator, BuiltAccelerator> built;
+};
+
+static MeshFixture & meshFixture(Shape shape, size_t numTriangles)
+{
+    static std::unique_ptr<MeshFixture> fixture;
+    if(!fixture || fixture->shape != shape || fixture->numTriangles != numTriangles) {
+        fixture.reset();   // free the previous mesh first
+        fixture = std::make_unique<MeshFixture>();
+        fixture->shape = shape;
+        fixture->numTriangles = numTriangles;
+        fixture->mesh = makeMesh(shape, numTriangles);
+    }
+    return *fixture;
+}
+
+static const BuiltAccelerator & builtAccelerator(MeshFixture & fixture, Accelerator accelerator)
+{
+    auto found = fixture.built.find(accelerator);
+    if(found == fixture.built.end()) {
+        found = fixture.built.emplace(accelerator, buildAccelerator(accelerator, fixture.mesh)).first;
+    }
+    return found->second;
+}
+
+static void Build(benchmark::State & state, Shape shape, size_t numTriangles, Accelerator accelerator)
+{
+    auto & fixture = meshFixture(shape, numTriangles);
+    size_t bytes = 0;
+    for(auto _ : state) {
+        auto built = buildAccelerator(accelerator, fixture.mesh);
+        bytes = built.bytes;
+        benchmark::DoNotOptimize(built.traceable);
+    }
+    const double MB = 1024.0 * 1024.0;
+    state.counters["triangles"] = double(fixture.mesh->numTriangles());
+    state.counters["meshMB"] = meshSizeInBytes(*fixture.mesh) / MB;
+    state.counters["accelMB"] = bytes / MB;
+}
+
+static void Query(benchmark::State & state, Shape shape, size_t numTriangles, Accelerator accelerator,
+                  bool closest, bool coherent)
+{
+    auto & fixture = meshFixture(shape, numTriangles);
+    const Traceable & traceable = *builtAccelerator(fixture, accelerator).traceable;
+    const auto rays = makeRays(fixture.mesh->meshData->bounds, coherent, raysPerQuery);
+    const float minDistance = 0.0f;
+    const float maxDistance = std::numeric_limits<float>::max();
+
+    uint64_t hits = 0;
+    for(auto _ : state) {
+        for(const auto & ray : rays) {
+            bool hit;
+            if(closest) {
+                RayHit rayHit;
+                hit = traceable.findHit(ray, minDistance, rayHit);
+                benchmark::DoNotOptimize(rayHit);
+            }
+            else {
+                hit = traceable.intersects(ray, minDistance, maxDistance);
+            }
+            hits += hit ? 1 : 0;
+        }
+    }
+    // Items per second is queries per second
+    state.SetItemsProcessed(state.iterations() * rays.size());
+    state.counters["hitRate"] = double(hits) / double(state.iterations() * rays.size());
+}
+
+int main(int argc, char ** argv)
+{
+    // Accelerator builds log to a file instead of the console
+    setLogger(std::make_shared<FileLogger>("accelerators_bench.log"));
+
+    for(const auto & shape : shapes) {
+        for(size_t numTriangles : meshSizes) {
+            if(shape.first == Shape::Slivers && numTriangles > maxSliverTriangles) {
+                continue;
+            }
+            for(const auto & accelerator : accelerators) {
+                if(shape.first == Shape::Slivers && accelerator.first == Accelerator::Octree
+                   && numTriangles > maxOctreeSliverTriangles) {
+                    continue;
+                }
+                const std::string name = std::string("/") + shape.second + "/" + std::to_string(numTriangles)
+                    + "/" + accelerator.second;
+                benchmark::RegisterBenchmark(("Build" + name).c_str(), Build,
+                                             shape.first, numTriangles, accelerator.first)
+                    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+                if(accelerator.first == Accelerator::BruteForce && numTriangles > maxBruteForceQueryTriangles) {
+                    continue;
+                }
+                for(bool closest : { true, false }) {
+                    for(bool coherent : { true, false }) {
+                        const std::string query = std::string(closest ? "ClosestHit" : "AnyHit")
+                            + (coherent ? "Coherent" : "Incoherent");
+                        benchmark::RegisterBenchmark((query + name).c_str(), Query,
+                                                     shape.first, numTriangles, accelerator.first,
+                                                     closest, coherent)
+                            ->Unit(benchmark::kMicrosecond);
+                    }
+                }
+            }
+        }
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if(benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "LatLonEnvironmentMap.h"
+#include "CubeMapEnvironmentMap.h"
+#include "rng.h"
+
+static Image<float> makeEnvMapImage(size_t w, size_t h)
+{
+    std::mt19937 engine(1);
+    std::uniform_real_distribution<float> value(0.0f, 1.0f);
+    Image<float> image(w, h, 3);
+    for(auto & v : image.data) {
+        v = value(engine);
+    }
+    return image;
+}
+
+// Reference of the previous lat/lon sampler: a binary search over the
+// cumulative row sums, then over the cumulative sums of the chosen row
+struct RefBinarySearchSampler
+{
+    RefBinarySearchSampler(const Image<float> & image)
+        : w(image.width), h(image.height),
+          rowSums(image.width * image.height), cumRows(image.height)
+    {
+        float total = 0.0f;
+        for(size_t y = 0; y < h; ++y) {
+            float row = 0.0f;
+            for(size_t x = 0; x < w; ++x) {
+                row += image.channelSum(x, y);
+                rowSums[y * w + x] = row;
+            }
+            for(size_t x = 0; x < w; ++x) {
+                rowSums[y * w + x] /= row;
+            }
+            total += row * std::sin((float(y) + 0.5f) / float(h) * float(M_PI));
+            cumRows[y] = total;
+        }
+        for(auto & c : cumRows) {
+            c /= total;
+        }
+    }
+
+    vec2 sample(float e1, float e2) const {
+        size_t y = std::min(size_t(std::upper_bound(cumRows.begin(), cumRows.end(), e2) - cumRows.begin()), h - 1);
+        auto row = rowSums.begin() + y * w;
+        size_t x = std::min(size_t(std::upper_bound(row, row + w, e1) - row), w - 1);
+        return { float(x) + 0.5f, float(y) + 0.5f };
+    }
+
+    size_t w, h;
+    std::vector<float> rowSums;
+    std::vector<float> cumRows;
+};
+
+static void Ref_LatLonEnvMap_BinarySearch(benchmark::State& state) {
+    RefBinarySearchSampler sampler(makeEnvMapImage(state.range(0), state.range(0) / 2));
+    RNG rng;
+    for (auto _ : state) {
+        vec2 e = rng.uniform2DRange01();
+        benchmark::DoNotOptimize(sampler.sample(e.x, e.y));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(Ref_LatLonEnvMap_BinarySearch)->Arg(512)->Arg(2048)->Arg(8192);
+
+static void LatLonEnvMap_ImportanceSample(benchmark::State& state) {
+    LatLonEnvironmentMap envmap;
+    envmap.loadFromImage(makeEnvMapImage(state.range(0), state.range(0) / 2));
+    RNG rng;
+    float pdf;
+    for (auto _ : state) {
+        vec2 e = rng.uniform2DRange01();
+        benchmark::DoNotOptimize(envmap.importanceSample(e.x, e.y, pdf));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(LatLonEnvMap_ImportanceSample)->Arg(512)->Arg(2048)->Arg(8192);
+
+static void LatLonEnvMap_ImportanceSampleDirection(benchmark::State& state) {
+    LatLonEnvironmentMap envmap;
+    envmap.loadFromImage(makeEnvMapImage(state.range(0), state.range(0) / 2));
+    RNG rng;
+    for (auto _ : state) {
+        vec2 e = rng.uniform2DRange01();
+        benchmark::DoNotOptimize(envmap.importanceSampleDirection(e.x, e.y));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(LatLonEnvMap_ImportanceSampleDirection)->Arg(512)->Arg(2048)->Arg(8192);
+
+static void CubeMapEnvMap_ImportanceSampleDirection(benchmark::State& state) {
+    CubeMapEnvironmentMap envmap;
+    envmap.loadFromDirectionFiles("grayramp", "grayramp", "grayramp",
+                                  "grayramp", "grayramp", "grayramp");
+    RNG rng;
+    for (auto _ : state) {
+        vec2 e = rng.uniform2DRange01();
+        benchmark::DoNotOptimize(envmap.importanceSampleDirection(e.x, e.y));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(CubeMapEnvMap_ImportanceSampleDirection);
+
+BENCHMARK_MAIN();
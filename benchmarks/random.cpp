@@ -1,5 +1,7 @@
+#include <random>
 #include <benchmark/benchmark.h>
 #include "rng.h"
+#include "Sampler.h"
 
 // Reference of C++ RNG Engines
 
@@ -82,6 +84,15 @@ static void RandomUniform01(benchmark::State& state) {
 }
 BENCHMARK(RandomUniform01);
 
+static void RandomForPixelSample(benchmark::State& state) {
+    uint32_t sampleIndex = 0;
+    for (auto _ : state) {
+        RNG rng = RNG::forPixelSample(17, 42, sampleIndex++);
+        benchmark::DoNotOptimize(rng.uniform01());
+    }
+}
+BENCHMARK(RandomForPixelSample);
+
 static void RandomUniformRange(benchmark::State& state) {
     RNG rng;
     for (auto _ : state) {
@@ -146,5 +157,23 @@ static void RandomSurfaceUnitHalfSphereCosineDistributionXYZ(benchmark::State& s
 }
 BENCHMARK(RandomSurfaceUnitHalfSphereCosineDistributionXYZ);
 
+// Samplers: one pixel sample with a full bounce of 2D values
+
+static void SamplerBounce2D(benchmark::State& state, const char * name) {
+    auto sampler = makeSampler(name);
+    uint32_t index = 0;
+    for (auto _ : state) {
+        sampler->startPixelSample(PixelSample{ 3, 5, index++ });
+        sampler->startBounce(1);
+        for(uint32_t d = 0; d < Sampler::BOUNCE_DIMENSIONS; d += 2) {
+            benchmark::DoNotOptimize(sampler->get2D());
+        }
+    }
+}
+BENCHMARK_CAPTURE(SamplerBounce2D, random, "random");
+BENCHMARK_CAPTURE(SamplerBounce2D, halton, "halton");
+BENCHMARK_CAPTURE(SamplerBounce2D, sobol, "sobol");
+BENCHMARK_CAPTURE(SamplerBounce2D, bluenoise, "bluenoise");
+
 BENCHMARK_MAIN();
 
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <vector>
 #include "Triangle.h"
+#include "TrianglePacket.h"
 
 static void RayTriangleIntersectsAnySingleHit(benchmark::State& state) {
     Ray ray(Position3(0, 0, 10), Direction3(0, 0, -1));
@@ -191,5 +192,86 @@ static void RayBundleTriangleArrayIntersectsAnyMissAll(benchmark::State& state)
 BENCHMARK(RayBundleTriangleArrayIntersectsAnyMissAll)
     ->RangeMultiplier(8)->Ranges({{1, 1 << 10}, {1, 1 << 8}});
 
+// Packed triangles. The second argument selects the kernel
+// (0: scalar, 1: SSE, 2: AVX2).
+
+static bool selectTriangleKernel(benchmark::State& state) {
+    auto kernel = TriangleKernel(state.range(1));
+    if(!setTriangleKernel(kernel)) {
+        state.SkipWithError("Triangle kernel not supported on this CPU");
+        return false;
+    }
+    state.SetLabel(triangleKernelString(kernel));
+    return true;
+}
+
+static TrianglePacketArray makeStackedTrianglePackets(int nTri) {
+    TrianglePacketArray packets(TrianglePacket::numPacketsFor(nTri));
+    for(auto & packet : packets) { packet.clear(); }
+    for(int i = 0; i < nTri; ++i) {
+        float z = -0.1 * float(nTri - i - 1);
+        packets[i / TrianglePacket::WIDTH].set(i % TrianglePacket::WIDTH,
+                                               vec3(-5, -5, z), vec3(5, -5, z), vec3(0, 5, z), i);
+    }
+    return packets;
+}
+
+static void RayTrianglePacketsIntersectsAnyHitAll(benchmark::State& state) {
+    if(!selectTriangleKernel(state)) { return; }
+    Ray ray(Position3(0, 0, 10), Direction3(0, 0, -1));
+    const int nTri = state.range(0);
+    auto packets = makeStackedTrianglePackets(nTri);
+
+    benchmark::DoNotOptimize(ray);
+    benchmark::DoNotOptimize(packets);
+
+    for (auto _ : state) {
+        bool hit = intersectsAnyTriangle(ray, &packets[0], packets.size(), 0.01, 100.0);
+        benchmark::DoNotOptimize(hit);
+    }
+    state.SetItemsProcessed(state.iterations() * nTri);
+}
+BENCHMARK(RayTrianglePacketsIntersectsAnyHitAll)
+    ->ArgsProduct({benchmark::CreateRange(8, 1 << 20, 8), {0, 1, 2}});
+
+static void RayTrianglePacketsIntersectsAnyMissAll(benchmark::State& state) {
+    if(!selectTriangleKernel(state)) { return; }
+    Ray ray(Position3(0, 0, 10), Direction3(0, 1, 0));
+    const int nTri = state.range(0);
+    auto packets = makeStackedTrianglePackets(nTri);
+
+    benchmark::DoNotOptimize(ray);
+    benchmark::DoNotOptimize(packets);
+
+    for (auto _ : state) {
+        bool hit = intersectsAnyTriangle(ray, &packets[0], packets.size(), 0.01, 100.0);
+        benchmark::DoNotOptimize(hit);
+    }
+    state.SetItemsProcessed(state.iterations() * nTri);
+}
+BENCHMARK(RayTrianglePacketsIntersectsAnyMissAll)
+    ->ArgsProduct({benchmark::CreateRange(8, 1 << 20, 8), {0, 1, 2}});
+
+static void RayTrianglePacketsFindClosestAllHit(benchmark::State& state) {
+    if(!selectTriangleKernel(state)) { return; }
+    Ray ray(Position3(0, 0, 10), Direction3(0, 0, -1));
+    const int nTri = state.range(0);
+    auto packets = makeStackedTrianglePackets(nTri);
+
+    benchmark::DoNotOptimize(ray);
+    benchmark::DoNotOptimize(packets);
+
+    for (auto _ : state) {
+        float distance = 100.0f;
+        uint32_t triangle = 0;
+        bool hit = findClosestTriangle(ray, &packets[0], packets.size(), 0.01, distance, triangle);
+        benchmark::DoNotOptimize(hit);
+        benchmark::DoNotOptimize(triangle);
+    }
+    state.SetItemsProcessed(state.iterations() * nTri);
+}
+BENCHMARK(RayTrianglePacketsFindClosestAllHit)
+    ->ArgsProduct({benchmark::CreateRange(8, 1 << 20, 8), {0, 1, 2}});
+
 BENCHMARK_MAIN();
 
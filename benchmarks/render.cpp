@@ -0,0 +1,239 @@
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <sys/resource.h>
+#include "scene.h"
+#include "Sampler.h"
+#include "Renderer.h"
+#include "WavefrontRenderer.h"
+#include "PerfCounters.h"
+#include "rng.h"
+#include "timer.h"
+#include "SyntheticMeshes.h"
+
+// End to end renders of whole scenes. Each benchmark loads a scene, builds
+// its accelerators and traces every pixel of a small image on one thread
+// with a fixed seed, so runs of different commits do the same work. The
+// time of an iteration is the time to render the image to renderSamples
+// samples per pixel. Save the results for diffing with
+//
+//   render_bench --benchmark_out=render.json --benchmark_out_format=json
+//
+// Only scenes that need no downloaded models or textures are used.
+
+static const uint32_t renderWidth = 160;
+static const uint32_t renderSamples = 4;
+static const uint64_t renderSeed = 1;
+
+// Peak resident set size of the process so far. It never goes down, so run
+// one benchmark per process (--benchmark_filter) to compare scenes.
+static double peakRSSMB()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return double(usage.ru_maxrss) / (1024.0 * 1024.0);  // bytes
+#else
+    return double(usage.ru_maxrss) / 1024.0;             // kilobytes
+#endif
+}
+
+// Trace every pixel of the image, with the same camera rays as trace_scene.
+// Returns the sum of the radiance, to keep the work from being optimized out.
+static RadianceRGB renderImage(Scene & scene, const WavefrontRenderer & renderer,
+                               bool wavefront, Sampler & sampler,
+                               WavefrontRenderer::CameraRayBatch & batch)
+{
+    auto pixelCameraRay = [&](size_t x, size_t y) {
+        const vec2 pixelCenter = vec2(x, y) + vec2(0.5f, 0.5f);
+        vec2 jitteredPixel = pixelCenter + RNG::gaussian2D(sampler.get2D(), 0.5f);
+        auto standardPixel = scene.sensor.pixelStandardImageLocation(jitteredPixel);
+        vec2 randomBlurCoord = RNG::uniformUnitCircle(sampler.get2D());
+        return scene.camera->rayThroughStandardImagePlane(standardPixel, randomBlurCoord);
+    };
+
+    const float minDistance = 0.0f;
+    RadianceRGB total;
+
+    for(uint32_t y = 0; y < scene.sensor.pixelheight; ++y) {
+        // Wavefront traces a row at a time
+        batch.clear();
+        for(uint32_t x = 0; x < scene.sensor.pixelwidth; ++x) {
+            for(uint32_t sampleIndex = 0; sampleIndex < renderSamples; ++sampleIndex) {
+                PixelSample pixelSample{ x, y, sampleIndex };
+                sampler.startPixelSample(pixelSample);
+                auto ray = pixelCameraRay(x, y);
+                if(wavefront) {
+                    batch.rays.push_back(ray);
+                    batch.pixelSamples.push_back(pixelSample);
+                    continue;
+                }
+                RayIntersection intersection;
+                RadianceRGB Lo;
+                renderer.traceCameraRay(scene, sampler, ray, minDistance, 1, { VaccuumMedium }, intersection, Lo);
+                total += Lo;
+            }
+        }
+        if(wavefront) {
+            renderer.traceCameraRays(scene, sampler, minDistance, 1, { VaccuumMedium }, batch);
+            for(const auto & Lo : batch.radiance) {
+                total += Lo;
+            }
+        }
+    }
+
+    return total;
+}
+
+// Builds a scene, adding the time spent building mesh accelerators to
+// meshBuildTime
+using SceneBuilder = std::function<bool(Scene & scene, double & meshBuildTime)>;
+
+// Load or generate a scene, then render it with the recursive or wavefront
+// integrator (argument 0)
+static void renderScene(benchmark::State & state, const SceneBuilder & buildScene)
+{
+    Scene scene;
+    double meshBuildTime = 0.0;
+    auto loadTimer = WallClockTimer::makeRunningTimer();
+    if(!buildScene(scene, meshBuildTime)) {
+        state.SkipWithError("Could not load scene");
+        return;
+    }
+    const double loadTime = loadTimer.elapsed() - meshBuildTime;
+
+    // Same aspect ratio, so the camera's field of view still fits
+    const float aspect = scene.sensor.aspectRatio();
+    scene.sensor = Sensor(renderWidth, std::max(uint32_t(1), uint32_t(std::lround(renderWidth / aspect))));
+
+    auto buildTimer = WallClockTimer::makeRunningTimer();
+    scene.buildAccelerators();
+    const double buildTime = buildTimer.elapsed() + meshBuildTime;
+
+    WavefrontRenderer renderer;
+    const bool wavefront = state.range(0) != 0;
+    RandomSampler sampler(renderSeed);
+    WavefrontRenderer::CameraRayBatch batch;
+
+    perf::reset();
+    auto traceTimer = WallClockTimer::makeRunningTimer();
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(renderImage(scene, renderer, wavefront, sampler, batch));
+    }
+    const double traceTime = traceTimer.elapsed();
+    const auto report = perf::report();
+
+    auto megaRaysPerSecond = [&](uint64_t rays) { return double(rays) / traceTime * 1.0e-6; };
+
+    state.counters["loadSec"] = loadTime;
+    state.counters["buildSec"] = buildTime;
+    state.counters["primaryMrays/s"] = megaRaysPerSecond(report[perf::CameraRays]);
+    // Light and environment map samples
+    state.counters["shadowMrays/s"] = megaRaysPerSecond(report[perf::ShadowRays] + report[perf::EnvMapRays]);
+    state.counters["secondaryMrays/s"] = megaRaysPerSecond(report[perf::BounceRays]);
+    state.counters["peakRSSMB"] = peakRSSMB();
+    state.counters["spp"] = renderSamples;
+}
+
+// Scene file from the bundled scenes. Their mesh accelerators build while
+// the file loads, so only the top level accelerators count as build time.
+static void renderSceneFile(benchmark::State & state, const char * file)
+{
+    renderScene(state, [file](Scene & scene, double & meshBuildTime) {
+        return loadSceneFromFile(scene, std::string(FLUXRT_SCENE_DIR) + "/" + file);
+    });
+}
+
+// Box with red and green side walls, lit by an emissive square in the
+// ceiling, holding a mirror sphere and a tessellated diffuse sphere of
+// argument 1 triangles (none if 0)
+static bool buildCornellBox(Scene & scene, size_t numTriangles, double & meshBuildTime)
+{
+    scene.materials.push_back(Material::makeDiffuse(ReflectanceRGB(0.75f, 0.75f, 0.75f)));
+    scene.materials.push_back(Material::makeDiffuse(ReflectanceRGB(0.75f, 0.2f, 0.2f)));
+    scene.materials.push_back(Material::makeDiffuse(ReflectanceRGB(0.2f, 0.75f, 0.2f)));
+    scene.materials.push_back(Material::makeEmissive(RadianceRGB(15.0f, 15.0f, 15.0f)));
+    scene.materials.push_back(Material::makeMirror());
+    const MaterialID white = 0, red = 1, green = 2, light = 3, mirror = 4;
+
+    // Room [-1,1] x [0,2] x [-1,1], open toward the camera
+    auto room = std::make_shared<TriangleMesh>();
+    auto & data = *room->meshData;
+    auto addQuad = [&](const Position3 & a, const Position3 & b, const Position3 & c, const Position3 & d,
+                       MaterialID material) {
+        const uint32_t first = uint32_t(data.vertices.size());
+        data.vertices.insert(data.vertices.end(), { a, b, c, d });
+        data.indices.vertex.insert(data.indices.vertex.end(),
+                                   { first, first + 1, first + 2, first, first + 2, first + 3 });
+        data.faces.material.insert(data.faces.material.end(), { material, material });
+    };
+    const float l = 0.25f;
+    addQuad(Position3(-1, 0, -1), Position3( 1, 0, -1), Position3( 1, 0,  1), Position3(-1, 0,  1), white);
+    addQuad(Position3(-1, 2, -1), Position3(-1, 2,  1), Position3( 1, 2,  1), Position3( 1, 2, -1), white);
+    addQuad(Position3(-1, 0, -1), Position3(-1, 2, -1), Position3( 1, 2, -1), Position3( 1, 0, -1), white);
+    addQuad(Position3(-1, 0, -1), Position3(-1, 0,  1), Position3(-1, 2,  1), Position3(-1, 2, -1), red);
+    addQuad(Position3( 1, 0, -1), Position3( 1, 2, -1), Position3( 1, 2,  1), Position3( 1, 0,  1), green);
+    addQuad(Position3(-l, 1.99f, -l), Position3(-l, 1.99f, l), Position3(l, 1.99f, l), Position3(l, 1.99f, -l), light);
+    finishSyntheticMesh(*room);
+    auto roomBVH = std::make_shared<TriangleMeshBVH>(room);
+    scene.objects.push_back(roomBVH);
+    std::vector<std::shared_ptr<TriangleMeshBVH>> meshBVHs = { roomBVH };
+
+    auto sphere = std::make_shared<Sphere>(Position3(0.45f, 0.35f, -0.3f), 0.35f);
+    sphere->material = mirror;
+    scene.objects.push_back(sphere);
+
+    if(numTriangles > 0) {
+        auto mesh = makeTessellatedSphere(numTriangles, Position3(-0.4f, 0.45f, 0.2f), 0.45f);
+        mesh->material = white;
+        auto meshBVH = std::make_shared<TriangleMeshBVH>(mesh);
+        scene.objects.push_back(meshBVH);
+        meshBVHs.push_back(meshBVH);
+    }
+
+    auto buildTimer = WallClockTimer::makeRunningTimer();
+    for(auto & meshBVH : meshBVHs) {
+        meshBVH->build();
+    }
+    meshBuildTime += buildTimer.elapsed();
+
+    scene.sensor = Sensor(renderWidth, renderWidth);
+    const float fov = DegreesToRadians(40.0f);
+    scene.camera = std::make_shared<PinholeCamera>(fov, fov);
+    scene.camera->setPositionDirectionUp(Position3(0.0f, 1.0f, 3.7f),
+                                         Direction3(0.0f, 0.0f, -1.0f),
+                                         Direction3(0.0f, 1.0f, 0.0f));
+    return true;
+}
+
+static void renderCornellBox(benchmark::State & state)
+{
+    const size_t numTriangles = size_t(state.range(1));
+    renderScene(state, [numTriangles](Scene & scene, double & meshBuildTime) {
+        return buildCornellBox(scene, numTriangles, meshBuildTime);
+    });
+}
+
+static void renderSettings(benchmark::internal::Benchmark * b)
+{
+    b->Unit(benchmark::kMillisecond)->Iterations(1)->UseRealTime();
+}
+
+BENCHMARK_CAPTURE(renderSceneFile, sphere, "sphere.toml")
+    ->ArgName("wavefront")->Arg(0)->Arg(1)->Apply(renderSettings);
+BENCHMARK_CAPTURE(renderSceneFile, many_spheres, "complex/many_spheres.toml")
+    ->ArgName("wavefront")->Arg(0)->Arg(1)->Apply(renderSettings);
+BENCHMARK_CAPTURE(renderSceneFile, cube_stack_area_light, "cube_stack_area_light.toml")
+    ->ArgName("wavefront")->Arg(0)->Arg(1)->Apply(renderSettings);
+BENCHMARK_CAPTURE(renderSceneFile, disk_light_shadow, "disklight/disk-light-casts-shadow.toml")
+    ->ArgName("wavefront")->Arg(0)->Arg(1)->Apply(renderSettings);
+BENCHMARK_CAPTURE(renderSceneFile, refracting_caustic, "caustics/disk-light-refracting-caustic-sphere-above.toml")
+    ->ArgName("wavefront")->Arg(0)->Arg(1)->Apply(renderSettings);
+
+BENCHMARK(renderCornellBox)
+    ->ArgNames({"wavefront", "triangles"})
+    ->ArgsProduct({{0, 1}, {0, 1 << 10, 1 << 14, 1 << 17, 1 << 20}})
+    ->Apply(renderSettings);
+
+BENCHMARK_MAIN();
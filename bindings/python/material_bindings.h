@@ -10,5 +10,25 @@ void material_bindings(py::module_ & m)
         ;
 
     m.attr("VaccuumMedium") = py::cast(VaccuumMedium);
+
+    py::class_<MediumStack, std::shared_ptr<MediumStack>>(m, "MediumStack")
+        // constructors
+        .def(py::init<>())
+        .def(py::init([](const std::vector<Medium> & media) {
+            MediumStack stack;
+            for(const auto & medium : media) {
+                stack.push_back(medium);
+            }
+            return stack;
+        }))
+        // methods
+        .def("push_back", &MediumStack::push_back)
+        .def("pop_back", &MediumStack::pop_back)
+        .def("back", &MediumStack::back)
+        .def("__len__", &MediumStack::size)
+        ;
+
+    // Lists of media, like [ VaccuumMedium ], pass as medium stacks
+    py::implicitly_convertible<py::list, MediumStack>();
 }
 
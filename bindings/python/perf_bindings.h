@@ -0,0 +1,43 @@
+
+void perf_bindings(py::module_ & m)
+{
+    // perf submodule
+    auto m_perf = m.def_submodule("perf");
+
+    py::enum_<perf::Counter>(m_perf, "Counter")
+        .value("CameraRays", perf::CameraRays)
+        .value("BounceRays", perf::BounceRays)
+        .value("ShadowRays", perf::ShadowRays)
+        .value("EnvMapRays", perf::EnvMapRays)
+        .value("NodesVisited", perf::NodesVisited)
+        .value("TriangleTests", perf::TriangleTests)
+        .value("ShadingCalls", perf::ShadingCalls)
+        ;
+
+    py::class_<perf::Report, std::shared_ptr<perf::Report>>(m_perf, "Report")
+        // constructors
+        .def(py::init<>())
+        // methods
+        .def("__getitem__", &perf::Report::operator[])
+        .def("rays", &perf::Report::rays)
+        .def("phaseTime", &perf::Report::phaseTime)
+        .def("megaRaysPerSecond", &perf::Report::megaRaysPerSecond)
+        .def("json", &perf::Report::json)
+        .def("print", &perf::Report::print,
+             py::call_guard<py::scoped_ostream_redirect>())
+        // properties
+        .def_property_readonly("counts", [](const perf::Report & report) {
+            py::dict counts;
+            for(unsigned int counter = 0; counter < perf::NumCounters; ++counter) {
+                counts[perf::counterName(perf::Counter(counter))] = report.counts[counter];
+            }
+            return counts;
+        })
+        .def_readonly("phases", &perf::Report::phases)
+        ;
+
+    // perf free functions
+    m_perf.def("report", &perf::report);
+    m_perf.def("reset", &perf::reset);
+    m_perf.def("recordPhase", &perf::recordPhase);
+}
@@ -17,6 +17,7 @@ struct PYBIND11_EXPORT Camera;
 #include "Ray.h"
 #include "Renderer.h"
 #include "rng.h"
+#include "Sampler.h"
 #include "scene.h"
 #include "sensor.h"
 #include "radiometry.h"
@@ -28,6 +29,7 @@ struct PYBIND11_EXPORT Camera;
 #include "GradientEnvironmentMap.h"
 #include "LatLonEnvironmentMap.h"
 #include "CubeMapEnvironmentMap.h"
+#include "PerfCounters.h"
 
 // Bindings
 #include "vec2_bindings.h"
@@ -39,11 +41,13 @@ struct PYBIND11_EXPORT Camera;
 #include "camera_bindings.h"
 #include "radiometry_bindings.h"
 #include "rng_bindings.h"
+#include "sampler_bindings.h"
 #include "material_bindings.h"
 #include "microfacet_bindings.h"
 #include "fresnel_bindings.h"
 #include "optics_bindings.h"
 #include "envmap_bindings.h"
+#include "perf_bindings.h"
 
 PYBIND11_MODULE(pyfluxrt, m) {
     m.doc() = "Python bindings for fluxrt";
@@ -57,10 +61,12 @@ PYBIND11_MODULE(pyfluxrt, m) {
     camera_bindings(m);
     radiometry_bindings(m);
     rng_bindings(m);
+    sampler_bindings(m);
     material_bindings(m);
     microfacet_bindings(m);
     fresnel_bindings(m);
     optics_bindings(m);
     envmap_bindings(m);
+    perf_bindings(m);
 }
 
@@ -5,32 +5,35 @@ void renderer_bindings(py::module_ & m)
         // constructors
         .def(py::init<>())
         // methods
+        // Path statistics are not exposed
+        .def("traceRay", [](const Renderer & renderer, const Scene & scene, Sampler & sampler,
+                            const Ray & ray,
+                            const float minDistance,
+                            const unsigned int depth,
+                            const MediumStack & mediumStack,
+                            const DirectLightSampling & lightSampling,
+                            RayIntersection & intersection,
+                            RadianceRGB & Lo) {
+                 return renderer.traceRay(scene, sampler, ray, minDistance, depth, mediumStack,
+                                          lightSampling, intersection, Lo);
+             })
         .def("traceRay", static_cast<
-             bool (Renderer::*)(const Scene &, RNG &,
-                                const Ray &,
-                                const float,
-                                const unsigned int,
-                                const MediumStack &,
-                                bool,
-                                bool,
-                                RayIntersection &,
-                                RadianceRGB &) const>(&Renderer::traceRay))
-        .def("traceRay", static_cast<
-             RadianceRGB (Renderer::*) (const Scene &, RNG &,
+             RadianceRGB (Renderer::*) (const Scene &, Sampler &,
                                         const Ray &,
                                         const float,
                                         const unsigned int,
                                         const MediumStack &,
-                                        bool,
-                                        bool) const>(&Renderer::traceRay))
-        .def("traceCameraRay", static_cast<
-             bool (Renderer::*)(const Scene &, RNG &,
-                                const Ray &,
-                                const float,
-                                const unsigned int,
-                                const MediumStack &,
-                                RayIntersection &,
-                                RadianceRGB &) const>(&Renderer::traceCameraRay))
+                                        const DirectLightSampling &) const>(&Renderer::traceRay))
+        .def("traceCameraRay", [](const Renderer & renderer, const Scene & scene, Sampler & sampler,
+                                  const Ray & ray,
+                                  const float minDistance,
+                                  const unsigned int depth,
+                                  const MediumStack & mediumStack,
+                                  RayIntersection & intersection,
+                                  RadianceRGB & Lo) {
+                 return renderer.traceCameraRay(scene, sampler, ray, minDistance, depth, mediumStack,
+                                                intersection, Lo);
+             })
 
         .def("printConfiguration", &Renderer::printConfiguration,
              py::call_guard<py::scoped_ostream_redirect>())
@@ -40,10 +43,19 @@ void renderer_bindings(py::module_ & m)
         .def_readwrite("monteCarloRefraction", &Renderer::monteCarloRefraction)
         .def_readwrite("russianRouletteChance", &Renderer::russianRouletteChance)
         .def_readwrite("russianRouletteMinDepth", &Renderer::russianRouletteMinDepth)
+        .def_readwrite("numLightSamples", &Renderer::numLightSamples)
         .def_readwrite("shadeDiffuseParams", &Renderer::shadeDiffuseParams)
         .def_readwrite("shadeSpecularParams", &Renderer::shadeSpecularParams)
         ;
 
+    py::class_<DirectLightSampling, std::shared_ptr<DirectLightSampling>>(m, "DirectLightSampling")
+        // constructors
+        .def(py::init<>())
+        .def_readwrite("brdfPdf", &DirectLightSampling::brdfPdf)
+        .def_readwrite("lights", &DirectLightSampling::lights)
+        .def_readwrite("numEnvMapSamples", &DirectLightSampling::numEnvMapSamples)
+        ;
+
     py::class_<Renderer::DiffuseShadingParameters,
                std::shared_ptr<Renderer::DiffuseShadingParameters>>(m, "DiffuseShadingParameters")
         // constructors
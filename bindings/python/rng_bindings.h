@@ -4,7 +4,11 @@ void rng_bindings(py::module_ & m)
     py::class_<RNG, std::shared_ptr<RNG>>(m, "RNG")
         // constructors
         .def(py::init<>())
+        .def(py::init<uint64_t, uint64_t>(), py::arg("seed"), py::arg("stream") = RNG::DEFAULT_STREAM)
+        .def_static("forPixelSample", &RNG::forPixelSample,
+                    py::arg("x"), py::arg("y"), py::arg("sampleIndex"), py::arg("seed") = 0)
         // methods
+        .def("seed", &RNG::seed, py::arg("seed"), py::arg("stream") = RNG::DEFAULT_STREAM)
         //   1D
         .def("uniform01", &RNG::uniform01)
         .def("uniformRange", &RNG::uniformRange)
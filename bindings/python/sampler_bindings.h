@@ -0,0 +1,42 @@
+
+void sampler_bindings(py::module_ & m)
+{
+    py::class_<PixelSample, std::shared_ptr<PixelSample>>(m, "PixelSample")
+        // constructors
+        .def(py::init<>())
+        .def(py::init([](uint32_t x, uint32_t y, uint32_t index) {
+                return PixelSample{ x, y, index };
+             }))
+        // properties
+        .def_readwrite("x", &PixelSample::x)
+        .def_readwrite("y", &PixelSample::y)
+        .def_readwrite("index", &PixelSample::index)
+        ;
+
+    py::class_<Sampler, std::shared_ptr<Sampler>>(m, "Sampler")
+        // methods
+        .def("startPixelSample", &Sampler::startPixelSample)
+        .def("startBounce", &Sampler::startBounce)
+        .def("get1D", &Sampler::get1D)
+        .def("get2D", &Sampler::get2D)
+        .def("name", &Sampler::name)
+        // properties
+        .def_readwrite("seed", &Sampler::seed)
+        ;
+
+    py::class_<RandomSampler, Sampler, std::shared_ptr<RandomSampler>>(m, "RandomSampler")
+        .def(py::init<uint64_t>(), py::arg("seed") = 0);
+    py::class_<HaltonSampler, Sampler, std::shared_ptr<HaltonSampler>>(m, "HaltonSampler")
+        .def(py::init<uint64_t>(), py::arg("seed") = 0);
+    py::class_<SobolSampler, Sampler, std::shared_ptr<SobolSampler>>(m, "SobolSampler")
+        .def(py::init<uint64_t>(), py::arg("seed") = 0);
+    py::class_<BlueNoiseSampler, Sampler, std::shared_ptr<BlueNoiseSampler>>(m, "BlueNoiseSampler")
+        .def(py::init<uint64_t>(), py::arg("seed") = 0);
+
+    m.def("makeSampler",
+          [](const std::string & name, uint64_t seed) {
+              return std::shared_ptr<Sampler>(makeSampler(name, seed));
+          },
+          py::arg("name"), py::arg("seed") = 0);
+}
+
@@ -1,16 +1,38 @@
 
 void sensor_bindings(py::module_ & m)
 {
-    py::class_<Sensor, std::shared_ptr<Sensor>>(m, "Sensor")
+    py::class_<Sensor, std::shared_ptr<Sensor>> sensor(m, "Sensor");
+
+    py::enum_<Sensor::TileOrder>(sensor, "TileOrder")
+        .value("Raster", Sensor::TileOrder::Raster)
+        .value("Spiral", Sensor::TileOrder::Spiral)
+        .value("Hilbert", Sensor::TileOrder::Hilbert)
+        ;
+
+    py::class_<Sensor::Tile>(sensor, "Tile")
+        .def_readwrite("xmin", &Sensor::Tile::xmin)
+        .def_readwrite("ymin", &Sensor::Tile::ymin)
+        .def_readwrite("xmax", &Sensor::Tile::xmax)
+        .def_readwrite("ymax", &Sensor::Tile::ymax)
+        ;
+
+    sensor
         // constructors
         .def(py::init<>())
         .def(py::init<uint32_t, uint32_t>())
         // methods
         .def("forEachPixel", &Sensor::forEachPixel)
         .def("forEachPixelInRect", &Sensor::forEachPixelInRect)
-        .def("forEachPixelTiled", &Sensor::forEachPixelTiled)
-        .def("forEachPixelThreaded", &Sensor::forEachPixelThreaded)
-        .def("forEachPixelTiledThreaded", &Sensor::forEachPixelTiledThreaded)
+        .def("forEachPixelTiled", &Sensor::forEachPixelTiled,
+             py::arg("fn"), py::arg("tileSize"), py::arg("order") = Sensor::TileOrder::Raster)
+        // Pool threads acquire the GIL to call back into Python
+        .def("forEachPixelThreaded", &Sensor::forEachPixelThreaded,
+             py::call_guard<py::gil_scoped_release>())
+        .def("forEachPixelTiledThreaded", &Sensor::forEachPixelTiledThreaded,
+             py::arg("fn"), py::arg("tileSize"), py::arg("numThreads"), py::arg("order") = Sensor::TileOrder::Spiral,
+             py::call_guard<py::gil_scoped_release>())
+        .def("tiles", &Sensor::tiles,
+             py::arg("tileSize"), py::arg("order") = Sensor::TileOrder::Raster)
         .def("pixelStandardImageLocation",
              static_cast<vec2(Sensor::*)(float, float)>(&Sensor::pixelStandardImageLocation))
         .def("pixelStandardImageLocation",
@@ -22,5 +44,7 @@ void sensor_bindings(py::module_ & m)
         .def_readwrite("pixelwidth", &Sensor::pixelwidth)
         .def_readwrite("pixelheight", &Sensor::pixelheight)
         ;
-}
 
+    m.def("setThreadPoolSize", &setThreadPoolSize,
+          py::arg("numThreads"), py::arg("pinToCores") = false);
+}
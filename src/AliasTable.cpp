@@ -0,0 +1,59 @@
+#include <stdexcept>
+#include "AliasTable.h"
+
+void AliasTable::build(const std::vector<float> & weights)
+{
+    const size_t n = weights.size();
+    entries.assign(n, Entry());
+    if(n == 0) {
+        return;
+    }
+    if(n > size_t(UINT32_MAX)) {
+        throw std::runtime_error("Too many alias table entries: " + std::to_string(n));
+    }
+
+    double total = 0.0;
+    for(float w : weights) {
+        total += w;
+    }
+
+    // Scaled so the mean is 1. Entries below 1 are filled up to 1 by an
+    // entry above 1, which becomes their alias.
+    std::vector<double> scaled(n);
+    for(size_t i = 0; i < n; ++i) {
+        const double p = total > 0.0 ? double(weights[i]) / total : 1.0 / double(n);
+        entries[i].probability = float(p);
+        scaled[i] = p * double(n);
+    }
+
+    std::vector<uint32_t> small, large;
+    small.reserve(n);
+    large.reserve(n);
+    for(size_t i = 0; i < n; ++i) {
+        (scaled[i] < 1.0 ? small : large).push_back(uint32_t(i));
+    }
+
+    while(!small.empty() && !large.empty()) {
+        const uint32_t s = small.back(); small.pop_back();
+        const uint32_t l = large.back();
+
+        entries[s].threshold = float(scaled[s]);
+        entries[s].alias = l;
+
+        scaled[l] -= 1.0 - scaled[s];
+        if(scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+
+    // Whatever remains is 1 up to round off
+    for(uint32_t i : large) {
+        entries[i].threshold = 1.0f;
+        entries[i].alias = i;
+    }
+    for(uint32_t i : small) {
+        entries[i].threshold = 1.0f;
+        entries[i].alias = i;
+    }
+}
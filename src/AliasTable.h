@@ -0,0 +1,80 @@
+#ifndef __ALIAS_TABLE_H__
+#define __ALIAS_TABLE_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Discrete distribution sampled in constant time with Walker's alias method,
+// built in linear time with Vose's algorithm. Each entry holds its own index
+// with some probability and otherwise an alias, so a sample is one uniform
+// index and one comparison, with no searching.
+class AliasTable
+{
+    public:
+        AliasTable() = default;
+        ~AliasTable() = default;
+
+        // Build from non-negative weights. If all weights are zero the
+        // distribution is uniform.
+        void build(const std::vector<float> & weights);
+
+        // Index drawn with probability proportional to its weight, using
+        // e1 to pick an entry and e2 to choose between it and its alias.
+        // Both are in [0,1).
+        inline uint32_t sample(float e1, float e2) const;
+        // Also returns two values in [0,1) left over from e1 and e2, which
+        // are independent of the index, for placing a sample within the
+        // entry. Their precision drops as the table grows.
+        inline uint32_t sample(float e1, float e2, float & r1, float & r2) const;
+
+        // Probability of drawing an index
+        float probability(uint32_t index) const { return entries[index].probability; }
+
+        size_t size() const { return entries.size(); }
+        bool empty() const { return entries.empty(); }
+
+    protected:
+        struct Entry {
+            float threshold = 1.0f;  // keep the entry if e2 is below this
+            uint32_t alias = 0;
+            float probability = 0.0f;
+        };
+        std::vector<Entry> entries;
+};
+
+// Inline implementations
+
+inline uint32_t AliasTable::sample(float e1, float e2) const
+{
+    const uint32_t n = uint32_t(entries.size());
+    // Double, so large tables can reach every entry
+    uint32_t index = uint32_t(double(e1) * double(n));
+    if(index >= n) {
+        index = n - 1;
+    }
+    const Entry & entry = entries[index];
+    return e2 < entry.threshold ? index : entry.alias;
+}
+
+inline uint32_t AliasTable::sample(float e1, float e2, float & r1, float & r2) const
+{
+    const float ONE_MINUS_EPSILON = 0.99999994f;
+    const uint32_t n = uint32_t(entries.size());
+    const double scaled = double(e1) * double(n);
+    uint32_t index = uint32_t(scaled);
+    if(index >= n) {
+        index = n - 1;
+    }
+    r1 = std::min(float(scaled - double(index)), ONE_MINUS_EPSILON);
+
+    const Entry & entry = entries[index];
+    if(e2 < entry.threshold) {
+        r2 = std::min(e2 / entry.threshold, ONE_MINUS_EPSILON);
+        return index;
+    }
+    r2 = std::min((e2 - entry.threshold) / (1.0f - entry.threshold), ONE_MINUS_EPSILON);
+    return entry.alias;
+}
+
+#endif
@@ -1,6 +1,6 @@
 #include "AmbientOcclusion.h"
 
-float computeAmbientOcclusion(Scene & scene, const RayIntersection & intersection, float minDistance, RNG & rng,
+float computeAmbientOcclusion(Scene & scene, const RayIntersection & intersection, float minDistance, Sampler & sampler,
                               unsigned int numSamples, bool sampleCosineLobe)
 {
     const float epsilon = 1.0e-4;
@@ -10,13 +10,13 @@ float computeAmbientOcclusion(Scene & scene, const RayIntersection & intersectio
     for(size_t i = 0; i < numSamples; ++i) {
         if(sampleCosineLobe) {
             // Sample according to cosine lobe about the normal
-            rng.cosineAboutDirection(intersection.normal, d);
+            d = Direction3(RNG::cosineAboutDirection(sampler.get2D(), intersection.normal));
             Ray aoShadowRay(p, d);
             ao += intersectsWorldRay(aoShadowRay, scene, minDistance) ? 0.0f : 1.0f;
         }
         else {
             // Sample hemisphere and scale by cosine of angle to normal
-            rng.uniformSurfaceUnitHalfSphere(intersection.normal, d);
+            d = Direction3(RNG::uniformSurfaceUnitHalfSphere(sampler.get2D(), intersection.normal));
             Ray aoShadowRay(p, d);
             ao += intersectsWorldRay(aoShadowRay, scene, minDistance) ? 0.0f : 2.0f * dot(d, intersection.normal);
         }
@@ -3,9 +3,9 @@
 
 #include "scene.h"
 #include "Ray.h"
-#include "rng.h"
+#include "Sampler.h"
 
-float computeAmbientOcclusion(Scene & scene, const RayIntersection & intersection, float minDistance, RNG & rng,
+float computeAmbientOcclusion(Scene & scene, const RayIntersection & intersection, float minDistance, Sampler & sampler,
                               unsigned int numSamples, bool sampleCosineLobe);
 
 #endif
@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <numeric>
+#include <cstdio>
+#include <cassert>
+#include <functional>
+
+#include "BVH.h"
+#include "slab.h"
+#include "Logger.h"
+#include "ThreadPool.h"
+
+const unsigned int BVH::MAX_DEPTH;
+
+void BVH::clear()
+{
+    nodes.clear();
+    primitives.clear();
+}
+
+void BVH::build(const std::vector<Bounds> & primitiveBounds)
+{
+    clear();
+
+    const auto numPrimitives = uint32_t(primitiveBounds.size());
+
+    if(numPrimitives == 0) {
+        return;
+    }
+
+    // Build references are partitioned in place as the tree is built,
+    // so each primitive ends up in exactly one leaf.
+    std::vector<PrimitiveRef> refs(numPrimitives);
+    for(uint32_t pi = 0; pi < numPrimitives; ++pi) {
+        refs[pi].bounds = primitiveBounds[pi];
+        refs[pi].index = pi;
+    }
+
+    nodes.reserve(2 * numPrimitives / std::max(maxPrimitivesPerLeaf / 2u, 1u) + 1);
+    buildNode(nodes, refs, 0, numPrimitives, 0);
+    nodes.shrink_to_fit();
+
+    primitives.resize(numPrimitives);
+    std::transform(refs.begin(), refs.end(), primitives.begin(),
+                   [](const PrimitiveRef & ref) { return ref.index; });
+}
+
+uint32_t BVH::makeLeaf(NodeArray & output, uint32_t nodeIndex, uint32_t first, uint32_t last)
+{
+    assert(last - first <= std::numeric_limits<uint16_t>::max());
+    auto & node = output[nodeIndex];
+    node.offset = first;
+    node.numPrimitives = uint16_t(last - first);
+    node.axis = 0;
+    return nodeIndex;
+}
+
+uint32_t BVH::buildNode(NodeArray & output,
+                        std::vector<PrimitiveRef> & refs,
+                        uint32_t first, uint32_t last,
+                        unsigned int depth)
+{
+    const uint32_t nodeIndex = uint32_t(output.size());
+    output.emplace_back();
+
+    const uint32_t count = last - first;
+
+    // Large ranges are scanned in chunks on the thread pool. Chunks are
+    // combined with min, max and integer sums, so the tree is the same as
+    // a serial build.
+    const bool parallel = count >= parallelBuildThreshold;
+    const uint32_t chunkSize = parallel ? std::max(parallelBuildThreshold / 4u, 1u) : count;
+    const uint32_t numChunks = (count + chunkSize - 1) / chunkSize;
+
+    auto forEachChunk = [&](const std::function<void(uint32_t /*chunk*/, uint32_t /*first*/, uint32_t /*last*/)> & fn) {
+        auto chunk = [&](size_t ci, ThreadIndex) {
+            const uint32_t chunkFirst = first + uint32_t(ci) * chunkSize;
+            fn(uint32_t(ci), chunkFirst, std::min(chunkFirst + chunkSize, last));
+        };
+        if(numChunks > 1) {
+            getThreadPool().parallelFor(numChunks, chunk);
+        }
+        else {
+            chunk(0, 0);
+        }
+    };
+
+    std::vector<Bounds> chunkBounds(numChunks), chunkCentroidBounds(numChunks);
+    forEachChunk([&](uint32_t ci, uint32_t chunkFirst, uint32_t chunkLast) {
+        for(uint32_t pi = chunkFirst; pi < chunkLast; ++pi) {
+            const auto & b = refs[pi].bounds;
+            chunkBounds[ci].extend(b);
+            const float c[3] = { b.centroid(0), b.centroid(1), b.centroid(2) };
+            chunkCentroidBounds[ci].extend(c);
+        }
+    });
+
+    Bounds bounds, centroidBounds;
+    for(uint32_t ci = 0; ci < numChunks; ++ci) {
+        bounds.extend(chunkBounds[ci]);
+        centroidBounds.extend(chunkCentroidBounds[ci]);
+    }
+
+    {
+        auto & node = output[nodeIndex];
+        std::copy(bounds.min, bounds.min + 3, node.min);
+        std::copy(bounds.max, bounds.max + 3, node.max);
+    }
+
+    if(count == 1 || depth + 1 >= MAX_DEPTH) {
+        return makeLeaf(output, nodeIndex, first, last);
+    }
+
+    // Binned SAH: bin primitive centroids along each axis and evaluate
+    // the cost of splitting between each pair of adjacent bins.
+    struct Bin {
+        Bounds bounds;
+        uint32_t count = 0;
+    };
+    std::vector<float> rightArea(numBins);
+    std::vector<uint32_t> rightCount(numBins);
+
+    const float parentArea = bounds.surfaceArea();
+    const float inverseParentArea = parentArea > 0.0f ? 1.0f / parentArea : 0.0f;
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1;
+    unsigned int bestSplit = 0;
+
+    auto binIndex = [&](const PrimitiveRef & ref, unsigned int axis) {
+        const float extent = centroidBounds.extent(axis);
+        const float offset = (ref.bounds.centroid(axis) - centroidBounds.min[axis]) / extent;
+        return std::min(unsigned(offset * float(numBins)), numBins - 1);
+    };
+
+    bool binAxis[3];
+    for(unsigned int axis = 0; axis < 3; ++axis) {
+        binAxis[axis] = centroidBounds.extent(axis) > 0.0f;
+    }
+
+    // Bins of every chunk for every axis, [chunk][axis][bin]
+    std::vector<Bin> chunkBins(numChunks * 3 * numBins);
+    forEachChunk([&](uint32_t ci, uint32_t chunkFirst, uint32_t chunkLast) {
+        for(unsigned int axis = 0; axis < 3; ++axis) {
+            if(!binAxis[axis]) {
+                continue;
+            }
+            Bin * bins = &chunkBins[(ci * 3 + axis) * numBins];
+            for(uint32_t pi = chunkFirst; pi < chunkLast; ++pi) {
+                auto & bin = bins[binIndex(refs[pi], axis)];
+                bin.bounds.extend(refs[pi].bounds);
+                bin.count++;
+            }
+        }
+    });
+
+    std::vector<Bin> bins(numBins);
+
+    for(unsigned int axis = 0; axis < 3; ++axis) {
+        if(!binAxis[axis]) {
+            continue;
+        }
+
+        std::fill(bins.begin(), bins.end(), Bin());
+        for(uint32_t ci = 0; ci < numChunks; ++ci) {
+            const Bin * cbins = &chunkBins[(ci * 3 + axis) * numBins];
+            for(unsigned int bi = 0; bi < numBins; ++bi) {
+                bins[bi].bounds.extend(cbins[bi].bounds);
+                bins[bi].count += cbins[bi].count;
+            }
+        }
+
+        // Sweep from the right to accumulate the right hand side of each split
+        Bounds accum;
+        uint32_t accumCount = 0;
+        for(unsigned int bi = numBins - 1; bi > 0; --bi) {
+            accum.extend(bins[bi].bounds);
+            accumCount += bins[bi].count;
+            rightArea[bi] = accum.surfaceArea();
+            rightCount[bi] = accumCount;
+        }
+
+        // Sweep from the left and evaluate the cost of splitting after each bin
+        accum = Bounds();
+        accumCount = 0;
+        for(unsigned int bi = 0; bi < numBins - 1; ++bi) {
+            accum.extend(bins[bi].bounds);
+            accumCount += bins[bi].count;
+            if(accumCount == 0 || rightCount[bi + 1] == 0) {
+                continue;
+            }
+            float cost = traversalCost + intersectionCost * inverseParentArea
+                * (float(accumCount) * accum.surfaceArea()
+                   + float(rightCount[bi + 1]) * rightArea[bi + 1]);
+            if(cost < bestCost) {
+                bestCost = cost;
+                bestAxis = int(axis);
+                bestSplit = bi;
+            }
+        }
+    }
+
+    const float leafCost = intersectionCost * float(count);
+
+    if(count <= maxPrimitivesPerLeaf && (bestAxis < 0 || leafCost <= bestCost)) {
+        return makeLeaf(output, nodeIndex, first, last);
+    }
+
+    uint32_t middle = first;
+    unsigned int axis = 0;
+
+    // Near the depth limit, fall back to median splits so the remaining
+    // levels are guaranteed to reduce the leaves to a reasonable size.
+    const bool forceMedian = depth + 16 >= MAX_DEPTH;
+
+    if(bestAxis >= 0 && !forceMedian) {
+        axis = unsigned(bestAxis);
+        auto mid = std::partition(refs.begin() + first, refs.begin() + last,
+                                  [&](const PrimitiveRef & ref) { return binIndex(ref, axis) <= bestSplit; });
+        middle = uint32_t(mid - refs.begin());
+    }
+
+    if(middle == first || middle == last) {
+        // Centroids are coincident or the split did not separate anything.
+        // Split the range in half about the median centroid of the widest axis.
+        axis = 0;
+        for(unsigned int a = 1; a < 3; ++a) {
+            if(centroidBounds.extent(a) > centroidBounds.extent(axis)) {
+                axis = a;
+            }
+        }
+        middle = first + count / 2;
+        std::nth_element(refs.begin() + first, refs.begin() + middle, refs.begin() + last,
+                         [&](const PrimitiveRef & a, const PrimitiveRef & b) {
+                             return a.bounds.centroid(axis) < b.bounds.centroid(axis);
+                         });
+    }
+
+    uint32_t secondChild = 0;
+
+    if(parallel) {
+        // The children own disjoint ranges of refs, so they can be built at
+        // the same time. The second child's subtree goes in an array of its
+        // own and is appended after the first child's.
+        NodeArray secondNodes;
+        getThreadPool().parallelFor(2, [&](size_t child, ThreadIndex) {
+            if(child == 0) {
+                buildNode(output, refs, first, middle, depth + 1);
+            }
+            else {
+                buildNode(secondNodes, refs, middle, last, depth + 1);
+            }
+        }, 2);
+        secondChild = uint32_t(output.size());
+        for(auto node : secondNodes) {
+            if(!node.isLeaf()) {
+                node.offset += secondChild;
+            }
+            output.push_back(node);
+        }
+    }
+    else {
+        // First child immediately follows this node
+        buildNode(output, refs, first, middle, depth + 1);
+        secondChild = buildNode(output, refs, middle, last, depth + 1);
+    }
+
+    auto & node = output[nodeIndex];
+    node.offset = secondChild;
+    node.numPrimitives = 0;
+    node.axis = uint16_t(axis);
+
+    return nodeIndex;
+}
+
+Slab BVH::bounds() const
+{
+    if(nodes.empty()) {
+        return Slab();
+    }
+    const auto & root = nodes[0];
+    return Slab(root.min[0], root.min[1], root.min[2],
+                root.max[0], root.max[1], root.max[2]);
+}
+
+unsigned int BVH::depth() const
+{
+    if(nodes.empty()) {
+        return 0;
+    }
+
+    unsigned int maxDepth = 0;
+    std::vector<std::pair<uint32_t, unsigned int>> stack = { { 0, 1 } };
+
+    while(!stack.empty()) {
+        auto entry = stack.back();
+        stack.pop_back();
+        maxDepth = std::max(maxDepth, entry.second);
+        const auto & node = nodes[entry.first];
+        if(!node.isLeaf()) {
+            stack.emplace_back(entry.first + 1, entry.second + 1);
+            stack.emplace_back(node.offset, entry.second + 1);
+        }
+    }
+
+    return maxDepth;
+}
+
+size_t BVH::sizeInBytes() const
+{
+    return nodes.size() * sizeof(Node) + primitives.size() * sizeof(uint32_t);
+}
+
+bool BVH::nodesCoverAllPrimitives(size_t numPrimitives) const
+{
+    std::vector<uint32_t> claimed(numPrimitives, 0u);
+    for(const auto & node : nodes) {
+        if(!node.isLeaf()) {
+            continue;
+        }
+        for(uint32_t pi = 0; pi < node.numPrimitives; ++pi) {
+            auto index = primitives[node.offset + pi];
+            if(index >= numPrimitives) {
+                return false;
+            }
+            claimed[index]++;
+        }
+    }
+    // Every primitive must be referenced by exactly one leaf
+    return std::all_of(claimed.begin(), claimed.end(), [](uint32_t n) { return n == 1; });
+}
+
+void BVH::printNodes() const
+{
+    printf("BVH nodes %u primitives %u\n",
+           (unsigned int) nodes.size(), (unsigned int) primitives.size());
+    for(uint32_t i = 0; i < nodes.size(); ++i) {
+        const auto & node = nodes[i];
+        printf("%3u : min (%f, %f, %f) max (%f, %f, %f) ", i,
+               node.min[0], node.min[1], node.min[2],
+               node.max[0], node.max[1], node.max[2]);
+        if(node.isLeaf()) {
+            printf("leaf first %u count %u\n", node.offset, (unsigned int) node.numPrimitives);
+        }
+        else {
+            printf("children %u, %u axis %u\n", i + 1, node.offset, (unsigned int) node.axis);
+        }
+    }
+}
+
+void BVH::log(Logger & logger) const
+{
+    auto numLeaves = std::count_if(nodes.begin(), nodes.end(), [](const Node & n) { return n.isLeaf(); });
+    logger.normalf("BVH: %u nodes, %u leaves, %u primitives, depth %u, %.2f primitives/leaf, %.2f MB",
+                   (unsigned int) nodes.size(), (unsigned int) numLeaves,
+                   (unsigned int) primitives.size(), depth(),
+                   numLeaves > 0 ? float(primitives.size()) / float(numLeaves) : 0.0f,
+                   float(sizeInBytes()) / (1024.0f * 1024.0f));
+}
@@ -0,0 +1,141 @@
+#ifndef __BVH_H__
+#define __BVH_H__
+
+#include <vector>
+#include <cstdint>
+#include <limits>
+
+#include "alignedallocator.h"
+#include "vectortypes.h"
+
+struct Ray;
+struct Slab;
+class Logger;
+
+// Bounding volume hierarchy over an abstract set of primitives.
+//
+// The hierarchy is built with a binned surface area heuristic (SAH) and
+// stored as a flat, depth-first array of compact nodes. Primitives are
+// referenced exactly once through the `primitives` index array, so each
+// leaf owns a contiguous range of it. Callers supply the primitive bounds
+// to build() and a leaf function to the traversal methods that intersects
+// the primitives of a leaf.
+struct BVH
+{
+    // Axis aligned bounds used during the build
+    struct Bounds {
+        float min[3] = {  std::numeric_limits<float>::max(),
+                          std::numeric_limits<float>::max(),
+                          std::numeric_limits<float>::max() };
+        float max[3] = { -std::numeric_limits<float>::max(),
+                         -std::numeric_limits<float>::max(),
+                         -std::numeric_limits<float>::max() };
+
+        inline void extend(const Bounds & b);
+        inline void extend(const vec3 & p);
+        inline void extend(const float p[3]);
+        inline float centroid(unsigned int axis) const { return 0.5f * (min[axis] + max[axis]); }
+        inline float extent(unsigned int axis) const { return max[axis] - min[axis]; }
+        inline bool isEmpty() const { return min[0] > max[0]; }
+        inline float surfaceArea() const;
+    };
+
+    // Compact node. Two nodes fit in a 64 byte cache line.
+    //   Interior: numPrimitives == 0. The first child immediately follows
+    //             the node in the array and `offset` is the index of the
+    //             second child. `axis` is the split axis.
+    //   Leaf:     numPrimitives > 0. `offset` is the index of the first
+    //             entry in `primitives` owned by the leaf. Owners that copy
+    //             the primitives into storage of their own may re-point it
+    //             after build() and release `primitives` (eg:
+    //             TriangleMeshBVH points it at the leaf's first packet).
+    struct alignas(32) Node {
+        float min[3];
+        uint32_t offset;
+        float max[3];
+        uint16_t numPrimitives;
+        uint16_t axis;
+
+        inline bool isLeaf() const { return numPrimitives > 0; }
+    };
+    static_assert(sizeof(Node) == 32, "BVH node must be 32 bytes");
+
+    using NodeArray = std::vector<Node, AlignedAllocator<Node, 64>>;
+
+    // Ray with precomputed values used for bounds tests
+    struct TraversalRay {
+        inline TraversalRay(const Ray & ray);
+
+        float origin[3];
+        float inverseDirection[3];
+        bool directionIsNegative[3];
+    };
+
+    void build(const std::vector<Bounds> & primitiveBounds);
+    void clear();
+
+    bool empty() const { return nodes.empty(); }
+
+    // Bounds of the whole hierarchy
+    Slab bounds() const;
+
+    // Intersect a node's bounds between minDistance and maxDistance
+    static inline bool intersectsNode(const Node & node, const TraversalRay & ray,
+                                      float minDistance, float maxDistance);
+
+    // Find the closest hit. `leaf` is called as
+    //   bool leaf(uint32_t firstPrimitive, uint32_t numPrimitives, float & maxDistance)
+    // and must return true and shrink maxDistance when it finds a closer hit.
+    template<typename LeafFunction>
+    inline bool findClosest(const Ray & ray, float minDistance, float & maxDistance,
+                            LeafFunction && leaf) const;
+
+    // Find any hit. `leaf` is called as
+    //   bool leaf(uint32_t firstPrimitive, uint32_t numPrimitives)
+    // and traversal stops as soon as it returns true.
+    template<typename LeafFunction>
+    inline bool findAny(const Ray & ray, float minDistance, float maxDistance,
+                        LeafFunction && leaf) const;
+
+    void printNodes() const;
+    void log(Logger & logger) const;
+    bool nodesCoverAllPrimitives(size_t numPrimitives) const;
+    unsigned int depth() const;
+    size_t sizeInBytes() const;
+
+    // Nodes of the hierarchy. First is the root.
+    NodeArray nodes;
+
+    // Primitive indices referenced by leaves
+    std::vector<uint32_t> primitives;
+
+    // Build configuration
+    unsigned int numBins = 16;
+    unsigned int maxPrimitivesPerLeaf = 8;
+    float traversalCost = 1.0f;
+    float intersectionCost = 1.0f;
+    // Ranges of at least this many primitives are binned in parallel, and
+    // their two children are built in parallel
+    uint32_t parallelBuildThreshold = 65536;
+
+    // Traversal stack size bounds the depth of the hierarchy
+    static const unsigned int MAX_DEPTH = 64;
+
+    protected:
+        struct PrimitiveRef {
+            Bounds bounds;
+            uint32_t index;
+        };
+
+        // Build the subtree of refs [first, last) onto the end of output and
+        // return the index of its root. Interior node offsets are relative to
+        // output.
+        uint32_t buildNode(NodeArray & output,
+                           std::vector<PrimitiveRef> & refs,
+                           uint32_t first, uint32_t last,
+                           unsigned int depth);
+        uint32_t makeLeaf(NodeArray & output, uint32_t nodeIndex, uint32_t first, uint32_t last);
+};
+
+#include "BVH.hpp"
+#endif
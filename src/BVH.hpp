@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cassert>
+
+#include "Ray.h"
+#include "PerfCounters.h"
+
+inline void BVH::Bounds::extend(const Bounds & b)
+{
+    for(unsigned int axis = 0; axis < 3; ++axis) {
+        min[axis] = std::min(min[axis], b.min[axis]);
+        max[axis] = std::max(max[axis], b.max[axis]);
+    }
+}
+
+inline void BVH::Bounds::extend(const vec3 & p)
+{
+    const float c[3] = { p.x, p.y, p.z };
+    extend(c);
+}
+
+inline void BVH::Bounds::extend(const float p[3])
+{
+    for(unsigned int axis = 0; axis < 3; ++axis) {
+        min[axis] = std::min(min[axis], p[axis]);
+        max[axis] = std::max(max[axis], p[axis]);
+    }
+}
+
+inline float BVH::Bounds::surfaceArea() const
+{
+    if(isEmpty()) {
+        return 0.0f;
+    }
+    float dx = extent(0), dy = extent(1), dz = extent(2);
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+inline BVH::TraversalRay::TraversalRay(const Ray & ray)
+{
+    const float d[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+    origin[0] = ray.origin.x;
+    origin[1] = ray.origin.y;
+    origin[2] = ray.origin.z;
+    for(unsigned int axis = 0; axis < 3; ++axis) {
+        inverseDirection[axis] = 1.0f / d[axis];
+        directionIsNegative[axis] = d[axis] < 0.0f;
+    }
+}
+
+inline bool BVH::intersectsNode(const Node & node, const TraversalRay & ray,
+                                float minDistance, float maxDistance)
+{
+    float tmin = minDistance, tmax = maxDistance;
+
+    for(unsigned int axis = 0; axis < 3; ++axis) {
+        float t1 = (node.min[axis] - ray.origin[axis]) * ray.inverseDirection[axis];
+        float t2 = (node.max[axis] - ray.origin[axis]) * ray.inverseDirection[axis];
+        // Note: NaNs from axis-parallel rays grazing a slab plane are
+        //       discarded by the argument order of min/max.
+        tmin = std::max(tmin, std::min(t1, t2));
+        tmax = std::min(tmax, std::max(t1, t2));
+    }
+
+    return tmin <= tmax;
+}
+
+template<typename LeafFunction>
+inline bool BVH::findClosest(const Ray & ray, float minDistance, float & maxDistance,
+                             LeafFunction && leaf) const
+{
+    if(nodes.empty()) {
+        return false;
+    }
+
+    const TraversalRay traversalRay(ray);
+    uint32_t stack[MAX_DEPTH];
+    unsigned int stackSize = 0;
+    uint32_t nodeIndex = 0;
+    bool hit = false;
+    uint64_t nodesVisited = 0;
+
+    while(true) {
+        const Node & node = nodes[nodeIndex];
+        ++nodesVisited;
+
+        if(intersectsNode(node, traversalRay, minDistance, maxDistance)) {
+            if(node.isLeaf()) {
+                hit |= leaf(node.offset, node.numPrimitives, maxDistance);
+            }
+            else {
+                // Visit the child on the near side of the split first
+                uint32_t nearChild = nodeIndex + 1;
+                uint32_t farChild = node.offset;
+                if(traversalRay.directionIsNegative[node.axis]) {
+                    std::swap(nearChild, farChild);
+                }
+                assert(stackSize < MAX_DEPTH);
+                stack[stackSize++] = farChild;
+                nodeIndex = nearChild;
+                continue;
+            }
+        }
+
+        if(stackSize == 0) {
+            break;
+        }
+        nodeIndex = stack[--stackSize];
+    }
+
+    perf::count(perf::NodesVisited, nodesVisited);
+    return hit;
+}
+
+template<typename LeafFunction>
+inline bool BVH::findAny(const Ray & ray, float minDistance, float maxDistance,
+                         LeafFunction && leaf) const
+{
+    if(nodes.empty()) {
+        return false;
+    }
+
+    const TraversalRay traversalRay(ray);
+    uint32_t stack[MAX_DEPTH];
+    unsigned int stackSize = 0;
+    uint32_t nodeIndex = 0;
+    uint64_t nodesVisited = 0;
+
+    while(true) {
+        const Node & node = nodes[nodeIndex];
+        ++nodesVisited;
+
+        if(intersectsNode(node, traversalRay, minDistance, maxDistance)) {
+            if(node.isLeaf()) {
+                if(leaf(node.offset, node.numPrimitives)) {
+                    perf::count(perf::NodesVisited, nodesVisited);
+                    return true;
+                }
+            }
+            else {
+                uint32_t nearChild = nodeIndex + 1;
+                uint32_t farChild = node.offset;
+                if(traversalRay.directionIsNegative[node.axis]) {
+                    std::swap(nearChild, farChild);
+                }
+                assert(stackSize < MAX_DEPTH);
+                stack[stackSize++] = farChild;
+                nodeIndex = nearChild;
+                continue;
+            }
+        }
+
+        if(stackSize == 0) {
+            break;
+        }
+        nodeIndex = stack[--stackSize];
+    }
+
+    perf::count(perf::NodesVisited, nodesVisited);
+    return false;
+}
@@ -1,6 +1,7 @@
 #include <iostream>
 #include "constants.h"
 #include "CubeMapEnvironmentMap.h"
+#include "ThreadPool.h"
 #include "Ray.h"
 #include "vectortypes.h"
 #include "interpolation.h"
@@ -30,18 +31,41 @@ void CubeMapEnvironmentMap::loadFromDirectionFiles(
     const std::string & znFile,
     const std::string & zpFile)
 {
-    xn = loadDirectionTile(xnFile);
-    xp = loadDirectionTile(xpFile);
-    yn = loadDirectionTile(ynFile);
-    yp = loadDirectionTile(ypFile);
-    zn = loadDirectionTile(znFile);
-    zp = loadDirectionTile(zpFile);
+    // Decode the six tiles in parallel
+    const std::string * files[6] = { &xnFile, &xpFile, &ynFile, &ypFile, &znFile, &zpFile };
+    TexturePtr * tiles[6] = { &xn, &xp, &yn, &yp, &zn, &zp };
+    getThreadPool().parallelFor(6, [&](size_t index, ThreadIndex) {
+        *tiles[index] = loadDirectionTile(*files[index]);
+    });
+
+    buildImportanceSampleLookup();
+}
+
+const TexturePtr & CubeMapEnvironmentMap::faceTexture(int face) const
+{
+    switch(face) {
+        case 0: return xn;
+        case 1: return xp;
+        case 2: return yn;
+        case 3: return yp;
+        case 4: return zn;
+        default: return zp;
+    }
 }
 
 // Reference: https://en.wikipedia.org/wiki/Cube_mapping
 void CubeMapEnvironmentMap::directionToTileCoord(const Direction3 & v,
                                                  TexturePtr & texture,
-                                                 TextureCoordinate & texcoord)
+                                                 TextureCoordinate & texcoord) const
+{
+    int face;
+    directionToFaceCoord(v, face, texcoord);
+    texture = faceTexture(face);
+}
+
+void CubeMapEnvironmentMap::directionToFaceCoord(const Direction3 & v,
+                                                 int & face,
+                                                 TextureCoordinate & texcoord) const
 {
     float absX = std::abs(v.x);
     float absY = std::abs(v.y);
@@ -59,7 +83,7 @@ void CubeMapEnvironmentMap::directionToTileCoord(const Direction3 & v,
         maxAxis = absX;
         texcoord.u = v.z;
         texcoord.v = v.y;
-        texture = xn;
+        face = 0;
     }
     else if(isXPositive && absX >= absY && absX >= absZ) {
         // u (0 to 1) goes from +z to -z
@@ -67,7 +91,7 @@ void CubeMapEnvironmentMap::directionToTileCoord(const Direction3 & v,
         maxAxis = absX;
         texcoord.u = -v.z;
         texcoord.v = v.y;
-        texture = xp;
+        face = 1;
     }
     else if(!isYPositive && absY >= absX && absY >= absZ) {
         // u (0 to 1) goes from -x to +x
@@ -75,7 +99,7 @@ void CubeMapEnvironmentMap::directionToTileCoord(const Direction3 & v,
         maxAxis = absY;
         texcoord.u = v.x;
         texcoord.v = v.z;
-        texture = yn;
+        face = 2;
     }
     else if(isYPositive && absY >= absX && absY >= absZ) {
         // u (0 to 1) goes from -x to +x
@@ -83,7 +107,7 @@ void CubeMapEnvironmentMap::directionToTileCoord(const Direction3 & v,
         maxAxis = absY;
         texcoord.u = v.x;
         texcoord.v = -v.z;
-        texture = yp;
+        face = 3;
     }
     else if(!isZPositive && absZ >= absX && absZ >= absY) {
         // u (0 to 1) goes from +x to -x
@@ -91,7 +115,7 @@ void CubeMapEnvironmentMap::directionToTileCoord(const Direction3 & v,
         maxAxis = absZ;
         texcoord.u = -v.x;
         texcoord.v = v.y;
-        texture = zn;
+        face = 4;
     }
     else { // default : if(isZPositive && absZ >= absX && absZ >= absY) {
         // u (0 to 1) goes from -x to +x
@@ -99,7 +123,7 @@ void CubeMapEnvironmentMap::directionToTileCoord(const Direction3 & v,
         maxAxis = absZ;
         texcoord.u = v.x;
         texcoord.v = v.y;
-        texture = zp;
+        face = 5;
     }
 
     // Convert range from -1 to 1 to 0 to 1
@@ -124,3 +148,104 @@ RadianceRGB CubeMapEnvironmentMap::sampleRay(const Ray & ray)
              scaleFactor * sample.b };
 }
 
+
+// Inverse of directionToFaceCoord(). Texel rows run top down, opposite to v.
+Direction3 CubeMapEnvironmentMap::texelDirection(int face, float x, float y) const
+{
+    const auto & texture = faceTexture(face);
+    float s = 2.0f * x / float(texture->width) - 1.0f;
+    float t = 1.0f - 2.0f * y / float(texture->height);
+
+    switch(face) {
+        case 0: return Direction3(-1.0f, t, s);
+        case 1: return Direction3(1.0f, t, -s);
+        case 2: return Direction3(s, -1.0f, t);
+        case 3: return Direction3(s, 1.0f, -t);
+        case 4: return Direction3(-s, t, -1.0f);
+        default: return Direction3(s, t, 1.0f);
+    }
+}
+
+void CubeMapEnvironmentMap::directionToTexel(const Direction3 & v, int & face, uint32_t & x, uint32_t & y) const
+{
+    TextureCoordinate texcoord;
+    directionToFaceCoord(v, face, texcoord);
+    const auto & texture = faceTexture(face);
+    const float w = float(texture->width), h = float(texture->height);
+    // v is negated into [-1, 0], and wraps to [0, 1] in lookups
+    x = uint32_t(std::min(std::max(texcoord.u * w, 0.0f), w - 1.0f));
+    y = uint32_t(std::min(std::max((1.0f + texcoord.v) * h, 0.0f), h - 1.0f));
+}
+
+// Samples are uniform over the texel's area on the face at distance 1. A
+// patch of the face at distance d subtends its area over d^3.
+float CubeMapEnvironmentMap::texelPdf(int face, uint32_t index, const Direction3 & direction) const
+{
+    const auto & texture = faceTexture(face);
+    const float area = 4.0f / (float(texture->width) * float(texture->height));
+    // For a unit direction, the point on the face is at distance 1 / major axis
+    const float major = std::max(std::abs(direction.x), std::max(std::abs(direction.y), std::abs(direction.z)));
+    return texelTable.probability(index) / (area * major * major * major);
+}
+
+// A texel at (s, t) on the face at distance 1 covers (2/w)(2/h) of the face,
+// foreshortened by the cosine over the squared distance
+float CubeMapEnvironmentMap::texelSolidAngle(int face, uint32_t x, uint32_t y) const
+{
+    const auto & texture = faceTexture(face);
+    float s = 2.0f * (float(x) + 0.5f) / float(texture->width) - 1.0f;
+    float t = 1.0f - 2.0f * (float(y) + 0.5f) / float(texture->height);
+    float d2 = 1.0f + s * s + t * t;
+    float area = 4.0f / (float(texture->width) * float(texture->height));
+    return area / (d2 * std::sqrt(d2));
+}
+
+void CubeMapEnvironmentMap::buildImportanceSampleLookup()
+{
+    uint32_t numTexels = 0;
+    for(int face = 0; face < 6; ++face) {
+        firstTexel[face] = numTexels;
+        numTexels += uint32_t(faceTexture(face)->width * faceTexture(face)->height);
+    }
+
+    std::vector<float> weights(numTexels);
+    getThreadPool().parallelFor(6, [&](size_t face, ThreadIndex) {
+        const auto & texture = faceTexture(int(face));
+        for(uint32_t y = 0; y < texture->height; ++y) {
+            for(uint32_t x = 0; x < texture->width; ++x) {
+                weights[firstTexel[face] + y * texture->width + x] =
+                    texture->channelSum(x, y) * texelSolidAngle(int(face), x, y);
+            }
+        }
+    });
+
+    texelTable.build(weights);
+}
+
+RandomDirection CubeMapEnvironmentMap::importanceSampleDirection(float e1, float e2) const
+{
+    float dx, dy;
+    const uint32_t index = texelTable.sample(e1, e2, dx, dy);
+
+    int face = 5;
+    while(face > 0 && index < firstTexel[face]) {
+        --face;
+    }
+    const uint32_t w = uint32_t(faceTexture(face)->width);
+    const uint32_t x = (index - firstTexel[face]) % w;
+    const uint32_t y = (index - firstTexel[face]) / w;
+
+    // Uniform within the texel
+    const Direction3 direction = texelDirection(face, float(x) + dx, float(y) + dy).normalized();
+
+    return { direction, texelPdf(face, index, direction) };
+}
+
+float CubeMapEnvironmentMap::importanceSamplePdf(const Direction3 & direction) const
+{
+    int face;
+    uint32_t x, y;
+    directionToTexel(direction, face, x, y);
+    const uint32_t index = firstTexel[face] + y * uint32_t(faceTexture(face)->width) + x;
+    return texelPdf(face, index, direction);
+}
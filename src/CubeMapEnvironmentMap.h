@@ -2,6 +2,7 @@
 #define __CUBEMAP_ENVIRONMENT_MAP_H__
 
 #include "EnvironmentMap.h"
+#include "AliasTable.h"
 
 class CubeMapEnvironmentMap : public EnvironmentMap
 {
@@ -18,6 +19,11 @@ class CubeMapEnvironmentMap : public EnvironmentMap
 
         RadianceRGB sampleRay(const Ray & ray) override;
 
+        // Importance sample using index variables e1,e2 in [0, 1]
+        RandomDirection importanceSampleDirection(float e1, float e2) const override;
+        float importanceSamplePdf(const Direction3 & direction) const override;
+        bool canImportanceSample() const override { return !texelTable.empty(); }
+
         void setScaleFactor(float f) { scaleFactor = f; }
 
     protected:
@@ -25,7 +31,24 @@ class CubeMapEnvironmentMap : public EnvironmentMap
 
         void directionToTileCoord(const Direction3 & v,
                                   TexturePtr & texture,
-                                  TextureCoordinate & texcoord);
+                                  TextureCoordinate & texcoord) const;
+        void directionToFaceCoord(const Direction3 & v,
+                                  int & face,
+                                  TextureCoordinate & texcoord) const;
+        // Face index in the order of loadFromDirectionFiles(), and pixel
+        // coordinate, of a direction
+        void directionToTexel(const Direction3 & v, int & face, uint32_t & x, uint32_t & y) const;
+        // Unnormalized direction through a point in a face, in pixels
+        Direction3 texelDirection(int face, float x, float y) const;
+        // Approximate solid angle of a texel
+        float texelSolidAngle(int face, uint32_t x, uint32_t y) const;
+        // Solid angle density of sampling a direction in a texel. Samples
+        // are uniform in area on the face.
+        float texelPdf(int face, uint32_t index, const Direction3 & direction) const;
+
+        const TexturePtr & faceTexture(int face) const;
+
+        void buildImportanceSampleLookup();
 
         TexturePtr xn;
         TexturePtr xp;
@@ -35,6 +58,11 @@ class CubeMapEnvironmentMap : public EnvironmentMap
         TexturePtr zp;
 
         float scaleFactor = 1.0f;
+
+        // Importance sampling. Texels of all faces are drawn in proportion
+        // to their radiance times their solid angle.
+        AliasTable texelTable;
+        uint32_t firstTexel[6] = {};
 };
 
 
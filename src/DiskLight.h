@@ -18,7 +18,8 @@ struct DiskLight : public Traceable
 
     // Ray intersection implementation
     inline virtual bool intersects(const Ray & ray, float minDistance, float maxDistance) const override;
-    inline virtual bool findIntersection(const Ray & ray, float minDistance, RayIntersection & intersection) const override;
+    inline virtual bool findHit(const Ray & ray, float minDistance, RayHit & hit) const override;
+    inline virtual void fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const override;
 
     // Bounding volume
     inline Slab boundingBox() override;
@@ -21,17 +21,17 @@ inline bool intersectPlane(const Ray & ray,
 
 inline bool DiskLight::intersects(const Ray & ray, float minDistance, float maxDistance) const
 {
-    RayIntersection intersection;
+    RayHit hit;
 
-    if(findIntersection(ray, minDistance, intersection) &&
-       intersection.distance <= maxDistance) {
+    if(findHit(ray, minDistance, hit) &&
+       hit.distance <= maxDistance) {
         return true;
     }
 
     return false;
 }
 
-inline bool DiskLight::findIntersection(const Ray & ray, float minDistance, RayIntersection & intersection) const
+inline bool DiskLight::findHit(const Ray & ray, float minDistance, RayHit & hit) const
 {
     float t = 0;
 
@@ -43,14 +43,7 @@ inline bool DiskLight::findIntersection(const Ray & ray, float minDistance, RayI
         vec3 v = p - position;
         float d2 = dot(v, v);
         if(d2 <= radius * radius) {
-            intersection.distance = t;
-            // compute intersection position
-            intersection.position = add(ray.origin, scale(ray.direction, intersection.distance));
-            // compute surface normal
-            intersection.normal = direction;
-            // generate tangent / bitangent
-            coordinate::coordinateSystem(intersection.normal, intersection.tangent, intersection.bitangent);
-            intersection.material = material;
+            hit.distance = t;
             return true;
         }
      }
@@ -58,6 +51,18 @@ inline bool DiskLight::findIntersection(const Ray & ray, float minDistance, RayI
      return false;
 }
 
+inline void DiskLight::fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const
+{
+    intersection.distance = hit.distance;
+    // compute intersection position
+    intersection.position = add(ray.origin, scale(ray.direction, intersection.distance));
+    // compute surface normal
+    intersection.normal = direction;
+    // generate tangent / bitangent
+    coordinate::coordinateSystem(intersection.normal, intersection.tangent, intersection.bitangent);
+    intersection.material = material;
+}
+
 inline Slab DiskLight::boundingBox()
 {
     auto extent = radius * Direction3(
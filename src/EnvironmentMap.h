@@ -25,6 +25,8 @@ class EnvironmentMap
         // Importance sampling
         virtual vec2 importanceSample(float e1, float e2, float & pdf) const { pdf = 0.0f; return vec2(0.0f, 0.0f); }
         virtual RandomDirection importanceSampleDirection(float e1, float e2) const { return { Direction3(0.0f, 0.0f, 0.0f), 0.0f }; }
+        // Solid angle density of importanceSampleDirection() drawing a direction
+        virtual float importanceSamplePdf(const Direction3 & direction) const { return 0.0f; }
         virtual bool canImportanceSample() const { return false; }
 
         virtual void saveDebugImages() {};
@@ -0,0 +1,8 @@
+#include "FilmTile.h"
+
+void FilmTile::reset(const Sensor::Tile & newTile)
+{
+    tile = newTile;
+    pixels.assign(size_t(tile.xmax - tile.xmin) * (tile.ymax - tile.ymin), Pixel());
+    invalidSamples = InvalidSampleCounts();
+}
@@ -0,0 +1,123 @@
+#ifndef __FILM_TILE_H__
+#define __FILM_TILE_H__
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "vec3.h"
+#include "color.h"
+#include "sensor.h"
+
+// Counts of samples that were not finite and non-negative. They are
+// replaced with black, so they still count as samples of their pixel.
+struct InvalidSampleCounts
+{
+    uint64_t nan = 0;
+    uint64_t inf = 0;
+    uint64_t negative = 0;
+
+    uint64_t total() const { return nan + inf + negative; }
+
+    InvalidSampleCounts & operator+=(const InvalidSampleCounts & other) {
+        nan += other.nan;
+        inf += other.inf;
+        negative += other.negative;
+        return *this;
+    }
+};
+
+// Replace an invalid sample with black, counting why it was invalid
+inline void validateSample(ColorRGB & color, InvalidSampleCounts & counts)
+{
+    if(std::isnan(color.r) || std::isnan(color.g) || std::isnan(color.b)) {
+        ++counts.nan;
+    }
+    else if(std::isinf(color.r) || std::isinf(color.g) || std::isinf(color.b)) {
+        ++counts.inf;
+    }
+    else if(color.r < 0.0f || color.g < 0.0f || color.b < 0.0f) {
+        ++counts.negative;
+    }
+    else {
+        return;
+    }
+    color = ColorRGB::BLACK();
+}
+
+// Samples of the pixels of one tile, accumulated by a single thread and
+// merged into Artifacts when the tile is done. Holds the sum, mean and sum
+// of squared differences from the mean (Welford) of the new samples only,
+// so merging is correct no matter what the image already holds.
+class FilmTile
+{
+    public:
+        FilmTile() = default;
+        ~FilmTile() = default;
+
+        // Clear and cover the pixels of a tile
+        void reset(const Sensor::Tile & tile);
+
+        // Coordinates are image pixel coordinates within the tile
+        inline void accumPixelRadiance(int x, int y, const RadianceRGB & rad);
+        inline void accumPixelColor(int x, int y, ColorRGB color);
+        inline void accumTime(int x, int y, float tm);
+
+        struct Pixel {
+            vec3 sum;
+            vec3 mean;
+            vec3 sumSquaredDiff;
+            uint32_t numSamples = 0;
+            float time = 0.0f;
+        };
+
+        inline const Pixel & pixel(int x, int y) const;
+
+        Sensor::Tile tile = { 0, 0, 0, 0 };
+        InvalidSampleCounts invalidSamples;
+
+    protected:
+        inline Pixel & mutablePixel(int x, int y);
+
+        std::vector<Pixel> pixels;
+};
+
+// Inline implementations
+
+inline const FilmTile::Pixel & FilmTile::pixel(int x, int y) const
+{
+    return pixels[(y - tile.ymin) * (tile.xmax - tile.xmin) + (x - tile.xmin)];
+}
+
+inline FilmTile::Pixel & FilmTile::mutablePixel(int x, int y)
+{
+    return pixels[(y - tile.ymin) * (tile.xmax - tile.xmin) + (x - tile.xmin)];
+}
+
+inline void FilmTile::accumPixelRadiance(int x, int y, const RadianceRGB & rad)
+{
+    accumPixelColor(x, y, ColorRGB(rad.r, rad.g, rad.b));
+}
+
+inline void FilmTile::accumPixelColor(int x, int y, ColorRGB color)
+{
+    validateSample(color, invalidSamples);
+
+    auto & p = mutablePixel(x, y);
+    vec3 value = { color.r, color.g, color.b };
+    p.sum = p.sum + value;
+    p.numSamples++;
+
+    // Welford: https://www.johndcook.com/blog/standard_deviation/
+    vec3 Dp = value - p.mean;
+    p.mean = p.mean + Dp / float(p.numSamples);
+    vec3 Dn = value - p.mean;
+    p.sumSquaredDiff = p.sumSquaredDiff + vec3{ Dp.x * Dn.x, Dp.y * Dn.y, Dp.z * Dn.z };
+}
+
+inline void FilmTile::accumTime(int x, int y, float tm)
+{
+    mutablePixel(x, y).time += tm;
+}
+
+#endif
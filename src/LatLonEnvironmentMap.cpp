@@ -1,6 +1,7 @@
 #include <iostream>
 #include "constants.h"
 #include "LatLonEnvironmentMap.h"
+#include "ThreadPool.h"
 #include "Ray.h"
 #include "vectortypes.h"
 #include "interpolation.h"
@@ -55,124 +56,40 @@ RadianceRGB LatLonEnvironmentMap::sampleRay(const Ray & ray)
 
 void LatLonEnvironmentMap::buildImportanceSampleLookup()
 {
-    int w = texture->width, h = texture->height;
-
-    rowSums = std::make_shared<Texture>(w, h, 1);
-    cumRows.resize(texture->height);
-    pdf2D = std::make_shared<Texture>(w, h, 1);
-
-    float totalCumVal = 0.0f;
-    
-    for(int y = 0; y < h; ++y) {
-        // Weight by the cosine of the elevation angle to account for
-        // area distortion in a flattened lat/lon representation
-        //float cosEl = std::cos(lerpFromTo<float>(float(y)+0.5f, 0.0f, float(h)+0.5f,
-        float cosEl = std::cos(lerpFromTo<float>(float(y)+0.5f, 0.0f, float(h),
-                                                 -constants::PI_OVER_TWO, constants::PI_OVER_TWO));
-        // Compute cumulative sums for each row
-        float rowCumVal = 0.0f;
-        for(int x = 0; x < w; ++x) {
-            float value = texture->channelSum(x, y);
-            rowCumVal += value * constants::TWO_PI;
-            pdf2D->set(x, y, 0, value);
-            rowSums->set(x, y, 0, rowCumVal);
-        }
-        totalCumVal += rowCumVal * cosEl;
-        cumRows[y] = totalCumVal;
-
-        // Normalize PDFs and CDFs to [0, 1]
-        if(rowCumVal > 0.0f) {
-            for(int x = 0; x < w; ++x) {
-                rowSums->set(x, y, 0, rowSums->get(x, y, 0) / rowCumVal);
-            }
-        }
-    }
-    // Normalize cumulative row sums to [0, 1]
-    if(totalCumVal > 0.0f) {
-        for(int y = 0; y < h; ++y) {
-            cumRows[y] /= totalCumVal;
-        }
+    const size_t w = texture->width, h = texture->height;
+    const double PI = constants::PI;
+
+    // Pixels of a row span equal longitudes, and cover the band of the
+    // sphere between the row's top and bottom polar angles
+    std::vector<float> rowSolidAngle(h);
+    for(size_t y = 0; y < h; ++y) {
+        double band = std::cos(PI * double(y) / double(h)) - std::cos(PI * double(y + 1) / double(h));
+        rowSolidAngle[y] = float(constants::TWO_PI / double(w) * band);
     }
+    pdfScale = float(double(w) * double(h) / (constants::TWO_PI * PI));
 
-    float pdfSum = 0.0f;
-    pdf2D->forEachPixel([&pdfSum](Image<float> & img, size_t x, size_t y) {
-                    pdfSum += img.get(x, y, 0); });
-
-    // Normalize the PDF
-    for(int y = 0; y < h; ++y) {
-        for(int x = 0; x < w; ++x) {
-            pdf2D->set(x, y, 0, pdf2D->get(x, y, 0) / pdfSum / constants::FOUR_PI);
+    std::vector<float> weights(w * h);
+    getThreadPool().parallelFor(h, [&](size_t y, ThreadIndex) {
+        for(size_t x = 0; x < w; ++x) {
+            weights[y * w + x] = texture->channelSum(x, y) * rowSolidAngle[y];
         }
-    }
+    });
+
+    pixelTable.build(weights);
 }
 
 vec2 LatLonEnvironmentMap::importanceSample(float e1, float e2, float & pdf) const
 {
-    const int w = texture->width, h = texture->height;
-
-#if 0  // WORKING
-    // Linear search y using row sums
-    int y;
-    for(y = 0; y < h - 1; ++y) {
-        if(cumRows[y] > e2)
-            break;
-    }
-
-    // Linear search for x in row given by y
-    int x;
-    for(x = 0; x < w - 1; ++x) {
-        if(rowSums->get(x, y, 0) > e1)
-            break;
-    }
-
-#else
-
-    // Binary search for y using row sums
-
-    int y1 = 0, y2 = h - 1;
-    //int y1 = 0, y2 = h;
-    int y = (y1 + y2) / 2;
-
-    while(y1 < y2) {
-        float value = cumRows[y];
-        if(value > e2) { y2 = y; }
-        else           { y1 = y + 1; }
-        y = (y1 + y2) / 2;
-    }
-
-    // Binary search for x in row given by y
+    const uint32_t w = uint32_t(texture->width), h = uint32_t(texture->height);
+    float dx, dy;
+    const uint32_t index = pixelTable.sample(e1, e2, dx, dy);
+    const uint32_t x = index % w, y = index / w;
 
-    int x1 = 0, x2 = w - 1;
-    int x = (x1 + x2) / 2;
+    // Uniform within the pixel
+    vec2 pixel = { float(x) + dx, float(y) + dy };
+    pdf = pixelPdf(x, y, std::sin(pixel.y / float(h) * float(constants::PI)));
 
-    while(x1 < x2) {
-        float value = rowSums->get(x, y, 0);
-        if(value > e1) { x2 = x; }
-        else           { x1 = x + 1; }
-        x = (x1 + x2) / 2;
-    }
-#endif
-
-    pdf = pdf2D->get(x, y, 0) * w * h;
-
-#if 0 // TODO: Seems okay, but needs more testing
-    // Grab some lower order bits of the random numbers and treat them
-    // as separate random numbers for subpixel sampling.
-    float sx = float(x), sy = float(y);
-    float shift = 2.0e4f;
-
-    float e3 = e1 * shift - floor(e1 * shift);
-    float e4 = e2 * shift - floor(e2 * shift);
-    //printf("e1 %f e2 %f : e3 %f e4 %f\n", e1, e2, e3, e4); // TEMP
-
-    sx += e3;
-    sy += e4;
-
-    return { sx, sy };
-#else
-    // No subpixel sampling
-    return { float(x) + 0.5f, float(y) + 0.5f };
-#endif
+    return pixel;
 }
 
 RandomDirection LatLonEnvironmentMap::importanceSampleDirection(float e1, float e2) const
@@ -199,11 +116,32 @@ RandomDirection LatLonEnvironmentMap::importanceSampleDirection(float e1, float
     return { dir, pdf };
 }
 
+float LatLonEnvironmentMap::importanceSamplePdf(const Direction3 & direction) const
+{
+    const float PI = float(constants::PI);
+    const size_t w = texture->width, h = texture->height;
+
+    float u = 0.5f * (1.0f + std::atan2(direction.x, -direction.z) / PI);
+    float cosTheta = clamp(direction.y, -1.0f, 1.0f);
+    float v = std::acos(cosTheta) / PI;
+
+    uint32_t x = uint32_t(std::min(size_t(std::max(u, 0.0f) * float(w)), w - 1));
+    uint32_t y = uint32_t(std::min(size_t(std::max(v, 0.0f) * float(h)), h - 1));
+
+    // More precise near the poles than from the polar angle
+    float sinTheta = std::sqrt(direction.x * direction.x + direction.z * direction.z);
+
+    return pixelPdf(x, y, sinTheta);
+}
+
 void LatLonEnvironmentMap::saveDebugImages()
 {
+    Image<float> pdf(texture->width, texture->height, 1);
+    pdf.forEachPixel([&](Image<float> & img, size_t x, size_t y) {
+        float theta = (float(y) + 0.5f) / float(img.height) * float(constants::PI);
+        img.set(x, y, 0, pixelPdf(uint32_t(x), uint32_t(y), std::sin(theta)));
+    });
+
     writePNG(*texture, "envmap_texture.png");
-    writePNG(*rowSums, "envmap_rowsums.png");
-    writePNG(applyGamma(*pdf2D, 1.0/10.0), "envmap_pdf.png");
-    //writePNG(*pdf2D, "envmap_pdf.png");
+    writePNG(applyGamma(pdf, 1.0/10.0), "envmap_pdf.png");
 }
-
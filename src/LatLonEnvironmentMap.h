@@ -2,6 +2,7 @@
 #define __LATLON_ENVIRONMENT_MAP_H__
 
 #include "EnvironmentMap.h"
+#include "AliasTable.h"
 
 class LatLonEnvironmentMap : public EnvironmentMap
 {
@@ -19,24 +20,31 @@ class LatLonEnvironmentMap : public EnvironmentMap
         TexturePtr getTexture() const { return texture; }
 
         // Importance sample using index variables e1,e2 in [0, 1]
-        // Returns pixel coordinate of index
+        // Returns pixel coordinate of the sample
         vec2 importanceSample(float e1, float e2, float & pdf) const override;
         RandomDirection importanceSampleDirection(float e1, float e2) const override;
-        bool canImportanceSample() const override { return true; }
+        float importanceSamplePdf(const Direction3 & direction) const override;
+        bool canImportanceSample() const override { return !pixelTable.empty(); }
 
         void saveDebugImages() override;
 
     protected:
         void buildImportanceSampleLookup();
 
+        // Solid angle density of sampling a direction in a pixel, at a
+        // polar angle (from +Y) with the given sine. Samples are uniform in
+        // longitude and polar angle within the pixel.
+        inline float pixelPdf(uint32_t x, uint32_t y, float sinTheta) const {
+            return pixelTable.probability(y * uint32_t(texture->width) + x) * pdfScale
+                / std::max(sinTheta, 1.0e-6f);
+        }
+
         TexturePtr texture;
 
-        // Importance sampling
-        //   PDFs/CDFs stored per row in textures
-        //   PDF/CDF of row aggregates
-        TexturePtr         rowSums; // Cumulative sums along rows
-        std::vector<float> cumRows; // Cumulative sum of row sums
-        TexturePtr         pdf2D;   // PDF
+        // Importance sampling. Pixels are drawn in proportion to their
+        // radiance times their solid angle, which shrinks toward the poles.
+        AliasTable pixelTable;
+        float      pdfScale = 0.0f; // 1 / (pixel width * height in radians)
 
         float scaleFactor = 1.0f;
 
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cmath>
+
+#include "LightSampler.h"
+#include "PointLight.h"
+#include "DiskLight.h"
+#include "TriangleLight.h"
+#include "barycentric.h"
+#include "constants.h"
+
+void LightSampler::build(const std::vector<PointLight> & pointLights,
+                         const std::vector<DiskLight> & diskLights,
+                         const std::vector<TriangleLight> & triangleLights,
+                         const MaterialArray & materials,
+                         const TextureArray & textures)
+{
+    std::vector<float> weights;
+    weights.reserve(pointLights.size() + diskLights.size() + triangleLights.size());
+
+    for(const auto & light : pointLights) {
+        weights.push_back(power(light));
+    }
+    for(const auto & light : diskLights) {
+        weights.push_back(power(light, materials, textures));
+    }
+    for(const auto & light : triangleLights) {
+        weights.push_back(power(light, materials, textures));
+    }
+
+    table.build(weights);
+}
+
+float LightSampler::power(const PointLight & light)
+{
+    const auto & I = light.intensity;
+    return float(constants::FOUR_PI) * (I.r + I.g + I.b);
+}
+
+float LightSampler::power(const DiskLight & light,
+                          const MaterialArray & materials,
+                          const TextureArray & textures)
+{
+    // Uniform radiance over both faces of the disk
+    const Material & material = materialFromID(light.material, materials);
+    const auto E = material.emission(textures, TextureCoordinate{ 0.0f, 0.0f });
+    const float area = float(constants::PI) * light.radius * light.radius;
+    return 2.0f * float(constants::PI) * area * (E.r + E.g + E.b);
+}
+
+float LightSampler::power(const TriangleLight & light,
+                          const MaterialArray & materials,
+                          const TextureArray & textures)
+{
+    const Material & material = materialFromID(light.material, materials);
+
+    // Texture lookup at the center, with a footprint as wide as the
+    // triangle, so the MIP level averages the texels it covers
+    TextureCoordinate center{ 0.0f, 0.0f };
+    float footprint = 0.0f;
+    if(light.hasTexCoords) {
+        const auto * tc = light.texcoords;
+        center = interpolate(tc[0], tc[1], tc[2], BarycentricCoordinate(1.0f / 3.0f, 1.0f / 3.0f));
+        for(int i = 0; i < 3; ++i) {
+            const auto & a = tc[i];
+            const auto & b = tc[(i + 1) % 3];
+            footprint = std::max(footprint, std::max(std::abs(a.u - b.u), std::abs(a.v - b.v)));
+        }
+    }
+    const auto E = material.emission(textures, center, footprint);
+
+    // Uniform radiance over both faces of the triangle
+    return 2.0f * float(constants::PI) * light.area * (E.r + E.g + E.b);
+}
@@ -0,0 +1,53 @@
+#ifndef __LIGHT_SAMPLER_H__
+#define __LIGHT_SAMPLER_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "AliasTable.h"
+#include "material.h"
+
+struct PointLight;
+struct DiskLight;
+struct TriangleLight;
+
+// Chooses one of a scene's lights with probability proportional to the
+// power it emits, so a shading point can sample a few lights instead of
+// every one. Lights are numbered point lights first, then disk lights, then
+// triangle lights.
+class LightSampler
+{
+    public:
+        LightSampler() = default;
+        ~LightSampler() = default;
+
+        void build(const std::vector<PointLight> & pointLights,
+                   const std::vector<DiskLight> & diskLights,
+                   const std::vector<TriangleLight> & triangleLights,
+                   const MaterialArray & materials,
+                   const TextureArray & textures);
+
+        // Index of a light, chosen using e1 and e2 in [0,1)
+        uint32_t sample(float e1, float e2) const { return table.sample(e1, e2); }
+
+        // Probability of choosing a light
+        float probability(uint32_t index) const { return table.probability(index); }
+
+        size_t size() const { return table.size(); }
+        bool empty() const { return table.empty(); }
+
+        // Power emitted by a light, summed over the color channels
+        static float power(const PointLight & light);
+        static float power(const DiskLight & light,
+                           const MaterialArray & materials,
+                           const TextureArray & textures);
+        // Emission textures are averaged over the triangle
+        static float power(const TriangleLight & light,
+                           const MaterialArray & materials,
+                           const TextureArray & textures);
+
+    protected:
+        AliasTable table;
+};
+
+#endif
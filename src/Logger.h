@@ -7,6 +7,7 @@
 #include <fstream>
 #include <mutex>
 #include <chrono>
+#include <memory>
 
 class Logger
 {
@@ -16,11 +16,14 @@ struct MaterialParameterRGB
     MaterialParameterRGB(const ReflectanceRGB & u) : uniform(u) {}
     MaterialParameterRGB(TextureID id) : textureId(id) {}
 
-    inline ReflectanceRGB get(const TextureArray & tex, const TextureCoordinate & texcoord) const
+    // The footprint is the width of the lookup in texture coordinates, for
+    // choosing a MIP level (0 for the finest level)
+    inline ReflectanceRGB get(const TextureArray & tex, const TextureCoordinate & texcoord,
+                              float footprint = 0.0f) const
     {
         if(textureId != NoTexture) {
             auto & texture = tex[textureId];
-            return ReflectanceRGB(texture->lerpUV3(texcoord.u, texcoord.v));
+            return ReflectanceRGB(texture->lerpUV3(texcoord.u, texcoord.v, footprint));
         }
         else {
             return uniform;
@@ -42,12 +45,13 @@ struct MaterialParameterScalar
     MaterialParameterScalar(float u) : uniform(u) {}
     MaterialParameterScalar(TextureID id) : textureId(id) {}
 
-    inline float get(const TextureArray & tex, const TextureCoordinate & texcoord) const
+    inline float get(const TextureArray & tex, const TextureCoordinate & texcoord,
+                     float footprint = 0.0f) const
     {
         if(textureId != NoTexture) {
             auto & texture = tex[textureId];
             // Take the last channel, assuming 1 channel is a mask, 3 is B&W, and 4 has alpha
-            return texture->lerpUV(texcoord.u, texcoord.v, texture->numChannels - 1);
+            return texture->lerpUV(texcoord.u, texcoord.v, texture->numChannels - 1, footprint);
         }
         else {
             return uniform;
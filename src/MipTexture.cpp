@@ -0,0 +1,280 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "MipTexture.h"
+
+const uint32_t MipTexture::TILE_SIZE;
+const int MipTexture::MAX_CHANNELS;
+
+//
+// MipTexture
+//
+
+MipTexture::MipTexture(const Image<float> & image, Format format,
+                       float offset, float scale)
+    : width(image.width),
+      height(image.height),
+      numChannels(image.numChannels),
+      format(format),
+      offset(offset),
+      scale(scale)
+{
+    if(numChannels < 1 || numChannels > MAX_CHANNELS) {
+        throw std::runtime_error("Unsupported number of texture channels: " + std::to_string(numChannels));
+    }
+    if(width == 0 || height == 0) {
+        throw std::runtime_error("Empty texture");
+    }
+
+    const size_t channelBytes = format == UInt8 ? 1 : format == Half ? 2 : 4;
+    normalize = format == UInt8 ? 1.0f / 255.0f : 1.0f;
+    texelBytes = channelBytes * numChannels;
+    tileBytes = texelBytes * TILE_SIZE * TILE_SIZE;
+
+    buildLevels(image);
+}
+
+MipTexture::~MipTexture()
+{
+    if(scratchFile >= 0) {
+        close(scratchFile);
+    }
+}
+
+MipTexture::Format MipTexture::compactFormat(const Image<float> & image)
+{
+    bool fitsUInt8 = true;
+    bool fitsHalf = true;
+    for(float value : image.data) {
+        const float s = value * 255.0f;
+        if(!(value >= 0.0f && value <= 1.0f) || std::abs(s - std::round(s)) > 1.0e-3f) {
+            fitsUInt8 = false;
+        }
+        if(!(std::abs(value) <= 65504.0f)) {
+            fitsHalf = false;
+            break;
+        }
+    }
+    return fitsUInt8 ? UInt8 : fitsHalf ? Half : Float;
+}
+
+// Each level halves the one above it, down to 1x1. Texels are the mean of
+// the 2x2 texels above them, wrapping at the edges like the lookups do.
+void MipTexture::buildLevels(const Image<float> & image)
+{
+    const size_t channels = size_t(numChannels);
+    std::vector<float> texels(image.data.begin(), image.data.end());
+    uint32_t levelWidth = uint32_t(width);
+    uint32_t levelHeight = uint32_t(height);
+
+    while(true) {
+        Level level;
+        level.width = levelWidth;
+        level.height = levelHeight;
+        level.tilesX = (levelWidth + TILE_SIZE - 1) / TILE_SIZE;
+        level.firstTile = numTiles;
+        numTiles += level.tilesX * ((levelHeight + TILE_SIZE - 1) / TILE_SIZE);
+        levels.push_back(level);
+        storeLevel(level, texels);
+
+        if(levelWidth == 1 && levelHeight == 1) {
+            break;
+        }
+
+        const uint32_t nextWidth = std::max(levelWidth / 2, 1u);
+        const uint32_t nextHeight = std::max(levelHeight / 2, 1u);
+        std::vector<float> next(size_t(nextWidth) * nextHeight * channels);
+        for(uint32_t y = 0; y < nextHeight; ++y) {
+            const uint32_t y0 = (2 * y) % levelHeight;
+            const uint32_t y1 = (2 * y + 1) % levelHeight;
+            for(uint32_t x = 0; x < nextWidth; ++x) {
+                const uint32_t x0 = (2 * x) % levelWidth;
+                const uint32_t x1 = (2 * x + 1) % levelWidth;
+                for(size_t c = 0; c < channels; ++c) {
+                    auto texel = [&](uint32_t tx, uint32_t ty) {
+                        return texels[(size_t(ty) * levelWidth + tx) * channels + c];
+                    };
+                    next[(size_t(y) * nextWidth + x) * channels + c] =
+                        0.25f * (texel(x0, y0) + texel(x1, y0) + texel(x0, y1) + texel(x1, y1));
+                }
+            }
+        }
+
+        texels.swap(next);
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+}
+
+void MipTexture::storeLevel(const Level & level, const std::vector<float> & texels)
+{
+    tiles.resize(size_t(numTiles) * tileBytes);
+
+    for(uint32_t y = 0; y < level.height; ++y) {
+        for(uint32_t x = 0; x < level.width; ++x) {
+            const uint32_t tileIndex = level.firstTile + (y / TILE_SIZE) * level.tilesX + x / TILE_SIZE;
+            uint8_t * data = tiles.data() + size_t(tileIndex) * tileBytes
+                + size_t((y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE) * texelBytes;
+            const float * source = &texels[(size_t(y) * level.width + x) * numChannels];
+
+            for(int c = 0; c < numChannels; ++c) {
+                switch(format) {
+                    case UInt8:
+                        data[c] = uint8_t(std::round(clamp(source[c], 0.0f, 1.0f) * 255.0f));
+                        break;
+                    case Half: {
+                        uint16_t h = floatToHalf(source[c]);
+                        std::memcpy(data + 2 * c, &h, 2);
+                        break;
+                    }
+                    default:
+                        std::memcpy(data + 4 * c, &source[c], 4);
+                        break;
+                }
+            }
+        }
+    }
+}
+
+void MipTexture::pageOut(const std::shared_ptr<TextureTileCache> & cache)
+{
+    if(tileCache) {
+        return;
+    }
+
+    std::string directory = cache->directory;
+    if(directory.empty()) {
+        const char * tmp = getenv("TMPDIR");
+        directory = tmp && *tmp ? tmp : "/tmp";
+    }
+    std::string name = directory + "/fluxtexXXXXXX";
+    std::vector<char> path(name.begin(), name.end());
+    path.push_back('\0');
+
+    int fd = mkstemp(path.data());
+    if(fd < 0) {
+        throw std::runtime_error("Error creating texture scratch file in " + directory + ": " + strerror(errno));
+    }
+    // The file only lives as long as the descriptor
+    unlink(path.data());
+
+    size_t written = 0;
+    while(written < tiles.size()) {
+        ssize_t n = write(fd, tiles.data() + written, tiles.size() - written);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            close(fd);
+            throw std::runtime_error("Error writing texture scratch file: " + std::string(strerror(errno)));
+        }
+        written += size_t(n);
+    }
+
+    scratchFile = fd;
+    pageID = cache->newPageID();
+    tileCache = cache;
+    std::vector<uint8_t>().swap(tiles);
+}
+
+void MipTexture::readTile(uint32_t tileIndex, uint8_t * data) const
+{
+    size_t done = 0;
+    const off_t start = off_t(tileIndex) * off_t(tileBytes);
+    while(done < tileBytes) {
+        ssize_t n = pread(scratchFile, data + done, tileBytes - done, start + off_t(done));
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            throw std::runtime_error("Error reading texture scratch file: " + std::string(strerror(errno)));
+        }
+        done += size_t(n);
+    }
+}
+
+//
+// TextureTileCache
+//
+
+static std::atomic<uint64_t> nextTileCacheID{ 1 };
+
+TextureTileCache::TextureTileCache(size_t maxBytes, const std::string & directory)
+    : maxBytes(maxBytes),
+      directory(directory),
+      cacheID(nextTileCacheID++)
+{
+}
+
+TextureTileCache::TilePtr TextureTileCache::tile(const MipTexture & texture, uint32_t pageID, uint32_t tileIndex)
+{
+    const uint64_t key = (uint64_t(pageID) << 32) | tileIndex;
+
+    // Tiles this thread used last, direct mapped by key
+    struct RecentTile {
+        uint64_t cacheID = 0;
+        uint64_t key = 0;
+        TilePtr tile;
+    };
+    static const int NUM_RECENT = 8;
+    thread_local RecentTile recent[NUM_RECENT];
+
+    auto & mine = recent[(tileIndex ^ pageID * 5) % NUM_RECENT];
+    if(mine.cacheID == cacheID && mine.key == key) {
+        return mine.tile;
+    }
+
+    auto & shard = shards[(key ^ (key >> 29)) % NUM_SHARDS];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    TilePtr result;
+    auto found = shard.entries.find(key);
+    if(found != shard.entries.end()) {
+        ++shard.hits;
+        shard.lru.splice(shard.lru.begin(), shard.lru, found->second.lru);
+        result = found->second.tile;
+    }
+    else {
+        ++shard.misses;
+        auto data = std::make_shared<std::vector<uint8_t>>(texture.tileSizeInBytes());
+        texture.readTile(tileIndex, data->data());
+        result = data;
+
+        shard.lru.push_front(key);
+        shard.entries[key] = Entry{ result, shard.lru.begin() };
+        shard.bytes += result->size();
+
+        // Evict least recently used tiles, keeping at least the new one
+        const size_t shardMaxBytes = maxBytes / NUM_SHARDS;
+        while(shard.bytes > shardMaxBytes && shard.lru.size() > 1) {
+            auto evicted = shard.entries.find(shard.lru.back());
+            shard.bytes -= evicted->second.tile->size();
+            shard.entries.erase(evicted);
+            shard.lru.pop_back();
+            ++shard.evictions;
+        }
+    }
+
+    mine.cacheID = cacheID;
+    mine.key = key;
+    mine.tile = result;
+
+    return result;
+}
+
+TextureTileCache::Stats TextureTileCache::stats() const
+{
+    Stats total;
+    for(auto & shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total.hits += shard.hits;
+        total.misses += shard.misses;
+        total.evictions += shard.evictions;
+        total.residentBytes += shard.bytes;
+    }
+    return total;
+}
@@ -0,0 +1,281 @@
+#ifndef __MIP_TEXTURE_H__
+#define __MIP_TEXTURE_H__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "image.h"
+#include "half.h"
+
+class TextureTileCache;
+
+// Texture for material lookups. On construction the image is filtered into
+// a MIP pyramid and stored in square tiles, in 8-bit, half or float texels.
+// A bilinear lookup usually touches one tile, and 8-bit tiles of a 4 channel
+// texture are a few cache lines, so lookups hit far fewer cache lines than a
+// row-major float image would.
+//
+// Tiles stay in memory unless the texture is paged out to a tile cache,
+// which keeps only the most recently used tiles of all paged textures.
+//
+// Lookups take the width of the lookup's footprint in texture coordinates
+// (0 for the finest level), and blend the two nearest MIP levels.
+class MipTexture
+{
+    public:
+        enum Format { UInt8, Half, Float };
+
+        static const uint32_t TILE_SIZE = 8;
+        static const int MAX_CHANNELS = 4;
+
+        // Stored texel values s decode to offset + scale * s, so for
+        // example normal maps can be stored as 8-bit colors. Throws
+        // std::runtime_error if the image has more than MAX_CHANNELS.
+        MipTexture(const Image<float> & image, Format format,
+                   float offset = 0.0f, float scale = 1.0f);
+        ~MipTexture();
+
+        MipTexture(const MipTexture &) = delete;
+        MipTexture & operator=(const MipTexture &) = delete;
+
+        // Smallest format for the image. 8-bit if every value is an 8-bit
+        // value in [0,1] (as loaded from LDR files), which is exact. Else
+        // half if every value is within half's range (+/-65504), which
+        // keeps about 3 significant digits. Else float.
+        static Format compactFormat(const Image<float> & image);
+
+        // Move the tiles to a scratch file, to be read through the cache
+        // as needed. Throws std::runtime_error if the file can't be written.
+        void pageOut(const std::shared_ptr<TextureTileCache> & cache);
+        bool isPagedOut() const { return tileCache != nullptr; }
+
+        // Texel of the finest level, wrapping out of bounds coordinates
+        inline float get(size_t x, size_t y, int channel) const;
+
+        inline float lerpUV(float u, float v, int channel, float footprint = 0.0f) const;
+        inline ColorRGB lerpUV3(float u, float v, float footprint = 0.0f) const;
+        // All channels of one lookup, so each texel is fetched once
+        inline void lookupUV(float u, float v, float footprint, float * values) const;
+
+        // Fractional MIP level for a footprint
+        inline float mipLevel(float footprint) const;
+        size_t numLevels() const { return levels.size(); }
+
+        // Bytes of all tiles, and bytes of tiles held by the texture itself
+        size_t storageBytes() const { return size_t(numTiles) * tileBytes; }
+        size_t residentBytes() const { return tiles.size(); }
+        size_t tileSizeInBytes() const { return tileBytes; }
+
+        // Copy one tile from the scratch file. Used by the tile cache.
+        void readTile(uint32_t tileIndex, uint8_t * data) const;
+
+        size_t width = 0;
+        size_t height = 0;
+        int numChannels = 0;
+        Format format = Float;
+
+        struct Level {
+            uint32_t width, height;
+            uint32_t tilesX;
+            uint32_t firstTile;
+        };
+        std::vector<Level> levels;
+
+    protected:
+        void buildLevels(const Image<float> & image);
+        void storeLevel(const Level & level, const std::vector<float> & texels);
+
+        inline void bilerpLevel(const Level & level, float u, float v, float * values) const;
+        inline void fetch(const Level & level, uint32_t x, uint32_t y, float * values) const;
+
+        size_t texelBytes = 0;
+        size_t tileBytes = 0;
+        uint32_t numTiles = 0;
+
+        // Stored value s decodes to (s * normalize) * scale + offset
+        float normalize = 1.0f;
+        float offset = 0.0f;
+        float scale = 1.0f;
+
+        std::vector<uint8_t> tiles;
+
+        // Set once paged out
+        std::shared_ptr<TextureTileCache> tileCache;
+        uint32_t pageID = 0;
+        int scratchFile = -1;
+};
+
+// Bounded LRU cache of texture tiles, shared by paged out textures. Tiles
+// are reference counted, so a tile evicted while a lookup uses it stays
+// valid until the lookup is done. Each thread also keeps its last few tiles
+// without locking, which can hold a few tiles per thread past the budget.
+class TextureTileCache
+{
+    public:
+        using TilePtr = std::shared_ptr<const std::vector<uint8_t>>;
+
+        // Scratch files are created in the directory, or the system temp
+        // directory if empty
+        TextureTileCache(size_t maxBytes, const std::string & directory = "");
+        ~TextureTileCache() = default;
+
+        TilePtr tile(const MipTexture & texture, uint32_t pageID, uint32_t tileIndex);
+
+        uint32_t newPageID() { return nextPageID++; }
+
+        struct Stats {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+            size_t residentBytes = 0;
+        };
+        Stats stats() const;
+
+        const size_t maxBytes;
+        const std::string directory;
+
+    protected:
+        static const int NUM_SHARDS = 16;
+
+        struct Entry {
+            TilePtr tile;
+            std::list<uint64_t>::iterator lru;
+        };
+
+        struct Shard {
+            std::mutex mutex;
+            std::unordered_map<uint64_t, Entry> entries;
+            std::list<uint64_t> lru;  // most recently used first
+            size_t bytes = 0;
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+        };
+        mutable std::array<Shard, NUM_SHARDS> shards;
+
+        std::atomic<uint32_t> nextPageID{ 0 };
+        // Distinguishes caches in the per-thread tiles
+        const uint64_t cacheID;
+};
+
+// Inline implementations
+
+inline float MipTexture::get(size_t x, size_t y, int channel) const
+{
+    const auto & level = levels[0];
+    float values[MAX_CHANNELS];
+    fetch(level, uint32_t(x % level.width), uint32_t(y % level.height), values);
+    return values[channel];
+}
+
+inline float MipTexture::lerpUV(float u, float v, int channel, float footprint) const
+{
+    float values[MAX_CHANNELS];
+    lookupUV(u, v, footprint, values);
+    return values[channel];
+}
+
+inline ColorRGB MipTexture::lerpUV3(float u, float v, float footprint) const
+{
+    float values[MAX_CHANNELS];
+    lookupUV(u, v, footprint, values);
+    if(numChannels < 3) {
+        // Gray
+        return { values[0], values[0], values[0] };
+    }
+    return { values[0], values[1], values[2] };
+}
+
+inline float MipTexture::mipLevel(float footprint) const
+{
+    const float texels = footprint * float(std::max(width, height));
+    if(!(texels > 1.0f)) {
+        return 0.0f;
+    }
+    return std::min(std::log2(texels), float(levels.size() - 1));
+}
+
+inline void MipTexture::lookupUV(float u, float v, float footprint, float * values) const
+{
+    const float level = mipLevel(footprint);
+    const uint32_t fine = uint32_t(level);
+    const float blend = level - float(fine);
+
+    bilerpLevel(levels[fine], u, v, values);
+
+    if(blend > 0.0f && fine + 1 < levels.size()) {
+        float coarse[MAX_CHANNELS];
+        bilerpLevel(levels[fine + 1], u, v, coarse);
+        for(int c = 0; c < numChannels; ++c) {
+            values[c] += blend * (coarse[c] - values[c]);
+        }
+    }
+}
+
+// Same filtering as Image<float>::lerpUV() with Repeat out of bounds
+// behavior, on one level
+inline void MipTexture::bilerpLevel(const Level & level, float u, float v, float * values) const
+{
+    float x = u * float(level.width) - 0.5f;
+    float y = v * float(level.height) - 0.5f;
+    const float fx = std::floor(x);
+    const float fy = std::floor(y);
+    const float bx = x - fx;
+    const float by = y - fy;
+
+    // Wrap, taking care with large or negative coordinates
+    auto wrap = [](float i, uint32_t size) {
+        float w = std::fmod(i, float(size));
+        if(w < 0.0f) { w += float(size); }
+        return std::min(uint32_t(w), size - 1);
+    };
+    const uint32_t x0 = wrap(fx, level.width);
+    const uint32_t y0 = wrap(fy, level.height);
+    const uint32_t x1 = x0 + 1 < level.width ? x0 + 1 : 0;
+    const uint32_t y1 = y0 + 1 < level.height ? y0 + 1 : 0;
+
+    float v00[MAX_CHANNELS], v01[MAX_CHANNELS], v10[MAX_CHANNELS], v11[MAX_CHANNELS];
+    fetch(level, x0, y0, v00);
+    fetch(level, x0, y1, v01);
+    fetch(level, x1, y0, v10);
+    fetch(level, x1, y1, v11);
+
+    for(int c = 0; c < numChannels; ++c) {
+        values[c] = bilerp(bx, by, v00[c], v01[c], v10[c], v11[c]);
+    }
+}
+
+inline void MipTexture::fetch(const Level & level, uint32_t x, uint32_t y, float * values) const
+{
+    const uint32_t tileIndex = level.firstTile + (y / TILE_SIZE) * level.tilesX + x / TILE_SIZE;
+    const size_t texel = size_t((y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE) * texelBytes;
+
+    const uint8_t * data;
+    TextureTileCache::TilePtr held;
+    if(tileCache) {
+        held = tileCache->tile(*this, pageID, tileIndex);
+        data = held->data() + texel;
+    }
+    else {
+        data = tiles.data() + size_t(tileIndex) * tileBytes + texel;
+    }
+
+    for(int c = 0; c < numChannels; ++c) {
+        float s;
+        switch(format) {
+            case UInt8: s = float(data[c]); break;
+            case Half:  { uint16_t h; std::memcpy(&h, data + 2 * c, 2); s = halfToFloat(h); } break;
+            default:    std::memcpy(&s, data + 4 * c, 4); break;
+        }
+        values[c] = (s * normalize) * scale + offset;
+    }
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <string>
+
+#include "PathStatistics.h"
+#include "Logger.h"
+
+static void addCounts(std::vector<uint64_t> & counts, const std::vector<uint64_t> & other)
+{
+    if(other.size() > counts.size()) {
+        counts.resize(other.size(), 0);
+    }
+    for(size_t depth = 0; depth < other.size(); ++depth) {
+        counts[depth] += other[depth];
+    }
+}
+
+static uint64_t countAt(const std::vector<uint64_t> & counts, size_t depth)
+{
+    return depth < counts.size() ? counts[depth] : 0;
+}
+
+uint64_t PathStatistics::numPaths() const
+{
+    uint64_t total = 0;
+    for(auto n : pathsEnded) {
+        total += n;
+    }
+    return total;
+}
+
+PathStatistics & PathStatistics::operator+=(const PathStatistics & other)
+{
+    addCounts(pathsEnded, other.pathsEnded);
+    addCounts(russianRouletteTests, other.russianRouletteTests);
+    addCounts(russianRouletteTerminations, other.russianRouletteTerminations);
+    return *this;
+}
+
+void PathStatistics::log(Logger & logger) const
+{
+    const uint64_t total = numPaths();
+    logger.normalf("Path statistics: %llu paths", (unsigned long long) total);
+    if(total == 0) {
+        return;
+    }
+
+    uint64_t mostEnded = 0;
+    for(auto n : pathsEnded) {
+        mostEnded = std::max(mostEnded, n);
+    }
+
+    logger.normalf("  Depth      Ended        %%  RR tests   RR ended  RR rate");
+    const size_t numDepths = std::max(pathsEnded.size(), russianRouletteTests.size());
+    for(size_t depth = 0; depth < numDepths; ++depth) {
+        const uint64_t ended = countAt(pathsEnded, depth);
+        const uint64_t tests = countAt(russianRouletteTests, depth);
+        const uint64_t terminated = countAt(russianRouletteTerminations, depth);
+        if(ended == 0 && tests == 0) {
+            continue;
+        }
+
+        // Bar scaled to the most common length
+        const std::string bar(size_t(40 * ended / mostEnded), '#');
+        logger.normalf("  %5zu %10llu %7.2f%% %9llu %10llu %7.2f%% %s",
+                       depth, (unsigned long long) ended, 100.0 * ended / total,
+                       (unsigned long long) tests, (unsigned long long) terminated,
+                       tests > 0 ? 100.0 * terminated / tests : 0.0,
+                       bar.c_str());
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef __PATH_STATISTICS_H__
+#define __PATH_STATISTICS_H__
+
+#include <cstdint>
+#include <vector>
+
+class Logger;
+
+// Where paths end and how often Russian roulette ends them, by depth, for
+// tuning the maximum depth and Russian roulette against real scenes. Each
+// thread keeps counts of its own, summed when rendering is done.
+struct PathStatistics
+{
+    // Paths by the depth of the ray that ended them. Paths cut off by the
+    // maximum depth end one past it.
+    std::vector<uint64_t> pathsEnded;
+    // Russian roulette tests and terminations by depth
+    std::vector<uint64_t> russianRouletteTests;
+    std::vector<uint64_t> russianRouletteTerminations;
+
+    void recordPathEnd(unsigned int depth) { ++count(pathsEnded, depth); }
+    void recordRussianRoulette(unsigned int depth, bool terminated) {
+        ++count(russianRouletteTests, depth);
+        if(terminated) {
+            ++count(russianRouletteTerminations, depth);
+        }
+    }
+
+    uint64_t numPaths() const;
+
+    PathStatistics & operator+=(const PathStatistics & other);
+
+    // Histogram of path lengths and Russian roulette termination rates
+    void log(Logger & logger) const;
+
+    protected:
+        // Counts only grow until they cover the deepest path
+        static uint64_t & count(std::vector<uint64_t> & counts, unsigned int depth) {
+            if(depth >= counts.size()) {
+                counts.resize(depth + 1, 0);
+            }
+            return counts[depth];
+        }
+};
+
+#endif
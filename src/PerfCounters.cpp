@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+
+#include "PerfCounters.h"
+#include "Logger.h"
+
+namespace perf {
+
+const char * const LoadPhase = "load";
+const char * const TracePhase = "trace";
+const char * const OutputPhase = "output";
+
+// Enough for the threads of any thread pool running at once. Threads past
+// these share one more block, which also keeps the counts of threads that
+// have exited.
+static const unsigned int MAX_BLOCKS = 256;
+static CounterBlock blocks[MAX_BLOCKS];
+static CounterBlock sharedBlock(true);
+// Blocks [0, numBlocksUsed) have been claimed at some point. Those released
+// since are in freeBlocks.
+static std::atomic<unsigned int> numBlocksUsed(0);
+static std::mutex freeBlocksMutex;
+static std::vector<unsigned int> freeBlocks;
+
+static std::mutex phasesMutex;
+static std::vector<std::pair<std::string, double>> phases;
+
+const char * counterName(Counter counter)
+{
+    switch(counter) {
+        case CameraRays:    return "camera_rays";
+        case BounceRays:    return "bounce_rays";
+        case ShadowRays:    return "shadow_rays";
+        case EnvMapRays:    return "envmap_rays";
+        case NodesVisited:  return "nodes_visited";
+        case TriangleTests: return "triangle_tests";
+        case ShadingCalls:  return "shading_calls";
+        default:            return "unknown";
+    }
+}
+
+CounterBlock & claimBlock()
+{
+    std::lock_guard<std::mutex> lock(freeBlocksMutex);
+    if(!freeBlocks.empty()) {
+        const unsigned int index = freeBlocks.back();
+        freeBlocks.pop_back();
+        return blocks[index];
+    }
+    const unsigned int index = numBlocksUsed.load(std::memory_order_relaxed);
+    if(index < MAX_BLOCKS) {
+        numBlocksUsed.store(index + 1, std::memory_order_relaxed);
+        return blocks[index];
+    }
+    return sharedBlock;
+}
+
+void releaseBlock(CounterBlock & block)
+{
+    if(block.shared) {
+        return;
+    }
+    // Only the exiting thread writes the block, so the move needs no lock
+    for(unsigned int counter = 0; counter < NumCounters; ++counter) {
+        const uint64_t value = block.counts[counter].exchange(0, std::memory_order_relaxed);
+        sharedBlock.counts[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> lock(freeBlocksMutex);
+    freeBlocks.push_back(unsigned(&block - blocks));
+}
+
+void recordPhase(const std::string & name, double seconds)
+{
+    std::lock_guard<std::mutex> lock(phasesMutex);
+    for(auto & phase : phases) {
+        if(phase.first == name) {
+            phase.second += seconds;
+            return;
+        }
+    }
+    phases.emplace_back(name, seconds);
+}
+
+Report report()
+{
+    Report report;
+    auto add = [&](const CounterBlock & block) {
+        for(unsigned int counter = 0; counter < NumCounters; ++counter) {
+            report.counts[counter] += block.counts[counter].load(std::memory_order_relaxed);
+        }
+    };
+    const unsigned int numBlocks = numBlocksUsed.load();
+    for(unsigned int index = 0; index < numBlocks; ++index) {
+        add(blocks[index]);
+    }
+    add(sharedBlock);
+
+    std::lock_guard<std::mutex> lock(phasesMutex);
+    report.phases = phases;
+    return report;
+}
+
+void reset()
+{
+    auto zero = [](CounterBlock & block) {
+        for(auto & value : block.counts) {
+            value.store(0, std::memory_order_relaxed);
+        }
+    };
+    for(auto & block : blocks) {
+        zero(block);
+    }
+    zero(sharedBlock);
+
+    std::lock_guard<std::mutex> lock(phasesMutex);
+    phases.clear();
+}
+
+uint64_t Report::rays() const
+{
+    return counts[CameraRays] + counts[BounceRays] + counts[ShadowRays] + counts[EnvMapRays];
+}
+
+double Report::phaseTime(const std::string & name) const
+{
+    for(const auto & phase : phases) {
+        if(phase.first == name) {
+            return phase.second;
+        }
+    }
+    return 0.0;
+}
+
+double Report::megaRaysPerSecond() const
+{
+    const double seconds = phaseTime(TracePhase);
+    return seconds > 0.0 ? double(rays()) / seconds * 1.0e-6 : 0.0;
+}
+
+std::string Report::json() const
+{
+    std::ostringstream out;
+    out << "{\n  \"counters\": {\n";
+    for(unsigned int counter = 0; counter < NumCounters; ++counter) {
+        out << "    \"" << counterName(Counter(counter)) << "\": " << counts[counter]
+            << (counter + 1 < NumCounters ? ",\n" : "\n");
+    }
+    out << "  },\n  \"rays\": " << rays() << ",\n";
+    out << "  \"mrays_per_second\": " << megaRaysPerSecond() << ",\n";
+    out << "  \"phases\": {";
+    for(size_t index = 0; index < phases.size(); ++index) {
+        // Phase names are our own identifiers, so need no escaping
+        out << (index > 0 ? ",\n" : "\n") << "    \"" << phases[index].first << "\": " << phases[index].second;
+    }
+    out << (phases.empty() ? "}\n" : "\n  }\n") << "}\n";
+    return out.str();
+}
+
+// Lines of the summary table
+template<typename LineFunction>
+static void summary(const Report & report, LineFunction && line)
+{
+    char buffer[128];
+    line("Performance counters:");
+    for(unsigned int counter = 0; counter < NumCounters; ++counter) {
+        snprintf(buffer, sizeof(buffer), "  %-16s %16llu", counterName(Counter(counter)),
+                 (unsigned long long) report.counts[counter]);
+        line(buffer);
+    }
+    snprintf(buffer, sizeof(buffer), "  %-16s %16llu", "rays", (unsigned long long) report.rays());
+    line(buffer);
+    snprintf(buffer, sizeof(buffer), "  %-16s %16.3f", "mrays_per_second", report.megaRaysPerSecond());
+    line(buffer);
+    for(const auto & phase : report.phases) {
+        snprintf(buffer, sizeof(buffer), "  %-16s %15.3fs", phase.first.c_str(), phase.second);
+        line(buffer);
+    }
+}
+
+void Report::print() const
+{
+    summary(*this, [](const char * line) { printf("%s\n", line); });
+}
+
+void Report::log(Logger & logger) const
+{
+    summary(*this, [&](const char * line) { logger.normal(line); });
+}
+
+} // namespace perf
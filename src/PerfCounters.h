@@ -0,0 +1,122 @@
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Logger;
+
+// Counters of rendering work, cheap enough to leave on everywhere. Each
+// thread counts into a block of its own, claimed the first time it counts
+// and released for reuse when the thread exits, so counting takes no lock
+// and shares no cache line with other threads. report() sums the blocks of
+// all threads.
+namespace perf {
+
+enum Counter : unsigned int {
+    CameraRays,
+    BounceRays,         // rays continuing a path past a hit (BRDF samples and refraction)
+    ShadowRays,         // light samples
+    EnvMapRays,         // environment map samples
+    NodesVisited,       // acceleration structure nodes tested against a ray
+    TriangleTests,      // every lane of each triangle packet tested
+    ShadingCalls,       // hits shaded
+    NumCounters
+};
+
+const char * counterName(Counter counter);
+
+// Counts of one thread. Only the owning thread writes them, unless the
+// block is shared by the threads past the number of blocks in use.
+struct alignas(64) CounterBlock {
+    explicit CounterBlock(bool shared = false) : shared(shared) {
+        for(auto & value : counts) {
+            value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<uint64_t> counts[NumCounters];
+    const bool shared;
+};
+
+// Claim a free block, or the shared one if none is free
+CounterBlock & claimBlock();
+// Keep the counts of a block and free it for another thread
+void releaseBlock(CounterBlock & block);
+
+// Block claimed by a thread, released when the thread exits
+struct ThreadBlockClaim {
+    ~ThreadBlockClaim() {
+        if(block) {
+            releaseBlock(*block);
+        }
+    }
+    CounterBlock * block = nullptr;
+};
+
+// Block of the calling thread, claiming one on first use
+inline CounterBlock & threadBlock()
+{
+    static thread_local ThreadBlockClaim claim;
+    if(!claim.block) {
+        claim.block = &claimBlock();
+    }
+    return *claim.block;
+}
+
+// Add to a counter of the calling thread
+inline void count(Counter counter, uint64_t n = 1)
+{
+    CounterBlock & block = threadBlock();
+    auto & value = block.counts[counter];
+    if(block.shared) {
+        value.fetch_add(n, std::memory_order_relaxed);
+    }
+    else {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+}
+
+// Names of the phases of a render. Rays per second are measured over the
+// trace phase.
+extern const char * const LoadPhase;
+extern const char * const TracePhase;
+extern const char * const OutputPhase;
+
+// Wall clock time of a named phase of work, such as loading or tracing.
+// Times of phases recorded more than once add up.
+void recordPhase(const std::string & name, double seconds);
+
+struct Report
+{
+    uint64_t counts[NumCounters] = {};
+    // Phases and their time in seconds, in the order they were first recorded
+    std::vector<std::pair<std::string, double>> phases;
+
+    uint64_t operator[](Counter counter) const { return counts[counter]; }
+
+    // Rays of every type
+    uint64_t rays() const;
+    // Time of a phase, 0 if it was not recorded
+    double phaseTime(const std::string & name) const;
+    // Millions of rays per second of the trace phase, 0 if it was not recorded
+    double megaRaysPerSecond() const;
+
+    std::string json() const;
+    // Summary table
+    void print() const;
+    void log(Logger & logger) const;
+};
+
+// Sum of the counts of all threads, and the phases recorded so far
+Report report();
+
+// Zero all counts and forget the phases. Only call while nothing is counting.
+void reset();
+
+} // namespace perf
+
+#endif
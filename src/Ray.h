@@ -22,6 +22,23 @@ struct Ray
     Direction3 direction;
 };
 
+struct Traceable;
+
+// Closest hit found by traversal. Holds just enough to evaluate the surface
+// at the hit afterwards (see Traceable::fillIntersection()), which is only
+// done once, for the closest hit, instead of for every closer hit found
+// along the way.
+struct RayHit
+{
+    float distance = std::numeric_limits<float>::max();
+    // Primitive of the object that was hit (eg: triangle index)
+    uint32_t primitive = 0;
+    // Object that was hit, set by containers of objects (eg: the instance
+    // hit in a top level BVH)
+    const Traceable * object = nullptr;
+};
+
+// Surface at a hit
 struct RayIntersection
 {
     inline RayIntersection() = default;
@@ -36,6 +53,15 @@ struct RayIntersection
     MaterialID material = NoMaterial;
     TextureCoordinate texcoord;
     bool hasTexCoord = false;
+    // Texture coordinate units per unit of distance on the surface
+    float texcoordScale = 0.0f;
+    // Width of the ray's footprint in texture coordinates, for choosing
+    // texture MIP levels. Set by the renderer, 0 for the finest level.
+    float texcoordFootprint = 0.0f;
+    // Top level scene object hit, and the primitive of it that was hit.
+    // Set by findIntersectionWorldRay().
+    const Traceable * object = nullptr;
+    uint32_t primitive = 0;
 };
 
 std::ostream & operator<<(std::ostream & os, const Ray & r);
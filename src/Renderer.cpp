@@ -1,11 +1,17 @@
+#include <functional>
+
 #include "material.h"
 #include "Renderer.h"
 #include "Logger.h"
 #include "Ray.h"
 #include "rng.h"
+#include "Sampler.h"
 #include "scene.h"
 #include "coordinate.h"
 #include "brdf.h"
+#include "barycentric.h"
+#include "PathStatistics.h"
+#include "PerfCounters.h"
 
 void printDepthPrefix(unsigned int num)
 {
@@ -14,99 +20,167 @@ void printDepthPrefix(unsigned int num)
     }
 }
 
-bool Renderer::traceRay(const Scene & scene, RNG & rng, const Ray & ray,
+bool Renderer::traceRay(const Scene & scene, Sampler & sampler, const Ray & ray,
                         const float minDistance, const unsigned int depth,
                         const MediumStack & mediumStack,
-                        bool accumEmission,
-                        bool accumEnvMap,
+                        const DirectLightSampling & lightSampling,
                         RayIntersection & intersection,
-                        RadianceRGB & Lo) const
+                        RadianceRGB & Lo,
+                        PathStatistics * statistics) const
 {
-    if(depth > maxDepth) {
-        return false;
-    }
+    Lo = RadianceRGB::BLACK();
 
-    // Check for RR termination
-    if(depth >= russianRouletteMinDepth
-       && rng.uniform01() < russianRouletteChance) {
-        return false;
+    PathState path;
+    path.ray = ray;
+    path.minDistance = minDistance;
+    path.depth = depth;
+    path.mediumStack = mediumStack;
+    path.lightSampling = lightSampling;
+
+    PendingPaths pending;
+
+    bool hit = tracePath(scene, sampler, path, pending, intersection, Lo, statistics);
+
+    // Follow the paths set aside along the way
+    RayIntersection pendingIntersection;
+    while(pending.count > 0) {
+        path = pending.paths[--pending.count];
+        sampler.setState(path.samplerState);
+        tracePath(scene, sampler, path, pending, pendingIntersection, Lo, statistics);
     }
 
-    // Russian roulette factor applied if we didn't terminate early
-    float RR = (depth >= russianRouletteMinDepth) ?  1.0f - russianRouletteChance : 1.0f;
+    return hit;
+}
+
+inline bool Renderer::tracePath(const Scene & scene, Sampler & sampler,
+                                PathState & path, PendingPaths & pending,
+                                RayIntersection & intersection,
+                                RadianceRGB & Lo,
+                                PathStatistics * statistics) const
+{
+    RayIntersection laterIntersection;
+    bool hit = false;
+
+    while(path.depth <= maxDepth) {
+        if(!survivesRussianRoulette(sampler, path, statistics)) {
+            break;
+        }
 
-    bool hit = findIntersectionWorldRay(ray, scene, minDistance, intersection);
+        RayIntersection & isect = hit ? laterIntersection : intersection;
 
-    if(!hit) {
-        if(accumEnvMap) {
+        if(!findIntersectionWorldRay(path.ray, scene, path.minDistance, isect)) {
             assert(scene.environmentMap);
-            Lo = scene.environmentMap->sampleRay(ray);
+            Lo += path.throughput
+                * environmentMapWeight(scene, path.lightSampling, path.ray.direction)
+                * scene.environmentMap->sampleRay(path.ray);
+            break;
+        }
+
+        assert(isect.distance >= path.minDistance);
+
+        const Direction3 Wo = -path.ray.direction;
+
+        isect.texcoordFootprint = textureFootprint(isect);
+        const float footprint = isect.texcoordFootprint;
+
+        const Material & material = materialFromID(isect.material, scene.materials);
+        auto A = material.alpha(scene.textureCache.textures, isect.texcoord, footprint);
+
+        material.applyNormalMap(scene.textureCache.textures, isect.texcoord,
+                                isect.normal, isect.tangent, isect.bitangent,
+                                footprint);
+
+        // Transparency: continue the same ray just past the intersection
+        if(A < 1.0f && sampler.get1D() > A) {
+            path.minDistance = applyRayDistanceEpsilon(isect.distance);
+            continue;
         }
-        Lo /= RR;
-        return false;
-    }
 
-    assert(intersection.distance >= minDistance);
+        hit = true;
 
-    const Direction3 Wo = -ray.direction;
+        // Emission (not attenuated by the medium)
+        const auto E = material.emission(scene.textureCache.textures, isect.texcoord, footprint);
+        if(E.hasNonZeroComponent()) {
+            Lo += path.throughput * emissionWeight(scene, path.lightSampling, isect) * E;
+        }
 
-    const Material & material = materialFromID(intersection.material, scene.materials);
-    auto A = material.alpha(scene.textureCache.textures, intersection.texcoord);
+        // Apply Beer's Law attenuation to everything reflected or transmitted here
+        ParameterRGB att = path.mediumStack.back().beersLawAttenuation;
+        ParameterRGB weight = path.throughput * optics::beersLawAttenuation(att, isect.distance);
 
-    material.applyNormalMap(scene.textureCache.textures, intersection.texcoord,
-                            intersection.normal, intersection.tangent, intersection.bitangent);
+        if(!shade(scene, sampler, path, weight, Wo, isect, material, pending, Lo)) {
+            break;
+        }
+    }
 
-    // Transparency
-    if(A < 1.0f && rng.uniform01() > A) {
-        // Trace a new ray just past the intersection
-        const float newMinDistance = applyRayDistanceEpsilon(intersection.distance);
-        bool hit = traceRay(scene, rng, ray, newMinDistance, depth, mediumStack, accumEmission, accumEnvMap, intersection, Lo);
-        Lo /= RR;
-        return hit;
+    if(statistics) {
+        statistics->recordPathEnd(path.depth);
     }
 
-    Lo = shade(scene, rng, minDistance, depth, mediumStack, Wo, intersection, material);
+    return hit;
+}
 
-    // Apply Beer's Law attenuation
-    ParameterRGB att = mediumStack.back().beersLawAttenuation;
-    ParameterRGB beer = optics::beersLawAttenuation(att, intersection.distance);
-    Lo = Lo * beer;
+float Renderer::russianRouletteSurvival(const ParameterRGB & throughput) const
+{
+    const float brightest = std::max(throughput.r, std::max(throughput.g, throughput.b));
+    return clamp(brightest, 1.0f - russianRouletteChance, 1.0f);
+}
 
-    // Emission
-    if(accumEmission) {
-        const auto E = material.emission(scene.textureCache.textures, intersection.texcoord);
-        Lo += E;
+bool Renderer::survivesRussianRoulette(Sampler & sampler, PathState & path,
+                                       PathStatistics * statistics) const
+{
+    if(path.depth < russianRouletteMinDepth || russianRouletteChance <= 0.0f
+       || path.depth == path.rouletteDepth) {
+        return true;
     }
+    path.rouletteDepth = path.depth;
 
-    // Account for RR loss
-    Lo /= RR;
+    const float survival = russianRouletteSurvival(path.throughput);
+    const bool survives = survival >= 1.0f || sampler.get1D() < survival;
 
-    return true;
+    if(statistics) {
+        statistics->recordRussianRoulette(path.depth, !survives);
+    }
+
+    if(survives) {
+        path.throughput = path.throughput / survival;
+    }
+
+    return survives;
+}
+
+float Renderer::textureFootprint(const RayIntersection & intersection) const
+{
+    // Grazing hits stretch the footprint along the surface. Limit the
+    // stretch so the footprint stays finite at silhouettes.
+    const float cosine = std::max(absDot(intersection.ray.direction, intersection.normal), 0.1f);
+    return pixelSpreadAngle * intersection.distance * intersection.texcoordScale / cosine;
 }
 
-RadianceRGB Renderer::traceRay(const Scene & scene, RNG & rng,
+RadianceRGB Renderer::traceRay(const Scene & scene, Sampler & sampler,
                                const Ray & ray,
                                const float minDistance, const unsigned int depth,
                                const MediumStack & mediumStack,
-                               bool accumEmission, bool accumEnvMap) const
+                               const DirectLightSampling & lightSampling) const
 {
     RayIntersection intersection;
     RadianceRGB Lo;
     
     // Ignore return
-    traceRay(scene, rng, ray, minDistance, depth, mediumStack, accumEmission, accumEnvMap, intersection, Lo);
+    traceRay(scene, sampler, ray, minDistance, depth, mediumStack, lightSampling, intersection, Lo);
 
     return Lo;
 }
 
-inline RadianceRGB Renderer::shade(const Scene & scene, RNG & rng,
-                                   const float minDistance,
-                                   const unsigned int depth,
-                                   const MediumStack & mediumStack,
-                                   const Direction3 & Wo,
-                                   RayIntersection & intersection,
-                                   const Material & material) const
+inline bool Renderer::shade(const Scene & scene, Sampler & sampler,
+                            PathState & path, const ParameterRGB & weight,
+                            const Direction3 & Wo,
+                            const RayIntersection & intersection,
+                            const Material & material,
+                            PendingPaths & pending, RadianceRGB & Lo) const
 {
+    perf::count(perf::ShadingCalls);
+
     // Notational convenience
     const auto P = intersection.position;
     auto N = intersection.normal;
@@ -115,8 +189,9 @@ inline RadianceRGB Renderer::shade(const Scene & scene, RNG & rng,
         N.negate();
     }
 
-    const auto D = material.diffuse(scene.textureCache.textures, intersection.texcoord);
-    const auto S = material.specular(scene.textureCache.textures, intersection.texcoord);
+    const float footprint = intersection.texcoordFootprint;
+    const auto D = material.diffuse(scene.textureCache.textures, intersection.texcoord, footprint);
+    const auto S = material.specular(scene.textureCache.textures, intersection.texcoord, footprint);
     const Medium & medium = material.innerMedium;
 
     //
@@ -128,8 +203,6 @@ inline RadianceRGB Renderer::shade(const Scene & scene, RNG & rng,
     //  transmissive  |
     // --------------------------
 
-    RadianceRGB Lo;
-
     // TODO
     //  - Material
     //    - distinctive types (diffuse, specular, refractive, PBR, etc)
@@ -140,56 +213,53 @@ inline RadianceRGB Renderer::shade(const Scene & scene, RNG & rng,
     //    - RGB BRDF?
 
     if(material.isRefractive) {
-        Lo = shadeRefractiveInterface(scene, rng, minDistance, depth, mediumStack, medium, Wo, P, N);
+        return shadeRefractiveInterface(scene, sampler, path, weight, medium, Wo, P, N, pending, Lo);
     }
-    else {
-        RadianceRGB Ld, Ls;
-        ReflectanceRGB F = { 0.0f, 0.0f, 0.0f };
-
-        // Randomly choose between specular and diffuse
-        // TODO: Determine the best probability
-        float probSpec = material.hasSpecular() ? ((S.r + S.g + S.b) / 3.0f) : 0.0f;
-        float probDiffuse = 1.0f - probSpec;
-        bool doSpec = rng.uniform01() < probSpec;
-        bool doDiffuse = !doSpec && material.hasDiffuse();
-
-        // Trace specular bounce
-        if(material.hasSpecular()) {
-            // Fresnel = specular - TODO: Is this right?
-            ReflectanceRGB F0 = S;
-            F = fresnel::schlick(F0, absDot(Wo, N));
-        }
 
-        // Trace specular bounce
-        if(doSpec) {
-            if(material.isGlossy(scene.textureCache.textures, intersection.texcoord)) {
-                float specularExponent = material.specularExponent(scene.textureCache.textures, intersection.texcoord);
-                Ls = shadeSpecularGlossy(scene, rng, minDistance, depth, mediumStack, Wo, P, N, specularExponent);
-            }
-            else {
-                Ls = shadeReflect(scene, rng, minDistance, depth, mediumStack, Wo, P, N);
-            }
-            Ls /= probSpec;
-        }
+    ReflectanceRGB F = { 0.0f, 0.0f, 0.0f };
+
+    // Randomly choose between specular and diffuse
+    // TODO: Determine the best probability
+    float probSpec = material.hasSpecular() ? ((S.r + S.g + S.b) / 3.0f) : 0.0f;
+    float probDiffuse = 1.0f - probSpec;
+    bool doSpec = sampler.get1D() < probSpec;
+    bool doDiffuse = !doSpec && material.hasDiffuse();
 
-        // Trace diffuse bounce
-        if(doDiffuse) {
-            Ld = shadeDiffuse(scene, rng, minDistance, depth, mediumStack, Wo, P, N);
-            Ld /= probDiffuse;
+    if(material.hasSpecular()) {
+        // Fresnel = specular - TODO: Is this right?
+        ReflectanceRGB F0 = S;
+        F = fresnel::schlick(F0, absDot(Wo, N));
+    }
+
+    // Trace specular bounce
+    if(doSpec) {
+        const ParameterRGB specWeight = weight * F / probSpec;
+
+        if(material.isGlossy(scene.textureCache.textures, intersection.texcoord, footprint)) {
+            float specularExponent = material.specularExponent(scene.textureCache.textures, intersection.texcoord, footprint);
+            return shadeSpecularGlossy(scene, sampler, path, specWeight, Wo, P, N, specularExponent, Lo);
         }
+        return shadeReflect(scene, sampler, path, specWeight, Wo, P, N, Lo);
+    }
 
-        Lo = F.residual() * (D * Ld) + F * Ls;
+    // Trace diffuse bounce
+    if(doDiffuse) {
+        const ParameterRGB diffuseWeight = weight * F.residual() * D / probDiffuse;
+        return shadeDiffuse(scene, sampler, path, diffuseWeight, Wo, P, N, Lo);
     }
 
-    return Lo;
+    return false;
 }
 
-bool Renderer::traceCameraRay(const Scene & scene, RNG & rng, const Ray & ray,
+bool Renderer::traceCameraRay(const Scene & scene, Sampler & sampler, const Ray & ray,
                               const float minDistance, const unsigned int depth,
                               const MediumStack & mediumStack,
-                              RayIntersection & intersection, RadianceRGB & Lo) const
+                              RayIntersection & intersection, RadianceRGB & Lo,
+                              PathStatistics * statistics) const
 {
-    bool hit = traceRay(scene, rng, ray, minDistance, depth, mediumStack, true, true, intersection, Lo);
+    perf::count(perf::CameraRays);
+    sampler.startBounce(depth);
+    bool hit = traceRay(scene, sampler, ray, minDistance, depth, mediumStack, DirectLightSampling(), intersection, Lo, statistics);
 
     if(verbose.radiance && hit) {
         printf("traceCameraRay: hit %s, Lo (%.1f, %.1f, %.1f)\n",
@@ -199,54 +269,61 @@ bool Renderer::traceCameraRay(const Scene & scene, RNG & rng, const Ray & ray,
     return hit;
 }
 
-inline RadianceRGB Renderer::shadeReflect(const Scene & scene, RNG & rng,
-                                          const float minDistance, const unsigned int depth,
-                                          const MediumStack & mediumStack,
-                                          const Direction3 & Wo,
-                                          const Position3 & P, const Direction3 & N) const
+inline bool Renderer::shadeReflect(const Scene & scene, Sampler & sampler,
+                                   PathState & path, const ParameterRGB & weight,
+                                   const Direction3 & Wo,
+                                   const Position3 & P, const Direction3 & N,
+                                   RadianceRGB & Lo) const
 {
     MirrorBRDF brdf;
 
-    return shadeBRDF(scene, rng, minDistance, depth, mediumStack, Wo, P, N, brdf,
+    return shadeBRDF(scene, sampler, path, weight, Wo, P, N, brdf,
                      false,
-                     0);
+                     0,
+                     Lo);
 }
 
 
-inline RadianceRGB Renderer::shadeRefract(const Scene & scene, RNG & rng,
-                                          const float minDistance, const unsigned int depth,
-                                          const MediumStack & mediumStack,
-                                          const Direction3 & Dt,
-                                          const Position3 & P, const Direction3 & N) const
+inline void Renderer::shadeRefract(PathState & path, const ParameterRGB & weight,
+                                   bool leaving, const Medium & medium,
+                                   const Direction3 & Dt,
+                                   const Position3 & P, const Direction3 & N) const
 {
-    const Ray ray(P - N * epsilon, Dt);
-    return traceRay(scene, rng, ray, epsilon, depth + 1, mediumStack, true, true);
+    // Update medium stack for refracted ray
+    if(leaving) {
+        path.mediumStack.pop_back();
+    }
+    else {
+        path.mediumStack.push_back(medium);
+    }
+
+    perf::count(perf::BounceRays);
+    path.ray = Ray(P - N * epsilon, Dt);
+    path.minDistance = epsilon;
+    path.depth += 1;
+    path.throughput = weight;
+    path.lightSampling = DirectLightSampling();
 }
 
-inline RadianceRGB Renderer::shadeRefractiveInterface(const Scene & scene, RNG & rng,
-                                                      const float minDistance, const unsigned int depth,
-                                                      const MediumStack & mediumStack,
-                                                      const Medium & medium,
-                                                      const Direction3 & Wo,
-                                                      const Position3 & P, const Direction3 & N) const
+inline bool Renderer::shadeRefractiveInterface(const Scene & scene, Sampler & sampler,
+                                               PathState & path, const ParameterRGB & weight,
+                                               const Medium & medium,
+                                               const Direction3 & Wo,
+                                               const Position3 & P, const Direction3 & N,
+                                               PendingPaths & pending, RadianceRGB & Lo) const
 {
-    RadianceRGB Ls, Lt;
-
     float n1, n2;
 
+    const auto & mediumStack = path.mediumStack;
     bool leaving = mediumStack.size() % 2 == 0;
 
-    // Update medium stack for refracted ray
-    MediumStack nextMediumStack = mediumStack;
     if(leaving) {
         n1 = medium.indexOfRefraction;
-        nextMediumStack.pop_back();
-        n2 = nextMediumStack.back().indexOfRefraction;
+        n2 = mediumStack[mediumStack.size() - 2].indexOfRefraction;
     }
     else {
-        n1 = nextMediumStack.back().indexOfRefraction;
+        n1 = mediumStack.back().indexOfRefraction;
         n2 = medium.indexOfRefraction;
-        nextMediumStack.push_back(medium);
     }
 
     Direction3 d = refract(Wo, N, n1, n2);
@@ -255,166 +332,224 @@ inline RadianceRGB Renderer::shadeRefractiveInterface(const Scene & scene, RNG &
 
     if(totalInternalReflection) {
         // Reflected ray
-        Ls = shadeReflect(scene, rng, minDistance, depth, mediumStack, Wo, P, N);
+        return shadeReflect(scene, sampler, path, weight, Wo, P, N, Lo);
     }
-    else {
-        float F = fresnel::dialectric::unpolarized(dot(Wo, N), dot(d, -N), n1, n2);
 
-        if(monteCarloRefraction) {
-            // Randomly choose a reflected or refracted ray using Fresnel as the
-            // weighting factor
-            if(F == 1.0f || rng.uniform01() < F) {
-                Ls = shadeReflect(scene, rng, minDistance, depth, mediumStack, Wo, P, N);
-            }
-            else {
-                Lt = shadeRefract(scene, rng, minDistance, depth, nextMediumStack, d, P, N);
-            }
-        }
-        else {
-            Ls = shadeReflect(scene, rng, minDistance, depth, mediumStack, Wo, P, N);
-            Lt = shadeRefract(scene, rng, minDistance, depth, nextMediumStack, d, P, N);
-            // Apply Fresnel
-            Ls = F * Ls;
-            Lt = (1.0f - F) * Lt;
-        }
+    float F = fresnel::dialectric::unpolarized(dot(Wo, N), dot(d, -N), n1, n2);
+
+    if(!monteCarloRefraction && !pending.full()) {
+        // Set the refracted ray aside, with a random stream of its own, and
+        // follow the reflected ray. Both are weighted by Fresnel.
+        PathState & refracted = pending.paths[pending.count++];
+        refracted = path;
+        shadeRefract(refracted, weight * (1.0f - F), leaving, medium, d, P, N);
+        refracted.samplerState = sampler.splitState(refracted.depth);
+
+        return shadeReflect(scene, sampler, path, weight * F, Wo, P, N, Lo);
     }
 
-    return Ls + Lt;
+    // Randomly choose a reflected or refracted ray using Fresnel as the
+    // weighting factor. Also used when there is no room left to set a
+    // refracted ray aside.
+    if(F == 1.0f || sampler.get1D() < F) {
+        return shadeReflect(scene, sampler, path, weight, Wo, P, N, Lo);
+    }
+
+    shadeRefract(path, weight, leaving, medium, d, P, N);
+    sampler.startBounce(path.depth);
+    return true;
 }
 
-inline RadianceRGB Renderer::shadeDiffuse(const Scene & scene, RNG & rng,
-                                          const float minDistance, const unsigned int depth,
-                                          const MediumStack & mediumStack,
-                                          const Direction3 & Wo,
-                                          const Position3 & P, const Direction3 & N) const
+inline bool Renderer::shadeDiffuse(const Scene & scene, Sampler & sampler,
+                                   PathState & path, const ParameterRGB & weight,
+                                   const Direction3 & Wo,
+                                   const Position3 & P, const Direction3 & N,
+                                   RadianceRGB & Lo) const
 {
     LambertianBRDF brdf;
     brdf.importanceSample = shadeDiffuseParams.sampleCosineLobe;
 
-    return shadeBRDF(scene, rng, minDistance, depth, mediumStack, Wo, P, N, brdf,
+    return shadeBRDF(scene, sampler, path, weight, Wo, P, N, brdf,
                      shadeDiffuseParams.sampleLights,
-                     shadeDiffuseParams.numEnvMapSamples);
+                     shadeDiffuseParams.numEnvMapSamples,
+                     Lo);
 }
 
-inline RadianceRGB Renderer::shadeSpecularGlossy(const Scene & scene, RNG & rng,
-                                                 const float minDistance, const unsigned int depth,
-                                                 const MediumStack & mediumStack,
-                                                 const Direction3 & Wo,
-                                                 const Position3 & P, const Direction3 & N,
-                                                 float exponent) const
+inline bool Renderer::shadeSpecularGlossy(const Scene & scene, Sampler & sampler,
+                                          PathState & path, const ParameterRGB & weight,
+                                          const Direction3 & Wo,
+                                          const Position3 & P, const Direction3 & N,
+                                          float exponent,
+                                          RadianceRGB & Lo) const
 {
     PhongBRDF brdf(exponent);
     brdf.importanceSample = shadeSpecularParams.samplePhongLobe;
 
-    return shadeBRDF(scene, rng, minDistance, depth, mediumStack, Wo, P, N, brdf,
+    return shadeBRDF(scene, sampler, path, weight, Wo, P, N, brdf,
                      shadeSpecularParams.sampleLights,
-                     shadeSpecularParams.numEnvMapSamples);
+                     shadeSpecularParams.numEnvMapSamples,
+                     Lo);
 }
 
-inline RadianceRGB Renderer::shadeBRDF(const Scene & scene, RNG & rng,
-                                       const float minDistance, const unsigned int depth,
-                                       const MediumStack & mediumStack,
-                                       const Direction3 & Wo,
-                                       const Position3 & P, const Direction3 & N,
-                                       BRDF & brdf,
-                                       bool sampleLights,
-                                       unsigned int numEnvMapSamples) const
+inline bool Renderer::shadeBRDF(const Scene & scene, Sampler & sampler,
+                                PathState & path, const ParameterRGB & weight,
+                                const Direction3 & Wo,
+                                const Position3 & P, const Direction3 & N,
+                                const BRDF & brdf,
+                                bool sampleLights,
+                                unsigned int numEnvMapSamples,
+                                RadianceRGB & Lo) const
 {
-    RadianceRGB Lo;
-
-    // Note: We don't accumulate emission on the next hit if we sample
-    //       lighting directly, to avoid double counting direct illumination.
+    // Note: Light found by the BRDF ray from sources we sample directly here
+    //       is weighted against the direct samples, to avoid double counting.
 
     const bool sampleEnvMap =
         numEnvMapSamples > 0
         && scene.environmentMap->canImportanceSample();
 
     if(sampleLights) {
-        Lo += sampleAllPointLights(scene, rng, brdf, Wo, P, N, epsilon);
-        Lo += sampleAllDiskLights(scene, rng, brdf, Wo, P, N, epsilon);
+        Lo += weight * sampleDirectLighting(scene, sampler, brdf, Wo, P, N);
     }
 
     if(sampleEnvMap) {
-        Lo += sampleEnvironmentMap(scene, rng, brdf, Wo, P, N, minDistance, numEnvMapSamples);
+        Lo += weight * sampleEnvironmentMap(scene, sampler, brdf, Wo, P, N, path.minDistance, numEnvMapSamples);
     }
 
-    brdfSample S = brdf.sample(rng.uniform2DRange01(), Wo, N);
+    // Continuation ray
+    brdfSample S = brdf.sample(sampler.get2D(), Wo, N);
 
-    RadianceRGB Li = traceRay(scene, rng, Ray(P + N * epsilon, S.W), epsilon, depth + 1, mediumStack,
-                              !sampleLights, !sampleEnvMap);
     float F = brdf.eval(Wo, S.W, N);
     float D = S.isDelta() ? 1.0f : clampedDot(S.W, N);
 
-    Lo += Li * F * D / S.pdf;
+    const ParameterRGB throughput = weight * (F * D / S.pdf);
 
     if(verbose.radiance) {
-        printf("shadeBRDF: Lo (%.1f, %.1f, %.1f) = Li (%.1f, %.1f, %.1f) * F (%.1f) * D (%.1f) / pdf (%.1f)\n",
-               Lo.r, Lo.g, Lo.b, Li.r, Li.g, Li.b, F, D, S.pdf);
+        printf("shadeBRDF: throughput (%.1f, %.1f, %.1f) = weight (%.1f, %.1f, %.1f) * F (%.1f) * D (%.1f) / pdf (%.1f)\n",
+               throughput.r, throughput.g, throughput.b, weight.r, weight.g, weight.b, F, D, S.pdf);
     }
 
-    return Lo;
+    if(!(S.pdf > 0.0f) || !throughput.hasNonZeroComponent()) {
+        return false;
+    }
+
+    perf::count(perf::BounceRays);
+    path.ray = Ray(P + N * epsilon, S.W);
+    path.minDistance = epsilon;
+    path.depth += 1;
+    path.throughput = throughput;
+    path.lightSampling.brdfPdf = S.pdf;
+    path.lightSampling.lights = sampleLights && !S.isDelta();
+    path.lightSampling.numEnvMapSamples = sampleEnvMap && !S.isDelta() ? numEnvMapSamples : 0;
 
+    sampler.startBounce(path.depth);
+
+    return true;
 }
 
-inline LightSample Renderer::samplePointLight(const Scene & scene,
-                                              RNG & rng,
-                                              const PointLight & light,
+inline RadianceRGB Renderer::sampleDirectLighting(const Scene & scene,
+                                                  Sampler & sampler,
+                                                  const BRDF & brdf,
+                                                  const Direction3 & Wo,
+                                                  const Position3 & P,
+                                                  const Direction3 & N) const
+{
+    RadianceRGB Lo;
+
+    const unsigned int numSamples = numDirectLightSamples(scene);
+    for(unsigned int sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex) {
+        DirectLightSample S = sampleDirectLight(scene, sampler, brdf, Wo, P, N, sampleIndex);
+        if(!S.Lo.hasNonZeroComponent()) {
+            continue;
+        }
+
+        // If we hit something, we can't see the light
+        perf::count(perf::ShadowRays);
+        if(intersectsScene(scene, sampler, Ray{P, S.direction}, epsilon, S.distance - epsilon)) {
+            continue;
+        }
+
+        Lo += S.Lo;
+    }
+
+    return Lo;
+}
+
+DirectLightSample Renderer::sampleDirectLight(const Scene & scene,
+                                              Sampler & sampler,
+                                              const BRDF & brdf,
+                                              const Direction3 & Wo,
                                               const Position3 & P,
                                               const Direction3 & N,
-                                              float minDistance) const
+                                              unsigned int sampleIndex) const
 {
-    const Direction3 toLight = light.position - P;
-    LightSample S;
-    S.L = RadianceRGB::BLACK();
-    S.direction = toLight.normalized();
+    DirectLightSample D;
+    D.Lo = RadianceRGB::BLACK();
+
+    // Choose a light
+    uint32_t lightIndex = sampleIndex;
+    float selectionProbability = 1.0f;
+    float numSamples = 1.0f;
+    if(!samplesEveryLight(scene)) {
+        vec2 e = sampler.get2D();
+        lightIndex = scene.lightSampler.sample(e.x, e.y);
+        selectionProbability = scene.lightSampler.probability(lightIndex);
+        numSamples = float(numLightSamples);
+    }
 
-    const float lightDistSq = toLight.magnitude_sq();
-    const float lightDist = std::sqrt(lightDistSq);
+    LightSample S;
+    const size_t firstDiskLight = scene.pointLights.size();
+    const size_t firstTriangleLight = firstDiskLight + scene.diskLights.size();
+    if(lightIndex < firstDiskLight) {
+        S = samplePointLight(scene.pointLights[lightIndex], P);
+    }
+    else if(lightIndex < firstTriangleLight) {
+        S = sampleDiskLight(scene, sampler, scene.diskLights[lightIndex - firstDiskLight], P);
+    }
+    else {
+        S = sampleTriangleLight(scene, sampler, scene.triangleLights[lightIndex - firstTriangleLight], P);
+    }
 
     // Make sure the light is on the right side of the surface
-    if(dot(toLight, N) < 0.0f) {
-        return S;
+    const float DdotN = dot(S.direction, N);
+    if(!S.L.hasNonZeroComponent() || !(DdotN > 0.0f) || !(selectionProbability > 0.0f)) {
+        return D;
     }
 
-    // If we hit something, we can't see the light
-    if(intersectsScene(scene, rng, Ray{P, S.direction}, epsilon, lightDist - epsilon)) {
-        return S;
-    }
+    // Area lights are weighted against the BRDF sample finding them. Point
+    // lights can only be found by sampling them.
+    const float lightPdf = selectionProbability * S.pdf;
+    const float w = S.pdf > 0.0f
+        ? powerHeuristic(numSamples, lightPdf, 1.0f, brdf.pdf(Wo, S.direction, N))
+        : 1.0f;
+    const float F = brdf.eval(Wo, S.direction, N);
 
-    S.L = light.intensity / lightDistSq;
+    D.Lo = (w * F * DdotN / (selectionProbability * numSamples)) * S.L;
+    D.direction = S.direction;
+    D.distance = S.distance;
 
-    return S;
+    return D;
 }
 
-
-inline RadianceRGB Renderer::sampleAllPointLights(const Scene & scene,
-                                                  RNG & rng,
-                                                  const BRDF & brdf,
-                                                  const Direction3 & Wo,
-                                                  const Position3 & P,
-                                                  const Direction3 & N,
-                                                  float minDistance) const
+LightSample Renderer::samplePointLight(const PointLight & light,
+                                       const Position3 & P) const
 {
-    RadianceRGB Lo;
+    const Direction3 toLight = light.position - P;
+    const float lightDistSq = toLight.magnitude_sq();
 
-    // Sample point lights
-    for(const auto & light: scene.pointLights) {
-        LightSample S = samplePointLight(scene, rng, light, P, N, epsilon);
-        float F = brdf.eval(Wo, S.direction, N);
-        Lo += F * S.L * clampedDot(S.direction, N);
-    }
+    LightSample S;
+    S.direction = toLight.normalized();
+    S.distance = std::sqrt(lightDistSq);
+    S.L = light.intensity / lightDistSq;
 
-    return Lo;
+    return S;
 }
 
-inline LightSample Renderer::sampleDiskLight(const Scene & scene,
-                                             RNG & rng,
-                                             const DiskLight & light,
-                                             const Position3 & P,
-                                             const Direction3 & N,
-                                             float minDistance) const
+LightSample Renderer::sampleDiskLight(const Scene & scene,
+                                      Sampler & sampler,
+                                      const DiskLight & light,
+                                      const Position3 & P) const
 {
-    vec2 offset = rng.uniformCircle(light.radius);
+    vec2 offset = RNG::uniformCircle(sampler.get2D(), light.radius);
     // rotate to align with direction
     vec3 ax1, ax2;
     coordinate::coordinateSystem(light.direction, ax1, ax2);
@@ -425,58 +560,154 @@ inline LightSample Renderer::sampleDiskLight(const Scene & scene,
     LightSample S;
     S.L = RadianceRGB::BLACK();
     S.direction = toLight.normalized();
+    S.distance = toLight.magnitude();
 
-    // Make sure the light is on the right side of the surface
-    if(dot(toLight, N) < 0.0f) {
-        return S;
+    const Material & material = materialFromID(light.material, scene.materials);
+    // Disks have no texture coordinates
+    auto E = material.emission(scene.textureCache.textures, TextureCoordinate{ 0.0f, 0.0f });
+
+    // Scale by the solid angle of the light as seen by the shaded point
+    S.pdf = diskLightPdf(light, S.direction, S.distance);
+    if(S.pdf > 0.0f) {
+        S.L = E / S.pdf;
     }
 
-    const float lightDistSq = toLight.magnitude_sq();
-    const float lightDist = std::sqrt(lightDistSq);
+    return S;
+}
 
-    // If we hit something, we can't see the light
-    if(intersectsScene(scene, rng, Ray{P, S.direction}, epsilon, lightDist - epsilon)) {
-        return S;
-    }
+LightSample Renderer::sampleTriangleLight(const Scene & scene,
+                                          Sampler & sampler,
+                                          const TriangleLight & light,
+                                          const Position3 & P) const
+{
+    vec3 b = RNG::uniformTriangle(sampler.get2D());
+    BarycentricCoordinate bary(b.x, b.y, b.z);
+    Position3 pointOnLight = interpolate(light.vertices[0], light.vertices[1], light.vertices[2], bary);
+    Direction3 toLight = pointOnLight - P;
 
+    LightSample S;
+    S.L = RadianceRGB::BLACK();
+    S.direction = toLight.normalized();
+    S.distance = toLight.magnitude();
+
+    TextureCoordinate texcoord{ 0.0f, 0.0f };
+    if(light.hasTexCoords) {
+        texcoord = interpolate(light.texcoords[0], light.texcoords[1], light.texcoords[2], bary);
+    }
     const Material & material = materialFromID(light.material, scene.materials);
-    RayIntersection lightIntersection; // FIXME - dummy for texcoords that we don't support yet
-    auto E = material.emission(scene.textureCache.textures, lightIntersection.texcoord);
+    auto E = material.emission(scene.textureCache.textures, texcoord);
 
     // Scale by the solid angle of the light as seen by the shaded point
-    float A = constants::PI * light.radius * light.radius;
-    float cos = std::abs(dot(light.direction, S.direction));
-    float sa = A * cos / lightDistSq;
-    S.L = E * sa;
+    S.pdf = triangleLightPdf(light, S.direction, S.distance);
+    if(S.pdf > 0.0f) {
+        S.L = E / S.pdf;
+    }
 
     return S;
 }
 
-inline RadianceRGB Renderer::sampleAllDiskLights(const Scene & scene,
-                                                 RNG & rng,
-                                                 const BRDF & brdf,
-                                                 const Direction3 & Wo,
-                                                 const Position3 & P,
-                                                 const Direction3 & N,
-                                                 float minDistance) const
+bool Renderer::samplesEveryLight(const Scene & scene) const
 {
-    RadianceRGB Lo;
+    // The light sampler is only available once built for these lights
+    const size_t numLights = scene.numLights();
+    return numLights <= numLightSamples || scene.lightSampler.size() != numLights;
+}
 
-    // Sample disk lights
-    for(const auto & light : scene.diskLights) {
-        LightSample S = sampleDiskLight(scene, rng, light, P, N, epsilon);
-        float F = brdf.eval(Wo, S.direction, N);
-        Lo += F * S.L * clampedDot(S.direction, N);
+unsigned int Renderer::numDirectLightSamples(const Scene & scene) const
+{
+    if(samplesEveryLight(scene)) {
+        return unsigned(scene.numLights());
     }
+    return numLightSamples;
+}
 
-    return Lo;
+float Renderer::lightSelectionProbability(const Scene & scene, uint32_t lightIndex) const
+{
+    return samplesEveryLight(scene) ? 1.0f : scene.lightSampler.probability(lightIndex);
 }
 
-inline bool Renderer::intersectsScene(const Scene & scene,
-                                      RNG & rng,
-                                      const Ray & ray,
-                                      float minDistance,
-                                      float maxDistance) const
+float Renderer::diskLightPdf(const DiskLight & light,
+                              const Direction3 & direction,
+                              float distance)
+{
+    // Area pdf of a uniform point on the disk, converted to solid angle.
+    // The light radiates from both faces.
+    float A = constants::PI * light.radius * light.radius;
+    float cos = std::abs(dot(light.direction, direction));
+    if(!(cos > 0.0f) || A <= 0.0f) {
+        return 0.0f;
+    }
+    return distance * distance / (A * cos);
+}
+
+float Renderer::triangleLightPdf(const TriangleLight & light,
+                                 const Direction3 & direction,
+                                 float distance)
+{
+    // Area pdf of a uniform point on the triangle, converted to solid
+    // angle. The light radiates from both faces.
+    float cos = std::abs(dot(light.normal, direction));
+    if(!(cos > 0.0f) || !(light.area > 0.0f)) {
+        return 0.0f;
+    }
+    return distance * distance / (light.area * cos);
+}
+
+float Renderer::emissionWeight(const Scene & scene,
+                               const DirectLightSampling & lightSampling,
+                               const RayIntersection & intersection) const
+{
+    if(!lightSampling.lights) {
+        return 1.0f;
+    }
+
+    // Solid angle pdf of sampling the light that was hit, before choosing it
+    uint32_t lightIndex;
+    float lightPdf;
+
+    // Disk lights are hit as themselves, from the scene's own array
+    std::less<const Traceable *> less;
+    const bool isDiskLight = !scene.diskLights.empty()
+        && !less(intersection.object, &scene.diskLights.front())
+        && !less(&scene.diskLights.back(), intersection.object);
+    uint32_t triangleLight;
+
+    if(isDiskLight) {
+        const auto & light = *static_cast<const DiskLight *>(intersection.object);
+        lightIndex = uint32_t(scene.pointLights.size() + (&light - &scene.diskLights.front()));
+        lightPdf = diskLightPdf(light, intersection.ray.direction, intersection.distance);
+    }
+    else if(findTriangleLight(scene.triangleLights, intersection.object, intersection.primitive, triangleLight)) {
+        const auto & light = scene.triangleLights[triangleLight];
+        lightIndex = uint32_t(scene.pointLights.size() + scene.diskLights.size() + triangleLight);
+        lightPdf = triangleLightPdf(light, intersection.ray.direction, intersection.distance);
+    }
+    else {
+        return 1.0f;
+    }
+
+    const float numSamples = samplesEveryLight(scene) ? 1.0f : float(numLightSamples);
+    lightPdf *= lightSelectionProbability(scene, lightIndex);
+    return powerHeuristic(1.0f, lightSampling.brdfPdf, numSamples, lightPdf);
+}
+
+float Renderer::environmentMapWeight(const Scene & scene,
+                                     const DirectLightSampling & lightSampling,
+                                     const Direction3 & direction) const
+{
+    if(lightSampling.numEnvMapSamples == 0) {
+        return 1.0f;
+    }
+
+    float envPdf = scene.environmentMap->importanceSamplePdf(direction);
+    return powerHeuristic(1.0f, lightSampling.brdfPdf, float(lightSampling.numEnvMapSamples), envPdf);
+}
+
+bool Renderer::intersectsScene(const Scene & scene,
+                               Sampler & sampler,
+                               const Ray & ray,
+                               float minDistance,
+                               float maxDistance) const
 {
     RayIntersection intersection;
     float A = 1.0f;
@@ -493,16 +724,16 @@ inline bool Renderer::intersectsScene(const Scene & scene,
         // Transparency
         if(hit) {
             const Material & material = materialFromID(intersection.material, scene.materials);
-            A = material.alpha(scene.textureCache.textures, intersection.texcoord);
+            A = material.alpha(scene.textureCache.textures, intersection.texcoord, textureFootprint(intersection));
             minDistance = applyRayDistanceEpsilon(intersection.distance);
         }
-    } while(hit && A < 1.0f && rng.uniform01() > A);
+    } while(hit && A < 1.0f && sampler.get1D() > A);
 
     return hit;
 }
 
 inline RadianceRGB Renderer::sampleEnvironmentMap(
-                const Scene & scene, RNG & rng, const BRDF & brdf,
+                const Scene & scene, Sampler & sampler, const BRDF & brdf,
                 const Direction3 & Wo, const Position3 & P, const Direction3 & N,
                 float minDistance, unsigned int numSamples) const
 {
@@ -511,19 +742,22 @@ inline RadianceRGB Renderer::sampleEnvironmentMap(
     // Importance sample environment map. Note, we do not draw another
     // sample if the sample is not visible, as doing so biases the estimate.
     for(unsigned int envSample = 0; envSample < numSamples; ++envSample) {
-        vec2 e = rng.uniform2DRange01();
+        vec2 e = sampler.get2D();
         RandomDirection dirSample = scene.environmentMap->importanceSampleDirection(e.x, e.y);
         float DdotN = dot(dirSample.direction, N);
         
         if(dirSample.pdf > 0.0f && DdotN > 0.0f) {
             Ray ray{ P + N * epsilon, dirSample.direction };
 
-            bool hit = intersectsScene(scene, rng, ray, minDistance);
+            perf::count(perf::EnvMapRays);
+            bool hit = intersectsScene(scene, sampler, ray, minDistance);
 
             if(!hit) {
                 float F = brdf.eval(Wo, dirSample.direction, N);
                 RadianceRGB Li = scene.environmentMap->sampleRay(ray); 
-                Lenv += F * DdotN * Li / dirSample.pdf;
+                float w = powerHeuristic(float(numSamples), dirSample.pdf,
+                                         1.0f, brdf.pdf(Wo, dirSample.direction, N));
+                Lenv += w * F * DdotN * Li / dirSample.pdf;
             }
         }
     }
@@ -538,7 +772,9 @@ void Renderer::printConfiguration() const
     printf("Renderer Configuration:\n");
     printf("  Epsilon = %.8f\n", epsilon);
     printf("  Max depth = %u\n", maxDepth);
+    printf("  Pixel spread angle = %.6f\n", pixelSpreadAngle);
     printf("  Monte Carlo refraction = %s\n", onoff(monteCarloRefraction));
+    printf("  Light samples = %u\n", numLightSamples);
     printf("  Russian Roulette:\n"
            "    Chance = %.2f\n"
            "    Minimum depth = %u\n",
@@ -566,7 +802,9 @@ void Renderer::logConfiguration(Logger & logger) const
     logger.normalf("Renderer Configuration:");
     logger.normalf("  Epsilon = %.8f", epsilon);
     logger.normalf("  Max depth = %u", maxDepth);
+    logger.normalf("  Pixel spread angle = %.6f", pixelSpreadAngle);
     logger.normalf("  Monte Carlo refraction = %s", onoff(monteCarloRefraction));
+    logger.normalf("  Light samples = %u", numLightSamples);
     logger.normalf("  Russian Roulette:");
     logger.normalf("    Chance = %.2f", russianRouletteChance);
     logger.normalf("    Minimum depth = %u", russianRouletteMinDepth);
@@ -5,129 +5,242 @@
 #include "radiometry.h"
 #include "material.h"
 #include "brdf.h"
+#include "Ray.h"
+#include "Sampler.h"
 
 struct Direction3;
 struct Position3;
-struct Ray;
 struct RayIntersection;
-struct RNG;
 struct Scene;
 struct PointLight;
 struct DiskLight;
+struct TriangleLight;
 class Logger;
+struct PathStatistics;
 
 // TODO: Put this somewhere sensible
 struct LightSample
 {
+    // Radiance arriving from the light if it is visible, divided by pdf
     RadianceRGB L;
     Direction3 direction;
+    // Solid angle pdf of the direction. 0 for point lights.
+    float pdf = 0.0f;
+    // Distance to the point sampled on the light
+    float distance = 0.0f;
 };
 
+// Light reflected toward the viewer by one light sample, if nothing blocks
+// the shadow ray to the light
+struct DirectLightSample
+{
+    RadianceRGB Lo;
+    Direction3 direction;
+    float distance = 0.0f;
+};
+
+// Light sampled directly at the origin of a ray drawn from a BRDF. Light
+// the ray finds from the same sources is weighted against those samples
+// with the power heuristic (multiple importance sampling), so each source
+// is counted once, by whichever strategy sampled it best. Everything else
+// the ray finds counts in full.
+struct DirectLightSampling
+{
+    // Solid angle pdf of the BRDF sample the ray was drawn from
+    float brdfPdf = 0.0f;
+    // Scene lights were sampled
+    bool lights = false;
+    // Number of environment map samples, 0 if it was not sampled
+    unsigned int numEnvMapSamples = 0;
+};
+
+// Power heuristic (beta = 2) weight of a sample drawn from strategy f,
+// combined with strategy g, given their sample counts and pdfs
+inline float powerHeuristic(float nf, float fPdf, float ng, float gPdf)
+{
+    const float f = nf * fPdf, g = ng * gPdf;
+    if(f == 0.0f) {
+        return 0.0f;
+    }
+    return (f * f) / (f * f + g * g);
+}
+
 class Renderer
 {
     public:
-        bool traceRay(const Scene & scene, RNG & rng,
+        bool traceRay(const Scene & scene, Sampler & sampler,
                       const Ray & ray,
                       const float minDistance, const unsigned int depth,
                       const MediumStack & mediumStack,
-                      bool accumEmission,
-                      bool accumEnvMap,
+                      const DirectLightSampling & lightSampling,
                       RayIntersection & intersection,
-                      RadianceRGB & Lo) const;
+                      RadianceRGB & Lo,
+                      PathStatistics * statistics = nullptr) const;
 
-        RadianceRGB traceRay(const Scene & scene, RNG & rng,
+        RadianceRGB traceRay(const Scene & scene, Sampler & sampler,
                              const Ray & ray,
                              const float minDistance, const unsigned int depth,
                              const MediumStack & mediumStack,
-                             bool accumEmission,
-                             bool accumEnvMap) const;
+                             const DirectLightSampling & lightSampling) const;
 
-        bool traceCameraRay(const Scene & scene, RNG & rng, const Ray & ray, const float minDistance, const unsigned int depth,
+        bool traceCameraRay(const Scene & scene, Sampler & sampler, const Ray & ray, const float minDistance, const unsigned int depth,
                             const MediumStack & mediumStack,
-                            RayIntersection & intersection, RadianceRGB & Lo) const;
+                            RayIntersection & intersection, RadianceRGB & Lo,
+                            PathStatistics * statistics = nullptr) const;
 
         void printConfiguration() const;
         void logConfiguration(Logger & logger) const;
 
-    protected:
-
-        inline RadianceRGB shade(const Scene & scene, RNG & rng, const float minDistance, const unsigned int depth,
-                                 const MediumStack & mediumStack,
-                                 const Direction3 & Wo, RayIntersection & intersection, const Material & material) const;
+        // Width of the ray cone at a hit in texture coordinates. The cone
+        // starts at the ray origin and spreads by pixelSpreadAngle.
+        float textureFootprint(const RayIntersection & intersection) const;
 
-        inline RadianceRGB shadeReflect(const Scene & scene, RNG & rng,
-                                        const float minDistance, const unsigned int depth,
-                                        const MediumStack & mediumStack,
-                                        const Direction3 & Wo,
-                                        const Position3 & P, const Direction3 & N) const;
-
-        inline RadianceRGB shadeRefract(const Scene & scene, RNG & rng,
-                                        const float minDistance, const unsigned int depth,
-                                        const MediumStack & mediumStack,
-                                        const Direction3 & Dt,
-                                        const Position3 & P, const Direction3 & N) const;
-
-        inline RadianceRGB shadeRefractiveInterface(const Scene & scene, RNG & rng,
-                                                    const float minDistance, const unsigned int depth,
-                                                    const MediumStack & mediumStack,
-                                                    const Medium & medium,
-                                                    const Direction3 & Wo,
-                                                    const Position3 & P, const Direction3 & N) const;
-
-        inline RadianceRGB shadeDiffuse(const Scene & scene, RNG & rng,
-                                        const float minDistance, const unsigned int depth,
-                                        const MediumStack & mediumStack,
+    protected:
+        // State of one path between bounces
+        struct PathState {
+            Ray ray;
+            float minDistance = 0.0f;
+            unsigned int depth = 0;
+            MediumStack mediumStack;
+
+            // Weight applied to all radiance found along the rest of the path
+            ParameterRGB throughput = { 1.0f, 1.0f, 1.0f };
+
+            // Light sampled where the ray was drawn
+            DirectLightSampling lightSampling;
+
+            // Depth Russian roulette was last played at. A ray continued
+            // through a cutout keeps its depth, and is not played again.
+            unsigned int rouletteDepth = ~0u;
+
+            // Where the path is in its sample dimensions, when it is not
+            // being followed on the sampler
+            Sampler::State samplerState;
+        };
+
+        // Paths set aside to follow once the current one ends, when a
+        // refraction boundary traces both its reflected and transmitted rays.
+        // Paths are followed depth first, so a few suffice.
+        struct PendingPaths {
+            static const unsigned int CAPACITY = 16;
+
+            PathState paths[CAPACITY];
+            unsigned int count = 0;
+
+            bool full() const { return count == CAPACITY; }
+        };
+
+        // Follow a path until it ends, adding the light it finds to Lo. The
+        // first hit is stored in intersection. Returns true if there was one.
+        inline bool tracePath(const Scene & scene, Sampler & sampler,
+                              PathState & path, PendingPaths & pending,
+                              RayIntersection & intersection,
+                              RadianceRGB & Lo,
+                              PathStatistics * statistics) const;
+
+        // Probability of a path with the given throughput surviving Russian
+        // roulette
+        float russianRouletteSurvival(const ParameterRGB & throughput) const;
+        // Play Russian roulette with a path at or beyond the minimum depth,
+        // once per depth. Survivors make up for the paths ended by scaling
+        // their throughput.
+        bool survivesRussianRoulette(Sampler & sampler, PathState & path,
+                                     PathStatistics * statistics) const;
+
+        // The shade* functions add the light reflected toward the viewer at
+        // a hit to Lo, scaled by weight, and update the path to continue from
+        // the hit. They return false if the path ends there.
+
+        inline bool shade(const Scene & scene, Sampler & sampler,
+                          PathState & path, const ParameterRGB & weight,
+                          const Direction3 & Wo, const RayIntersection & intersection,
+                          const Material & material,
+                          PendingPaths & pending, RadianceRGB & Lo) const;
+
+        inline bool shadeReflect(const Scene & scene, Sampler & sampler,
+                                 PathState & path, const ParameterRGB & weight,
+                                 const Direction3 & Wo,
+                                 const Position3 & P, const Direction3 & N,
+                                 RadianceRGB & Lo) const;
+
+        // Continue a path through a refraction boundary, into or out of a
+        // medium. The sampler is left to the caller.
+        inline void shadeRefract(PathState & path, const ParameterRGB & weight,
+                                 bool leaving, const Medium & medium,
+                                 const Direction3 & Dt,
+                                 const Position3 & P, const Direction3 & N) const;
+
+        inline bool shadeRefractiveInterface(const Scene & scene, Sampler & sampler,
+                                             PathState & path, const ParameterRGB & weight,
+                                             const Medium & medium,
+                                             const Direction3 & Wo,
+                                             const Position3 & P, const Direction3 & N,
+                                             PendingPaths & pending, RadianceRGB & Lo) const;
+
+        inline bool shadeDiffuse(const Scene & scene, Sampler & sampler,
+                                 PathState & path, const ParameterRGB & weight,
+                                 const Direction3 & Wo,
+                                 const Position3 & P, const Direction3 & N,
+                                 RadianceRGB & Lo) const;
+
+        inline bool shadeSpecularGlossy(const Scene & scene, Sampler & sampler,
+                                        PathState & path, const ParameterRGB & weight,
                                         const Direction3 & Wo,
-                                        const Position3 & P, const Direction3 & N) const;
-
-        inline RadianceRGB shadeSpecularGlossy(const Scene & scene, RNG & rng,
-                                               const float minDistance, const unsigned int depth,
-                                               const MediumStack & mediumStack,
-                                               const Direction3 & Wo,
-                                               const Position3 & P, const Direction3 & N,
-                                               float exponent) const;
-
-        inline RadianceRGB shadeBRDF(const Scene & scene, RNG & rng,
-                                     const float minDistance, const unsigned int depth,
-                                     const MediumStack & mediumStack,
-                                     const Direction3 & Wo,
-                                     const Position3 & P, const Direction3 & N,
-                                     BRDF & brdf,
-                                     bool sampleLights,
-                                     unsigned int numEnvMapSamples) const;
-
-        inline LightSample samplePointLight(const Scene & scene,
-                                            RNG & rng,
-                                            const PointLight & light,
-                                            const Position3 & P,
-                                            const Direction3 & N,
-                                            float minDistance) const;
-
-        inline RadianceRGB sampleAllPointLights(const Scene & scene,
-                                                RNG & rng,
+                                        const Position3 & P, const Direction3 & N,
+                                        float exponent,
+                                        RadianceRGB & Lo) const;
+
+        inline bool shadeBRDF(const Scene & scene, Sampler & sampler,
+                              PathState & path, const ParameterRGB & weight,
+                              const Direction3 & Wo,
+                              const Position3 & P, const Direction3 & N,
+                              const BRDF & brdf,
+                              bool sampleLights,
+                              unsigned int numEnvMapSamples,
+                              RadianceRGB & Lo) const;
+
+        // Sum of the light samples at a shaded point that reach it
+        inline RadianceRGB sampleDirectLighting(const Scene & scene,
+                                                Sampler & sampler,
                                                 const BRDF & brdf,
                                                 const Direction3 & Wo,
                                                 const Position3 & P,
-                                                const Direction3 & N,
-                                                float minDistance) const;
-
-        inline LightSample sampleDiskLight(const Scene & scene,
-                                           RNG & rng,
-                                           const DiskLight & light,
-                                           const Position3 & P,
-                                           const Direction3 & N,
-                                           float minDistance) const;
-
-        inline RadianceRGB sampleAllDiskLights(const Scene & scene,
-                                               RNG & rng,
-                                               const BRDF & brdf,
-                                               const Direction3 & Wo,
-                                               const Position3 & P,
-                                               const Direction3 & N,
-                                               float minDistance) const;
+                                                const Direction3 & N) const;
+
+        // Light sample of the given index at a shaded point, weighted
+        // against the BRDF sample finding the same light. Visibility is
+        // left to the caller.
+        DirectLightSample sampleDirectLight(const Scene & scene,
+                                            Sampler & sampler,
+                                            const BRDF & brdf,
+                                            const Direction3 & Wo,
+                                            const Position3 & P,
+                                            const Direction3 & N,
+                                            unsigned int sampleIndex) const;
+
+        LightSample samplePointLight(const PointLight & light,
+                                     const Position3 & P) const;
+
+        LightSample sampleDiskLight(const Scene & scene,
+                                    Sampler & sampler,
+                                    const DiskLight & light,
+                                    const Position3 & P) const;
+
+        LightSample sampleTriangleLight(const Scene & scene,
+                                        Sampler & sampler,
+                                        const TriangleLight & light,
+                                        const Position3 & P) const;
+
+        // Every light is sampled once if there are few enough, otherwise
+        // numLightSamples lights are chosen by power
+        bool samplesEveryLight(const Scene & scene) const;
+        // Number of light samples drawn at each shaded point
+        unsigned int numDirectLightSamples(const Scene & scene) const;
+        // Probability of a light sample choosing a light
+        float lightSelectionProbability(const Scene & scene, uint32_t lightIndex) const;
 
         inline RadianceRGB sampleEnvironmentMap(const Scene & scene,
-                                                RNG & rng,
+                                                Sampler & sampler,
                                                 const BRDF & brdf,
                                                 const Direction3 & Wo,
                                                 const Position3 & P,
@@ -135,11 +248,30 @@ class Renderer
                                                 float minDistance,
                                                 unsigned int numSamples) const;
 
-        inline bool intersectsScene(const Scene & scene,
-                                    RNG & rng,
-                                    const Ray & ray,
-                                    float minDistance,
-                                    float maxDistance = std::numeric_limits<float>::max()) const;
+        // Multiple importance sampling weights of emission and environment
+        // light found by a ray
+        float emissionWeight(const Scene & scene,
+                             const DirectLightSampling & lightSampling,
+                             const RayIntersection & intersection) const;
+        float environmentMapWeight(const Scene & scene,
+                                   const DirectLightSampling & lightSampling,
+                                   const Direction3 & direction) const;
+
+        // Solid angle pdf of sampleDiskLight() choosing a point on the light
+        // at a distance along a direction
+        static float diskLightPdf(const DiskLight & light,
+                                  const Direction3 & direction,
+                                  float distance);
+        // Same for sampleTriangleLight()
+        static float triangleLightPdf(const TriangleLight & light,
+                                      const Direction3 & direction,
+                                      float distance);
+
+        bool intersectsScene(const Scene & scene,
+                             Sampler & sampler,
+                             const Ray & ray,
+                             float minDistance,
+                             float maxDistance = std::numeric_limits<float>::max()) const;
 
     float applyRayDistanceEpsilon(float minDistance) const;
 
@@ -148,21 +280,35 @@ class Renderer
         static constexpr float        DEFAULT_EPSILON_ADDITIVE       = 1.0e-4f;
         static constexpr float        DEFAULT_EPSILON_MULTIPLICATIVE = 1.001f;
         static constexpr unsigned int DEFAULT_MAX_DEPTH = 10;
+        static constexpr unsigned int DEFAULT_NUM_LIGHT_SAMPLES = 4;
+        static constexpr float        DEFAULT_RUSSIAN_ROULETTE_CHANCE = 0.95f;
 
         float epsilon     = DEFAULT_EPSILON_ADDITIVE;
         float epsilon_far = DEFAULT_EPSILON_MULTIPLICATIVE;
 
         unsigned int maxDepth = DEFAULT_MAX_DEPTH;
 
+        // Angle between the rays through neighboring pixels, for choosing
+        // texture MIP levels. 0 always uses the finest level.
+        float pixelSpreadAngle = 0.0f;
+
         // Use Monte Carlo to choose between reflected and transmitted
         // ray at a refraction boundary. If false, both rays are traced.
         bool monteCarloRefraction = true;
 
-        // Russian roulette chance [0, 1]. 0 = no RR termination
-        float russianRouletteChance = 0.1f;
+        // Russian roulette chance [0, 1]. 0 = no RR termination. Paths
+        // survive with a probability of the largest component of their
+        // throughput, so those still carrying a lot of light keep going and
+        // dim ones end early. This is the chance of ending the dimmest paths.
+        float russianRouletteChance = DEFAULT_RUSSIAN_ROULETTE_CHANCE;
         // Only apply RR if at or beyond this depth
         unsigned int russianRouletteMinDepth = 3;
 
+        // Number of lights sampled at each shaded point. Scenes with at
+        // most this many lights sample each of them once. Larger scenes
+        // choose this many lights in proportion to their power.
+        unsigned int numLightSamples = DEFAULT_NUM_LIGHT_SAMPLES;
+
         // Diffuse shading parameters
         struct DiffuseShadingParameters {
             unsigned int numEnvMapSamples = 10;
@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "Sampler.h"
+
+const uint32_t Sampler::CAMERA_DIMENSIONS;
+const uint32_t Sampler::BOUNCE_DIMENSIONS;
+const uint32_t BlueNoiseSampler::MASK_SIZE;
+
+// Largest float below 1
+static const float ONE_MINUS_EPSILON = 0.99999994f;
+
+static inline float toUnitFloat(uint32_t v)
+{
+    return std::min(float(v) * (1.0f / 4294967296.0f), ONE_MINUS_EPSILON);
+}
+
+// Wrap a value in [0,2) to [0,1)
+static inline float wrapUnit(float v)
+{
+    v = v >= 1.0f ? v - 1.0f : v;
+    return std::min(v, ONE_MINUS_EPSILON);
+}
+
+static inline uint32_t hash(uint64_t a, uint64_t b, uint64_t c = 0)
+{
+    return uint32_t(mix64(a ^ mix64(b ^ mix64(c))) >> 32);
+}
+
+static inline uint32_t pixelKey(const PixelSample & pixelSample)
+{
+    return hash(pixelSample.x, pixelSample.y);
+}
+
+//
+// Sampler
+//
+
+void Sampler::startPixelSample(const PixelSample & pixelSample)
+{
+    current.pixelSample = pixelSample;
+    current.dimension = 0;
+    current.dimensionEnd = CAMERA_DIMENSIONS;
+    current.rng = RNG::forPixelSample(pixelSample.x, pixelSample.y, pixelSample.index, seed);
+}
+
+void Sampler::startBounce(unsigned int depth)
+{
+    current.dimension = CAMERA_DIMENSIONS + depth * BOUNCE_DIMENSIONS;
+    current.dimensionEnd = current.dimension + BOUNCE_DIMENSIONS;
+}
+
+Sampler::State Sampler::splitState(unsigned int depth)
+{
+    State state = current;
+    state.dimension = CAMERA_DIMENSIONS + depth * BOUNCE_DIMENSIONS;
+    state.dimensionEnd = state.dimension + BOUNCE_DIMENSIONS;
+    const uint64_t newSeed = (uint64_t(current.rng.next32()) << 32) | current.rng.next32();
+    state.rng = RNG(newSeed, mix64(newSeed));
+    return state;
+}
+
+//
+// Random
+//
+
+float RandomSampler::sample1D(const PixelSample &, uint32_t)
+{
+    return current.rng.uniform01();
+}
+
+vec2 RandomSampler::sample2D(const PixelSample &, uint32_t)
+{
+    return current.rng.uniform2DRange01();
+}
+
+//
+// Owen scrambled Sobol
+//
+
+static inline uint32_t reverseBits(uint32_t v)
+{
+    v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+    v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+    v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+    v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+    return (v >> 16) | (v << 16);
+}
+
+// First two dimensions of the Sobol sequence
+static inline uint32_t sobolDimension0(uint32_t index)
+{
+    return reverseBits(index);
+}
+
+static inline uint32_t sobolDimension1(uint32_t index)
+{
+    uint32_t result = 0;
+    for(uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1) {
+        if(index & 1) {
+            result ^= v;
+        }
+    }
+    return result;
+}
+
+// Laine and Karras' hash, which only lets bits affect more significant bits
+static inline uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed)
+{
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+// Owen scrambling: each bit is flipped depending only on the bits above it
+static inline uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+{
+    return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+}
+
+static inline vec2 owenScrambledSobol2D(uint32_t index, uint32_t seed)
+{
+    // Shuffle the order of the points, then scramble each dimension
+    index = nestedUniformScramble(index, seed);
+    uint32_t x = nestedUniformScramble(sobolDimension0(index), hash(seed, 1));
+    uint32_t y = nestedUniformScramble(sobolDimension1(index), hash(seed, 2));
+    return { toUnitFloat(x), toUnitFloat(y) };
+}
+
+static inline float owenScrambledSobol1D(uint32_t index, uint32_t seed)
+{
+    index = nestedUniformScramble(index, seed);
+    return toUnitFloat(nestedUniformScramble(sobolDimension0(index), hash(seed, 1)));
+}
+
+float SobolSampler::sample1D(const PixelSample & pixelSample, uint32_t dimension)
+{
+    return owenScrambledSobol1D(pixelSample.index, hash(pixelKey(pixelSample), dimension, seed));
+}
+
+vec2 SobolSampler::sample2D(const PixelSample & pixelSample, uint32_t dimension)
+{
+    return owenScrambledSobol2D(pixelSample.index, hash(pixelKey(pixelSample), dimension, seed));
+}
+
+//
+// Halton
+//
+
+static inline float radicalInverse(uint32_t base, uint32_t index)
+{
+    const double invBase = 1.0 / base;
+    double invBaseN = 1.0;
+    double value = 0.0;
+    while(index > 0) {
+        uint32_t next = index / base;
+        uint32_t digit = index - next * base;
+        value = value * base + digit;
+        invBaseN *= invBase;
+        index = next;
+    }
+    return std::min(float(value * invBaseN), ONE_MINUS_EPSILON);
+}
+
+float HaltonSampler::sample1D(const PixelSample & pixelSample, uint32_t dimension)
+{
+    const uint32_t pairSeed = hash(pixelKey(pixelSample), dimension / 2, seed);
+    const uint32_t index = nestedUniformScramble(pixelSample.index, pairSeed);
+    const uint32_t base = (dimension % 2 == 0) ? 2 : 3;
+    const float shift = toUnitFloat(hash(pixelKey(pixelSample), dimension, seed ^ 0x68616c74u));
+    return wrapUnit(radicalInverse(base, index) + shift);
+}
+
+vec2 HaltonSampler::sample2D(const PixelSample & pixelSample, uint32_t dimension)
+{
+    return { sample1D(pixelSample, dimension), sample1D(pixelSample, dimension + 1) };
+}
+
+//
+// Blue noise dithered Sobol
+//
+
+// Grows a point set one point at a time, always into the largest void (the
+// pixel with least energy under a toroidal Gaussian of the points so far).
+// The insertion order of each pixel is its mask value.
+static std::vector<float> buildBlueNoiseMask(uint32_t size, float sigma)
+{
+    const uint32_t numPixels = size * size;
+
+    std::vector<float> kernel(numPixels);
+    for(uint32_t y = 0; y < size; ++y) {
+        for(uint32_t x = 0; x < size; ++x) {
+            float dx = float(std::min(x, size - x));
+            float dy = float(std::min(y, size - y));
+            kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+        }
+    }
+
+    // Tiny random energies break ties, which would otherwise grow a lattice
+    RNG rng(12345);
+    std::vector<float> energy(numPixels);
+    for(auto & e : energy) {
+        e = 1.0e-4f * rng.uniform01();
+    }
+
+    std::vector<float> mask(numPixels, -1.0f);
+    for(uint32_t rank = 0; rank < numPixels; ++rank) {
+        uint32_t best = 0;
+        float bestEnergy = std::numeric_limits<float>::max();
+        for(uint32_t p = 0; p < numPixels; ++p) {
+            if(mask[p] < 0.0f && energy[p] < bestEnergy) {
+                bestEnergy = energy[p];
+                best = p;
+            }
+        }
+
+        mask[best] = (float(rank) + 0.5f) / float(numPixels);
+
+        const uint32_t bx = best % size;
+        const uint32_t by = best / size;
+        for(uint32_t y = 0; y < size; ++y) {
+            const uint32_t ky = (y + size - by) % size;
+            for(uint32_t x = 0; x < size; ++x) {
+                const uint32_t kx = (x + size - bx) % size;
+                energy[y * size + x] += kernel[ky * size + kx];
+            }
+        }
+    }
+
+    return mask;
+}
+
+const float * BlueNoiseSampler::mask()
+{
+    static const std::vector<float> mask = buildBlueNoiseMask(MASK_SIZE, 1.5f);
+    return mask.data();
+}
+
+// Mask value for a pixel, offset differently for each dimension so the
+// dimensions are not correlated
+static inline float blueNoiseShift(const PixelSample & pixelSample, uint32_t dimension, uint64_t seed)
+{
+    const uint32_t size = BlueNoiseSampler::MASK_SIZE;
+    const uint32_t offset = hash(dimension, seed, 0x626c7565u);
+    const uint32_t x = (pixelSample.x + offset) % size;
+    const uint32_t y = (pixelSample.y + (offset >> 16)) % size;
+    return BlueNoiseSampler::mask()[y * size + x];
+}
+
+float BlueNoiseSampler::sample1D(const PixelSample & pixelSample, uint32_t dimension)
+{
+    const float v = owenScrambledSobol1D(pixelSample.index, hash(dimension, seed));
+    return wrapUnit(v + blueNoiseShift(pixelSample, dimension, seed));
+}
+
+vec2 BlueNoiseSampler::sample2D(const PixelSample & pixelSample, uint32_t dimension)
+{
+    const vec2 v = owenScrambledSobol2D(pixelSample.index, hash(dimension, seed));
+    return { wrapUnit(v.x + blueNoiseShift(pixelSample, dimension, seed)),
+             wrapUnit(v.y + blueNoiseShift(pixelSample, dimension + 1, seed)) };
+}
+
+std::unique_ptr<Sampler> makeSampler(const std::string & name, uint64_t seed)
+{
+    if(name == "random")         { return std::make_unique<RandomSampler>(seed); }
+    else if(name == "halton")    { return std::make_unique<HaltonSampler>(seed); }
+    else if(name == "sobol")     { return std::make_unique<SobolSampler>(seed); }
+    else if(name == "bluenoise") { return std::make_unique<BlueNoiseSampler>(seed); }
+    return nullptr;
+}
@@ -0,0 +1,168 @@
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "vec2.h"
+#include "rng.h"
+
+// Identifies one sample of one pixel
+struct PixelSample
+{
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t index = 0;
+};
+
+// Source of the values in [0,1) that drive a path. Values are a function of
+// the pixel sample and a dimension, so a sampler can spread the samples of
+// a pixel evenly in every dimension instead of drawing them independently.
+//
+// Dimensions are consumed in order: the camera dimensions first, then a
+// fixed block for each bounce, so the same decision at the same depth uses
+// the same dimension in every sample of a pixel. Values needed past the end
+// of a block come from an independent random stream.
+class Sampler
+{
+    public:
+        static const uint32_t CAMERA_DIMENSIONS = 4;  // pixel position, lens position
+        static const uint32_t BOUNCE_DIMENSIONS = 16;
+
+        Sampler(uint64_t seed = 0) : seed(seed) {}
+        virtual ~Sampler() = default;
+
+        virtual std::unique_ptr<Sampler> clone() const = 0;
+        virtual const char * name() const = 0;
+
+        // Begin a pixel sample, at the first camera dimension
+        void startPixelSample(const PixelSample & pixelSample);
+        // Begin the block of dimensions for a bounce at the given path depth
+        void startBounce(unsigned int depth);
+
+        inline float get1D();
+        inline vec2 get2D();
+
+        // Everything that changes per path, so breadth-first renderers can
+        // interleave many paths on one sampler
+        struct State {
+            PixelSample pixelSample;
+            uint32_t dimension = 0;
+            uint32_t dimensionEnd = 0;
+            RNG rng;
+        };
+        const State & state() const { return current; }
+        void setState(const State & state) { current = state; }
+        // State for a new path starting the bounce at the given depth, with
+        // a random stream of its own
+        State splitState(unsigned int depth);
+
+        uint64_t seed = 0;
+
+    protected:
+        // Value of a pixel sample in one dimension, or two consecutive ones
+        virtual float sample1D(const PixelSample & pixelSample, uint32_t dimension) = 0;
+        virtual vec2 sample2D(const PixelSample & pixelSample, uint32_t dimension) = 0;
+
+        State current;
+};
+
+// Independent uniform random values
+class RandomSampler : public Sampler
+{
+    public:
+        using Sampler::Sampler;
+
+        std::unique_ptr<Sampler> clone() const override { return std::make_unique<RandomSampler>(*this); }
+        const char * name() const override { return "random"; }
+
+    protected:
+        float sample1D(const PixelSample & pixelSample, uint32_t dimension) override;
+        vec2 sample2D(const PixelSample & pixelSample, uint32_t dimension) override;
+};
+
+// First two Halton dimensions (bases 2 and 3), with a random toroidal shift
+// per pixel and dimension (Cranley-Patterson rotation). Like SobolSampler,
+// each pair of dimensions shuffles the sample order independently, since
+// the large prime bases of higher Halton dimensions are poorly distributed
+// at the sample counts we render with.
+class HaltonSampler : public Sampler
+{
+    public:
+        using Sampler::Sampler;
+
+        std::unique_ptr<Sampler> clone() const override { return std::make_unique<HaltonSampler>(*this); }
+        const char * name() const override { return "halton"; }
+
+    protected:
+        float sample1D(const PixelSample & pixelSample, uint32_t dimension) override;
+        vec2 sample2D(const PixelSample & pixelSample, uint32_t dimension) override;
+};
+
+// First two Sobol dimensions with hash based Owen scrambling (Burley,
+// "Practical Hash-based Owen Scrambling", 2020). Each pair of dimensions is
+// an independently scrambled and shuffled copy ("padding"), so any number
+// of dimensions is supported.
+class SobolSampler : public Sampler
+{
+    public:
+        using Sampler::Sampler;
+
+        std::unique_ptr<Sampler> clone() const override { return std::make_unique<SobolSampler>(*this); }
+        const char * name() const override { return "sobol"; }
+
+    protected:
+        float sample1D(const PixelSample & pixelSample, uint32_t dimension) override;
+        vec2 sample2D(const PixelSample & pixelSample, uint32_t dimension) override;
+};
+
+// Owen scrambled Sobol shared by all pixels, shifted per pixel by a blue
+// noise mask (Georgiev and Fajardo, "Blue-noise Dithered Sampling", 2016).
+// Error is distributed as blue noise across the image, which looks much
+// smoother than white noise at low sample counts.
+class BlueNoiseSampler : public Sampler
+{
+    public:
+        using Sampler::Sampler;
+
+        std::unique_ptr<Sampler> clone() const override { return std::make_unique<BlueNoiseSampler>(*this); }
+        const char * name() const override { return "bluenoise"; }
+
+        static const uint32_t MASK_SIZE = 64;
+
+        // MASK_SIZE x MASK_SIZE values in [0,1), built by void-and-cluster on
+        // first use
+        static const float * mask();
+
+    protected:
+        float sample1D(const PixelSample & pixelSample, uint32_t dimension) override;
+        vec2 sample2D(const PixelSample & pixelSample, uint32_t dimension) override;
+};
+
+// Make a sampler by name (random, halton, sobol, bluenoise). Returns null
+// if the name is not recognized.
+std::unique_ptr<Sampler> makeSampler(const std::string & name, uint64_t seed = 0);
+
+// Inline implementations
+
+inline float Sampler::get1D()
+{
+    if(current.dimension < current.dimensionEnd) {
+        return sample1D(current.pixelSample, current.dimension++);
+    }
+    return current.rng.uniform01();
+}
+
+inline vec2 Sampler::get2D()
+{
+    if(current.dimension + 1 < current.dimensionEnd) {
+        vec2 e = sample2D(current.pixelSample, current.dimension);
+        current.dimension += 2;
+        return e;
+    }
+    current.dimension = current.dimensionEnd;
+    return current.rng.uniform2DRange01();
+}
+
+#endif
@@ -32,7 +32,7 @@ inline bool Sphere::intersects(const Ray & ray, float minDistance, float maxDist
         || (minmax.second >= minDistance && minmax.second <= maxDistance);
 }
 
-inline bool Sphere::findIntersection(const Ray & ray, float minDistance, RayIntersection & intersection) const
+inline bool Sphere::findHit(const Ray & ray, float minDistance, RayHit & hit) const
 {
     float dist1, dist2;
     if(!intersectHelper(ray, dist1, dist2))
@@ -49,7 +49,13 @@ inline bool Sphere::findIntersection(const Ray & ray, float minDistance, RayInte
     if(dist1 < minDistance) { dist1 = dist2; }
 #endif
     
-    intersection.distance = dist1;
+    hit.distance = dist1;
+    return true;
+}
+
+inline void Sphere::fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const
+{
+    intersection.distance = hit.distance;
     // compute intersection position
     intersection.position = add(ray.origin, scale(ray.direction, intersection.distance));
     // compute surface normal
@@ -57,7 +63,6 @@ inline bool Sphere::findIntersection(const Ray & ray, float minDistance, RayInte
     // generate tangent / bitangent
     coordinate::coordinateSystem(intersection.normal, intersection.tangent, intersection.bitangent);
     intersection.material = material;
-    return true;
 }
 
 inline Slab Sphere::boundingBox()
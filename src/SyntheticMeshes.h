@@ -0,0 +1,147 @@
+#ifndef __SYNTHETIC_MESHES_H__
+#define __SYNTHETIC_MESHES_H__
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "TriangleMesh.h"
+#include "constants.h"
+
+// Procedural meshes for tests and benchmarks. They need no files, and the
+// same arguments always give the same mesh, so benchmark numbers can be
+// compared across commits.
+
+// Fill in the per-triangle data the mesh still lacks
+inline void finishSyntheticMesh(TriangleMesh & mesh)
+{
+    auto & data = *mesh.meshData;
+    data.indices.texcoord.assign(data.indices.vertex.size(), TriangleMeshData::NoTexCoord);
+    if(data.faces.material.size() < data.indices.vertex.size() / 3) {
+        data.faces.material.resize(data.indices.vertex.size() / 3, NoMaterial);
+    }
+    data.bounds = boundingBox(data.vertices);
+}
+
+// Vector with each component drawn from a distribution, in x, y, z order
+template<typename Distribution>
+inline vec3 randomVec3(std::mt19937 & engine, Distribution & distribution)
+{
+    const float x = distribution(engine);
+    const float y = distribution(engine);
+    const float z = distribution(engine);
+    return vec3(x, y, z);
+}
+
+// Latitude/longitude sphere with smooth normals, of about numTriangles
+// triangles
+inline std::shared_ptr<TriangleMesh> makeTessellatedSphere(size_t numTriangles,
+                                                           const Position3 & center,
+                                                           float radius)
+{
+    // 2 * segments * (rings - 1) triangles, with twice as many segments as rings
+    const uint32_t rings = std::max(uint32_t(2), uint32_t(std::lround(std::sqrt(numTriangles / 4.0))) + 1);
+    const uint32_t segments = 2 * rings;
+
+    auto mesh = std::make_shared<TriangleMesh>();
+    auto & data = *mesh->meshData;
+    const float PI = float(constants::PI);
+
+    // Poles, then the rings between them
+    data.normals.push_back(Direction3(0.0f, 1.0f, 0.0f));
+    data.normals.push_back(Direction3(0.0f, -1.0f, 0.0f));
+    for(uint32_t r = 1; r < rings; ++r) {
+        const float theta = PI * float(r) / float(rings);
+        for(uint32_t s = 0; s < segments; ++s) {
+            const float phi = 2.0f * PI * float(s) / float(segments);
+            data.normals.push_back(Direction3(std::sin(theta) * std::cos(phi),
+                                              std::cos(theta),
+                                              std::sin(theta) * std::sin(phi)));
+        }
+    }
+    for(const auto & N : data.normals) {
+        data.vertices.push_back(center + N * radius);
+    }
+
+    auto ringVertex = [&](uint32_t r, uint32_t s) { return 2 + (r - 1) * segments + s % segments; };
+    auto addTriangle = [&](uint32_t a, uint32_t b, uint32_t c) {
+        data.indices.vertex.insert(data.indices.vertex.end(), { a, b, c });
+    };
+
+    for(uint32_t s = 0; s < segments; ++s) {
+        addTriangle(0, ringVertex(1, s + 1), ringVertex(1, s));
+        addTriangle(1, ringVertex(rings - 1, s), ringVertex(rings - 1, s + 1));
+        for(uint32_t r = 1; r + 1 < rings; ++r) {
+            addTriangle(ringVertex(r, s), ringVertex(r, s + 1), ringVertex(r + 1, s));
+            addTriangle(ringVertex(r, s + 1), ringVertex(r + 1, s + 1), ringVertex(r + 1, s));
+        }
+    }
+    data.indices.normal = data.indices.vertex;
+
+    finishSyntheticMesh(*mesh);
+    return mesh;
+}
+
+// Triangles scattered uniformly over the cube [-1,1]^3, each with its
+// vertices within triangleSize of its center along each axis
+inline std::shared_ptr<TriangleMesh> makeRandomSoup(size_t numTriangles, float triangleSize, unsigned int seed = 1)
+{
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> offset(-triangleSize, triangleSize);
+
+    auto mesh = std::make_shared<TriangleMesh>();
+    auto & data = *mesh->meshData;
+    data.vertices.reserve(3 * numTriangles);
+    for(size_t tri = 0; tri < numTriangles; ++tri) {
+        const Position3 center(randomVec3(engine, position));
+        for(int i = 0; i < 3; ++i) {
+            data.vertices.push_back(center + Direction3(randomVec3(engine, offset)));
+        }
+    }
+    data.indices.vertex.resize(data.vertices.size());
+    std::iota(data.indices.vertex.begin(), data.indices.vertex.end(), 0u);
+
+    finishSyntheticMesh(*mesh);
+    return mesh;
+}
+
+// Size of random soup triangles that get smaller the more there are, so the
+// cube stays about equally full
+inline float randomSoupTriangleSize(size_t numTriangles)
+{
+    return 2.0f / std::cbrt(float(std::max(numTriangles, size_t(1))));
+}
+
+// Slivers from one random point of the cube [-1,1]^3 to another, a
+// thousandth as wide as they are long. Their bounding boxes are large and
+// overlap, which is hard on every accelerator.
+inline std::shared_ptr<TriangleMesh> makeLongThinTriangles(size_t numTriangles, unsigned int seed = 1)
+{
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> along(0.0f, 1.0f);
+    const float width = 0.002f;
+    std::uniform_real_distribution<float> offset(-width, width);
+
+    auto mesh = std::make_shared<TriangleMesh>();
+    auto & data = *mesh->meshData;
+    data.vertices.reserve(3 * numTriangles);
+    for(size_t tri = 0; tri < numTriangles; ++tri) {
+        const Position3 a(randomVec3(engine, position));
+        const Position3 b(randomVec3(engine, position));
+        const float t = along(engine);
+        const Position3 c = a + (b - a) * t + Direction3(randomVec3(engine, offset));
+        data.vertices.insert(data.vertices.end(), { a, b, c });
+    }
+    data.indices.vertex.resize(data.vertices.size());
+    std::iota(data.indices.vertex.begin(), data.indices.vertex.end(), 0u);
+
+    finishSyntheticMesh(*mesh);
+    return mesh;
+}
+
+#endif
@@ -0,0 +1,193 @@
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <exception>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "ThreadPool.h"
+
+// Pool that owns the calling thread, if any
+static thread_local const ThreadPool * currentThreadPool = nullptr;
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+{
+    numThreads = std::max(numThreads, 1u);
+    workers.reserve(numThreads);
+    for(ThreadIndex index = 0; index < numThreads; ++index) {
+        workers.emplace_back([this, index]() { workerLoop(index); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for(auto & worker : workers) {
+        worker.join();
+    }
+}
+
+unsigned int ThreadPool::defaultNumThreads()
+{
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+bool ThreadPool::isWorkerThread() const
+{
+    return currentThreadPool == this;
+}
+
+void ThreadPool::workerLoop(ThreadIndex index)
+{
+    currentThreadPool = this;
+
+    while(true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            // Drain queued work before exiting
+            if(tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+std::future<void> ThreadPool::submit(const Task & task)
+{
+    auto packaged = std::make_shared<std::packaged_task<void()>>(task);
+    auto future = packaged->get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.emplace_back([packaged]() { (*packaged)(); });
+    }
+    taskAvailable.notify_one();
+    return future;
+}
+
+void ThreadPool::parallelFor(size_t count, const IndexFunction & fn, unsigned int maxThreads)
+{
+    if(count == 0) {
+        return;
+    }
+
+    unsigned int numRunners = numThreads();
+    if(maxThreads > 0) {
+        numRunners = std::min(numRunners, maxThreads);
+    }
+    numRunners = unsigned(std::min<size_t>(numRunners, count));
+
+    // Shared between the caller and the runners. Runners that are dequeued
+    // after the loop has finished find no work left and only touch this.
+    struct State {
+        size_t count;
+        const IndexFunction * fn;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr exception;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto state = std::make_shared<State>();
+    state->count = count;
+    state->fn = &fn;
+
+    auto run = [state](ThreadIndex tid) {
+        for(size_t index = state->next++; index < state->count; index = state->next++) {
+            if(!state->failed) {
+                try {
+                    (*state->fn)(index, tid);
+                }
+                catch(...) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if(!state->exception) {
+                        state->exception = std::current_exception();
+                    }
+                    state->failed = true;
+                }
+            }
+            if(++state->done == state->count) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    // A worker calling in runs as the first runner rather than blocking,
+    // so nested loops make progress even when every worker is busy.
+    const bool callerRuns = isWorkerThread();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(ThreadIndex tid = callerRuns ? 1 : 0; tid < numRunners; ++tid) {
+            tasks.emplace_back([run, tid]() { run(tid); });
+        }
+    }
+    taskAvailable.notify_all();
+
+    if(callerRuns) {
+        run(0);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&]() { return state->done == state->count; });
+    }
+
+    if(state->exception) {
+        std::rethrow_exception(state->exception);
+    }
+}
+
+bool ThreadPool::pinThreadsToCores()
+{
+#if defined(__linux__)
+    const unsigned int numCores = defaultNumThreads();
+    bool success = true;
+    for(unsigned int index = 0; index < workers.size(); ++index) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(index % numCores, &cpuset);
+        if(pthread_setaffinity_np(workers[index].native_handle(), sizeof(cpu_set_t), &cpuset) != 0) {
+            success = false;
+        }
+    }
+    return success;
+#else
+    return false;
+#endif
+}
+
+static std::unique_ptr<ThreadPool> globalThreadPool;
+static std::mutex globalThreadPoolMutex;
+
+ThreadPool & getThreadPool()
+{
+    std::lock_guard<std::mutex> lock(globalThreadPoolMutex);
+    if(!globalThreadPool) {
+        globalThreadPool = std::make_unique<ThreadPool>(ThreadPool::defaultNumThreads());
+    }
+    return *globalThreadPool;
+}
+
+// Must not be called while work is running on the current pool
+void setThreadPoolSize(unsigned int numThreads, bool pinToCores)
+{
+    std::lock_guard<std::mutex> lock(globalThreadPoolMutex);
+    globalThreadPool.reset();
+    globalThreadPool = std::make_unique<ThreadPool>(numThreads);
+    if(pinToCores) {
+        globalThreadPool->pinThreadsToCores();
+    }
+}
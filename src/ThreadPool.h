@@ -0,0 +1,71 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+
+using ThreadIndex = uint32_t;
+
+// Long lived set of worker threads shared by rendering, accelerator builds
+// and image output, so threads are not created and destroyed per pass.
+class ThreadPool
+{
+    public:
+        ThreadPool(unsigned int numThreads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool & operator=(const ThreadPool &) = delete;
+
+        using Task = std::function<void()>;
+        using IndexFunction = std::function<void(size_t /*index*/, ThreadIndex)>;
+
+        unsigned int numThreads() const { return unsigned(workers.size()); }
+
+        // Queue a task to run on a worker. The future becomes ready when the
+        // task completes, and rethrows any exception the task threw. Waiting
+        // on the future from inside a worker can deadlock a small pool, so
+        // nested work should use parallelFor() instead.
+        std::future<void> submit(const Task & task);
+
+        // Call fn for every index in [0, count) and wait for all of them.
+        // Indices are handed out one at a time from a shared counter, so
+        // uneven work balances across threads. At most maxThreads threads
+        // take part (0 means all of them), and the ThreadIndex passed to fn
+        // is unique to one of them and less than that number. Called from a
+        // worker, the calling thread takes part as well. The first exception
+        // thrown by fn is rethrown here after the loop has stopped.
+        void parallelFor(size_t count, const IndexFunction & fn, unsigned int maxThreads = 0);
+
+        // Pin each worker thread to its own core. Returns false if affinity
+        // is not supported on this platform or could not be set.
+        bool pinThreadsToCores();
+
+        // True if the calling thread is one of this pool's workers
+        bool isWorkerThread() const;
+
+        static unsigned int defaultNumThreads();
+
+    protected:
+        void workerLoop(ThreadIndex index);
+
+        std::vector<std::thread> workers;
+        std::deque<Task> tasks;
+        std::mutex mutex;
+        std::condition_variable taskAvailable;
+        bool stopping = false;
+};
+
+// Process-wide pool. Sized to the hardware concurrency until
+// setThreadPoolSize() is called.
+ThreadPool & getThreadPool();
+void setThreadPoolSize(unsigned int numThreads, bool pinToCores = false);
+
+#endif
@@ -0,0 +1,95 @@
+#include "TraceableBVH.h"
+#include "DiskLight.h"
+#include "Logger.h"
+#include "timer.h"
+
+void TraceableBVH::addObject(Traceable & object, std::vector<BVH::Bounds> & bounds)
+{
+    Slab slab = object.boundingBoxTransformed();
+    BVH::Bounds b;
+    b.extend(vec3(slab.xmin, slab.ymin, slab.zmin));
+    b.extend(vec3(slab.xmax, slab.ymax, slab.zmax));
+    bounds.push_back(b);
+    objects.push_back(&object);
+}
+
+void TraceableBVH::build(std::vector<TraceablePtr> & objects)
+{
+    std::vector<DiskLight> noDiskLights;
+    build(objects, noDiskLights);
+}
+
+void TraceableBVH::build(std::vector<TraceablePtr> & sceneObjects,
+                         std::vector<DiskLight> & diskLights)
+{
+    auto buildTimer = WallClockTimer::makeRunningTimer();
+
+    objects.clear();
+    objects.reserve(sceneObjects.size() + diskLights.size());
+
+    std::vector<BVH::Bounds> bounds;
+    bounds.reserve(sceneObjects.size() + diskLights.size());
+
+    for(auto & object : sceneObjects) {
+        addObject(*object, bounds);
+    }
+    for(auto & light : diskLights) {
+        addObject(light, bounds);
+    }
+
+    // Each primitive test transforms the ray, so favor small leaves
+    bvh.maxPrimitivesPerLeaf = 2;
+    bvh.build(bounds);
+    built = true;
+
+    auto & logger = getLogger();
+    logger.normalf("Top level BVH over %u objects built in %f sec",
+                   (unsigned int) objects.size(), buildTimer.elapsed());
+    log(logger);
+}
+
+void TraceableBVH::log(Logger & logger) const
+{
+    bvh.log(logger);
+}
+
+bool TraceableBVH::intersects(const Ray & ray, float minDistance, float maxDistance) const
+{
+    return bvh.findAny(ray, minDistance, maxDistance,
+        [&](uint32_t first, uint32_t count) {
+            for(uint32_t oi = 0; oi < count; ++oi) {
+                const auto & object = *objects[bvh.primitives[first + oi]];
+                if(object.intersectsWorldRay(ray, minDistance, maxDistance)) {
+                    return true;
+                }
+            }
+            return false;
+        });
+}
+
+bool TraceableBVH::findHit(const Ray & ray, float minDistance, RayHit & hit) const
+{
+    float bestDistance = std::numeric_limits<float>::max();
+    RayHit nextHit;
+
+    return bvh.findClosest(ray, minDistance, bestDistance,
+        [&](uint32_t first, uint32_t count, float & maxDistance) {
+            bool leafHit = false;
+            for(uint32_t oi = 0; oi < count; ++oi) {
+                const auto & object = *objects[bvh.primitives[first + oi]];
+                if(object.findHitWorldRay(ray, minDistance, nextHit)
+                   && nextHit.distance < maxDistance) {
+                    hit = nextHit;
+                    hit.object = &object;
+                    maxDistance = nextHit.distance;
+                    leafHit = true;
+                }
+            }
+            return leafHit;
+        });
+}
+
+void TraceableBVH::fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const
+{
+    hit.object->fillIntersectionWorldRay(ray, hit, intersection);
+}
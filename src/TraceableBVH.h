@@ -0,0 +1,51 @@
+#ifndef __TRACEABLE_BVH_H__
+#define __TRACEABLE_BVH_H__
+
+#include <vector>
+#include "traceable.h"
+#include "slab.h"
+#include "BVH.h"
+
+struct DiskLight;
+class Logger;
+
+// Top level bounding volume hierarchy over the transformed bounds of the
+// objects in a scene. Rays are given in world space; each object is only
+// transformed into its own space and tested when the ray overlaps its
+// world bounds.
+//
+// The hierarchy refers to the objects by pointer, so the containers
+// passed to build() must not be modified until the next build().
+class TraceableBVH : public Traceable
+{
+    public:
+        TraceableBVH() = default;
+        ~TraceableBVH() = default;
+
+        void build(std::vector<TraceablePtr> & objects);
+        void build(std::vector<TraceablePtr> & objects,
+                   std::vector<DiskLight> & diskLights);
+
+        bool isBuilt() const { return built; }
+
+        void log(Logger & logger) const;
+
+        // Ray intersection implementation
+        virtual bool intersects(const Ray & ray, float minDistance, float maxDistance) const override;
+        // The hit records the object hit, and the distance in world space
+        virtual bool findHit(const Ray & ray, float minDistance, RayHit & hit) const override;
+        virtual void fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const override;
+
+        // Bounding volume
+        Slab boundingBox() override { return bvh.bounds(); }
+
+        BVH bvh;
+
+    protected:
+        void addObject(Traceable & object, std::vector<BVH::Bounds> & bounds);
+
+        std::vector<const Traceable *> objects;
+        bool built = false;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#include "TraceableInstance.h"
+
+TraceableInstance::TraceableInstance(const TraceablePtr & object)
+    : object(object)
+{
+}
+
+bool TraceableInstance::intersects(const Ray & ray, float minDistance, float maxDistance) const
+{
+    return object->intersects(ray, minDistance, maxDistance);
+}
+
+bool TraceableInstance::findHit(const Ray & ray, float minDistance, RayHit & hit) const
+{
+    return object->findHit(ray, minDistance, hit);
+}
+
+void TraceableInstance::fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const
+{
+    object->fillIntersection(ray, hit, intersection);
+
+    if(material != NoMaterial) {
+        intersection.material = material;
+    }
+}
+
+Slab TraceableInstance::boundingBox()
+{
+    return object->boundingBox();
+}
@@ -0,0 +1,32 @@
+#ifndef __TRACEABLE_INSTANCE_H__
+#define __TRACEABLE_INSTANCE_H__
+
+#include "traceable.h"
+#include "slab.h"
+#include "material.h"
+
+// Placement of a shared object in the scene. The instance's transform
+// positions the object in the world; the shared object's own transform
+// is ignored, so one bottom level structure (eg: a mesh accelerator)
+// can be referenced by many instances. A material override set on the
+// instance replaces the one of the shared object.
+struct TraceableInstance : public Traceable
+{
+    TraceableInstance(const TraceablePtr & object);
+    ~TraceableInstance() = default;
+
+    // Ray intersection implementation
+    virtual bool intersects(const Ray & ray, float minDistance, float maxDistance) const override;
+    virtual bool findHit(const Ray & ray, float minDistance, RayHit & hit) const override;
+    virtual void fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const override;
+
+    // Bounding volume
+    Slab boundingBox() override;
+
+    TraceablePtr object;
+
+    // Material override
+    MaterialID material = NoMaterial;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "TraceableKDTree.h"
 #include "rng.h"
 #include "Logger.h"
+#include "PerfCounters.h"
 
 struct TraceableKDTree::BuildContext {
     RNG rng;
@@ -217,20 +218,28 @@ bool TraceableKDTree::intersects(const Ray & ray, float minDistance, float maxDi
     return intersectsNode(root, ray, minDistance, maxDistance);
 }
 
-bool TraceableKDTree::findIntersection(const Ray & ray, float minDistance, RayIntersection & intersection) const
+bool TraceableKDTree::findHit(const Ray & ray, float minDistance, RayHit & hit) const
 {
-    return findIntersectionNode(root, ray, minDistance, intersection);
+    return findHitNode(root, ray, minDistance, hit);
+}
+
+void TraceableKDTree::fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const
+{
+    hit.object->fillIntersectionWorldRay(ray, hit, intersection);
 }
 
 bool TraceableKDTree::intersectsNode(const KDNode & node, const Ray & ray, float minDistance, float maxDistance) const
 {
+    perf::count(perf::NodesVisited);
+
     // Leaf node
-    if(!node.objects.empty()) {
+    if(node.splitDirection == KDNode::LEAF) {
         for(auto object : node.objects) {
             if(object->intersectsWorldRay(ray, minDistance, maxDistance)) {
                 return true;
             }
         }
+        return false;
     }
 
     // Internal node
@@ -271,18 +280,21 @@ bool TraceableKDTree::intersectsNode(const KDNode & node, const Ray & ray, float
     return false;
 }
 
-bool TraceableKDTree::findIntersectionNode(const KDNode & node, const Ray & ray, float minDistance, RayIntersection & intersection) const
+bool TraceableKDTree::findHitNode(const KDNode & node, const Ray & ray, float minDistance, RayHit & hit) const
 {
+    perf::count(perf::NodesVisited);
+
     // Leaf node
     //   Find best intersection among leaf node objects
-    if(!node.objects.empty()) {
-        RayIntersection tempIntersection;
+    if(node.splitDirection == KDNode::LEAF) {
+        RayHit tempHit;
         bool anyHit = false;
 
         for(auto object : node.objects) {
-            bool hit = object->findIntersectionWorldRay(ray, minDistance, tempIntersection);
-            if(hit && (!anyHit || tempIntersection.distance < intersection.distance)) {
-                intersection = tempIntersection;
+            bool objectHit = object->findHitWorldRay(ray, minDistance, tempHit);
+            if(objectHit && (!anyHit || tempHit.distance < hit.distance)) {
+                hit = tempHit;
+                hit.object = object.get();
                 anyHit = true;
             }
         }
@@ -302,24 +314,24 @@ bool TraceableKDTree::findIntersectionNode(const KDNode & node, const Ray & ray,
     bool leftFirst = directionComponent >= 0.0f;
 
     // Descend down the tree
-    bool hit = false;
+    bool childHit = false;
     if(leftFirst) {
         // Skip near side if origin on far side already
         if(originComponent + minDistance < node.splitOffset) {
-            hit = findIntersectionNode(*node.left, ray, minDistance, intersection);
-            if(hit) { return true; }
+            childHit = findHitNode(*node.left, ray, minDistance, hit);
+            if(childHit) { return true; }
         }
-        hit = findIntersectionNode(*node.right, ray, minDistance, intersection);
-        if(hit) { return true; }
+        childHit = findHitNode(*node.right, ray, minDistance, hit);
+        if(childHit) { return true; }
     }
     else { // right first
         // Skip near side if origin on far side already
         if(originComponent - minDistance > node.splitOffset) {
-            hit = findIntersectionNode(*node.right, ray, minDistance, intersection);
-            if(hit) { return true; }
+            childHit = findHitNode(*node.right, ray, minDistance, hit);
+            if(childHit) { return true; }
         }
-        hit = findIntersectionNode(*node.left, ray, minDistance, intersection);
-        if(hit) { return true; }
+        childHit = findHitNode(*node.left, ray, minDistance, hit);
+        if(childHit) { return true; }
     }
 
     return false;
@@ -345,3 +357,18 @@ void TraceableKDTree::getRayComponent(const Ray & ray, KDNode::SplitDirection sp
     }
 }
 
+
+size_t TraceableKDTree::sizeInBytes() const
+{
+    return nodeSizeInBytes(root);
+}
+
+size_t TraceableKDTree::nodeSizeInBytes(const KDNode & node) const
+{
+    size_t bytes = sizeof(KDNode) + node.objects.capacity() * sizeof(TraceablePtr);
+    if(node.left)
+        bytes += nodeSizeInBytes(*node.left);
+    if(node.right)
+        bytes += nodeSizeInBytes(*node.right);
+    return bytes;
+}
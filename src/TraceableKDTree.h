@@ -18,9 +18,14 @@ class TraceableKDTree : public Traceable
         void print() const;
         void log(Logger & logger) const;
 
+        // Memory of the nodes and their object lists, not counting the objects
+        size_t sizeInBytes() const;
+
         // Ray intersection implementation
         virtual bool intersects(const Ray & ray, float minDistance, float maxDistance) const override;
-        virtual bool findIntersection(const Ray & ray, float minDistance, RayIntersection & intersection) const override;
+        // The hit records the object hit, and the distance in world space
+        virtual bool findHit(const Ray & ray, float minDistance, RayHit & hit) const override;
+        virtual void fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const override;
 
         // Bounding volume
         Slab boundingBox() override { return bounds; }
@@ -56,9 +61,10 @@ class TraceableKDTree : public Traceable
 
         void printNode(const KDNode & node, unsigned int depth = 0) const;
         void logNode(Logger & logger, const KDNode & node, unsigned int depth = 0) const;
+        size_t nodeSizeInBytes(const KDNode & node) const;
 
         bool intersectsNode(const KDNode & node, const Ray & ray, float minDistance, float maxDistance) const;
-        bool findIntersectionNode(const KDNode & node, const Ray & ray, float minDistance, RayIntersection & intersection) const;
+        bool findHitNode(const KDNode & node, const Ray & ray, float minDistance, RayHit & hit) const;
 
         void getRayComponent(const Ray & ray, KDNode::SplitDirection splitDirection,
                              float & originComponent, float & directionComponent) const;
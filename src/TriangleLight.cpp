@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <functional>
+
+#include "TriangleLight.h"
+#include "TriangleMesh.h"
+#include "TriangleMeshBVH.h"
+#include "TriangleMeshOctree.h"
+#include "TraceableInstance.h"
+
+// Mesh traced by an object, if any. The object's own transform places it.
+static const TriangleMesh * meshOfObject(const Traceable * object)
+{
+    if(auto instance = dynamic_cast<const TraceableInstance *>(object)) {
+        object = instance->object.get();
+    }
+    if(auto mesh = dynamic_cast<const TriangleMesh *>(object)) {
+        return mesh;
+    }
+    if(auto bvh = dynamic_cast<const TriangleMeshBVH *>(object)) {
+        return bvh->mesh.get();
+    }
+    if(auto octree = dynamic_cast<const TriangleMeshOctree *>(object)) {
+        return octree->mesh.get();
+    }
+    return nullptr;
+}
+
+// Material override covering the whole mesh of an object. An instance's
+// override replaces the one of the mesh it shares.
+static MaterialID materialOverride(const Traceable * object, const TriangleMesh & mesh)
+{
+    auto instance = dynamic_cast<const TraceableInstance *>(object);
+    if(instance && instance->material != NoMaterial) {
+        return instance->material;
+    }
+    return mesh.material;
+}
+
+void gatherTriangleLights(const std::vector<TraceablePtr> & objects,
+                          const MaterialArray & materials,
+                          std::vector<TriangleLight> & lights)
+{
+    lights.clear();
+
+    for(const auto & object : objects) {
+        const TriangleMesh * mesh = meshOfObject(object.get());
+        if(!mesh) {
+            continue;
+        }
+
+        // A non-emissive material override covers the whole mesh
+        const MaterialID meshMaterial = materialOverride(object.get(), *mesh);
+        if(meshMaterial != NoMaterial && !materialFromID(meshMaterial, materials).hasEmission()) {
+            continue;
+        }
+
+        const auto & meshData = *mesh->meshData;
+        const auto & fwd = object->transform.fwd;
+        const uint32_t numTriangles = uint32_t(mesh->numTriangles());
+
+        for(uint32_t tri = 0; tri < numTriangles; ++tri) {
+            MaterialID material = meshMaterial;
+            if(material == NoMaterial && tri < meshData.faces.material.size()) {
+                material = meshData.faces.material[tri];
+            }
+            if(!materialFromID(material, materials).hasEmission()) {
+                continue;
+            }
+
+            TriangleLight light;
+            for(uint32_t i = 0; i < 3; ++i) {
+                light.vertices[i] = fwd * mesh->triangleVertex(tri, i);
+            }
+
+            light.hasTexCoords = true;
+            for(uint32_t i = 0; i < 3; ++i) {
+                if(meshData.indices.texcoord[3 * tri + i] == TriangleMeshData::NoTexCoord) {
+                    light.hasTexCoords = false;
+                }
+            }
+            if(light.hasTexCoords) {
+                for(uint32_t i = 0; i < 3; ++i) {
+                    light.texcoords[i] = mesh->triangleTextureCoordinate(tri, i);
+                }
+            }
+
+            Direction3 N = cross(light.vertices[1] - light.vertices[0],
+                                 light.vertices[2] - light.vertices[0]);
+            light.area = 0.5f * N.magnitude();
+            if(!(light.area > 0.0f)) {
+                continue;
+            }
+            light.normal = N.normalized();
+
+            light.material = material;
+            light.object = object.get();
+            light.triangle = tri;
+            lights.push_back(light);
+        }
+    }
+
+    std::less<const Traceable *> less;
+    std::sort(lights.begin(), lights.end(),
+              [&](const TriangleLight & a, const TriangleLight & b) {
+                  return less(a.object, b.object)
+                      || (a.object == b.object && a.triangle < b.triangle);
+              });
+}
+
+bool findTriangleLight(const std::vector<TriangleLight> & lights,
+                       const Traceable * object, uint32_t triangle,
+                       uint32_t & index)
+{
+    std::less<const Traceable *> less;
+    auto it = std::lower_bound(lights.begin(), lights.end(), std::make_pair(object, triangle),
+                               [&](const TriangleLight & light, const std::pair<const Traceable *, uint32_t> & key) {
+                                   return less(light.object, key.first)
+                                       || (light.object == key.first && light.triangle < key.second);
+                               });
+    if(it == lights.end() || it->object != object || it->triangle != triangle) {
+        return false;
+    }
+    index = uint32_t(it - lights.begin());
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef __TRIANGLE_LIGHT_H__
+#define __TRIANGLE_LIGHT_H__
+
+#include <vector>
+
+#include "vectortypes.h"
+#include "material.h"
+#include "traceable.h"
+
+// Triangle Light
+//   Triangle of an emissive mesh, in world space, sampled as an area light.
+//   Radiates from both faces
+struct TriangleLight
+{
+    Position3 vertices[3];
+    TextureCoordinate texcoords[3];
+    bool hasTexCoords = false;
+
+    Direction3 normal;
+    float area = 0.0f;
+
+    MaterialID material = NoMaterial;
+
+    // Top level scene object and triangle within its mesh, for recognizing
+    // rays that hit the light
+    const Traceable * object = nullptr;
+    uint32_t triangle = 0;
+};
+
+// Collect the emissive triangles of the meshes among the objects, placed
+// directly or instanced through their accelerators. The lights are sorted
+// for findTriangleLight().
+void gatherTriangleLights(const std::vector<TraceablePtr> & objects,
+                          const MaterialArray & materials,
+                          std::vector<TriangleLight> & lights);
+
+// Find the light for a triangle of a top level object
+bool findTriangleLight(const std::vector<TriangleLight> & lights,
+                       const Traceable * object, uint32_t triangle,
+                       uint32_t & index);
+
+#endif
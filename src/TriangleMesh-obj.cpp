@@ -1,7 +1,11 @@
+#include <fstream>
+#include <sstream>
+
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
 #include "TriangleMesh.h"
+#include "TriangleMeshCache.h"
 #include "slab.h"
 #include "Logger.h"
 
@@ -87,7 +91,7 @@ static void loadMaterialsFromOBJ(MaterialArray & materials,
         if(!objmaterial.diffuse_texname.empty()) {
             material.diffuseParam = textureCache.loadTextureFromFile(path, objmaterial.diffuse_texname);
             // If the texture is RGBA, get alpha from the txture
-            if(textureCache.textures[material.diffuseParam.textureId]->numChannels == 4) {
+            if(textureCache.texture(material.diffuseParam.textureId)->numChannels == 4) {
                 material.alphaParam = material.diffuseParam.textureId;
             }
         }
@@ -99,12 +103,7 @@ static void loadMaterialsFromOBJ(MaterialArray & materials,
         }
         if(!objmaterial.bump_texname.empty()) {
             // Despite the name, bump map seems to hold a normal map in OBJ files
-            material.normalMapTexture = textureCache.loadTextureFromFile(path, objmaterial.bump_texname);
-            auto & texture = textureCache.textures[material.normalMapTexture];
-            // Convert normal map color to normal [0, 1] -> [-1, 1]
-            texture->forEachPixelChannel([](Texture & image, size_t x, size_t y, int c) {
-                                             image.set(x, y, c, image.get(x, y, c) * 2.0f - 1.0f);
-                                         });
+            material.normalMapTexture = textureCache.loadNormalMapFromFile(path, objmaterial.bump_texname);
         }
 
         material.opacity = objmaterial.dissolve;
@@ -121,18 +120,17 @@ static void loadMaterialsFromOBJ(MaterialArray & materials,
     }
 }
 
-bool loadTriangleMeshFromOBJ(TriangleMesh & mesh,
-                             MaterialArray & materials,
-                             TriangleMeshDataCache & meshDataCache,
-                             TextureCache & textureCache,
-                             const std::string & path, const std::string & filename)
+// Parse an OBJ file into meshData, leaving the face materials as indices
+// into objmaterials
+static bool parseOBJ(TriangleMeshData & meshData,
+                     std::vector<tinyobj::material_t> & objmaterials,
+                     const std::string & path, const std::string & filename)
 {
     auto & logger = getLogger();
 
     std::string warn, err;
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> objmaterials;
 
     logger.normal("Reading OBJ with tinyobjloader");
     bool ret = tinyobj::LoadObj(&attrib, &shapes, &objmaterials, &warn, &err,
@@ -157,15 +155,6 @@ bool loadTriangleMeshFromOBJ(TriangleMesh & mesh,
                    (int) objmaterials.size(),
                    (int) shapes.size());
 
-    // Keep a mapping from original material indices to the ones we insert into
-    // the materials array
-    std::vector<MaterialID> objMatToMatArrIndex;
-
-    loadMaterialsFromOBJ(materials, objMatToMatArrIndex, textureCache, objmaterials, path);
-
-    mesh.meshData = std::make_shared<TriangleMeshData>();
-    auto & meshData = *mesh.meshData;
-
     // reserve memory
     meshData.vertices.reserve(attrib.vertices.size() / 3);
     meshData.normals.reserve(attrib.normals.size() / 3);
@@ -218,14 +207,8 @@ bool loadTriangleMeshFromOBJ(TriangleMesh & mesh,
         // faces
         for(size_t fi = 0; fi < num_faces; ++fi) {
             auto indices = &shape.mesh.indices[3 * fi];
-            size_t matIndex = shape.mesh.material_ids[fi];
-            MaterialID materialId = 0;
-            if(matIndex >= 0 && matIndex < objMatToMatArrIndex.size()) {
-                materialId = objMatToMatArrIndex[matIndex];
-            }
-            meshData.faces.material.push_back(materialId);
-            assert(materialId >= 0);
-            assert(materialId < materials.size());
+            // -1 (no material) wraps to an invalid index
+            meshData.faces.material.push_back(MaterialID(shape.mesh.material_ids[fi]));
             // vertex indices
             for (int vi = 0; vi < 3; ++vi) {
                 // FIXME - Handle -1 for missing vertex_index, normal_index
@@ -246,11 +229,168 @@ bool loadTriangleMeshFromOBJ(TriangleMesh & mesh,
         }
     }
 
-    Slab bounds = boundingBox(meshData.vertices);
-    logger.normalf("Mesh bounds: "); bounds.log(logger);
-
     // TODO: Handle missing normals
 
     return true;
 }
 
+// Paths of the material libraries an OBJ file names, where tinyobjloader
+// looks for them
+static std::vector<std::string> materialLibraries(const std::string & path, const std::string & filename)
+{
+    std::vector<std::string> libraries;
+    std::ifstream in(path + '/' + filename);
+    std::string line;
+
+    while(std::getline(in, line)) {
+        std::istringstream tokens(line);
+        std::string keyword, library;
+        tokens >> keyword;
+        if(keyword != "mtllib") {
+            continue;
+        }
+        while(tokens >> library) {
+            libraries.push_back(path + '/' + library);
+        }
+    }
+
+    return libraries;
+}
+
+// The materials come from the OBJ's material libraries, so the cache file
+// starts with the source key of each. It is followed by the mesh data and
+// the fields of the OBJ materials that loadMaterialsFromOBJ uses.
+static void writeOBJCache(const std::string & cacheFile, uint64_t sourceKey,
+                          const std::vector<std::string> & libraries,
+                          const TriangleMeshData & meshData,
+                          const std::vector<tinyobj::material_t> & objmaterials)
+{
+    auto & logger = getLogger();
+    try {
+        MeshCacheWriter writer(cacheFile, sourceKey);
+        writer.writeValue(uint64_t(libraries.size()));
+        for(const auto & library : libraries) {
+            writer.writeString(library);
+            writer.writeValue(meshSourceKey(library));
+        }
+        writer.writeMeshData(meshData);
+        writer.writeValue(uint64_t(objmaterials.size()));
+        for(const auto & m : objmaterials) {
+            writer.writeString(m.name);
+            writer.writeValue(m.illum);
+            writer.writeValue(m.ior);
+            writer.writeValue(m.diffuse);
+            writer.writeValue(m.specular);
+            writer.writeValue(m.emission);
+            writer.writeValue(m.shininess);
+            writer.writeValue(m.dissolve);
+            writer.writeString(m.diffuse_texname);
+            writer.writeString(m.specular_texname);
+            writer.writeString(m.emissive_texname);
+            writer.writeString(m.bump_texname);
+            writer.writeString(m.alpha_texname);
+        }
+        writer.close();
+        logger.normal() << "Wrote mesh cache " << cacheFile;
+    }
+    catch(std::exception & e) {
+        logger.warning() << e.what();
+    }
+}
+
+static bool readOBJCache(const std::string & cacheFile, uint64_t sourceKey,
+                         TriangleMeshData & meshData,
+                         std::vector<tinyobj::material_t> & objmaterials)
+{
+    auto & logger = getLogger();
+    MeshCacheReader reader(cacheFile, sourceKey);
+    if(!reader.isValid()) {
+        return false;
+    }
+    try {
+        // Editing a material library invalidates the cache file
+        const uint64_t numLibraries = reader.readValue<uint64_t>();
+        for(uint64_t li = 0; li < numLibraries; ++li) {
+            const std::string library = reader.readString();
+            if(reader.readValue<uint64_t>() != meshSourceKey(library)) {
+                logger.normal() << "Ignoring mesh cache " << cacheFile << ": " << library << " changed";
+                return false;
+            }
+        }
+        reader.readMeshData(meshData);
+        objmaterials.resize(reader.readValue<uint64_t>());
+        for(auto & m : objmaterials) {
+            m.name = reader.readString();
+            m.illum = reader.readValue<decltype(m.illum)>();
+            m.ior = reader.readValue<decltype(m.ior)>();
+            reader.readValue(m.diffuse);
+            reader.readValue(m.specular);
+            reader.readValue(m.emission);
+            m.shininess = reader.readValue<decltype(m.shininess)>();
+            m.dissolve = reader.readValue<decltype(m.dissolve)>();
+            m.diffuse_texname = reader.readString();
+            m.specular_texname = reader.readString();
+            m.emissive_texname = reader.readString();
+            m.bump_texname = reader.readString();
+            m.alpha_texname = reader.readString();
+        }
+    }
+    catch(std::exception & e) {
+        logger.warning() << "Ignoring mesh cache " << cacheFile << ": " << e.what();
+        meshData = TriangleMeshData();
+        objmaterials.clear();
+        return false;
+    }
+    logger.normal() << "Loaded mesh from cache " << cacheFile;
+    return true;
+}
+
+bool loadTriangleMeshFromOBJ(TriangleMesh & mesh,
+                             MaterialArray & materials,
+                             TriangleMeshDataCache & meshDataCache,
+                             TextureCache & textureCache,
+                             const std::string & path, const std::string & filename)
+{
+    auto & logger = getLogger();
+
+    mesh.meshData = std::make_shared<TriangleMeshData>();
+    auto & meshData = *mesh.meshData;
+    std::vector<tinyobj::material_t> objmaterials;
+
+    const std::string pathToFile = path + '/' + filename;
+    std::string cacheFile;
+    uint64_t sourceKey = 0;
+    bool cached = false;
+
+    if(meshDataCache.diskCache) {
+        cacheFile = meshCacheFile(meshDataCache.diskCacheDirectory, pathToFile);
+        sourceKey = meshSourceKey(pathToFile);
+        cached = readOBJCache(cacheFile, sourceKey, meshData, objmaterials);
+    }
+
+    if(!cached) {
+        if(!parseOBJ(meshData, objmaterials, path, filename)) {
+            return false;
+        }
+        if(meshDataCache.diskCache) {
+            writeOBJCache(cacheFile, sourceKey, materialLibraries(path, filename), meshData, objmaterials);
+        }
+    }
+
+    // Keep a mapping from original material indices to the ones we insert into
+    // the materials array
+    std::vector<MaterialID> objMatToMatArrIndex;
+
+    loadMaterialsFromOBJ(materials, objMatToMatArrIndex, textureCache, objmaterials, path);
+
+    // Faces without a material (or with one the file does not define) use
+    // the default material
+    for(auto & materialId : meshData.faces.material) {
+        materialId = materialId < objMatToMatArrIndex.size() ? objMatToMatArrIndex[materialId] : NoMaterial;
+    }
+
+    Slab bounds = boundingBox(meshData.vertices);
+    logger.normalf("Mesh bounds: "); bounds.log(logger);
+
+    return true;
+}
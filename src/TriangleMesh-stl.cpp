@@ -2,7 +2,9 @@
 #include <stlloader.h>
 
 #include "TriangleMesh.h"
+#include "TriangleMeshCache.h"
 #include "slab.h"
+#include "Logger.h"
 
 bool loadTriangleMeshFromSTL(TriangleMesh & mesh,
                              MaterialArray & materials,
@@ -10,6 +12,28 @@ bool loadTriangleMeshFromSTL(TriangleMesh & mesh,
                              TextureCache & textureCache,
                              const std::string & path, const std::string & filename)
 {
+    auto & logger = getLogger();
+    const std::string pathToFile = path + '/' + filename;
+    std::string cacheFile;
+    uint64_t sourceKey = 0;
+
+    if(meshDataCache.diskCache) {
+        cacheFile = meshCacheFile(meshDataCache.diskCacheDirectory, pathToFile);
+        sourceKey = meshSourceKey(pathToFile);
+        MeshCacheReader reader(cacheFile, sourceKey);
+        if(reader.isValid()) {
+            try {
+                mesh.meshData = std::make_shared<TriangleMeshData>();
+                reader.readMeshData(*mesh.meshData);
+                logger.normal() << "Loaded mesh from cache " << cacheFile;
+                return true;
+            }
+            catch(std::exception & e) {
+                logger.warning() << "Ignoring mesh cache " << cacheFile << ": " << e.what();
+            }
+        }
+    }
+
     stlloader::Mesh stlmesh;
     stlloader::parse_file((path + '/' + filename).c_str(), stlmesh);
     //stlloader::print(stlmesh);
@@ -45,6 +69,18 @@ bool loadTriangleMeshFromSTL(TriangleMesh & mesh,
     meshData.bounds = boundingBox(meshData.vertices);
     printf("Mesh bounds: "); meshData.bounds.print();
 
+    if(meshDataCache.diskCache) {
+        try {
+            MeshCacheWriter writer(cacheFile, sourceKey);
+            writer.writeMeshData(meshData);
+            writer.close();
+            logger.normal() << "Wrote mesh cache " << cacheFile;
+        }
+        catch(std::exception & e) {
+            logger.warning() << e.what();
+        }
+    }
+
     return true;
 }
 
@@ -57,18 +57,35 @@ bool loadTriangleMesh(TriangleMesh & mesh,
     return success;
 }
 
+void TriangleMesh::buildPackets()
+{
+    buildTrianglePackets(packets, *this);
+}
+
 bool TriangleMesh::intersects(const Ray & ray, float minDistance, float maxDistance) const
 {
+    if(!packets.empty()) {
+        return intersectsAnyTriangle(ray, packets.data(), uint32_t(packets.size()), minDistance, maxDistance);
+    }
+
     return intersectsTrianglesIndexed(ray, &meshData->vertices[0], &meshData->indices.vertex[0], meshData->indices.vertex.size(),
                                       minDistance, maxDistance);
 }
 
-bool TriangleMesh::findIntersection(const Ray & ray, float minDistance, RayIntersection & intersection) const
+bool TriangleMesh::findHit(const Ray & ray, float minDistance, RayHit & rayHit) const
 {
     float bestDistance = std::numeric_limits<float>::max(), t = std::numeric_limits<float>::max();
     uint32_t bestTriangle = 0;
     bool hit = false;
 
+    if(!packets.empty()) {
+        if(!findClosestTriangle(ray, packets.data(), uint32_t(packets.size()), minDistance, bestDistance, bestTriangle))
+            return false;
+        rayHit.distance = bestDistance;
+        rayHit.primitive = bestTriangle;
+        return true;
+    }
+
     auto vertex = [&](uint32_t tri, uint32_t index) { return triangleVertex(tri, index); };
     const auto numTriangles = this->numTriangles();
 
@@ -85,11 +102,17 @@ bool TriangleMesh::findIntersection(const Ray & ray, float minDistance, RayInter
     if(!hit)
         return false;
 
-    fillTriangleMeshIntersection(ray, bestTriangle, bestDistance, intersection);
+    rayHit.distance = bestDistance;
+    rayHit.primitive = bestTriangle;
 
     return true;
 }
 
+void TriangleMesh::fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const
+{
+    fillTriangleMeshIntersection(ray, hit.primitive, hit.distance, intersection);
+}
+
 Slab TriangleMesh::boundingBox()
 {
     return meshData->bounds;
@@ -178,6 +201,12 @@ void TriangleMesh::fillTriangleMeshIntersection(const Ray & ray, uint32_t tri, f
 
         float sf = du1 * dv2 - du2 * dv1;
 
+        // Ratio of texture to surface area gives the texture scale
+        float surfaceArea = cross(V1, V2).magnitude();
+        if(surfaceArea > 0.0f) {
+            intersection.texcoordScale = std::sqrt(std::abs(sf) / surfaceArea);
+        }
+
         if(sf == 0.0f)
             sf = 1.0f;
 
@@ -248,8 +277,11 @@ void TriangleMesh::printMeta() const
 
 void TriangleMesh::scaleToFit(const Slab & bounds)
 {
-    Slab old = ::boundingBox(meshData->vertices);
+    transform = scaleToFitTransform(::boundingBox(meshData->vertices), bounds);
+}
 
+Transform scaleToFitTransform(const Slab & old, const Slab & bounds)
+{
     auto s = relativeScale(old, bounds);
     auto mine = s.minElement();
     auto maxe = s.maxElement();
@@ -266,11 +298,10 @@ void TriangleMesh::scaleToFit(const Slab & bounds)
     auto oldCenter = old.midpoint();
     auto newCenter = bounds.midpoint();
 
-    transform = compose(
+    // NOTE: We don't need to adjust normals be cause we are scaling uniformly in all directions
+    return compose(
         Transform::translation(newCenter),
         Transform::scale(scaleFactor),
         Transform::translation(-oldCenter));
-
-    // NOTE: We don't need to adjust normals be cause we are scaling uniformly in all directions
 }
 
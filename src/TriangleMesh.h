@@ -6,6 +6,7 @@
 #include "material.h"
 #include "traceable.h"
 #include "slab.h"
+#include "TrianglePacket.h"
 
 struct Ray;
 struct RayIntersection;
@@ -40,6 +41,12 @@ using TriangleMeshDataArray = std::vector<TriangleMeshDataPtr>;
 struct TriangleMeshDataCache
 {
     std::map<std::string, TriangleMeshDataPtr> fileToMeshData;
+
+    // Keep a binary copy of each loaded mesh file on disk, which later runs
+    // load without parsing (see TriangleMeshCache.h). Cache files go in
+    // diskCacheDirectory, or next to the mesh files if it is empty.
+    bool diskCache = false;
+    std::string diskCacheDirectory;
 };
 
 struct TriangleMesh : public Traceable
@@ -49,7 +56,8 @@ struct TriangleMesh : public Traceable
 
     // Ray intersection implementation
     virtual bool intersects(const Ray & ray, float minDistance, float maxDistance) const override;
-    virtual bool findIntersection(const Ray & ray, float minDistance, RayIntersection & intersection) const override;
+    virtual bool findHit(const Ray & ray, float minDistance, RayHit & hit) const override;
+    virtual void fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const override;
 
     // Bounding volume
     Slab boundingBox() override;
@@ -67,12 +75,24 @@ struct TriangleMesh : public Traceable
 
     void scaleToFit(const Slab & bounds);
 
+    // Pack all triangles for the SIMD kernels used by intersects() and
+    // findHit(). Must be called again if meshData changes.
+    void buildPackets();
+
     TriangleMeshDataPtr meshData = std::make_shared<TriangleMeshData>();
 
+    // Packed triangles. Empty until buildPackets() is called, in which case
+    // the unpacked triangles are tested one at a time.
+    TrianglePacketArray packets;
+
     // Global material override
     MaterialID material = NoMaterial;
 };
 
+// Uniform scale and translation that fits the box old inside bounds,
+// centered in it
+Transform scaleToFitTransform(const Slab & old, const Slab & bounds);
+
 bool loadTriangleMesh(TriangleMesh & mesh,
                       MaterialArray & materials,
                       TriangleMeshDataCache & meshDataCache,
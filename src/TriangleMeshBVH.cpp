@@ -0,0 +1,140 @@
+#include <limits>
+#include <algorithm>
+#include <cassert>
+
+#include "TriangleMeshBVH.h"
+#include "TriangleMesh.h"
+#include "Logger.h"
+#include "ThreadPool.h"
+#include "timer.h"
+
+TriangleMeshBVH::TriangleMeshBVH(std::shared_ptr<TriangleMesh> & mesh)
+    : mesh(mesh)
+{
+    transform = mesh->transform;
+}
+
+void TriangleMeshBVH::build()
+{
+    auto buildTimer = WallClockTimer::makeRunningTimer();
+
+    const auto numTriangles = mesh->numTriangles();
+
+    std::vector<BVH::Bounds> triangleBounds(numTriangles);
+
+    const size_t chunkSize = 4096;
+    getThreadPool().parallelFor((numTriangles + chunkSize - 1) / chunkSize, [&](size_t chunk, ThreadIndex) {
+        const uint32_t first = uint32_t(chunk * chunkSize);
+        const uint32_t last = uint32_t(std::min(first + chunkSize, size_t(numTriangles)));
+        for(uint32_t tri = first; tri < last; ++tri) {
+            auto & bounds = triangleBounds[tri];
+            bounds.extend(mesh->triangleVertex(tri, 0));
+            bounds.extend(mesh->triangleVertex(tri, 1));
+            bounds.extend(mesh->triangleVertex(tri, 2));
+        }
+    });
+
+    // Largest allocations of the build: the triangle bounds, and the
+    // build's references to them (bounds and index)
+    const size_t buildBytes = triangleBounds.size() * (2 * sizeof(BVH::Bounds) + sizeof(uint32_t));
+
+    bvh.build(triangleBounds);
+    std::vector<BVH::Bounds>().swap(triangleBounds);
+
+    // Pack the triangles of each leaf and point the leaf at its first packet
+    std::vector<uint32_t> leaves, firstPackets;
+    uint32_t numPackets = 0;
+    for(uint32_t ni = 0; ni < bvh.nodes.size(); ++ni) {
+        if(bvh.nodes[ni].isLeaf()) {
+            leaves.push_back(ni);
+            firstPackets.push_back(numPackets);
+            numPackets += TrianglePacket::numPacketsFor(bvh.nodes[ni].numPrimitives);
+        }
+    }
+
+    packets.clear();
+    packets.resize(numPackets);
+    packets.shrink_to_fit();
+
+    getThreadPool().parallelFor(leaves.size(), [&](size_t li, ThreadIndex) {
+        auto & node = bvh.nodes[leaves[li]];
+        fillTrianglePackets(&packets[firstPackets[li]], *mesh, &bvh.primitives[node.offset], node.numPrimitives);
+        node.offset = firstPackets[li];
+    });
+
+    auto buildTime = buildTimer.elapsed();
+
+    const float MB = 1024.0f * 1024.0f;
+    auto & logger = getLogger();
+    bvh.log(logger);
+    logger.normalf("BVH: %u triangle packets, %.2f MB, %s kernel, built in %.3f sec, peak %.2f MB of build data",
+                   (unsigned int) packets.size(),
+                   float(packets.size() * sizeof(TrianglePacket)) / MB,
+                   triangleKernelString(triangleKernel()),
+                   buildTime, float(buildBytes) / MB);
+
+    // The packets hold the triangle indices now
+    std::vector<uint32_t>().swap(bvh.primitives);
+}
+
+bool TriangleMeshBVH::nodesCoverAllTriangles() const
+{
+    const auto numTriangles = mesh->numTriangles();
+    std::vector<uint32_t> claimed(numTriangles, 0u);
+    for(const auto & node : bvh.nodes) {
+        if(!node.isLeaf()) {
+            continue;
+        }
+        for(uint32_t ti = 0; ti < node.numPrimitives; ++ti) {
+            const auto & packet = packets[node.offset + ti / TrianglePacket::WIDTH];
+            auto tri = packet.triangle[ti % TrianglePacket::WIDTH];
+            if(tri >= numTriangles) {
+                return false;
+            }
+            claimed[tri]++;
+        }
+    }
+    // Every triangle must be referenced by exactly one leaf
+    return std::all_of(claimed.begin(), claimed.end(), [](uint32_t n) { return n == 1; });
+}
+
+bool TriangleMeshBVH::intersects(const Ray & ray, float minDistance, float maxDistance) const
+{
+    return bvh.findAny(ray, minDistance, maxDistance,
+        [&](uint32_t firstPacket, uint32_t count) {
+            return intersectsAnyTriangle(ray, &packets[firstPacket], TrianglePacket::numPacketsFor(count),
+                                         minDistance, maxDistance);
+        });
+}
+
+bool TriangleMeshBVH::findHit(const Ray & ray, float minDistance, RayHit & rayHit) const
+{
+    uint32_t bestTriangle = 0;
+    float bestDistance = std::numeric_limits<float>::max();
+
+    bool hit = bvh.findClosest(ray, minDistance, bestDistance,
+        [&](uint32_t firstPacket, uint32_t count, float & maxDistance) {
+            return findClosestTriangle(ray, &packets[firstPacket], TrianglePacket::numPacketsFor(count),
+                                       minDistance, maxDistance, bestTriangle);
+        });
+
+    if(!hit)
+        return false;
+
+    assert(bestDistance >= minDistance);
+
+    rayHit.distance = bestDistance;
+    rayHit.primitive = bestTriangle;
+
+    return true;
+}
+
+void TriangleMeshBVH::fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const
+{
+    mesh->fillTriangleMeshIntersection(ray, hit.primitive, hit.distance, intersection);
+}
+
+Slab TriangleMeshBVH::boundingBox()
+{
+    return bvh.bounds();
+}
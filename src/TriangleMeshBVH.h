@@ -0,0 +1,46 @@
+#ifndef __TRIANGLE_MESH_BVH_H__
+#define __TRIANGLE_MESH_BVH_H__
+
+#include <memory>
+
+#include "traceable.h"
+#include "slab.h"
+#include "BVH.h"
+#include "TrianglePacket.h"
+
+struct Ray;
+struct RayIntersection;
+
+struct TriangleMesh;
+
+// Bounding volume hierarchy accelerator for a triangle mesh. Each triangle
+// is referenced by exactly one leaf. The triangles of each leaf are packed
+// into SIMD friendly packets after the build. Leaf offsets then index
+// `packets`, and `bvh.primitives` is released, as the packets hold the
+// triangle indices.
+struct TriangleMeshBVH : public Traceable
+{
+    TriangleMeshBVH(std::shared_ptr<TriangleMesh> & mesh);
+    ~TriangleMeshBVH() = default;
+
+    // Ray intersection implementation
+    virtual bool intersects(const Ray & ray, float minDistance, float maxDistance) const override;
+    virtual bool findHit(const Ray & ray, float minDistance, RayHit & hit) const override;
+    virtual void fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const override;
+
+    // Bounding volume
+    Slab boundingBox() override;
+
+    void build();
+
+    bool nodesCoverAllTriangles() const;
+
+    std::shared_ptr<TriangleMesh> mesh;
+
+    BVH bvh;
+
+    // Triangles of each leaf, in leaf order
+    TrianglePacketArray packets;
+};
+
+#endif
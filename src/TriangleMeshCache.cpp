@@ -0,0 +1,173 @@
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "TriangleMeshCache.h"
+#include "filesystem.h"
+#include "hash.h"
+
+static const char MESH_CACHE_MAGIC[8] = { 'F', 'L', 'U', 'X', 'M', 'E', 'S', 'H' };
+static const uint32_t MESH_CACHE_VERSION = 2;
+
+uint64_t meshSourceKey(const std::string & pathToFile)
+{
+    struct stat info;
+    if(stat(pathToFile.c_str(), &info) != 0) {
+        return 0;
+    }
+    const int64_t fileSize = info.st_size;
+    const int64_t modificationTime = info.st_mtime;
+    uint64_t key = fnv1a64(pathToFile);
+    key = fnv1a64(&fileSize, sizeof(fileSize), key);
+    key = fnv1a64(&modificationTime, sizeof(modificationTime), key);
+    return key;
+}
+
+std::string meshCacheFile(const std::string & directory, const std::string & pathToFile)
+{
+    if(directory.empty()) {
+        return pathToFile + ".fluxmesh";
+    }
+    // Files with the same name in different directories must not collide
+    std::string path, filename;
+    std::tie(path, filename) = filesystem::splitFileDirectory(pathToFile);
+    char pathHash[17];
+    snprintf(pathHash, sizeof(pathHash), "%016llx", (unsigned long long) fnv1a64(path));
+    return directory + '/' + filename + '.' + pathHash + ".fluxmesh";
+}
+
+//
+// Writer
+//
+
+MeshCacheWriter::MeshCacheWriter(const std::string & filename, uint64_t sourceKey)
+    : filename(filename),
+      tempFilename(filename + ".tmp")
+{
+    out.open(tempFilename, std::ios::binary | std::ios::trunc);
+    if(!out) {
+        throw std::runtime_error("Error creating mesh cache file " + tempFilename);
+    }
+    out.write(MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    writeValue(MESH_CACHE_VERSION);
+    writeValue(sourceKey);
+}
+
+MeshCacheWriter::~MeshCacheWriter()
+{
+    // Not closed, so the file is incomplete
+    if(out.is_open()) {
+        out.close();
+        std::remove(tempFilename.c_str());
+    }
+}
+
+void MeshCacheWriter::writeMeshData(const TriangleMeshData & meshData)
+{
+    writeArray(meshData.vertices);
+    writeArray(meshData.normals);
+    writeArray(meshData.texcoords);
+    writeArray(meshData.indices.vertex);
+    writeArray(meshData.indices.normal);
+    writeArray(meshData.indices.texcoord);
+    writeArray(meshData.faces.material);
+    const auto & b = meshData.bounds;
+    const float bounds[6] = { b.xmin, b.ymin, b.zmin, b.xmax, b.ymax, b.zmax };
+    writeValue(bounds);
+}
+
+void MeshCacheWriter::writeString(const std::string & s)
+{
+    writeValue(uint64_t(s.size()));
+    out.write(s.data(), s.size());
+}
+
+void MeshCacheWriter::close()
+{
+    out.close();
+    if(out.fail()) {
+        std::remove(tempFilename.c_str());
+        throw std::runtime_error("Error writing mesh cache file " + tempFilename);
+    }
+    if(std::rename(tempFilename.c_str(), filename.c_str()) != 0) {
+        std::remove(tempFilename.c_str());
+        throw std::runtime_error("Error renaming mesh cache file to " + filename);
+    }
+}
+
+//
+// Reader
+//
+
+MeshCacheReader::MeshCacheReader(const std::string & filename, uint64_t sourceKey)
+{
+    if(sourceKey == 0) {
+        return;
+    }
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(MESH_CACHE_MAGIC) + sizeof(uint32_t) + sizeof(uint64_t)) {
+        ::close(fd);
+        return;
+    }
+    void * mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(mapping == MAP_FAILED) {
+        return;
+    }
+    data = static_cast<const char *>(mapping);
+    size = info.st_size;
+
+    const bool magicMatches = std::equal(MESH_CACHE_MAGIC, MESH_CACHE_MAGIC + sizeof(MESH_CACHE_MAGIC),
+                                         consume(sizeof(MESH_CACHE_MAGIC)));
+    const uint32_t version = readValue<uint32_t>();
+    const uint64_t fileSourceKey = readValue<uint64_t>();
+    if(!magicMatches || version != MESH_CACHE_VERSION || fileSourceKey != sourceKey) {
+        munmap(const_cast<char *>(data), size);
+        data = nullptr;
+    }
+}
+
+MeshCacheReader::~MeshCacheReader()
+{
+    if(data) {
+        munmap(const_cast<char *>(data), size);
+    }
+}
+
+const char * MeshCacheReader::consume(size_t numBytes)
+{
+    if(numBytes > size - offset) {
+        throw std::runtime_error("Mesh cache file is truncated");
+    }
+    const char * p = data + offset;
+    offset += numBytes;
+    return p;
+}
+
+void MeshCacheReader::readMeshData(TriangleMeshData & meshData)
+{
+    readArray(meshData.vertices);
+    readArray(meshData.normals);
+    readArray(meshData.texcoords);
+    readArray(meshData.indices.vertex);
+    readArray(meshData.indices.normal);
+    readArray(meshData.indices.texcoord);
+    readArray(meshData.faces.material);
+    float bounds[6];
+    std::memcpy(bounds, consume(sizeof(bounds)), sizeof(bounds));
+    meshData.bounds = Slab(bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]);
+}
+
+std::string MeshCacheReader::readString()
+{
+    const uint64_t length = readValue<uint64_t>();
+    const char * chars = consume(length);
+    return std::string(chars, length);
+}
@@ -0,0 +1,128 @@
+#ifndef __TRIANGLE_MESH_CACHE_H__
+#define __TRIANGLE_MESH_CACHE_H__
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "TriangleMesh.h"
+
+// Binary cache of loaded mesh files. A cache file holds the arrays of a
+// TriangleMeshData as raw memory, followed by whatever else the loader needs
+// to recreate the mesh (e.g. OBJ materials), so later runs map the file and
+// copy the arrays out without parsing the source mesh.
+//
+// Cache files are keyed by the path, size and modification time of the
+// source file, so editing the source invalidates its cache file. Loaders
+// store the keys of any other files the mesh comes from (e.g. OBJ material
+// libraries) in the cache file and check them on load.
+
+// Identifies the current contents of a source file. 0 if it can't be found.
+uint64_t meshSourceKey(const std::string & pathToFile);
+
+// Cache file for a source file, in the directory if given, otherwise next
+// to the source file
+std::string meshCacheFile(const std::string & directory, const std::string & pathToFile);
+
+class MeshCacheWriter
+{
+    public:
+        // Writes to a temporary file until close(), so an interrupted write
+        // never leaves a truncated cache file. Throws std::runtime_error if
+        // the file can't be created.
+        MeshCacheWriter(const std::string & filename, uint64_t sourceKey);
+        ~MeshCacheWriter();
+
+        void writeMeshData(const TriangleMeshData & meshData);
+
+        template<typename T> void writeValue(const T & value);
+        template<typename T> void writeArray(const std::vector<T> & array);
+        void writeString(const std::string & s);
+
+        // Move the finished file into place. Throws std::runtime_error on
+        // error.
+        void close();
+
+    protected:
+        std::string filename;
+        std::string tempFilename;
+        std::ofstream out;
+};
+
+class MeshCacheReader
+{
+    public:
+        // Maps the file. The reader is not valid if the file is missing, or
+        // was written for another version of the source file or of the
+        // format.
+        MeshCacheReader(const std::string & filename, uint64_t sourceKey);
+        ~MeshCacheReader();
+
+        bool isValid() const { return data != nullptr; }
+
+        // Read functions throw std::runtime_error if the file is too short
+        void readMeshData(TriangleMeshData & meshData);
+
+        template<typename T> T readValue();
+        template<typename T, size_t N> void readValue(T (&values)[N]);
+        template<typename T> void readArray(std::vector<T> & array);
+        std::string readString();
+
+    protected:
+        const char * consume(size_t numBytes);
+
+        const char * data = nullptr;
+        size_t size = 0;
+        size_t offset = 0;
+};
+
+// Inline implementations
+
+template<typename T>
+void MeshCacheWriter::writeValue(const T & value)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Cached values are copied as raw memory");
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+void MeshCacheWriter::writeArray(const std::vector<T> & array)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Cached arrays are copied as raw memory");
+    writeValue(uint64_t(array.size()));
+    out.write(reinterpret_cast<const char *>(array.data()), array.size() * sizeof(T));
+}
+
+template<typename T>
+T MeshCacheReader::readValue()
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Cached values are copied as raw memory");
+    T value;
+    std::memcpy(&value, consume(sizeof(T)), sizeof(T));
+    return value;
+}
+
+template<typename T, size_t N>
+void MeshCacheReader::readValue(T (&values)[N])
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Cached values are copied as raw memory");
+    std::memcpy(values, consume(sizeof(values)), sizeof(values));
+}
+
+template<typename T>
+void MeshCacheReader::readArray(std::vector<T> & array)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Cached arrays are copied as raw memory");
+    const uint64_t count = readValue<uint64_t>();
+    if(count > (size - offset) / sizeof(T)) {
+        throw std::runtime_error("Mesh cache file is truncated");
+    }
+    array.resize(count);
+    std::memcpy(array.data(), consume(count * sizeof(T)), count * sizeof(T));
+}
+
+#endif
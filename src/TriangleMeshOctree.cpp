@@ -1,6 +1,5 @@
 #include <algorithm>
 #include <numeric>
-#include <functional>
 #include <iostream>
 #include <cassert>
 #include <stack>
@@ -10,6 +9,10 @@
 #include "Triangle.h"
 #include "vectortypes.h"
 #include "slab.h"
+#include "timer.h"
+#include "Logger.h"
+#include "ThreadPool.h"
+#include "PerfCounters.h"
 
 TriangleMeshOctree::TriangleMeshOctree(std::shared_ptr<TriangleMesh> & mesh)
     : mesh(mesh)
@@ -19,41 +22,91 @@ TriangleMeshOctree::TriangleMeshOctree(std::shared_ptr<TriangleMesh> & mesh)
 
 void TriangleMeshOctree::build()
 {
-    nodes.clear();
-    nodes.reserve(256);
-
-    auto rootIndex = addNode(0);
+    auto buildTimer = WallClockTimer::makeRunningTimer();
 
     Slab bounds = ::boundingBox(mesh->meshData->vertices);
 
     // Create a list of unique triangle indices
-    std::vector<uint32_t> tris;
-    tris.resize(mesh->numTriangles());
+    std::vector<uint32_t> tris(mesh->numTriangles());
     std::iota(tris.begin(), tris.end(), 0u);
 
-    triangles.reserve(mesh->numTriangles());
-    buildNode(rootIndex, tris, bounds);
+    BuildStats stats;
+    stats.allocated(tris.capacity() * sizeof(uint32_t));
+
+    BuildTree tree;
+    buildNode(tree, tris, bounds, 0, stats);
+
+    nodes = std::move(tree.nodes);
+    nodes.shrink_to_fit();
+
+    buildPackets(tree.triangles);
+    const size_t numReferences = tree.triangles.size();
+    tree = BuildTree();
+
+    auto buildTime = buildTimer.elapsed();
+
+    const float MB = 1024.0f * 1024.0f;
+    auto & logger = getLogger();
+    logger.normalf("Octree: %u nodes, %u triangles, %u references (%.2f per triangle), "
+                   "%u triangle packets, %.2f MB, built in %.3f sec, peak %.2f MB of triangle lists",
+                   (unsigned int) nodes.size(), (unsigned int) mesh->numTriangles(),
+                   (unsigned int) numReferences,
+                   mesh->numTriangles() > 0 ? float(numReferences) / float(mesh->numTriangles()) : 0.0f,
+                   (unsigned int) packets.size(),
+                   float(sizeInBytes()) / MB, buildTime,
+                   float(stats.peakListBytes.load()) / MB);
+}
+
+size_t TriangleMeshOctree::sizeInBytes() const
+{
+    return nodes.size() * sizeof(Node)
+        + packets.size() * sizeof(TrianglePacket);
+}
+
+void TriangleMeshOctree::BuildStats::allocated(size_t bytes)
+{
+    size_t current = (listBytes += bytes);
+    size_t peak = peakListBytes.load();
+    while(current > peak && !peakListBytes.compare_exchange_weak(peak, current)) {}
 }
 
-void TriangleMeshOctree::buildNode(uint32_t nodeIndex,
-                                   const std::vector<uint32_t> & tris,
-                                   const Slab & bounds)
+// Split triangles among the children of a node:
+//  - Each triangle's child mask is found from which side of each split
+//    plane its vertices are on. A triangle with all vertices on one side of
+//    every plane is inside a single child.
+//  - Triangles that straddle planes may still miss some children the mask
+//    allows (eg: one crossing the corner of a child cell), so those are
+//    tested exactly against each child's bounds.
+//  - Triangles whose overlap is lost to round off at the boundaries stay
+//    in the node itself, so no triangle is ever dropped.
+uint32_t TriangleMeshOctree::buildNode(BuildTree & tree,
+                                       std::vector<uint32_t> & tris,
+                                       const Slab & bounds,
+                                       uint8_t level,
+                                       BuildStats & stats) const
 {
-    auto first = tris.begin();
-    auto last = tris.end();
+    const uint32_t nodeIndex = uint32_t(tree.nodes.size());
+    tree.nodes.emplace_back();
 
     // Note: We are not using a reference to the node, because
     //       recursive calls may reallocate the array.
-    Node node = nodes[nodeIndex];
+    Node node;
     node.bounds = bounds;
+    node.level = level;
+
+    auto releaseTriangles = [&stats](std::vector<uint32_t> & list) {
+        stats.freed(list.capacity() * sizeof(uint32_t));
+        std::vector<uint32_t>().swap(list);
+    };
 
-    if(uint32_t(last - first) <= buildCutOffNumTriangles
+    if(uint32_t(tris.size()) <= buildCutOffNumTriangles
        || node.level >= buildMaxLevel) {
-        node.firstTriangle = uint32_t(triangles.size());
-        node.numTriangles = uint32_t(last - first);
-        std::copy(first, last, std::back_inserter(triangles));
-        nodes[nodeIndex] = node;
-        return;
+        node.offset = uint32_t(tree.triangles.size());
+        node.numTriangles = uint32_t(tris.size());
+        tree.triangles.insert(tree.triangles.end(), tris.begin(), tris.end());
+        releaseTriangles(tris);
+        tree.nodes[nodeIndex] = node;
+        return nodeIndex;
     }
 
     // Convenience constants
@@ -63,90 +116,223 @@ void TriangleMeshOctree::buildNode(uint32_t nodeIndex,
     // Find split planes
     const float xmid = bounds.xmid(), ymid = bounds.ymid(), zmid = bounds.zmid();
 
-    // Helper functions for partitioning
-    auto evalForVerts = [&](uint32_t ti, std::function<bool(const Position3 &)> p) {
-        return p(mesh->triangleVertex(ti, 0))
-            || p(mesh->triangleVertex(ti, 1))
-            || p(mesh->triangleVertex(ti, 2));
-    };
+    Slab childBounds[MAX_CHILDREN];
+    for(child_index_t ci = 0; ci < MAX_CHILDREN; ++ci) {
+        childBounds[ci] = Slab((ci & XBIT) ? xmid : xmin, (ci & YBIT) ? ymid : ymin, (ci & ZBIT) ? zmid : zmin,
+                               (ci & XBIT) ? xmax : xmid, (ci & YBIT) ? ymax : ymid, (ci & ZBIT) ? zmax : zmid);
+    }
 
-    // FIXME: This is not sufficient to determine if a triangle intersects a bounding box. There is a WAR in findIntersection(),
-    //        but the proper fix should be here, and the WAR may not catch all cases.
-    auto isInXLow  = [&](uint32_t ti) { return evalForVerts(ti, [&](const Position3 & p) { return p.x <= xmid; }); };
-    auto isInXHigh = [&](uint32_t ti) { return evalForVerts(ti, [&](const Position3 & p) { return p.x >= xmid; }); };
-    auto isInYLow  = [&](uint32_t ti) { return evalForVerts(ti, [&](const Position3 & p) { return p.y <= ymid; }); };
-    auto isInYHigh = [&](uint32_t ti) { return evalForVerts(ti, [&](const Position3 & p) { return p.y >= ymid; }); };
-    auto isInZLow  = [&](uint32_t ti) { return evalForVerts(ti, [&](const Position3 & p) { return p.z <= zmid; }); };
-    auto isInZHigh = [&](uint32_t ti) { return evalForVerts(ti, [&](const Position3 & p) { return p.z >= zmid; }); };
-
-    // Bin in X
-    std::vector<uint32_t> L, H;
-    std::copy_if(first, last, std::back_inserter(L), isInXLow);
-    std::copy_if(first, last, std::back_inserter(H), isInXHigh);
-
-    // Bin in Y
-    std::vector<uint32_t> LL, LH, HL, HH;
-    std::copy_if(L.begin(), L.end(), std::back_inserter(LL), isInYLow);
-    std::copy_if(L.begin(), L.end(), std::back_inserter(LH), isInYHigh);
-    std::copy_if(H.begin(), H.end(), std::back_inserter(HL), isInYLow);
-    std::copy_if(H.begin(), H.end(), std::back_inserter(HH), isInYHigh);
-
-    // Bin in Z
-    std::vector<uint32_t> LLL, LHL, HLL, HHL, LLH, LHH, HLH, HHH;
-    std::copy_if(LL.begin(), LL.end(), std::back_inserter(LLL), isInZLow);
-    std::copy_if(LL.begin(), LL.end(), std::back_inserter(LLH), isInZHigh);
-    std::copy_if(LH.begin(), LH.end(), std::back_inserter(LHL), isInZLow);
-    std::copy_if(LH.begin(), LH.end(), std::back_inserter(LHH), isInZHigh);
-    std::copy_if(HL.begin(), HL.end(), std::back_inserter(HLL), isInZLow);
-    std::copy_if(HL.begin(), HL.end(), std::back_inserter(HLH), isInZHigh);
-    std::copy_if(HH.begin(), HH.end(), std::back_inserter(HHL), isInZLow);
-    std::copy_if(HH.begin(), HH.end(), std::back_inserter(HHH), isInZHigh);
+    // Slightly enlarged child bounds for the exact tests, so triangles
+    // lying on a split plane are not lost to round off
+    const float epsilon = 1.0e-5f * std::max(bounds.maxdim(), 1.0e-20f);
+    Slab testBounds[MAX_CHILDREN];
+    for(child_index_t ci = 0; ci < MAX_CHILDREN; ++ci) {
+        const auto & b = childBounds[ci];
+        testBounds[ci] = Slab(b.xmin - epsilon, b.ymin - epsilon, b.zmin - epsilon,
+                              b.xmax + epsilon, b.ymax + epsilon, b.zmax + epsilon);
+    }
+
+    // Bit mask of the children each triangle overlaps
+    std::vector<uint8_t> masks(tris.size());
+    uint32_t counts[MAX_CHILDREN] = {};
+    uint32_t numUnclaimed = 0;
+
+    for(size_t i = 0; i < tris.size(); ++i) {
+        const auto ti = tris[i];
+        const auto & v0 = mesh->triangleVertex(ti, 0);
+        const auto & v1 = mesh->triangleVertex(ti, 1);
+        const auto & v2 = mesh->triangleVertex(ti, 2);
+
+        // Sides of each split plane touched by the vertices
+        auto sides = [](float a, float b, float c, float mid, child_index_t bit) {
+            child_index_t low = (a <= mid || b <= mid || c <= mid) ? 1u : 0u;
+            child_index_t high = (a >= mid || b >= mid || c >= mid) ? 1u : 0u;
+            return std::make_pair(low ? 0u : bit, high ? bit : 0u);
+        };
+        auto xs = sides(v0.x, v1.x, v2.x, xmid, XBIT);
+        auto ys = sides(v0.y, v1.y, v2.y, ymid, YBIT);
+        auto zs = sides(v0.z, v1.z, v2.z, zmid, ZBIT);
+
+        uint8_t mask = 0;
+        for(child_index_t ci = 0; ci < MAX_CHILDREN; ++ci) {
+            if(((ci & XBIT) == xs.first || (ci & XBIT) == xs.second)
+               && ((ci & YBIT) == ys.first || (ci & YBIT) == ys.second)
+               && ((ci & ZBIT) == zs.first || (ci & ZBIT) == zs.second)) {
+                mask |= uint8_t(1u << ci);
+            }
+        }
+
+        if(mask & (mask - 1)) {
+            // Straddles a split plane
+            for(child_index_t ci = 0; ci < MAX_CHILDREN; ++ci) {
+                if((mask & (1u << ci)) && !triangleOverlapsBox(v0, v1, v2, testBounds[ci])) {
+                    mask &= uint8_t(~(1u << ci));
+                }
+            }
+        }
+
+        masks[i] = mask;
+        for(child_index_t ci = 0; ci < MAX_CHILDREN; ++ci) {
+            counts[ci] += (mask >> ci) & 1u;
+        }
+        numUnclaimed += mask == 0 ? 1u : 0u;
+    }
+
+    // Hand the triangles to the children, then release this node's list
+    std::vector<uint32_t> childTris[MAX_CHILDREN];
+    for(child_index_t ci = 0; ci < MAX_CHILDREN; ++ci) {
+        childTris[ci].reserve(counts[ci]);
+        stats.allocated(childTris[ci].capacity() * sizeof(uint32_t));
+    }
+
+    node.offset = uint32_t(tree.triangles.size());
+    node.numTriangles = numUnclaimed;
+
+    for(size_t i = 0; i < tris.size(); ++i) {
+        const uint8_t mask = masks[i];
+        if(mask == 0) {
+            tree.triangles.push_back(tris[i]);
+        }
+        for(child_index_t ci = 0; ci < MAX_CHILDREN; ++ci) {
+            if(mask & (1u << ci)) {
+                childTris[ci].push_back(tris[i]);
+            }
+        }
+    }
+
+    releaseTriangles(tris);
+    std::vector<uint8_t>().swap(masks);
 
     // Create child nodes
-    buildChild(node, TriangleMeshOctree::LLL, LLL, Slab(xmin, ymin, zmin, xmid, ymid, zmid));
-    buildChild(node, TriangleMeshOctree::LLH, LLH, Slab(xmin, ymin, zmid, xmid, ymid, zmax));
-    buildChild(node, TriangleMeshOctree::LHL, LHL, Slab(xmin, ymid, zmin, xmid, ymax, zmid));
-    buildChild(node, TriangleMeshOctree::LHH, LHH, Slab(xmin, ymid, zmid, xmid, ymax, zmax));
-    buildChild(node, TriangleMeshOctree::HLL, HLL, Slab(xmid, ymin, zmin, xmax, ymid, zmid));
-    buildChild(node, TriangleMeshOctree::HLH, HLH, Slab(xmid, ymin, zmid, xmax, ymid, zmax));
-    buildChild(node, TriangleMeshOctree::HHL, HHL, Slab(xmid, ymid, zmin, xmax, ymax, zmid));
-    buildChild(node, TriangleMeshOctree::HHH, HHH, Slab(xmid, ymid, zmid, xmax, ymax, zmax));
+    if(level < buildParallelLevels) {
+        // Build the children as subtrees of their own in parallel, then
+        // append them to this one
+        BuildTree childTrees[MAX_CHILDREN];
+        getThreadPool().parallelFor(MAX_CHILDREN, [&](size_t ci, ThreadIndex) {
+            if(!childTris[ci].empty()) {
+                buildNode(childTrees[ci], childTris[ci], childBounds[ci], level + 1, stats);
+            }
+        });
+        for(child_index_t ci = 0; ci < MAX_CHILDREN; ++ci) {
+            if(!childTrees[ci].nodes.empty()) {
+                node.children[ci] = appendBuildTree(tree, childTrees[ci]);
+            }
+        }
+    }
+    else {
+        for(child_index_t ci = 0; ci < MAX_CHILDREN; ++ci) {
+            if(!childTris[ci].empty()) {
+                node.children[ci] = buildNode(tree, childTris[ci], childBounds[ci], level + 1, stats);
+            }
+        }
+    }
 
     // Count non-zero child indices to determine number of children
     node.numChildren = std::count_if(node.children, node.children + MAX_CHILDREN, [](uint32_t index) { return index != NO_CHILD; });
 
     // Update the node in the array
-    nodes[nodeIndex] = node;
+    tree.nodes[nodeIndex] = node;
+
+    return nodeIndex;
 }
 
-void TriangleMeshOctree::buildChild(Node & node,
-                                    child_index_t childIndex,
-                                    const std::vector<uint32_t> & childTris,
-                                    const Slab & childBounds)
+uint32_t TriangleMeshOctree::appendBuildTree(BuildTree & tree, BuildTree & subtree)
 {
-    if(childTris.empty())
-        return;
-    auto childNodeIndex = addNode(node.level + 1);
-    node.children[childIndex] = childNodeIndex;
-    buildNode(childNodeIndex, childTris, childBounds);
+    const auto firstNode = uint32_t(tree.nodes.size());
+    const auto firstTriangle = uint32_t(tree.triangles.size());
+
+    for(auto node : subtree.nodes) {
+        node.offset += firstTriangle;
+        for(auto & child : node.children) {
+            if(child != NO_CHILD) {
+                child += firstNode;
+            }
+        }
+        tree.nodes.push_back(node);
+    }
+    tree.triangles.insert(tree.triangles.end(), subtree.triangles.begin(), subtree.triangles.end());
+
+    subtree = BuildTree();
+
+    return firstNode;
 }
 
-uint32_t TriangleMeshOctree::addNode(uint8_t level)
+void TriangleMeshOctree::buildPackets(const std::vector<uint32_t> & triangles)
 {
-    nodes.emplace_back();
-    nodes.back().level = level;
-    return nodes.size() - 1;
+    // Lay out the packets of each node, then fill them in parallel
+    std::vector<uint32_t> firstPackets(nodes.size());
+    uint32_t numPackets = 0;
+    for(size_t ni = 0; ni < nodes.size(); ++ni) {
+        firstPackets[ni] = numPackets;
+        numPackets += TrianglePacket::numPacketsFor(nodes[ni].numTriangles);
+    }
+
+    packets.clear();
+    packets.resize(numPackets);
+    packets.shrink_to_fit();
+
+    getThreadPool().parallelFor(nodes.size(), [&](size_t nodeIndex, ThreadIndex) {
+        auto & node = nodes[nodeIndex];
+        if(node.numTriangles > 0) {
+            fillTrianglePackets(&packets[firstPackets[nodeIndex]], *mesh, &triangles[node.offset], node.numTriangles);
+        }
+        node.offset = firstPackets[nodeIndex];
+    });
+}
+
+bool TriangleMeshOctree::triangleOverlapsBox(const vec3 & v0, const vec3 & v1, const vec3 & v2,
+                                             const Slab & box)
+{
+    // Akenine-Moller, "Fast 3D Triangle-Box Overlap Testing", 2001. The
+    // triangle and box are disjoint if their projections onto any of 13
+    // axes are: the box normals, the triangle normal, and the cross
+    // products of the box normals with the triangle edges.
+    const vec3 center(box.xmid(), box.ymid(), box.zmid());
+    const vec3 halfSize(0.5f * box.xdim(), 0.5f * box.ydim(), 0.5f * box.zdim());
+    const vec3 v[3] = { v0 - center, v1 - center, v2 - center };
+
+    auto separates = [&](const vec3 & axis) {
+        float p0 = dot(axis, v[0]), p1 = dot(axis, v[1]), p2 = dot(axis, v[2]);
+        float r = halfSize.x * std::abs(axis.x) + halfSize.y * std::abs(axis.y) + halfSize.z * std::abs(axis.z);
+        return std::min({ p0, p1, p2 }) > r || std::max({ p0, p1, p2 }) < -r;
+    };
+
+    // Box normals (the triangle's bounds against the box)
+    const vec3 boxAxes[3] = { vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f) };
+    for(const auto & axis : boxAxes) {
+        if(separates(axis)) {
+            return false;
+        }
+    }
+
+    const vec3 edges[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+
+    // Triangle normal
+    if(separates(cross(edges[0], edges[1]))) {
+        return false;
+    }
+
+    // Edge cross products. Degenerate axes are zero and never separate.
+    for(const auto & edge : edges) {
+        for(const auto & boxAxis : boxAxes) {
+            if(separates(cross(boxAxis, edge))) {
+                return false;
+            }
+        }
+    }
+
+    return true;
 }
 
 void TriangleMeshOctree::printNodes() const
 {
-    printf("triangles mesh %u octree %u\n",
+    printf("triangles mesh %u octree packets %u\n",
            (unsigned int) mesh->numTriangles(),
-           (unsigned int) triangles.size());
+           (unsigned int) packets.size());
     for(uint32_t i = 0; i < nodes.size(); ++i) {
         const auto & node = nodes[i];
-        printf("%3u : level %2u first %u count %u\n", i,
-               (unsigned int) node.level, node.firstTriangle, node.numTriangles);
+        printf("%3u : level %2u first packet %u count %u\n", i,
+               (unsigned int) node.level, node.offset, node.numTriangles);
         if(node.numChildren > 0) {
             printf("      children  ");
             for(uint32_t c = 0; c < MAX_CHILDREN; ++c) {
@@ -162,7 +348,7 @@ bool TriangleMeshOctree::nodesCoverAllTriangles() const
     std::fill(claimed.begin(), claimed.end(), uint8_t(0));
     for(const auto & node : nodes) {
         for(uint32_t ti = 0; ti < node.numTriangles; ++ti) {
-            claimed[triangles[node.firstTriangle + ti]] = uint8_t(1);
+            claimed[nodeTriangle(node, ti)] = uint8_t(1);
         }
     }
     return std::find(claimed.begin(), claimed.end(), uint8_t(0)) == claimed.end();
@@ -234,18 +420,14 @@ bool TriangleMeshOctree::intersectsNode(const Ray & ray, float minDistance, floa
 {
     const auto & node = nodes[nodeIndex];
 
+    perf::count(perf::NodesVisited);
     if(!node.bounds.intersects(ray, minDistance, maxDistance))
        return false;
 
-    if(node.numTriangles > 0) {
-        for(uint32_t ti = 0; ti < node.numTriangles; ++ti) {
-            auto tri = triangles[node.firstTriangle + ti];
-            if(intersectsTriangle(ray,
-                                  mesh->triangleVertex(tri, 0), mesh->triangleVertex(tri, 1), mesh->triangleVertex(tri, 2),
-                                  minDistance, maxDistance)) {
-                return true;
-            }
-        }
+    if(node.numTriangles > 0
+       && intersectsAnyTriangle(ray, &packets[node.offset], TrianglePacket::numPacketsFor(node.numTriangles),
+                                minDistance, maxDistance)) {
+        return true;
     }
 
     if(node.numChildren > 0) {
@@ -281,6 +463,7 @@ bool TriangleMeshOctree::findIntersectionNode(const Ray & ray, float minDistance
     const auto & node = nodes[nodeIndex];
     bool hit = false;
 
+    perf::count(perf::NodesVisited);
     if(!node.bounds.intersects(ray, minDistance, std::numeric_limits<float>::max()))
        return false;
     
@@ -294,13 +477,10 @@ bool TriangleMeshOctree::findIntersectionNode(const Ray & ray, float minDistance
             if(childNode == TriangleMeshOctree::NO_CHILD)
                 continue; // empty child cell
             if(findIntersectionNode(ray, minDistance, bestTriangle, bestDistance, childOrder, childNode, level + 1)) {
-                // FIXME[WAR]: We have a bug in the octree building logic that includes triangles in cells
-                //             that do not actually contain them. This leads to incorrectly determining the first
-                //             hit in the wrong cell sometimes. By iterating over all children, we make sure to
-                //             find the true nearest hit.  The right fix would be to build the tree correctly in
-                //             the first place.
-                hit = true; // WAR
-                //return true;
+                // Triangles spanning several cells are in each of them, so a hit
+                // found in a near cell may lie beyond it, behind a closer hit in
+                // a later cell. Keep going so the true nearest hit is found.
+                hit = true;
             }
         }
     }
@@ -321,29 +501,14 @@ bool TriangleMeshOctree::findIntersectionNodeTriangles(
     bool hit = false;
 
     if(node.numTriangles > 0) {
-        float t = std::numeric_limits<float>::max();
-        assert(node.firstTriangle + node.numTriangles - 1 < triangles.size());
-        for(uint32_t ti = 0; ti < node.numTriangles; ++ti) {
-            auto tri = triangles[node.firstTriangle + ti];
-            if(intersectsTriangle(ray,
-                                  mesh->triangleVertex(tri, 0),
-                                  mesh->triangleVertex(tri, 1),
-                                  mesh->triangleVertex(tri, 2),
-                                  minDistance, std::numeric_limits<float>::max(), &t)) {
-                if(t < bestDistance) {
-                    bestTriangle = tri;
-                    bestDistance = t;
-                    hit = true;
-                }
-            }
-        }
+        hit = findClosestTriangle(ray, &packets[node.offset], TrianglePacket::numPacketsFor(node.numTriangles),
+                                  minDistance, bestDistance, bestTriangle);
     }
 
     return hit;
 }
 
-bool TriangleMeshOctree::findIntersection(const Ray & ray, float minDistance,
-                                          RayIntersection & intersection) const
+bool TriangleMeshOctree::findHit(const Ray & ray, float minDistance, RayHit & rayHit) const
 {
     TriangleMeshOctree::child_array_t childOrder = {};
     std::stack<uint32_t> nodesToCheck;
@@ -387,11 +552,17 @@ bool TriangleMeshOctree::findIntersection(const Ray & ray, float minDistance,
     if(!hit)
         return false;
 
-    mesh->fillTriangleMeshIntersection(ray, bestTriangle, bestDistance, intersection);
+    rayHit.distance = bestDistance;
+    rayHit.primitive = bestTriangle;
 
     return true;
 }
 
+void TriangleMeshOctree::fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const
+{
+    mesh->fillTriangleMeshIntersection(ray, hit.primitive, hit.distance, intersection);
+}
+
 Slab TriangleMeshOctree::boundingBox()
 {
     if(!nodes.empty()) {
@@ -3,9 +3,11 @@
 
 #include <vector>
 #include <cstdint>
+#include <atomic>
 
 #include "traceable.h"
 #include "slab.h"
+#include "TrianglePacket.h"
 
 struct Ray;
 struct RayIntersection;
@@ -25,7 +27,8 @@ struct TriangleMeshOctree : public Traceable
 
     // Ray intersection implementation
     virtual bool intersects(const Ray & ray, float minDistance, float maxDistance) const override;
-    virtual bool findIntersection(const Ray & ray, float minDistance, RayIntersection & intersection) const override;
+    virtual bool findHit(const Ray & ray, float minDistance, RayHit & hit) const override;
+    virtual void fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const override;
 
     bool intersectsNode(const Ray & ray, float minDistance, float maxDistance,
                         const TriangleMeshOctree::child_array_t & childOrder,
@@ -46,13 +49,13 @@ struct TriangleMeshOctree : public Traceable
     // Bounding volume
     Slab boundingBox() override;
 
+    // Build the octree. Subtrees build in parallel on the thread pool, and
+    // the build time and memory are logged.
     void build();
 
-    // Add a new node and return its index
-    uint32_t addNode(uint8_t level);
-
     void printNodes() const;
     bool nodesCoverAllTriangles() const;
+    size_t sizeInBytes() const;
 
     std::shared_ptr<TriangleMesh> mesh;
 
@@ -64,6 +67,10 @@ struct TriangleMeshOctree : public Traceable
     static const char * octantString(child_index_t childIndex);
     static void printChildOrder(child_array_t & indices);
 
+    // Exact triangle / box overlap test (separating axis theorem)
+    static bool triangleOverlapsBox(const vec3 & v0, const vec3 & v1, const vec3 & v2,
+                                    const Slab & box);
+
     // Bit masks for child indices. Used to determine which half
     // of the octree a child cell is in along each direction.
     enum { XBIT = 0x4, YBIT = 0x2, ZBIT = 0x1 };
@@ -78,8 +85,10 @@ struct TriangleMeshOctree : public Traceable
         // order (XYZ): LLL,LLH,LHL,LHH,HLL,HLH,HHL,HHH
         child_array_t children = {};
 
-        // Triangles owned by this node (indices into the mesh)
-        uint32_t firstTriangle = 0;
+        // Triangles owned by this node. While the tree is built, `offset`
+        // is the index of the first in the build's triangle list. Once it
+        // is built, it is the index of the node's first packet.
+        uint32_t offset = 0;
         uint32_t numTriangles = 0;
 
         uint8_t level = 0;
@@ -89,24 +98,46 @@ struct TriangleMeshOctree : public Traceable
     // Nodes of the octree. First is the root.
     std::vector<Node> nodes;
 
-    // Indices into the triangle mesh. Octree nodes index into this
-    // array instead of directly into the mesh because there may be
-    // triangles duplicated in multiple nodes and we want to keep
-    // nodes small, so we only store a range of indices into this array.
-    std::vector<uint32_t> triangles;
-
-    // Build a node by claiming the appropriate triangles from the array
-    void buildNode(uint32_t nodeIndex,
-                   const std::vector<uint32_t> & tris,
-                   const Slab & bounds);
-    void buildChild(Node & node,
-                    child_index_t childIndex,
-                    const std::vector<uint32_t> & childTris,
-                    const Slab & childBounds);
+    // Triangles of each node packed for intersection, in node order. A
+    // triangle may be in more than one node. The packets hold the mesh
+    // index of each triangle, so no separate index list is kept.
+    TrianglePacketArray packets;
+
+    // Mesh index of triangle ti of a node
+    inline uint32_t nodeTriangle(const Node & node, uint32_t ti) const {
+        return packets[node.offset + ti / TrianglePacket::WIDTH].triangle[ti % TrianglePacket::WIDTH];
+    }
 
     // Build configuration
     uint32_t buildCutOffNumTriangles = 32;
     uint8_t buildMaxLevel = 8;
+    // Children of nodes above this level are built as parallel subtrees
+    uint8_t buildParallelLevels = 2;
+
+    // Nodes and triangles of a subtree while it is built. Indices are
+    // relative to the subtree until it is appended to its parent.
+    struct BuildTree {
+        std::vector<Node> nodes;
+        std::vector<uint32_t> triangles;
+    };
+
+    struct BuildStats {
+        std::atomic<size_t> listBytes{0};
+        std::atomic<size_t> peakListBytes{0};
+        void allocated(size_t bytes);
+        void freed(size_t bytes) { listBytes -= bytes; }
+    };
+
+    // Build a node and its subtree from the triangles overlapping its
+    // bounds. Triangle lists are handed down and released as soon as they
+    // are split among the children. Returns the node's index in tree.
+    uint32_t buildNode(BuildTree & tree, std::vector<uint32_t> & tris,
+                       const Slab & bounds, uint8_t level, BuildStats & stats) const;
+    // Append a subtree, returning the index of its root
+    static uint32_t appendBuildTree(BuildTree & tree, BuildTree & subtree);
+    // Pack the triangles of all nodes, in node order, and point each node
+    // at its first packet
+    void buildPackets(const std::vector<uint32_t> & triangles);
 };
 
 
@@ -0,0 +1,434 @@
+#include <cmath>
+#include <cstring>
+
+#include "TrianglePacket.h"
+#include "TriangleMesh.h"
+#include "Ray.h"
+#include "PerfCounters.h"
+
+// SIMD kernels are compiled for their instruction set with function target
+// attributes and selected at run time, so the library itself still runs
+// on CPUs without them.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TRIANGLE_PACKET_X86
+#include <immintrin.h>
+#endif
+
+static const float triangleEpsilon = 1.0e-6;
+
+const uint32_t TrianglePacket::WIDTH;
+
+void TrianglePacket::clear()
+{
+    // Zero edges give a zero determinant, which never hits
+    std::memset(this, 0, sizeof(*this));
+}
+
+void TrianglePacket::set(uint32_t lane, const vec3 & a, const vec3 & b, const vec3 & c, uint32_t tri)
+{
+    const vec3 edge1 = b - a;
+    const vec3 edge2 = c - a;
+    v0[0][lane] = a.x;     v0[1][lane] = a.y;     v0[2][lane] = a.z;
+    e1[0][lane] = edge1.x; e1[1][lane] = edge1.y; e1[2][lane] = edge1.z;
+    e2[0][lane] = edge2.x; e2[1][lane] = edge2.y; e2[2][lane] = edge2.z;
+    triangle[lane] = tri;
+}
+
+uint32_t appendTrianglePackets(TrianglePacketArray & packets, const TriangleMesh & mesh,
+                               const uint32_t triangles[], uint32_t numTriangles)
+{
+    const auto firstPacket = uint32_t(packets.size());
+    packets.resize(firstPacket + TrianglePacket::numPacketsFor(numTriangles));
+    fillTrianglePackets(packets.data() + firstPacket, mesh, triangles, numTriangles);
+    return firstPacket;
+}
+
+void fillTrianglePackets(TrianglePacket packets[], const TriangleMesh & mesh,
+                         const uint32_t triangles[], uint32_t numTriangles)
+{
+    for(uint32_t pi = 0; pi < TrianglePacket::numPacketsFor(numTriangles); ++pi) {
+        packets[pi].clear();
+    }
+
+    for(uint32_t ti = 0; ti < numTriangles; ++ti) {
+        auto tri = triangles[ti];
+        packets[ti / TrianglePacket::WIDTH].set(ti % TrianglePacket::WIDTH,
+                                                mesh.triangleVertex(tri, 0),
+                                                mesh.triangleVertex(tri, 1),
+                                                mesh.triangleVertex(tri, 2),
+                                                tri);
+    }
+}
+
+void buildTrianglePackets(TrianglePacketArray & packets, const TriangleMesh & mesh)
+{
+    const auto numTriangles = uint32_t(mesh.numTriangles());
+    std::vector<uint32_t> triangles(numTriangles);
+    for(uint32_t tri = 0; tri < numTriangles; ++tri) {
+        triangles[tri] = tri;
+    }
+    packets.clear();
+    appendTrianglePackets(packets, mesh, triangles.data(), numTriangles);
+}
+
+// Scalar kernel. Same arithmetic as intersectsTriangle(), so all kernels
+// agree with the unpacked path.
+
+static inline bool intersectsLane(const Ray & ray, const TrianglePacket & p, uint32_t lane,
+                                  float minDistance, float maxDistance, float & t)
+{
+    const auto & o = ray.origin;
+    const auto & d = ray.direction;
+    const float e1x = p.e1[0][lane], e1y = p.e1[1][lane], e1z = p.e1[2][lane];
+    const float e2x = p.e2[0][lane], e2y = p.e2[1][lane], e2z = p.e2[2][lane];
+
+    // P = cross(d, e2)
+    const float Px = d.y * e2z - d.z * e2y;
+    const float Py = d.z * e2x - d.x * e2z;
+    const float Pz = d.x * e2y - d.y * e2x;
+    const float det = e1x * Px + e1y * Py + e1z * Pz;
+    if(std::fabs(det) < triangleEpsilon)
+        return false;
+    const float invDet = 1.0f / det;
+
+    const float Tx = o.x - p.v0[0][lane];
+    const float Ty = o.y - p.v0[1][lane];
+    const float Tz = o.z - p.v0[2][lane];
+    const float u = invDet * (Tx * Px + Ty * Py + Tz * Pz);
+    if(u < 0.0f || u > 1.0f)
+        return false;
+
+    // Q = cross(T, e1)
+    const float Qx = Ty * e1z - Tz * e1y;
+    const float Qy = Tz * e1x - Tx * e1z;
+    const float Qz = Tx * e1y - Ty * e1x;
+    const float v = invDet * (d.x * Qx + d.y * Qy + d.z * Qz);
+    if(v < 0.0f || u + v > 1.0f)
+        return false;
+
+    t = invDet * (e2x * Qx + e2y * Qy + e2z * Qz);
+    return t >= minDistance && t <= maxDistance;
+}
+
+static bool findClosestTriangleScalar(const Ray & ray, const TrianglePacket packets[], uint32_t numPackets,
+                                      float minDistance, float & maxDistance, uint32_t & triangle)
+{
+    bool hit = false;
+    float t = 0.0f;
+    for(uint32_t pi = 0; pi < numPackets; ++pi) {
+        for(uint32_t lane = 0; lane < TrianglePacket::WIDTH; ++lane) {
+            if(intersectsLane(ray, packets[pi], lane, minDistance, maxDistance, t) && t < maxDistance) {
+                maxDistance = t;
+                triangle = packets[pi].triangle[lane];
+                hit = true;
+            }
+        }
+    }
+    return hit;
+}
+
+static bool intersectsAnyTriangleScalar(const Ray & ray, const TrianglePacket packets[], uint32_t numPackets,
+                                        float minDistance, float maxDistance)
+{
+    float t = 0.0f;
+    for(uint32_t pi = 0; pi < numPackets; ++pi) {
+        for(uint32_t lane = 0; lane < TrianglePacket::WIDTH; ++lane) {
+            if(intersectsLane(ray, packets[pi], lane, minDistance, maxDistance, t)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+#if defined(TRIANGLE_PACKET_X86)
+
+// Update the closest hit from the lanes set in a hit mask
+static inline bool closestLane(int mask, const float t[], const TrianglePacket & packet, uint32_t firstLane,
+                               float & maxDistance, uint32_t & triangle)
+{
+    bool hit = false;
+    while(mask) {
+        int lane = __builtin_ctz(mask);
+        mask &= mask - 1;
+        if(t[lane] < maxDistance) {
+            maxDistance = t[lane];
+            triangle = packet.triangle[firstLane + lane];
+            hit = true;
+        }
+    }
+    return hit;
+}
+
+// SSE kernel: 4 lanes at a time
+
+__attribute__((target("sse2")))
+static inline int packetHitsSSE(const __m128 o[3], const __m128 d[3], const TrianglePacket & p, uint32_t firstLane,
+                                const __m128 & tmin, const __m128 & tmax, __m128 & t)
+{
+    const __m128 e1x = _mm_load_ps(&p.e1[0][firstLane]);
+    const __m128 e1y = _mm_load_ps(&p.e1[1][firstLane]);
+    const __m128 e1z = _mm_load_ps(&p.e1[2][firstLane]);
+    const __m128 e2x = _mm_load_ps(&p.e2[0][firstLane]);
+    const __m128 e2y = _mm_load_ps(&p.e2[1][firstLane]);
+    const __m128 e2z = _mm_load_ps(&p.e2[2][firstLane]);
+
+    const __m128 Px = _mm_sub_ps(_mm_mul_ps(d[1], e2z), _mm_mul_ps(d[2], e2y));
+    const __m128 Py = _mm_sub_ps(_mm_mul_ps(d[2], e2x), _mm_mul_ps(d[0], e2z));
+    const __m128 Pz = _mm_sub_ps(_mm_mul_ps(d[0], e2y), _mm_mul_ps(d[1], e2x));
+    const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, Px), _mm_mul_ps(e1y, Py)), _mm_mul_ps(e1z, Pz));
+
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 mask = _mm_cmpnlt_ps(_mm_and_ps(det, absMask), _mm_set1_ps(triangleEpsilon));
+    const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    const __m128 Tx = _mm_sub_ps(o[0], _mm_load_ps(&p.v0[0][firstLane]));
+    const __m128 Ty = _mm_sub_ps(o[1], _mm_load_ps(&p.v0[1][firstLane]));
+    const __m128 Tz = _mm_sub_ps(o[2], _mm_load_ps(&p.v0[2][firstLane]));
+    const __m128 u = _mm_mul_ps(invDet, _mm_add_ps(_mm_add_ps(_mm_mul_ps(Tx, Px), _mm_mul_ps(Ty, Py)), _mm_mul_ps(Tz, Pz)));
+    mask = _mm_and_ps(mask, _mm_cmpnlt_ps(u, _mm_setzero_ps()));
+    mask = _mm_and_ps(mask, _mm_cmpngt_ps(u, _mm_set1_ps(1.0f)));
+
+    const __m128 Qx = _mm_sub_ps(_mm_mul_ps(Ty, e1z), _mm_mul_ps(Tz, e1y));
+    const __m128 Qy = _mm_sub_ps(_mm_mul_ps(Tz, e1x), _mm_mul_ps(Tx, e1z));
+    const __m128 Qz = _mm_sub_ps(_mm_mul_ps(Tx, e1y), _mm_mul_ps(Ty, e1x));
+    const __m128 v = _mm_mul_ps(invDet, _mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], Qx), _mm_mul_ps(d[1], Qy)), _mm_mul_ps(d[2], Qz)));
+    mask = _mm_and_ps(mask, _mm_cmpnlt_ps(v, _mm_setzero_ps()));
+    mask = _mm_and_ps(mask, _mm_cmpngt_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+
+    t = _mm_mul_ps(invDet, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, Qx), _mm_mul_ps(e2y, Qy)), _mm_mul_ps(e2z, Qz)));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(t, tmin));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(t, tmax));
+
+    return _mm_movemask_ps(mask);
+}
+
+__attribute__((target("sse2")))
+static bool findClosestTriangleSSE(const Ray & ray, const TrianglePacket packets[], uint32_t numPackets,
+                                   float minDistance, float & maxDistance, uint32_t & triangle)
+{
+    const __m128 o[3] = { _mm_set1_ps(ray.origin.x), _mm_set1_ps(ray.origin.y), _mm_set1_ps(ray.origin.z) };
+    const __m128 d[3] = { _mm_set1_ps(ray.direction.x), _mm_set1_ps(ray.direction.y), _mm_set1_ps(ray.direction.z) };
+    const __m128 tmin = _mm_set1_ps(minDistance);
+    alignas(16) float t[4];
+    bool hit = false;
+
+    for(uint32_t pi = 0; pi < numPackets; ++pi) {
+        for(uint32_t firstLane = 0; firstLane < TrianglePacket::WIDTH; firstLane += 4) {
+            const __m128 tmax = _mm_set1_ps(maxDistance);
+            __m128 tv;
+            int mask = packetHitsSSE(o, d, packets[pi], firstLane, tmin, tmax, tv);
+            if(mask) {
+                _mm_store_ps(t, tv);
+                hit |= closestLane(mask, t, packets[pi], firstLane, maxDistance, triangle);
+            }
+        }
+    }
+    return hit;
+}
+
+__attribute__((target("sse2")))
+static bool intersectsAnyTriangleSSE(const Ray & ray, const TrianglePacket packets[], uint32_t numPackets,
+                                     float minDistance, float maxDistance)
+{
+    const __m128 o[3] = { _mm_set1_ps(ray.origin.x), _mm_set1_ps(ray.origin.y), _mm_set1_ps(ray.origin.z) };
+    const __m128 d[3] = { _mm_set1_ps(ray.direction.x), _mm_set1_ps(ray.direction.y), _mm_set1_ps(ray.direction.z) };
+    const __m128 tmin = _mm_set1_ps(minDistance);
+    const __m128 tmax = _mm_set1_ps(maxDistance);
+
+    for(uint32_t pi = 0; pi < numPackets; ++pi) {
+        for(uint32_t firstLane = 0; firstLane < TrianglePacket::WIDTH; firstLane += 4) {
+            __m128 t;
+            if(packetHitsSSE(o, d, packets[pi], firstLane, tmin, tmax, t)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// AVX2 kernel: 8 lanes at a time
+
+__attribute__((target("avx2")))
+static inline int packetHitsAVX2(const __m256 o[3], const __m256 d[3], const TrianglePacket & p,
+                                 const __m256 & tmin, const __m256 & tmax, __m256 & t)
+{
+    const __m256 e1x = _mm256_load_ps(p.e1[0]);
+    const __m256 e1y = _mm256_load_ps(p.e1[1]);
+    const __m256 e1z = _mm256_load_ps(p.e1[2]);
+    const __m256 e2x = _mm256_load_ps(p.e2[0]);
+    const __m256 e2y = _mm256_load_ps(p.e2[1]);
+    const __m256 e2z = _mm256_load_ps(p.e2[2]);
+
+    const __m256 Px = _mm256_sub_ps(_mm256_mul_ps(d[1], e2z), _mm256_mul_ps(d[2], e2y));
+    const __m256 Py = _mm256_sub_ps(_mm256_mul_ps(d[2], e2x), _mm256_mul_ps(d[0], e2z));
+    const __m256 Pz = _mm256_sub_ps(_mm256_mul_ps(d[0], e2y), _mm256_mul_ps(d[1], e2x));
+    const __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, Px), _mm256_mul_ps(e1y, Py)), _mm256_mul_ps(e1z, Pz));
+
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 mask = _mm256_cmp_ps(_mm256_and_ps(det, absMask), _mm256_set1_ps(triangleEpsilon), _CMP_NLT_UQ);
+    const __m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+
+    const __m256 Tx = _mm256_sub_ps(o[0], _mm256_load_ps(p.v0[0]));
+    const __m256 Ty = _mm256_sub_ps(o[1], _mm256_load_ps(p.v0[1]));
+    const __m256 Tz = _mm256_sub_ps(o[2], _mm256_load_ps(p.v0[2]));
+    const __m256 u = _mm256_mul_ps(invDet, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(Tx, Px), _mm256_mul_ps(Ty, Py)), _mm256_mul_ps(Tz, Pz)));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, _mm256_setzero_ps(), _CMP_NLT_UQ));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, _mm256_set1_ps(1.0f), _CMP_NGT_UQ));
+
+    const __m256 Qx = _mm256_sub_ps(_mm256_mul_ps(Ty, e1z), _mm256_mul_ps(Tz, e1y));
+    const __m256 Qy = _mm256_sub_ps(_mm256_mul_ps(Tz, e1x), _mm256_mul_ps(Tx, e1z));
+    const __m256 Qz = _mm256_sub_ps(_mm256_mul_ps(Tx, e1y), _mm256_mul_ps(Ty, e1x));
+    const __m256 v = _mm256_mul_ps(invDet, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(d[0], Qx), _mm256_mul_ps(d[1], Qy)), _mm256_mul_ps(d[2], Qz)));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_NLT_UQ));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(u, v), _mm256_set1_ps(1.0f), _CMP_NGT_UQ));
+
+    t = _mm256_mul_ps(invDet, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, Qx), _mm256_mul_ps(e2y, Qy)), _mm256_mul_ps(e2z, Qz)));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, tmin, _CMP_GE_OQ));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, tmax, _CMP_LE_OQ));
+
+    return _mm256_movemask_ps(mask);
+}
+
+__attribute__((target("avx2")))
+static bool findClosestTriangleAVX2(const Ray & ray, const TrianglePacket packets[], uint32_t numPackets,
+                                    float minDistance, float & maxDistance, uint32_t & triangle)
+{
+    const __m256 o[3] = { _mm256_set1_ps(ray.origin.x), _mm256_set1_ps(ray.origin.y), _mm256_set1_ps(ray.origin.z) };
+    const __m256 d[3] = { _mm256_set1_ps(ray.direction.x), _mm256_set1_ps(ray.direction.y), _mm256_set1_ps(ray.direction.z) };
+    const __m256 tmin = _mm256_set1_ps(minDistance);
+    alignas(32) float t[8];
+    bool hit = false;
+
+    for(uint32_t pi = 0; pi < numPackets; ++pi) {
+        const __m256 tmax = _mm256_set1_ps(maxDistance);
+        __m256 tv;
+        int mask = packetHitsAVX2(o, d, packets[pi], tmin, tmax, tv);
+        if(mask) {
+            _mm256_store_ps(t, tv);
+            hit |= closestLane(mask, t, packets[pi], 0, maxDistance, triangle);
+        }
+    }
+    return hit;
+}
+
+__attribute__((target("avx2")))
+static bool intersectsAnyTriangleAVX2(const Ray & ray, const TrianglePacket packets[], uint32_t numPackets,
+                                      float minDistance, float maxDistance)
+{
+    const __m256 o[3] = { _mm256_set1_ps(ray.origin.x), _mm256_set1_ps(ray.origin.y), _mm256_set1_ps(ray.origin.z) };
+    const __m256 d[3] = { _mm256_set1_ps(ray.direction.x), _mm256_set1_ps(ray.direction.y), _mm256_set1_ps(ray.direction.z) };
+    const __m256 tmin = _mm256_set1_ps(minDistance);
+    const __m256 tmax = _mm256_set1_ps(maxDistance);
+
+    for(uint32_t pi = 0; pi < numPackets; ++pi) {
+        __m256 t;
+        if(packetHitsAVX2(o, d, packets[pi], tmin, tmax, t)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif // TRIANGLE_PACKET_X86
+
+// Dispatch
+
+bool triangleKernelSupported(TriangleKernel kernel)
+{
+    switch(kernel) {
+        case TriangleKernel::Scalar:
+            return true;
+#if defined(TRIANGLE_PACKET_X86)
+        case TriangleKernel::SSE:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2");
+        case TriangleKernel::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+TriangleKernel bestTriangleKernel()
+{
+    if(triangleKernelSupported(TriangleKernel::AVX2)) {
+        return TriangleKernel::AVX2;
+    }
+    if(triangleKernelSupported(TriangleKernel::SSE)) {
+        return TriangleKernel::SSE;
+    }
+    return TriangleKernel::Scalar;
+}
+
+// Selected on first use rather than during static initialization, so
+// kernels used from other translation units' static initializers are
+// already selected
+static TriangleKernel & activeTriangleKernel()
+{
+    static TriangleKernel kernel = bestTriangleKernel();
+    return kernel;
+}
+
+TriangleKernel triangleKernel()
+{
+    return activeTriangleKernel();
+}
+
+bool setTriangleKernel(TriangleKernel kernel)
+{
+    if(!triangleKernelSupported(kernel)) {
+        return false;
+    }
+    activeTriangleKernel() = kernel;
+    return true;
+}
+
+const char * triangleKernelString(TriangleKernel kernel)
+{
+    switch(kernel) {
+        case TriangleKernel::Scalar: return "scalar";
+        case TriangleKernel::SSE:    return "sse";
+        case TriangleKernel::AVX2:   return "avx2";
+    }
+    return "unknown";
+}
+
+bool findClosestTriangle(const Ray & ray,
+                         const TrianglePacket packets[], uint32_t numPackets,
+                         float minDistance, float & maxDistance,
+                         uint32_t & triangle)
+{
+    perf::count(perf::TriangleTests, uint64_t(numPackets) * TrianglePacket::WIDTH);
+
+    switch(activeTriangleKernel()) {
+#if defined(TRIANGLE_PACKET_X86)
+        case TriangleKernel::AVX2:
+            return findClosestTriangleAVX2(ray, packets, numPackets, minDistance, maxDistance, triangle);
+        case TriangleKernel::SSE:
+            return findClosestTriangleSSE(ray, packets, numPackets, minDistance, maxDistance, triangle);
+#endif
+        default:
+            return findClosestTriangleScalar(ray, packets, numPackets, minDistance, maxDistance, triangle);
+    }
+}
+
+bool intersectsAnyTriangle(const Ray & ray,
+                           const TrianglePacket packets[], uint32_t numPackets,
+                           float minDistance, float maxDistance)
+{
+    perf::count(perf::TriangleTests, uint64_t(numPackets) * TrianglePacket::WIDTH);
+
+    switch(activeTriangleKernel()) {
+#if defined(TRIANGLE_PACKET_X86)
+        case TriangleKernel::AVX2:
+            return intersectsAnyTriangleAVX2(ray, packets, numPackets, minDistance, maxDistance);
+        case TriangleKernel::SSE:
+            return intersectsAnyTriangleSSE(ray, packets, numPackets, minDistance, maxDistance);
+#endif
+        default:
+            return intersectsAnyTriangleScalar(ray, packets, numPackets, minDistance, maxDistance);
+    }
+}
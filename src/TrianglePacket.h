@@ -0,0 +1,79 @@
+#ifndef __TRIANGLE_PACKET_H__
+#define __TRIANGLE_PACKET_H__
+
+#include <vector>
+#include <cstdint>
+
+#include "alignedallocator.h"
+#include "vectortypes.h"
+
+struct Ray;
+struct TriangleMesh;
+
+// Group of up to WIDTH triangles stored as structure of arrays, with the
+// first vertex and both edges precomputed, so one ray can be tested against
+// all of them at once with SIMD instructions. Unused lanes hold degenerate
+// triangles that never report a hit.
+struct alignas(32) TrianglePacket
+{
+    static const uint32_t WIDTH = 8;
+
+    // [axis][lane]
+    float v0[3][WIDTH];
+    float e1[3][WIDTH];
+    float e2[3][WIDTH];
+
+    // Index of the triangle in each lane (eg: into its mesh)
+    uint32_t triangle[WIDTH];
+
+    void clear();
+    void set(uint32_t lane, const vec3 & v0, const vec3 & v1, const vec3 & v2, uint32_t triangle);
+
+    static inline uint32_t numPacketsFor(uint32_t numTriangles) { return (numTriangles + WIDTH - 1) / WIDTH; }
+};
+
+using TrianglePacketArray = std::vector<TrianglePacket, AlignedAllocator<TrianglePacket, 64>>;
+
+// Pack triangles of a mesh, in the order given, onto the end of an array
+// of packets. Returns the index of the first new packet.
+uint32_t appendTrianglePackets(TrianglePacketArray & packets, const TriangleMesh & mesh,
+                               const uint32_t triangles[], uint32_t numTriangles);
+
+// Pack triangles of a mesh, in the order given, into the numPacketsFor()
+// packets starting at `packets`. Used to fill disjoint ranges of one array
+// from several threads.
+void fillTrianglePackets(TrianglePacket packets[], const TriangleMesh & mesh,
+                         const uint32_t triangles[], uint32_t numTriangles);
+
+// Pack all triangles of a mesh in order
+void buildTrianglePackets(TrianglePacketArray & packets, const TriangleMesh & mesh);
+
+// Find the closest hit with distance in [minDistance, maxDistance). On a hit,
+// shrinks maxDistance to the hit distance and sets triangle to the index
+// stored in the hit lane.
+bool findClosestTriangle(const Ray & ray,
+                         const TrianglePacket packets[], uint32_t numPackets,
+                         float minDistance, float & maxDistance,
+                         uint32_t & triangle);
+
+// True if any triangle is hit with distance in [minDistance, maxDistance]
+bool intersectsAnyTriangle(const Ray & ray,
+                           const TrianglePacket packets[], uint32_t numPackets,
+                           float minDistance, float maxDistance);
+
+// Instruction set used by the packet kernels. The best one supported by the
+// CPU is selected the first time a kernel is used.
+enum class TriangleKernel {
+    Scalar,
+    SSE,    // 4 lanes at a time
+    AVX2    // 8 lanes at a time
+};
+
+TriangleKernel triangleKernel();
+TriangleKernel bestTriangleKernel();
+bool triangleKernelSupported(TriangleKernel kernel);
+// Returns false, leaving the kernel unchanged, if the CPU lacks support
+bool setTriangleKernel(TriangleKernel kernel);
+const char * triangleKernelString(TriangleKernel kernel);
+
+#endif
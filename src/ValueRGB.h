@@ -96,6 +96,13 @@ inline RadianceRGB operator*(const ParameterRGB & param,
 inline RadianceRGB operator*(const RadianceRGB & rad,
                              const ParameterRGB & param);
 
+inline ParameterRGB operator*(const ParameterRGB & a,
+                              const ParameterRGB & b);
+inline ParameterRGB operator*(const ParameterRGB & param,
+                              const ReflectanceRGB & ref);
+inline ParameterRGB operator*(const ParameterRGB & param, float s);
+inline ParameterRGB operator/(const ParameterRGB & param, float s);
+
 // Inline implementations
 
 inline RadianceRGB operator*(const ReflectanceRGB & ref,
@@ -113,4 +120,22 @@ inline RadianceRGB operator*(const RadianceRGB & rad,
     return operator*(param, rad);
 }
 
+inline ParameterRGB operator*(const ParameterRGB & a,
+                              const ParameterRGB & b) {
+    return { a.r * b.r, a.g * b.g, a.b * b.b };
+}
+
+inline ParameterRGB operator*(const ParameterRGB & param,
+                              const ReflectanceRGB & ref) {
+    return { param.r * ref.r, param.g * ref.g, param.b * ref.b };
+}
+
+inline ParameterRGB operator*(const ParameterRGB & param, float s) {
+    return { param.r * s, param.g * s, param.b * s };
+}
+
+inline ParameterRGB operator/(const ParameterRGB & param, float s) {
+    return { param.r / s, param.g / s, param.b / s };
+}
+
 #endif
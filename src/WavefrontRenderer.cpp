@@ -0,0 +1,440 @@
+#include <algorithm>
+#include <limits>
+
+#include "WavefrontRenderer.h"
+#include "material.h"
+#include "Logger.h"
+#include "Ray.h"
+#include "rng.h"
+#include "scene.h"
+#include "coordinate.h"
+#include "brdf.h"
+#include "PathStatistics.h"
+
+void WavefrontRenderer::CameraRayBatch::clear()
+{
+    rays.clear();
+    pixelSamples.clear();
+    radiance.clear();
+    intersections.clear();
+    hit.clear();
+}
+
+void WavefrontRenderer::traceCameraRays(const Scene & scene, Sampler & sampler,
+                                        const float minDistance, const unsigned int depth,
+                                        const MediumStack & mediumStack,
+                                        CameraRayBatch & batch,
+                                        PathStatistics * statistics) const
+{
+    const size_t numRays = batch.rays.size();
+    assert(batch.pixelSamples.empty() || batch.pixelSamples.size() == numRays);
+
+    batch.radiance.assign(numRays, RadianceRGB::BLACK());
+    batch.intersections.assign(numRays, RayIntersection());
+    batch.hit.assign(numRays, 0);
+
+    const size_t batchSize = std::max(maxBatchSize, 1u);
+    Queues queues;
+
+    for(size_t first = 0; first < numRays; first += batchSize) {
+        const size_t last = std::min(first + batchSize, numRays);
+
+        queues.paths.clear();
+        queues.paths.reserve(last - first);
+
+        for(size_t index = first; index < last; ++index) {
+            PixelSample pixelSample;
+            if(batch.pixelSamples.empty()) {
+                pixelSample.index = uint32_t(index);
+            }
+            else {
+                pixelSample = batch.pixelSamples[index];
+            }
+            sampler.startPixelSample(pixelSample);
+            sampler.startBounce(depth);
+
+            PathState path;
+            path.ray = batch.rays[index];
+            path.minDistance = minDistance;
+            path.depth = depth;
+            path.mediumStack = mediumStack;
+            path.cameraRay = uint32_t(index);
+            path.primary = true;
+            path.samplerState = sampler.state();
+            queues.paths.push_back(path);
+            perf::count(perf::CameraRays);
+        }
+
+        traceBatch(scene, sampler, queues, batch, statistics);
+    }
+}
+
+void WavefrontRenderer::traceBatch(const Scene & scene, Sampler & sampler,
+                                   Queues & queues,
+                                   CameraRayBatch & batch,
+                                   PathStatistics * statistics) const
+{
+    auto recordPathEnd = [&](const PathState & path) {
+        if(statistics) {
+            statistics->recordPathEnd(path.depth);
+        }
+    };
+
+    while(!queues.paths.empty()) {
+        queues.nextPaths.clear();
+        queues.hits.clear();
+        queues.shadowRays.clear();
+
+        // Intersect all paths of this bounce
+        for(uint32_t index = 0; index < queues.paths.size(); ++index) {
+            PathState & path = queues.paths[index];
+
+            if(path.depth > maxDepth) {
+                recordPathEnd(path);
+                continue;
+            }
+
+            sampler.setState(path.samplerState);
+
+            if(!survivesRussianRoulette(sampler, path, statistics)) {
+                recordPathEnd(path);
+                continue;
+            }
+
+            PathHit hit;
+            hit.path = index;
+            RayIntersection & intersection = hit.intersection;
+
+            if(!findIntersectionWorldRay(path.ray, scene, path.minDistance, intersection)) {
+                assert(scene.environmentMap);
+                batch.radiance[path.cameraRay] += path.throughput
+                    * environmentMapWeight(scene, path.lightSampling, path.ray.direction)
+                    * scene.environmentMap->sampleRay(path.ray);
+                recordPathEnd(path);
+                continue;
+            }
+
+            assert(intersection.distance >= path.minDistance);
+
+            intersection.texcoordFootprint = textureFootprint(intersection);
+            const float footprint = intersection.texcoordFootprint;
+
+            const Material & material = materialFromID(intersection.material, scene.materials);
+            auto A = material.alpha(scene.textureCache.textures, intersection.texcoord, footprint);
+
+            material.applyNormalMap(scene.textureCache.textures, intersection.texcoord,
+                                    intersection.normal, intersection.tangent, intersection.bitangent,
+                                    footprint);
+
+            // Transparency: continue the same ray just past the intersection
+            if(A < 1.0f && sampler.get1D() > A) {
+                PathState next = path;
+                next.minDistance = applyRayDistanceEpsilon(intersection.distance);
+                next.samplerState = sampler.state();
+                queues.nextPaths.push_back(next);
+                continue;
+            }
+
+            if(path.primary) {
+                batch.intersections[path.cameraRay] = intersection;
+                batch.hit[path.cameraRay] = 1;
+            }
+
+            // Shading picks up the sample dimensions where we left off
+            path.samplerState = sampler.state();
+            queues.hits.push_back(hit);
+        }
+
+        // Group hits by material so shading touches one material at a time
+        if(sortByMaterial) {
+            std::stable_sort(queues.hits.begin(), queues.hits.end(),
+                             [](const PathHit & a, const PathHit & b) {
+                                 return a.intersection.material < b.intersection.material;
+                             });
+        }
+
+        for(auto & hit : queues.hits) {
+            const PathState & path = queues.paths[hit.path];
+            const size_t numNextPaths = queues.nextPaths.size();
+            shadeHit(scene, sampler, path, hit.intersection, queues, batch);
+            // Paths end where they are not continued
+            if(queues.nextPaths.size() == numNextPaths) {
+                recordPathEnd(path);
+            }
+        }
+
+        // Direct lighting
+        for(const auto & shadowRay : queues.shadowRays) {
+            perf::count(shadowRay.type);
+            sampler.setState(shadowRay.samplerState);
+            if(!intersectsScene(scene, sampler, shadowRay.ray, shadowRay.minDistance, shadowRay.maxDistance)) {
+                batch.radiance[shadowRay.cameraRay] += shadowRay.L;
+            }
+        }
+
+        std::swap(queues.paths, queues.nextPaths);
+    }
+}
+
+void WavefrontRenderer::shadeHit(const Scene & scene, Sampler & sampler,
+                                 const PathState & path, RayIntersection & intersection,
+                                 Queues & queues, CameraRayBatch & batch) const
+{
+    const Material & material = materialFromID(intersection.material, scene.materials);
+    const Direction3 Wo = -path.ray.direction;
+
+    sampler.setState(path.samplerState);
+    perf::count(perf::ShadingCalls);
+
+    // Notational convenience
+    const auto P = intersection.position;
+    auto N = intersection.normal;
+    const float footprint = intersection.texcoordFootprint;
+
+    if(dot(Wo, N) < 0.0f) {
+        N.negate();
+    }
+
+    // Emission (not attenuated by the medium, as in Renderer::traceRay)
+    const auto E = material.emission(scene.textureCache.textures, intersection.texcoord, footprint);
+    if(E.hasNonZeroComponent()) {
+        batch.radiance[path.cameraRay] += path.throughput * emissionWeight(scene, path.lightSampling, intersection) * E;
+    }
+
+    // Apply Beer's Law attenuation to everything reflected or transmitted here
+    ParameterRGB att = path.mediumStack.back().beersLawAttenuation;
+    ParameterRGB weight = path.throughput * optics::beersLawAttenuation(att, intersection.distance);
+
+    if(material.isRefractive) {
+        shadeRefractiveInterface(scene, sampler, path, weight, material.innerMedium, Wo, P, N, queues);
+        return;
+    }
+
+    const auto D = material.diffuse(scene.textureCache.textures, intersection.texcoord, footprint);
+    const auto S = material.specular(scene.textureCache.textures, intersection.texcoord, footprint);
+
+    ReflectanceRGB F = { 0.0f, 0.0f, 0.0f };
+
+    // Randomly choose between specular and diffuse
+    float probSpec = material.hasSpecular() ? ((S.r + S.g + S.b) / 3.0f) : 0.0f;
+    float probDiffuse = 1.0f - probSpec;
+    bool doSpec = sampler.get1D() < probSpec;
+    bool doDiffuse = !doSpec && material.hasDiffuse();
+
+    if(material.hasSpecular()) {
+        ReflectanceRGB F0 = S;
+        F = fresnel::schlick(F0, absDot(Wo, N));
+    }
+
+    if(doSpec) {
+        const ParameterRGB specWeight = weight * F / probSpec;
+
+        if(material.isGlossy(scene.textureCache.textures, intersection.texcoord, footprint)) {
+            float specularExponent = material.specularExponent(scene.textureCache.textures, intersection.texcoord, footprint);
+            PhongBRDF brdf(specularExponent);
+            brdf.importanceSample = shadeSpecularParams.samplePhongLobe;
+            shadeBRDF(scene, sampler, path, specWeight, Wo, P, N, brdf,
+                      shadeSpecularParams.sampleLights,
+                      shadeSpecularParams.numEnvMapSamples,
+                      queues);
+        }
+        else {
+            MirrorBRDF brdf;
+            shadeBRDF(scene, sampler, path, specWeight, Wo, P, N, brdf, false, 0, queues);
+        }
+    }
+
+    if(doDiffuse) {
+        const ParameterRGB diffuseWeight = weight * F.residual() * D / probDiffuse;
+
+        LambertianBRDF brdf;
+        brdf.importanceSample = shadeDiffuseParams.sampleCosineLobe;
+        shadeBRDF(scene, sampler, path, diffuseWeight, Wo, P, N, brdf,
+                  shadeDiffuseParams.sampleLights,
+                  shadeDiffuseParams.numEnvMapSamples,
+                  queues);
+    }
+}
+
+void WavefrontRenderer::shadeRefractiveInterface(const Scene & scene, Sampler & sampler,
+                                                 const PathState & path, const ParameterRGB & weight,
+                                                 const Medium & medium,
+                                                 const Direction3 & Wo,
+                                                 const Position3 & P, const Direction3 & N,
+                                                 Queues & queues) const
+{
+    float n1, n2;
+
+    const auto & mediumStack = path.mediumStack;
+    bool leaving = mediumStack.size() % 2 == 0;
+
+    if(leaving) {
+        n1 = medium.indexOfRefraction;
+        n2 = mediumStack[mediumStack.size() - 2].indexOfRefraction;
+    }
+    else {
+        n1 = mediumStack.back().indexOfRefraction;
+        n2 = medium.indexOfRefraction;
+    }
+
+    Direction3 d = refract(Wo, N, n1, n2);
+
+    auto reflect = [&](const ParameterRGB & reflectWeight) {
+        MirrorBRDF brdf;
+        shadeBRDF(scene, sampler, path, reflectWeight, Wo, P, N, brdf, false, 0, queues);
+    };
+
+    auto transmit = [&](const ParameterRGB & transmitWeight) {
+        PathState next;
+        next.ray = Ray(P - N * epsilon, d);
+        next.minDistance = epsilon;
+        next.depth = path.depth + 1;
+        next.mediumStack = path.mediumStack;
+        if(leaving) {
+            next.mediumStack.pop_back();
+        }
+        else {
+            next.mediumStack.push_back(medium);
+        }
+        next.throughput = transmitWeight;
+        next.cameraRay = path.cameraRay;
+        next.primary = false;
+        next.samplerState = sampler.splitState(next.depth);
+        queues.nextPaths.push_back(next);
+        perf::count(perf::BounceRays);
+    };
+
+    bool totalInternalReflection = d.isZeros();
+
+    if(totalInternalReflection) {
+        reflect(weight);
+        return;
+    }
+
+    float F = fresnel::dialectric::unpolarized(dot(Wo, N), dot(d, -N), n1, n2);
+
+    if(monteCarloRefraction) {
+        // Randomly choose a reflected or refracted ray using Fresnel as the
+        // weighting factor
+        if(F == 1.0f || sampler.get1D() < F) {
+            reflect(weight);
+        }
+        else {
+            transmit(weight);
+        }
+    }
+    else {
+        reflect(weight * F);
+        transmit(weight * (1.0f - F));
+    }
+}
+
+void WavefrontRenderer::shadeBRDF(const Scene & scene, Sampler & sampler,
+                                  const PathState & path, const ParameterRGB & weight,
+                                  const Direction3 & Wo,
+                                  const Position3 & P, const Direction3 & N,
+                                  const BRDF & brdf,
+                                  bool sampleLights,
+                                  unsigned int numEnvMapSamples,
+                                  Queues & queues) const
+{
+    // Note: Light found by the continuation ray from sources we sample
+    //       directly here is weighted against the direct samples, to avoid
+    //       double counting.
+
+    const bool sampleEnvMap =
+        numEnvMapSamples > 0
+        && scene.environmentMap->canImportanceSample();
+
+    if(sampleLights) {
+        const unsigned int numSamples = numDirectLightSamples(scene);
+        for(unsigned int sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex) {
+            DirectLightSample S = sampleDirectLight(scene, sampler, brdf, Wo, P, N, sampleIndex);
+            queueShadowRay(Ray{P, S.direction}, epsilon, S.distance - epsilon,
+                           weight * S.Lo, path.cameraRay, perf::ShadowRays, sampler.state(), queues);
+        }
+    }
+
+    if(sampleEnvMap) {
+        // Importance sample environment map. Occluded samples are not
+        // redrawn, as doing so biases the estimate.
+        for(unsigned int envSample = 0; envSample < numEnvMapSamples; ++envSample) {
+            vec2 e = sampler.get2D();
+            RandomDirection dirSample = scene.environmentMap->importanceSampleDirection(e.x, e.y);
+            float DdotN = dot(dirSample.direction, N);
+
+            if(dirSample.pdf > 0.0f && DdotN > 0.0f) {
+                Ray ray{ P + N * epsilon, dirSample.direction };
+                float F = brdf.eval(Wo, dirSample.direction, N);
+                RadianceRGB Li = scene.environmentMap->sampleRay(ray);
+                float w = powerHeuristic(float(numEnvMapSamples), dirSample.pdf,
+                                         1.0f, brdf.pdf(Wo, dirSample.direction, N));
+                RadianceRGB L = w * F * DdotN * Li / dirSample.pdf / float(numEnvMapSamples);
+
+                queueShadowRay(ray, path.minDistance, std::numeric_limits<float>::max(),
+                               weight * L, path.cameraRay, perf::EnvMapRays, sampler.state(), queues);
+            }
+        }
+    }
+
+    // Continuation ray
+    brdfSample S = brdf.sample(sampler.get2D(), Wo, N);
+
+    float F = brdf.eval(Wo, S.W, N);
+    float D = S.isDelta() ? 1.0f : clampedDot(S.W, N);
+
+    const ParameterRGB nextThroughput = weight * (F * D / S.pdf);
+
+    if(!(S.pdf > 0.0f) || !nextThroughput.hasNonZeroComponent()) {
+        return;
+    }
+
+    PathState next;
+    next.ray = Ray(P + N * epsilon, S.W);
+    next.minDistance = epsilon;
+    next.depth = path.depth + 1;
+    next.mediumStack = path.mediumStack;
+    next.throughput = nextThroughput;
+    next.cameraRay = path.cameraRay;
+    next.lightSampling.brdfPdf = S.pdf;
+    next.lightSampling.lights = sampleLights && !S.isDelta();
+    next.lightSampling.numEnvMapSamples = sampleEnvMap && !S.isDelta() ? numEnvMapSamples : 0;
+    next.primary = false;
+    next.samplerState = sampler.splitState(next.depth);
+    queues.nextPaths.push_back(next);
+    perf::count(perf::BounceRays);
+}
+
+void WavefrontRenderer::queueShadowRay(const Ray & ray, float minDistance, float maxDistance,
+                                       const RadianceRGB & L, uint32_t cameraRay,
+                                       perf::Counter type,
+                                       const Sampler::State & samplerState,
+                                       Queues & queues) const
+{
+    if(!L.hasNonZeroComponent()) {
+        return;
+    }
+
+    queues.shadowRays.push_back({ ray, minDistance, maxDistance, L, cameraRay, type, samplerState });
+}
+
+void WavefrontRenderer::printConfiguration() const
+{
+    auto onoff = [](bool v) { return v ? "ON" : "OFF"; };
+
+    Renderer::printConfiguration();
+    printf("  Wavefront:\n"
+           "    Max batch size = %u\n"
+           "    Sort by material = %s\n",
+           maxBatchSize, onoff(sortByMaterial));
+}
+
+void WavefrontRenderer::logConfiguration(Logger & logger) const
+{
+    auto onoff = [](bool v) { return v ? "ON" : "OFF"; };
+
+    Renderer::logConfiguration(logger);
+    logger.normalf("  Wavefront:");
+    logger.normalf("    Max batch size = %u", maxBatchSize);
+    logger.normalf("    Sort by material = %s", onoff(sortByMaterial));
+}
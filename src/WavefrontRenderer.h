@@ -0,0 +1,131 @@
+#ifndef __WAVEFRONT_RENDERER_H__
+#define __WAVEFRONT_RENDERER_H__
+
+#include <vector>
+#include <cstdint>
+
+#include "Renderer.h"
+#include "Ray.h"
+#include "Sampler.h"
+#include "PerfCounters.h"
+
+// Breadth-first (wavefront) path tracer. Instead of following one path at a
+// time to its end, all paths of a batch advance together one bounce at a
+// time:
+//
+//   1. intersect every active path ray
+//   2. sort the hits by material
+//   3. shade, queueing shadow rays for direct lighting and continuation rays
+//   4. trace the shadow rays as one batch
+//   5. repeat with the continuation rays
+//
+// It uses the same configuration and produces the same estimate as the
+// depth-first Renderer, but with far better memory coherence on large scenes.
+class WavefrontRenderer : public Renderer
+{
+    public:
+        WavefrontRenderer() = default;
+        // Use the configuration of a recursive renderer
+        explicit WavefrontRenderer(const Renderer & renderer) : Renderer(renderer) {}
+
+        // Camera rays in, radiance and first hits out. Outputs are indexed
+        // like the input rays.
+        struct CameraRayBatch {
+            std::vector<Ray> rays;
+            // Pixel sample of each ray, used to seed the sampler. If empty,
+            // ray i is sample i of pixel (0, 0).
+            std::vector<PixelSample> pixelSamples;
+
+            std::vector<RadianceRGB> radiance;
+            std::vector<RayIntersection> intersections;
+            std::vector<uint8_t> hit;
+
+            void clear();
+        };
+
+        // Trace all rays in the batch starting at the given depth
+        void traceCameraRays(const Scene & scene, Sampler & sampler,
+                             const float minDistance, const unsigned int depth,
+                             const MediumStack & mediumStack,
+                             CameraRayBatch & batch,
+                             PathStatistics * statistics = nullptr) const;
+
+        void printConfiguration() const;
+        void logConfiguration(Logger & logger) const;
+
+        // Camera rays are traced in groups of at most this many paths
+        unsigned int maxBatchSize = 4096;
+
+        // Sort hits by material before shading
+        bool sortByMaterial = true;
+
+    protected:
+        // State of one path between bounces, and where its light goes
+        struct PathState : public Renderer::PathState {
+            // Index of the camera ray the path contributes to
+            uint32_t cameraRay;
+
+            // Still looking for the camera ray's first hit
+            bool primary;
+        };
+
+        // Direct lighting that contributes if the ray is unoccluded
+        struct ShadowRay {
+            Ray ray;
+            float minDistance;
+            float maxDistance;
+            RadianceRGB L;
+            uint32_t cameraRay;
+            // Light or environment map sample
+            perf::Counter type;
+            // Sample dimensions of the path that queued it, where Renderer
+            // would test the ray, for transparent surfaces along it
+            Sampler::State samplerState;
+        };
+
+        struct PathHit {
+            uint32_t path;
+            RayIntersection intersection;
+        };
+
+        // Per batch queues, reused from bounce to bounce
+        struct Queues {
+            std::vector<PathState> paths;
+            std::vector<PathState> nextPaths;
+            std::vector<PathHit> hits;
+            std::vector<ShadowRay> shadowRays;
+        };
+
+        void traceBatch(const Scene & scene, Sampler & sampler,
+                        Queues & queues,
+                        CameraRayBatch & batch,
+                        PathStatistics * statistics) const;
+
+        void shadeHit(const Scene & scene, Sampler & sampler,
+                      const PathState & path, RayIntersection & intersection,
+                      Queues & queues, CameraRayBatch & batch) const;
+
+        void shadeRefractiveInterface(const Scene & scene, Sampler & sampler,
+                                      const PathState & path, const ParameterRGB & weight,
+                                      const Medium & medium,
+                                      const Direction3 & Wo,
+                                      const Position3 & P, const Direction3 & N,
+                                      Queues & queues) const;
+
+        void shadeBRDF(const Scene & scene, Sampler & sampler,
+                       const PathState & path, const ParameterRGB & weight,
+                       const Direction3 & Wo,
+                       const Position3 & P, const Direction3 & N,
+                       const BRDF & brdf,
+                       bool sampleLights,
+                       unsigned int numEnvMapSamples,
+                       Queues & queues) const;
+
+        void queueShadowRay(const Ray & ray, float minDistance, float maxDistance,
+                            const RadianceRGB & L, uint32_t cameraRay,
+                            perf::Counter type,
+                            const Sampler::State & samplerState,
+                            Queues & queues) const;
+};
+
+#endif
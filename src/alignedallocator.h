@@ -0,0 +1,43 @@
+#ifndef __ALIGNED_ALLOCATOR_H__
+#define __ALIGNED_ALLOCATOR_H__
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Minimal STL allocator that returns memory aligned to a fixed boundary.
+// C++14 std::allocator does not honor over-aligned types, so containers
+// of cache-line aligned structures need this to guarantee their alignment.
+template<typename T, size_t Alignment>
+struct AlignedAllocator
+{
+    static_assert(Alignment >= alignof(T), "Alignment must satisfy the type's own alignment");
+    static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two");
+
+    using value_type = T;
+
+    template<typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+    T * allocate(size_t n)
+    {
+        void * ptr = nullptr;
+        if(posix_memalign(&ptr, Alignment, n * sizeof(T)) != 0) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(ptr);
+    }
+
+    void deallocate(T * ptr, size_t) { free(ptr); }
+};
+
+template<typename T, typename U, size_t Alignment>
+inline bool operator==(const AlignedAllocator<T, Alignment> &, const AlignedAllocator<U, Alignment> &) { return true; }
+template<typename T, typename U, size_t Alignment>
+inline bool operator!=(const AlignedAllocator<T, Alignment> &, const AlignedAllocator<U, Alignment> &) { return false; }
+
+#endif
@@ -1,7 +1,11 @@
+#include <fstream>
+#include <cstdio>
+
 #include "artifacts.h"
 #include "timer.h"
 #include "tonemapping.h"
 #include "textoverlay.h"
+#include "ThreadPool.h"
 
 Artifacts::Artifacts()
     : Artifacts(256, 256)
@@ -46,24 +50,49 @@ Artifacts::Artifacts(int w, int h)
     samplesPerPixel.setAll(0u);
 }
 
+void Artifacts::mergeTile(const FilmTile & film)
+{
+    std::lock_guard<std::mutex> lock(mergeMutex);
+    const auto & tile = film.tile;
+    for(int y = tile.ymin; y < int(tile.ymax); ++y) {
+        for(int x = tile.xmin; x < int(tile.xmax); ++x) {
+            const auto & samples = film.pixel(x, y);
+            mergePixel(x, y, samples);
+            accumTime(x, y, samples.time);
+        }
+    }
+    invalidSamples += film.invalidSamples;
+}
+
+Artifacts Artifacts::snapshot()
+{
+    std::lock_guard<std::mutex> lock(mergeMutex);
+    return *this;
+}
+
 void Artifacts::writeAll()
 {
     printf("Flushing artifacts\n");
     auto artifactWriteTimer = WallClockTimer::makeRunningTimer();
-    writePNG(hitMask, prefix + "hit_mask.png");
-    writePNG(isectDist, prefix + "isect_distance.png");
-    writePNG(isectNormal, prefix + "isect_normal.png");
-    writePNG(isectTangent, prefix + "isect_tangent.png");
-    writePNG(isectBitangent, prefix + "isect_bitangent.png");
-    writePNG(isectTexCoord, prefix + "isect_texcoord.png");
-    //writePNG(isectPos, prefix + "isect_position.png");
+
+    // Each image is converted and encoded independently, so the writes
+    // are spread across the thread pool
+    std::vector<std::function<void()>> writes;
+
+    writes.push_back([&]() { writePNG(hitMask, prefix + "hit_mask.png"); });
+    writes.push_back([&]() { writePNG(isectDist, prefix + "isect_distance.png"); });
+    writes.push_back([&]() { writePNG(isectNormal, prefix + "isect_normal.png"); });
+    writes.push_back([&]() { writePNG(isectTangent, prefix + "isect_tangent.png"); });
+    writes.push_back([&]() { writePNG(isectBitangent, prefix + "isect_bitangent.png"); });
+    writes.push_back([&]() { writePNG(isectTexCoord, prefix + "isect_texcoord.png"); });
+    //writes.push_back([&]() { writePNG(isectPos, prefix + "isect_position.png"); });
     if(doBasicLighting) {
-        writePNG(applyStandardGamma(isectBasicLighting), prefix + "isect_basic_lighting.png");
+        writes.push_back([&]() { writePNG(applyStandardGamma(isectBasicLighting), prefix + "isect_basic_lighting.png"); });
     }
-    writePNG(isectMatDiffuse, prefix + "isect_mat_diffuse.png");
-    writePNG(isectMatSpecular, prefix + "isect_mat_specular.png");
+    writes.push_back([&]() { writePNG(isectMatDiffuse, prefix + "isect_mat_diffuse.png"); });
+    writes.push_back([&]() { writePNG(isectMatSpecular, prefix + "isect_mat_specular.png"); });
     if(hasAO) {
-        writePNG(applyStandardGamma(isectAO), prefix + "ao.png");
+        writes.push_back([&]() { writePNG(applyStandardGamma(isectAO), prefix + "ao.png"); });
     }
 
 #if 0
@@ -76,20 +105,27 @@ void Artifacts::writeAll()
 #endif
     //writePNG(scaledTime, prefix + "isect_time.png");
     //writeHDR(scaledTime, prefix + "isect_time.hdr");
-    writeHDR(isectTime, prefix + "isect_time.hdr");
-
-    auto stddev = runningVarianceS;
-    auto makeStdDev = [&](Image<float> & image, size_t x, size_t y, int c) {
-        auto Np = samplesPerPixel.get(x, y, 0);
-        if(Np > 1) {
-            float var = image.get(x, y, c) / float(Np - 1);
-            image.set(x, y, c, std::sqrt(var));
-        }
-    };
-    stddev.forEachPixelChannel(makeStdDev);
-    writePNG(stddev, prefix + "isect_stddev.png");
+    writes.push_back([&]() { writeHDR(isectTime, prefix + "isect_time.hdr"); });
+
+    writes.push_back([&]() {
+        auto stddev = runningVarianceS;
+        auto makeStdDev = [&](Image<float> & image, size_t x, size_t y, int c) {
+            auto Np = samplesPerPixel.get(x, y, 0);
+            if(Np > 1) {
+                float var = image.get(x, y, c) / float(Np - 1);
+                image.set(x, y, c, std::sqrt(var));
+            }
+        };
+        stddev.forEachPixelChannel(makeStdDev);
+        writePNG(stddev, prefix + "isect_stddev.png");
+    });
+
+    writes.push_back([&]() { writeSamplesPerPixel(); });
+
+    writes.push_back([&]() { writePixelColor(); });
+
+    getThreadPool().parallelFor(writes.size(), [&](size_t wi, ThreadIndex) { writes[wi](); });
 
-    writePixelColor();
     auto artifactWriteTime = artifactWriteTimer.elapsed();
     printf("Artifacts written in %f sec\n", artifactWriteTime);
 }
@@ -128,3 +164,188 @@ void Artifacts::writePixelColor()
     writePNG(toneMappedImage, prefix + "color_tone_mapped.png");
 }
 
+
+void Artifacts::writeSamplesPerPixel()
+{
+    // Raw counts in the HDR, scaled so the most sampled pixel is white in the PNG
+    Image<float> spp(w, h, 1);
+    uint32_t maxSamples = std::max(samplesPerPixel.maxValueAllChannels(), 1u);
+    auto copySamples = [&](Image<float> & image, size_t x, size_t y, int c) {
+        image.set(x, y, c, float(samplesPerPixel.get(x, y, c)));
+    };
+    spp.forEachPixelChannel(copySamples);
+    writeHDR(spp, prefix + "samples_per_pixel.hdr");
+
+    auto scaleToMax = [&](Image<float> & image, size_t x, size_t y, int c) {
+        image.set(x, y, c, image.get(x, y, c) / float(maxSamples));
+    };
+    spp.forEachPixelChannel(scaleToMax);
+    writePNG(spp, prefix + "samples_per_pixel.png");
+}
+
+float Artifacts::relativeError(int x, int y) const
+{
+    // Keeps dark pixels from needing an unbounded number of samples
+    const float minMean = 0.01f;
+
+    auto Np = samplesPerPixel.get(x, y, 0);
+    if(Np < 2) {
+        return std::numeric_limits<float>::infinity();
+    }
+
+    float stdErr = 0.0f, mean = 0.0f;
+    for(int c = 0; c < 3; ++c) {
+        float var = runningVarianceS.get(x, y, c) / float(Np - 1);
+        stdErr += std::sqrt(var / float(Np));
+        mean += runningVarianceM.get(x, y, c);
+    }
+
+    return stdErr / std::max(mean, minMean);
+}
+
+float Artifacts::relativeError(int xmin, int ymin, int xmax, int ymax) const
+{
+    float sum = 0.0f;
+    for(int y = ymin; y < ymax; ++y) {
+        for(int x = xmin; x < xmax; ++x) {
+            sum += relativeError(x, y);
+        }
+    }
+    return sum / float((xmax - xmin) * (ymax - ymin));
+}
+
+static const char CHECKPOINT_MAGIC[8] = { 'F', 'L', 'U', 'X', 'C', 'K', 'P', 'T' };
+static const uint32_t CHECKPOINT_VERSION = 2;
+
+template<typename T>
+static void writeValue(std::ofstream & out, const T & value)
+{
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+static void readValue(std::ifstream & in, T & value)
+{
+    in.read(reinterpret_cast<char *>(&value), sizeof(T));
+}
+
+template<typename T>
+static void writeImageData(std::ofstream & out, const Image<T> & image)
+{
+    writeValue(out, uint32_t(image.numChannels));
+    out.write(reinterpret_cast<const char *>(image.data.data()), image.data.size() * sizeof(T));
+}
+
+template<typename T>
+static void readImageData(std::ifstream & in, Image<T> & image)
+{
+    uint32_t numChannels = 0;
+    readValue(in, numChannels);
+    if(numChannels != uint32_t(image.numChannels)) {
+        throw std::runtime_error("Checkpoint image has wrong number of channels");
+    }
+    in.read(reinterpret_cast<char *>(image.data.data()), image.data.size() * sizeof(T));
+}
+
+void Artifacts::writeCheckpoint(const std::string & filename, uint64_t sceneHash) const
+{
+    const std::string tempFilename = filename + ".tmp";
+    {
+        std::ofstream out(tempFilename, std::ios::binary | std::ios::trunc);
+        if(!out) {
+            throw std::runtime_error("Error opening checkpoint file " + tempFilename);
+        }
+
+        out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        writeValue(out, CHECKPOINT_VERSION);
+        writeValue(out, sceneHash);
+        writeValue(out, int32_t(w));
+        writeValue(out, int32_t(h));
+        writeValue(out, uint8_t(hasAO));
+        writeValue(out, invalidSamples.nan);
+        writeValue(out, invalidSamples.inf);
+        writeValue(out, invalidSamples.negative);
+
+        writeImageData(out, hitMask);
+        writeImageData(out, isectDist);
+        writeImageData(out, isectNormal);
+        writeImageData(out, isectTangent);
+        writeImageData(out, isectBitangent);
+        writeImageData(out, isectTexCoord);
+        writeImageData(out, isectBasicLighting);
+        writeImageData(out, isectMatDiffuse);
+        writeImageData(out, isectMatSpecular);
+        writeImageData(out, isectAO);
+        writeImageData(out, isectTime);
+        writeImageData(out, pixelColor);
+        writeImageData(out, samplesPerPixel);
+        writeImageData(out, runningVarianceM);
+        writeImageData(out, runningVarianceS);
+
+        if(!out.flush()) {
+            throw std::runtime_error("Error writing checkpoint file " + tempFilename);
+        }
+    }
+
+    if(std::rename(tempFilename.c_str(), filename.c_str()) != 0) {
+        throw std::runtime_error("Error renaming checkpoint file to " + filename);
+    }
+}
+
+void Artifacts::readCheckpoint(const std::string & filename, uint64_t sceneHash)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if(!in) {
+        throw std::runtime_error("Error opening checkpoint file " + filename);
+    }
+
+    char magic[sizeof(CHECKPOINT_MAGIC)] = {};
+    uint32_t version = 0;
+    uint64_t fileSceneHash = 0;
+    int32_t fileWidth = 0, fileHeight = 0;
+    uint8_t fileHasAO = 0;
+
+    in.read(magic, sizeof(magic));
+    readValue(in, version);
+    if(!in || !std::equal(magic, magic + sizeof(magic), CHECKPOINT_MAGIC)) {
+        throw std::runtime_error(filename + " is not a checkpoint file");
+    }
+    if(version != CHECKPOINT_VERSION) {
+        throw std::runtime_error("Unsupported checkpoint version " + std::to_string(version));
+    }
+    readValue(in, fileSceneHash);
+    if(fileSceneHash != sceneHash) {
+        throw std::runtime_error("Checkpoint was written for a different scene or settings");
+    }
+    readValue(in, fileWidth);
+    readValue(in, fileHeight);
+    if(fileWidth != w || fileHeight != h) {
+        throw std::runtime_error("Checkpoint image size " + std::to_string(fileWidth) + " x " + std::to_string(fileHeight)
+                                 + " does not match " + std::to_string(w) + " x " + std::to_string(h));
+    }
+    readValue(in, fileHasAO);
+    readValue(in, invalidSamples.nan);
+    readValue(in, invalidSamples.inf);
+    readValue(in, invalidSamples.negative);
+
+    readImageData(in, hitMask);
+    readImageData(in, isectDist);
+    readImageData(in, isectNormal);
+    readImageData(in, isectTangent);
+    readImageData(in, isectBitangent);
+    readImageData(in, isectTexCoord);
+    readImageData(in, isectBasicLighting);
+    readImageData(in, isectMatDiffuse);
+    readImageData(in, isectMatSpecular);
+    readImageData(in, isectAO);
+    readImageData(in, isectTime);
+    readImageData(in, pixelColor);
+    readImageData(in, samplesPerPixel);
+    readImageData(in, runningVarianceM);
+    readImageData(in, runningVarianceS);
+
+    if(!in) {
+        throw std::runtime_error("Checkpoint file " + filename + " is truncated");
+    }
+    hasAO = hasAO || fileHasAO;
+}
@@ -1,6 +1,7 @@
 #ifndef __ARTIFACTS_H__
 #define __ARTIFACTS_H__
 
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -8,6 +9,7 @@
 #include "image.h"
 #include "constants.h"
 #include "brdf.h"
+#include "FilmTile.h"
 
 class Artifacts
 {
@@ -17,64 +19,49 @@ class Artifacts
 
         void writeAll();
         void writePixelColor();
+        void writeSamplesPerPixel();
+
+        // Binary snapshot of every buffer, including the sample counts. The
+        // sampler values of a pixel sample depend only on its index, so the
+        // count of each pixel is also its sampler stream position and a
+        // render resumes by tracing the samples after it. sceneHash
+        // identifies the scene and settings the samples were traced with.
+        // Written to a temporary file first, so a crash while writing never
+        // leaves a truncated checkpoint.
+        void writeCheckpoint(const std::string & filename, uint64_t sceneHash) const;
+        // Throws std::runtime_error if the file can't be read, is for a
+        // different image size or has a different scene hash
+        void readCheckpoint(const std::string & filename, uint64_t sceneHash);
 
         // Lines of text to overlay onto the final color output images
         // (e.g. date/time, commit hash). Empty by default.
         std::vector<std::string> annotation;
 
+        // Accumulate a single sample directly. Not thread safe; threads
+        // accumulate into a FilmTile each and merge it instead.
         inline void accumPixelRadiance(int x, int y, const RadianceRGB & rad)
         {
-            ColorRGB color = { rad.r, rad.g, rad.b };
-            accumPixelColor(x, y, color);
+            accumPixelColor(x, y, ColorRGB(rad.r, rad.g, rad.b));
         }
-        inline void accumPixelColor(int x, int y, const ColorRGB & color, bool clampInvalid = true)
+        inline void accumPixelColor(int x, int y, ColorRGB color)
         {
-            bool isValid = true;
-
-            if(clampInvalid) {
-                if(std::isinf(color.r) || std::isinf(color.g) || std::isinf(color.b)) {
-                    std::cerr << "WARNING: Pixel " << x << ", " << y << " color has Inf value : " << color.string() << '\n';
-                    isValid = false;
-                }
-                else if(std::isnan(color.r) || std::isnan(color.g) || std::isnan(color.b)) {
-                    std::cerr << "WARNING: Pixel " << x << ", " << y << " color has NaN value : " << color.string() << '\n';
-                    isValid = false;
-                }
-                else if(color.r < 0.0f || color.g < 0.0f || color.b < 0.0f) {
-                    std::cerr << "WARNING: Pixel " << x << ", " << y << " color has Negative value : " << color.string() << '\n';
-                    isValid = false;
-                }
-            }
+            validateSample(color, invalidSamples);
+            FilmTile::Pixel sample;
+            sample.sum = sample.mean = vec3(color.r, color.g, color.b);
+            sample.numSamples = 1;
+            mergePixel(x, y, sample);
+        }
 
-            if(isValid) {
-                pixelColor.accum(x, y, color);
-                // Update running variance
-                auto Np = samplesPerPixel.get(x, y, 0) + 1;
-                vec3 Mn, Sn;
-                if(Np <= 1) {
-                    Mn = { color.r, color.g, color.b };
-                    Sn = { 0.0f, 0.0f, 0.0f };
-                }
-                else {
-                    // Compute running variance using Welford method
-                    //   https://www.johndcook.com/blog/standard_deviation/
-                    vec3 Mp = { runningVarianceM.get(x, y, 0), runningVarianceM.get(x, y, 1), runningVarianceM.get(x, y, 2) };
-                    vec3 Sp = { runningVarianceS.get(x, y, 0), runningVarianceS.get(x, y, 1), runningVarianceS.get(x, y, 2) };
-                    vec3 Dp = { color.r - Mp.x, color.g - Mp.y, color.b - Mp.z };
-                    Mn = Mp + Dp / float(Np);
-                    vec3 Dn = { color.r - Mn.x, color.g - Mn.y, color.b - Mn.z };
-                    Sn = Sp + vec3{ Dp.x * Dn.x, Dp.y * Dn.y, Dp.z * Dn.z };
-                }
-
-                runningVarianceM.set3(x, y, Mn.x, Mn.y, Mn.z);
-                runningVarianceS.set3(x, y, Sn.x, Sn.y, Sn.z);
-            }
-            else {
-                pixelColor.accum(x, y, ::ColorRGB::BLACK());
-            }
+        // Add the samples of a tile. Safe to call from multiple threads, even
+        // for overlapping tiles.
+        void mergeTile(const FilmTile & film);
 
-            samplesPerPixel.accum(x, y, 0, 1);
-        }
+        // Copy of every buffer, taken between tile merges so no tile is half
+        // merged into it. Safe to call while other threads merge tiles.
+        Artifacts snapshot();
+
+        // Samples replaced with black so far
+        InvalidSampleCounts invalidSamples;
 
         inline void setIntersection(int x, int y, float minDistance, const Scene & scene, const RayIntersection & intersection)
         {
@@ -140,11 +127,42 @@ class Artifacts
             isectBasicLighting.set3(x, y, r, g, b);
         }
 
+        inline uint32_t numSamples(int x, int y) const { return samplesPerPixel.get(x, y, 0); }
+
+        // Standard error of the mean color of a pixel, relative to the mean
+        // and summed over channels. Infinite until the pixel has two samples.
+        float relativeError(int x, int y) const;
+        // Mean relative error of the pixels in [xmin, xmax) x [ymin, ymax)
+        float relativeError(int xmin, int ymin, int xmax, int ymax) const;
+
         inline void setAmbientOcclusion(int x, int y, float ao) { setAmbientOcclusionColor(isectAO, x, y, ao); }
         inline void setTime(int x, int y, float tm) { setTimeColor(isectTime, x, y, tm); }
         inline void accumTime(int x, int y, float tm) { accumTimeColor(isectTime, x, y, tm); }
 
     protected:
+        // Combine the samples of a pixel with the ones already accumulated
+        // (Chan et al., "Updating Formulae and a Pairwise Algorithm for
+        // Computing Sample Variances", 1979)
+        inline void mergePixel(int x, int y, const FilmTile::Pixel & samples)
+        {
+            if(samples.numSamples == 0) {
+                return;
+            }
+            const float Na = float(samplesPerPixel.get(x, y, 0));
+            const float Nb = float(samples.numSamples);
+            const float N = Na + Nb;
+            vec3 Ma = { runningVarianceM.get(x, y, 0), runningVarianceM.get(x, y, 1), runningVarianceM.get(x, y, 2) };
+            vec3 Sa = { runningVarianceS.get(x, y, 0), runningVarianceS.get(x, y, 1), runningVarianceS.get(x, y, 2) };
+            vec3 D = samples.mean - Ma;
+            vec3 M = Ma + D * (Nb / N);
+            vec3 S = Sa + samples.sumSquaredDiff + vec3{ D.x * D.x, D.y * D.y, D.z * D.z } * (Na * Nb / N);
+
+            pixelColor.accum3(x, y, samples.sum.x, samples.sum.y, samples.sum.z);
+            runningVarianceM.set3(x, y, M.x, M.y, M.z);
+            runningVarianceS.set3(x, y, S.x, S.y, S.z);
+            samplesPerPixel.accum(x, y, 0, samples.numSamples);
+        }
+
         inline void setDistColor(Image<float> & isectDist, int x, int y, float minDistance, float distance)
         {
             if(distance >= std::numeric_limits<float>::max())
@@ -251,6 +269,14 @@ class Artifacts
         bool hasAO = false;
         bool doBasicLighting = false;
 
+        // Copies as a new mutex, so Artifacts can be copied
+        struct CopyableMutex : public std::mutex {
+            CopyableMutex() = default;
+            CopyableMutex(const CopyableMutex &) {}
+            CopyableMutex & operator=(const CopyableMutex &) { return *this; }
+        };
+        CopyableMutex mergeMutex;
+
     protected:
         int w = 0, h = 0;
         std::string prefix = "trace_";
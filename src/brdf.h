@@ -39,20 +39,21 @@ class BRDF {
         // Evaluate the BRDF
         virtual InverseSteradians eval(const Direction3 & Wi, const Direction3 & Wo, const Direction3 & N) const = 0;
 
-        // Evaluate PDF for a direction
-        virtual float pdf(const Direction3 & Wi, const Direction3 & Wo, const Direction3 & N) = 0;
+        // Evaluate the solid angle PDF of sample() choosing Wo. Zero for
+        // BRDFs that only reflect in discrete directions.
+        virtual float pdf(const Direction3 & Wi, const Direction3 & Wo, const Direction3 & N) const = 0;
 
         // Sample Wo from the BRDF, given Wi and random numbers
-        virtual brdfSample sample(const vec2 & e, const Direction3 & Wi, const Direction3 & N) = 0;
+        virtual brdfSample sample(const vec2 & e, const Direction3 & Wi, const Direction3 & N) const = 0;
 
         // Uniform sampling across the hemisphere
-        float pdfHemisphereUniform() {
-            return 1.0f / constants::TWO_PI;
+        float pdfHemisphereUniform(const Direction3 & Wo, const Direction3 & N) const {
+            return dot(Wo, N) > 0.0f ? 1.0f / constants::TWO_PI : 0.0f;
         }
-        brdfSample sampleHemisphereUniform(const vec2 & e, const Direction3 & N) {
+        brdfSample sampleHemisphereUniform(const vec2 & e, const Direction3 & N) const {
             brdfSample S;
             S.W = Direction3(RNG::uniformSurfaceUnitHalfSphere(e, N));
-            S.pdf = pdfHemisphereUniform();
+            S.pdf = 1.0f / constants::TWO_PI;
             return S;
         }
 
@@ -68,14 +69,14 @@ class LambertianBRDF : public BRDF {
             return lambertian(Wi, Wo, N);
         }
 
-        virtual float pdf(const Direction3 & Wi, const Direction3 & Wo, const Direction3 & N) override {
+        virtual float pdf(const Direction3 & Wi, const Direction3 & Wo, const Direction3 & N) const override {
             if(!importanceSample) {
-                return pdfHemisphereUniform();
+                return pdfHemisphereUniform(Wo, N);
             }
             return clampedDot(Wo, N) / constants::PI;
         }
 
-        virtual brdfSample sample(const vec2 & e, const Direction3 & Wi, const Direction3 & N) override {
+        virtual brdfSample sample(const vec2 & e, const Direction3 & Wi, const Direction3 & N) const override {
             if(!importanceSample) {
                 return sampleHemisphereUniform(e, N);
             }
@@ -97,14 +98,15 @@ class PhongBRDF : public BRDF {
             return phong(Wi, Wo, N, a);
         }
 
-        virtual float pdf(const Direction3 & Wi, const Direction3 & Wo, const Direction3 & N) override {
+        virtual float pdf(const Direction3 & Wi, const Direction3 & Wo, const Direction3 & N) const override {
             if(!importanceSample) {
-                return pdfHemisphereUniform();
+                return pdfHemisphereUniform(Wo, N);
             }
+            // The lobe about the mirror direction is sampled exactly
             return phong(Wi, Wo, N, a);
         }
 
-        virtual brdfSample sample(const vec2 & e, const Direction3 & Wi, const Direction3 & N) override {
+        virtual brdfSample sample(const vec2 & e, const Direction3 & Wi, const Direction3 & N) const override {
             if(!importanceSample) {
                 return sampleHemisphereUniform(e, N);
             }
@@ -123,14 +125,16 @@ class MirrorBRDF : public BRDF {
             return 1.0f;
         }
 
-        virtual float pdf(const Direction3 & Wi, const Direction3 & Wo, const Direction3 & N) override {
-            return 1.0f;
+        // Any given direction has zero probability of being the mirror direction
+        virtual float pdf(const Direction3 & Wi, const Direction3 & Wo, const Direction3 & N) const override {
+            return 0.0f;
         }
 
-        virtual brdfSample sample(const vec2 & e, const Direction3 & Wi, const Direction3 & N) override {
+        // The pdf of the delta sample is 1, cancelling the delta in the BRDF
+        virtual brdfSample sample(const vec2 & e, const Direction3 & Wi, const Direction3 & N) const override {
             brdfSample S;
             S.W = mirror(Wi, N);
-            S.pdf = pdf(Wi, S.W, N);
+            S.pdf = 1.0f;
             S.delta = true;
             return S;
         }
@@ -0,0 +1,88 @@
+#ifndef __HALF_H__
+#define __HALF_H__
+
+#include <cstdint>
+#include <cstring>
+
+// IEEE 754 half precision (binary16) conversion. Used for compact storage
+// of high dynamic range textures.
+
+inline float halfToFloat(uint16_t h)
+{
+    const uint32_t sign = uint32_t(h & 0x8000u) << 16;
+    uint32_t exponent = (h >> 10) & 0x1fu;
+    uint32_t mantissa = h & 0x3ffu;
+    uint32_t bits;
+
+    if(exponent == 0x1fu) {
+        // Infinity or NaN
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    }
+    else if(exponent != 0) {
+        // Normal
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if(mantissa != 0) {
+        // Subnormal. Normalize the mantissa.
+        exponent = 113;
+        while(!(mantissa & 0x400u)) {
+            mantissa <<= 1;
+            --exponent;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+    }
+    else {
+        // Zero
+        bits = sign;
+    }
+
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Rounds to nearest even. Values too large for a half become infinity.
+inline uint16_t floatToHalf(float f)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+
+    const uint16_t sign = uint16_t((bits >> 16) & 0x8000u);
+    const uint32_t absBits = bits & 0x7fffffffu;
+
+    if(absBits >= 0x7f800000u) {
+        // Infinity or NaN
+        return sign | 0x7c00u | (absBits > 0x7f800000u ? 0x200u : 0u);
+    }
+    if(absBits >= 0x477ff000u) {
+        // Rounds past the largest half
+        return sign | 0x7c00u;
+    }
+    if(absBits < 0x38800000u) {
+        // Subnormal half, or zero
+        if(absBits < 0x33000000u) {
+            return sign;
+        }
+        const uint32_t exponent = absBits >> 23;
+        const uint32_t mantissa = (absBits & 0x7fffffu) | 0x800000u;
+        const uint32_t shift = 126 - exponent;
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if(remainder > halfway || (remainder == halfway && (half & 1u))) {
+            ++half;
+        }
+        return sign | uint16_t(half);
+    }
+
+    // Normal. Rebias the exponent and round the mantissa, letting a
+    // mantissa overflow carry into the exponent.
+    uint32_t half = ((absBits >> 13) - (112u << 10));
+    const uint32_t remainder = absBits & 0x1fffu;
+    if(remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+        ++half;
+    }
+    return sign | uint16_t(half);
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+static const uint64_t FNV1A64_BASIS = 0xcbf29ce484222325ULL;
+static const uint64_t FNV1A64_PRIME = 0x100000001b3ULL;
+
+// 64-bit FNV-1a. Pass the result of a previous call as the basis to hash
+// data in pieces.
+inline uint64_t fnv1a64(const void * data, size_t size, uint64_t hash = FNV1A64_BASIS)
+{
+    auto bytes = static_cast<const uint8_t *>(data);
+    for(size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * FNV1A64_PRIME;
+    }
+    return hash;
+}
+
+inline uint64_t fnv1a64(const std::string & s, uint64_t hash = FNV1A64_BASIS)
+{
+    return fnv1a64(s.data(), s.size(), hash);
+}
+
+#endif
@@ -154,4 +154,5 @@ T Image<T>::maxValueAllChannels() const
 }
 
 template float Image<float>::maxValueAllChannels() const;
+template uint32_t Image<uint32_t>::maxValueAllChannels() const;
 
@@ -1,7 +1,9 @@
 #ifndef __MATERIAL_H__
 #define __MATERIAL_H__
 
+#include <cassert>
 #include <cstdint>
+#include <initializer_list>
 #include <limits>
 #include <memory>
 
@@ -20,7 +22,38 @@ struct Medium {
 
 const Medium VaccuumMedium = { 1.0f, { 0.0f, 0.0f, 0.0f } };
 
-using MediumStack = std::vector<Medium>;
+// Media a ray is inside, innermost last. The media are held inline, so
+// paths can copy and update their stack without allocating. Refraction only
+// ever enters one medium past the outermost, so the capacity is generous.
+class MediumStack
+{
+    public:
+        static const unsigned int CAPACITY = 8;
+
+        MediumStack() = default;
+        MediumStack(std::initializer_list<Medium> list) {
+            for(const auto & medium : list) {
+                push_back(medium);
+            }
+        }
+
+        // Past capacity, the innermost medium is replaced
+        void push_back(const Medium & medium) {
+            assert(count < CAPACITY);
+            media[count < CAPACITY ? count++ : CAPACITY - 1] = medium;
+        }
+        void pop_back() { assert(count > 0); --count; }
+
+        const Medium & back() const { assert(count > 0); return media[count - 1]; }
+        const Medium & operator[](size_t index) const { assert(index < count); return media[index]; }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+    protected:
+        Medium media[CAPACITY];
+        unsigned int count = 0;
+};
 
 using MaterialID = uint32_t;
 
@@ -40,8 +73,9 @@ struct Material
     MaterialParameterScalar alphaParam = { 1.0f };
     float opacity = 1.0f;
 
-    // Emission
+    // Emission, scaled per texel by the emission texture if present
     RadianceRGB emissionColor = { 0.0f, 0.0f, 0.0f };
+    TextureID emissionTexture = NoTexture;
 
     // Normal Map
     TextureID normalMapTexture = NoTexture;
@@ -50,24 +84,25 @@ struct Material
     Medium innerMedium;
     bool isRefractive = false;
 
-    inline ReflectanceRGB diffuse(const TextureArray & tex, const TextureCoordinate & texcoord) const;
-    inline ReflectanceRGB specular(const TextureArray & tex, const TextureCoordinate & texcoord) const;
-    inline float specularExponent(const TextureArray & tex, const TextureCoordinate & texcoord) const;
-    inline RadianceRGB emission(const TextureArray & tex, const TextureCoordinate & texcoord) const;
-    inline Direction3 normalMap(const TextureArray & tex, const TextureCoordinate & texcoord) const;
-    inline float alpha(const TextureArray & tex, const TextureCoordinate & texcoord) const;
+    inline ReflectanceRGB diffuse(const TextureArray & tex, const TextureCoordinate & texcoord, float footprint = 0.0f) const;
+    inline ReflectanceRGB specular(const TextureArray & tex, const TextureCoordinate & texcoord, float footprint = 0.0f) const;
+    inline float specularExponent(const TextureArray & tex, const TextureCoordinate & texcoord, float footprint = 0.0f) const;
+    inline RadianceRGB emission(const TextureArray & tex, const TextureCoordinate & texcoord, float footprint = 0.0f) const;
+    inline Direction3 normalMap(const TextureArray & tex, const TextureCoordinate & texcoord, float footprint = 0.0f) const;
+    inline float alpha(const TextureArray & tex, const TextureCoordinate & texcoord, float footprint = 0.0f) const;
 
     inline bool hasDiffuse() const;
     inline bool hasSpecular() const;
     inline bool hasEmission() const;
     inline bool hasNormalMap() const;
 
-    inline bool isGlossy(const TextureArray & tex, const TextureCoordinate & texcoord) const
-        { return specularExponent(tex, texcoord) > 0.01f; }
+    inline bool isGlossy(const TextureArray & tex, const TextureCoordinate & texcoord, float footprint = 0.0f) const
+        { return specularExponent(tex, texcoord, footprint) > 0.01f; }
 
     // Apply normal map (if any) to the supplied basis vectors
     inline void applyNormalMap(const TextureArray & tex, const TextureCoordinate & texcoord,
-                               Direction3 & normal, Direction3 & tangent, Direction3 & bitangent) const;
+                               Direction3 & normal, Direction3 & tangent, Direction3 & bitangent,
+                               float footprint = 0.0f) const;
 
     void print() const;
 
@@ -90,9 +125,9 @@ inline const Material & materialFromID(MaterialID id, const MaterialArray & mate
 
 // Inline implementations
 
-inline ReflectanceRGB Material::diffuse(const TextureArray & tex, const TextureCoordinate & texcoord) const
+inline ReflectanceRGB Material::diffuse(const TextureArray & tex, const TextureCoordinate & texcoord, float footprint) const
 {
-    return diffuseParam.get(tex, texcoord);
+    return diffuseParam.get(tex, texcoord, footprint);
 }
 
 inline bool Material::hasDiffuse() const
@@ -100,9 +135,9 @@ inline bool Material::hasDiffuse() const
     return diffuseParam.isNonZero();
 }
 
-inline ReflectanceRGB Material::specular(const TextureArray & tex, const TextureCoordinate & texcoord) const
+inline ReflectanceRGB Material::specular(const TextureArray & tex, const TextureCoordinate & texcoord, float footprint) const
 {
-    return specularParam.get(tex, texcoord);
+    return specularParam.get(tex, texcoord, footprint);
 }
 
 inline bool Material::hasSpecular() const
@@ -110,25 +145,28 @@ inline bool Material::hasSpecular() const
     return specularParam.isNonZero();
 }
 
-inline float Material::specularExponent(const TextureArray & tex, const TextureCoordinate & texcoord) const
+inline float Material::specularExponent(const TextureArray & tex, const TextureCoordinate & texcoord, float footprint) const
 {
-    return specularExponentParam.get(tex, texcoord);
+    return specularExponentParam.get(tex, texcoord, footprint);
 }
 
-inline float Material::alpha(const TextureArray & tex, const TextureCoordinate & texcoord) const
+inline float Material::alpha(const TextureArray & tex, const TextureCoordinate & texcoord, float footprint) const
 {
-    return opacity * alphaParam.get(tex, texcoord);
+    return opacity * alphaParam.get(tex, texcoord, footprint);
 }
 
-inline RadianceRGB Material::emission(const TextureArray & tex, const TextureCoordinate & texcoord) const
+inline RadianceRGB Material::emission(const TextureArray & tex, const TextureCoordinate & texcoord, float footprint) const
 {
-    // TODO - emissive texture
+    if(emissionTexture != NoTexture) {
+        auto & texture = tex[emissionTexture];
+        auto T = texture->lerpUV3(texcoord.u, texcoord.v, footprint);
+        return { emissionColor.r * T.r, emissionColor.g * T.g, emissionColor.b * T.b };
+    }
     return emissionColor;
 }
 
 inline bool Material::hasEmission() const
 {
-    // TODO - emissive texture
     return emissionColor.hasNonZeroComponent();
 }
 
@@ -137,15 +175,13 @@ inline bool Material::hasNormalMap() const
     return normalMapTexture != NoTexture;
 }
 
-inline Direction3 Material::normalMap(const TextureArray & tex, const TextureCoordinate & texcoord) const
+inline Direction3 Material::normalMap(const TextureArray & tex, const TextureCoordinate & texcoord, float footprint) const
 {
     if(normalMapTexture != NoTexture) {
         auto & texture = tex[normalMapTexture];
-        float u = texcoord.u;
-        float v = texcoord.v;
-        return Direction3{ texture->lerpUV(u, v, 0),
-                           texture->lerpUV(u, v, 1),
-                           texture->lerpUV(u, v, 2) };
+        float values[MipTexture::MAX_CHANNELS];
+        texture->lookupUV(texcoord.u, texcoord.v, footprint, values);
+        return Direction3{ values[0], values[1], values[2] };
     }
     else {
         return Direction3{ 0.0f, 0.0f, 1.0f };
@@ -153,13 +189,14 @@ inline Direction3 Material::normalMap(const TextureArray & tex, const TextureCoo
 }
 
 inline void Material::applyNormalMap(const TextureArray & tex, const TextureCoordinate & texcoord,
-                                     Direction3 & normal, Direction3 & tangent, Direction3 & bitangent) const
+                                     Direction3 & normal, Direction3 & tangent, Direction3 & bitangent,
+                                     float footprint) const
 {
     if(!hasNormalMap()) {
         return;
     }
 
-    auto map = normalMap(tex, texcoord);
+    auto map = normalMap(tex, texcoord, footprint);
 
     // Compute new basis by perturbing via the normal map
     auto N = (normal * map.z + tangent * map.x + bitangent * map.y).normalized();
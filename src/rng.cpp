@@ -1,9 +1,29 @@
 #include "rng.h"
 
+constexpr uint64_t RNG::DEFAULT_SEED;
+constexpr uint64_t RNG::DEFAULT_STREAM;
+
 RNG::RNG()
-  : engine(device()),
-    distribution(0.0f, 1.0f),
-    normalDistribution(0.0f, 1.0f)
 {
+    seed(DEFAULT_SEED, DEFAULT_STREAM);
 }
 
+RNG::RNG(uint64_t seed, uint64_t stream)
+{
+    this->seed(seed, stream);
+}
+
+void RNG::seed(uint64_t seed, uint64_t stream)
+{
+    state = 0;
+    increment = (stream << 1u) | 1u;
+    next32();
+    state += seed;
+    next32();
+}
+
+RNG RNG::forPixelSample(uint32_t x, uint32_t y, uint32_t sampleIndex, uint64_t seed)
+{
+    const uint64_t pixel = (uint64_t(y) << 32) | uint64_t(x);
+    return RNG(mix64(seed ^ mix64(pixel)), mix64(pixel + mix64(sampleIndex)));
+}
@@ -3,24 +3,46 @@
 
 // Random Number Generation
 
-#include <random>
+#include <cstdint>
 #include "base.h"
 #include "vectortypes.h"
 #include "vec2.h"
 
+// PCG32 generator (O'Neill, "PCG: A Family of Simple Fast Space-Efficient
+// Statistically Good Algorithms for Random Number Generation"). The whole
+// state is 16 bytes, so generators are cheap to create per pixel sample.
+// Each stream (odd increment) is an independent sequence.
 struct RNG
 {
+    static constexpr uint64_t DEFAULT_SEED   = 0x853c49e6748fea9bULL;
+    static constexpr uint64_t DEFAULT_STREAM = 0xda3e39cb94b95bdbULL;
+
     RNG();
+    RNG(uint64_t seed, uint64_t stream = DEFAULT_STREAM);
     ~RNG() = default;
 
+    void seed(uint64_t seed, uint64_t stream = DEFAULT_STREAM);
+
+    // Generator for one sample of one pixel. The result depends only on the
+    // arguments, not on which thread traces the sample or in what order, so
+    // renders are reproducible for any number of threads. Sample dimensions
+    // are drawn in order from the stream.
+    static RNG forPixelSample(uint32_t x, uint32_t y, uint32_t sampleIndex, uint64_t seed = 0);
+
+    // Raw 32 bit output
+    inline uint32_t next32();
+
     // TODO: Clean this up to separate picking random numbers and mapping them
     //       to different domains
 
     static inline vec2 uniformCircle(const vec2 & e, float radius);
     static inline vec2 uniformUnitCircle(const vec2 & e);
+    // Barycentric coordinates of a point uniformly distributed over a triangle
+    static inline vec3 uniformTriangle(const vec2 & e);
     static inline vec3 cosineAboutDirection(const vec2 & e, const Direction3 & n);
     static inline vec3 uniformSurfaceUnitSphere(const vec2 & e);
     static inline vec3 uniformSurfaceUnitHalfSphere(const vec2 & e, const Direction3 & halfSpace);
+    static inline vec2 gaussian2D(const vec2 & e, float stddev);
 
     // 1D
 	inline float uniform01();
@@ -54,13 +76,13 @@ struct RNG
     inline vec3 gaussian3D(float mean, float stddev);
     inline vec3 gaussian3D(float stddev);
 
-    std::random_device device;
-    std::mt19937 engine;
-    //std::minstd_rand0 engine;
-    //std::default_random_engine engine;
-    std::uniform_real_distribution<float> distribution;
-    std::normal_distribution<float> normalDistribution;
+    uint64_t state = 0;
+    uint64_t increment = 0;
 };
 
+// SplitMix64 finalizer. Spreads nearby inputs (eg: neighboring pixels) to
+// unrelated seeds and streams.
+inline uint64_t mix64(uint64_t v);
+
 #include "rng.hpp"
 #endif
@@ -2,9 +2,26 @@
 #include "constants.h"
 #include "coordinate.h"
 
+inline uint64_t mix64(uint64_t v)
+{
+    v = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    v = (v ^ (v >> 27)) * 0x94d049bb133111ebULL;
+    return v ^ (v >> 31);
+}
+
+inline uint32_t RNG::next32()
+{
+    uint64_t oldState = state;
+    state = oldState * 6364136223846793005ULL + increment;
+    uint32_t xorShifted = uint32_t(((oldState >> 18u) ^ oldState) >> 27u);
+    uint32_t rotate = uint32_t(oldState >> 59u);
+    return (xorShifted >> rotate) | (xorShifted << ((-rotate) & 31u));
+}
+
 inline float RNG::uniform01()
 {
-    return distribution(engine);
+    // Top 24 bits, so the result is exactly representable and in [0, 1)
+    return float(next32() >> 8) * (1.0f / 16777216.0f);
 }
 
 inline float RNG::uniformRange(float min, float max)
@@ -14,12 +31,17 @@ inline float RNG::uniformRange(float min, float max)
 
 inline float RNG::gaussian(float mean, float stddev)
 {
-    return mean + normalDistribution(engine) * stddev;
+    return mean + gaussian(stddev);
 }
 
 inline float RNG::gaussian(float stddev)
 {
-    return normalDistribution(engine) * stddev;
+    using namespace constants;
+
+    // Box-Muller transform. 1 - u keeps the log argument in (0, 1].
+    float u1 = 1.0f - uniform01();
+    float u2 = uniform01();
+    return std::sqrt(-2.0f * std::log(u1)) * std::cos(2.0f * float(PI) * u2) * stddev;
 }
 
 inline vec2 RNG::uniformCircle(const vec2 & e, float radius)
@@ -40,6 +62,15 @@ inline vec2 RNG::uniformUnitCircle(const vec2 & e)
     return uniformCircle(e, 1.0f);
 }
 
+inline vec3 RNG::uniformTriangle(const vec2 & e)
+{
+    float s = std::sqrt(e.x);
+    float b1 = 1.0f - s;
+    float b2 = e.y * s;
+
+    return vec3 { 1.0f - b1 - b2, b1, b2 };
+}
+
 inline void RNG::uniformUnitCircle(float & x, float & y)
 {
     uniformCircle(1.0f, x, y);
@@ -113,6 +144,20 @@ inline vec2 RNG::uniform2DRange01Stratified(int xbins, int ybins, int index)
     };
 }
 
+inline vec2 RNG::gaussian2D(const vec2 & e, float stddev)
+{
+    using namespace constants;
+
+    // Box-Muller transform
+    float r = std::sqrt(-2.0f * std::log(1.0f - e.x)) * stddev;
+    float theta = 2.0f * float(PI) * e.y;
+
+    return vec2 {
+        r * std::cos(theta),
+        r * std::sin(theta)
+    };
+}
+
 inline vec2 RNG::gaussian2D(float mean, float stddev)
 {
     return { gaussian(mean, stddev), gaussian(mean, stddev) };
@@ -8,6 +8,7 @@
 #include "constants.h"
 #include "transform.h"
 #include "timer.h"
+#include "ThreadPool.h"
 #include "GradientEnvironmentMap.h"
 #include "LatLonEnvironmentMap.h"
 #include "CubeMapEnvironmentMap.h"
@@ -125,8 +126,14 @@ MaterialID loadMaterial(const std::shared_ptr<cpptoml::table> & materialTable, S
     }
     else if(*type == "emissive") {
         auto rgb = materialTable->get_array_of<double>("emissive");
-        auto emissive = vectorToRadianceRGB(*rgb);
+        auto tex = materialTable->get_as<std::string>("emissive_texture");
+        if(!rgb && !tex) { throw std::runtime_error("Emissive material must supply an emissive color or texture"); }
+        // The color scales the texture, if both are given
+        auto emissive = rgb ? vectorToRadianceRGB(*rgb) : RadianceRGB{ 1.0f, 1.0f, 1.0f };
         material = Material::makeEmissive(emissive);
+        if(tex) {
+            material.emissionTexture = scene.textureCache.loadTextureFromFile(texturePath, *tex);
+        }
     }
     else {
         throw std::runtime_error(std::string("Unknown material type : ") + *type);
@@ -134,12 +141,7 @@ MaterialID loadMaterial(const std::shared_ptr<cpptoml::table> & materialTable, S
 
     auto normalMapTex = materialTable->get_as<std::string>("normalmap");
     if(normalMapTex) {
-        material.normalMapTexture = scene.textureCache.loadTextureFromFile("", *normalMapTex);
-        auto & texture = scene.textureCache.textures[material.normalMapTexture];
-        // Convert normal map color to normal [0, 1] -> [-1, 1]
-        texture->forEachPixelChannel([](Texture & image, size_t x, size_t y, int c) {
-                                         image.set(x, y, c, image.get(x, y, c) * 2.0f - 1.0f);
-                                     });
+        material.normalMapTexture = scene.textureCache.loadNormalMapFromFile("", *normalMapTex);
     }
 
     MaterialID id = scene.materials.size();
@@ -205,6 +207,60 @@ void loadTransformsForObject(const std::shared_ptr<cpptoml::table> & table, OBJ
     }
 }
 
+// Mesh file loading on the thread pool. The file's materials go in a list of
+// their own, which is added to the scene's when the mesh is first used.
+struct MeshFileLoad
+{
+    std::shared_ptr<TriangleMesh> mesh = std::make_shared<TriangleMesh>();
+    MaterialArray materials;
+    std::future<void> loaded;
+    bool added = false;
+};
+
+// Loads started on the thread pool by one scene file. The tasks refer to the
+// scene, so they are waited for if loading stops early with an exception.
+struct SceneLoadTasks
+{
+    ~SceneLoadTasks() {
+        for(auto & meshFile : meshFiles) {
+            if(meshFile.second.loaded.valid()) {
+                meshFile.second.loaded.wait();
+            }
+        }
+        if(environmentMapLoaded.valid()) {
+            environmentMapLoaded.wait();
+        }
+    }
+
+    std::map<std::string, MeshFileLoad> meshFiles;
+    std::unique_ptr<EnvironmentMap> environmentMap;
+    std::future<void> environmentMapLoaded;
+};
+
+// Wait for a mesh file to load and add its data and materials to the scene
+static void addLoadedMeshFile(Scene & scene, const std::string & fullFilePath, MeshFileLoad & load)
+{
+    load.loaded.get();
+    load.added = true;
+
+    // Renumber the file's materials to follow the scene's
+    const MaterialID firstMaterial = scene.materials.size();
+    scene.materials.insert(scene.materials.end(), load.materials.begin(), load.materials.end());
+    for(auto & material : load.mesh->meshData->faces.material) {
+        if(material != NoMaterial) {
+            material += firstMaterial;
+        }
+    }
+
+    scene.meshDataCache.fileToMeshData[fullFilePath] = load.mesh->meshData;
+}
+
+// Loading runs as a graph of tasks on the thread pool: mesh files (with their
+// textures) and the environment map (with its importance sampling tables)
+// load while the rest of the file is read, and mesh accelerators build while
+// the remaining objects are read. Everything is joined before returning.
+// Results are added to the scene in file order, so the scene is the same as
+// if it were loaded one piece at a time. Must not be called from a worker.
 bool loadSceneFromParsedTOML(Scene & scene, std::shared_ptr<cpptoml::table> & top,
                              std::map<std::string, MaterialID> & namedMaterials)
 {
@@ -246,6 +302,35 @@ bool loadSceneFromParsedTOML(Scene & scene, std::shared_ptr<cpptoml::table> & to
             }
         }
 
+        SceneLoadTasks tasks;
+
+        auto meshTableArray = top->get_table_array("meshes");
+        if(meshTableArray) {
+            // Start loading each mesh file that isn't loaded already
+            for (const auto & meshTable : *meshTableArray) {
+                auto filePath = meshTable->get_as<std::string>("file");
+                if(!filePath) { throw std::runtime_error("Meshes must supply a file name"); }
+                std::string fullFilePath = applyPathPrefix(meshPath, *filePath);
+                if(scene.meshDataCache.fileToMeshData.count(fullFilePath) > 0 ||
+                   tasks.meshFiles.count(fullFilePath) > 0) {
+                    continue;
+                }
+
+                auto & load = tasks.meshFiles[fullFilePath];
+                bool diskCache = scene.meshDataCache.diskCache;
+                std::string diskCacheDirectory = scene.meshDataCache.diskCacheDirectory;
+                load.loaded = getThreadPool().submit([&scene, &load, fullFilePath, diskCache, diskCacheDirectory]() {
+                    // The scene's mesh data cache is updated when the mesh is added
+                    TriangleMeshDataCache meshDataCache;
+                    meshDataCache.diskCache = diskCache;
+                    meshDataCache.diskCacheDirectory = diskCacheDirectory;
+                    if(!loadTriangleMesh(*load.mesh, load.materials, meshDataCache, scene.textureCache, fullFilePath)) {
+                        throw std::runtime_error("Error loading mesh " + fullFilePath);
+                    }
+                });
+            }
+        }
+
         auto sensorTable = top->get_table("sensor");
         if(sensorTable) {
             auto pixelwidth = sensorTable->get_as<uint32_t>("pixelwidth").value_or(100);
@@ -327,10 +412,13 @@ bool loadSceneFromParsedTOML(Scene & scene, std::shared_ptr<cpptoml::table> & to
                 std::string ypos = applyPathPrefix(envMapPath, *envmapTable->get_as<std::string>("ypos"));
                 std::string zneg = applyPathPrefix(envMapPath, *envmapTable->get_as<std::string>("zneg"));
                 std::string zpos = applyPathPrefix(envMapPath, *envmapTable->get_as<std::string>("zpos"));
-                auto envmap = std::make_unique<CubeMapEnvironmentMap>();
-                envmap->loadFromDirectionFiles(xneg, xpos, yneg, ypos, zneg, zpos);
-                envmap->setScaleFactor(envmapTable->get_as<double>("scalefactor").value_or(1.0));
-                scene.environmentMap = std::move(envmap);
+                float scaleFactor = envmapTable->get_as<double>("scalefactor").value_or(1.0);
+                tasks.environmentMapLoaded = getThreadPool().submit([&tasks, xneg, xpos, yneg, ypos, zneg, zpos, scaleFactor]() {
+                    auto envmap = std::make_unique<CubeMapEnvironmentMap>();
+                    envmap->loadFromDirectionFiles(xneg, xpos, yneg, ypos, zneg, zpos);
+                    envmap->setScaleFactor(scaleFactor);
+                    tasks.environmentMap = std::move(envmap);
+                });
             }
             else if(type == "gradient") {
                 auto low = vectorToRadianceRGB(envmapTable->get_array_of<double>("low").value_or(std::vector<double>{0.0, 0.0, 0.0}));
@@ -341,10 +429,13 @@ bool loadSceneFromParsedTOML(Scene & scene, std::shared_ptr<cpptoml::table> & to
             }
             else if(type == "latlon") {
                 std::string file = applyPathPrefix(envMapPath, *envmapTable->get_as<std::string>("file"));
-                auto envmap = std::make_unique<LatLonEnvironmentMap>();
-                envmap->loadFromFile(file);
-                envmap->setScaleFactor(envmapTable->get_as<double>("scalefactor").value_or(1.0));
-                scene.environmentMap = std::move(envmap);
+                float scaleFactor = envmapTable->get_as<double>("scalefactor").value_or(1.0);
+                tasks.environmentMapLoaded = getThreadPool().submit([&tasks, file, scaleFactor]() {
+                    auto envmap = std::make_unique<LatLonEnvironmentMap>();
+                    envmap->loadFromFile(file);
+                    envmap->setScaleFactor(scaleFactor);
+                    tasks.environmentMap = std::move(envmap);
+                });
             }
         }
 
@@ -358,8 +449,11 @@ bool loadSceneFromParsedTOML(Scene & scene, std::shared_ptr<cpptoml::table> & to
             }
         }
 
-        auto meshTableArray = top->get_table_array("meshes");
         if(meshTableArray) {
+            // Mesh accelerators are built on the thread pool while the
+            // remaining meshes load
+            std::vector<std::future<void>> acceleratorBuilds;
+
             for (const auto & meshTable : *meshTableArray) {
                 auto name = meshTable->get_as<std::string>("name").value_or("");
                 auto filePath = meshTable->get_as<std::string>("file");
@@ -367,37 +461,80 @@ bool loadSceneFromParsedTOML(Scene & scene, std::shared_ptr<cpptoml::table> & to
                 std::string fullFilePath = applyPathPrefix(meshPath, *filePath);
                 std::cout << "Mesh: name " << name << " file " << fullFilePath << std::endl;
 
-                auto mesh = std::make_shared<TriangleMesh>();
+                auto fileLoad = tasks.meshFiles.find(fullFilePath);
+                if(fileLoad != tasks.meshFiles.end() && !fileLoad->second.added) {
+                    addLoadedMeshFile(scene, fullFilePath, fileLoad->second);
+                }
+
+                auto accelerator = meshTable->get_as<std::string>("accelerator").value_or("octree");
+
+                // Instances of the same mesh file share one mesh and
+                // accelerator. Material overrides and placement go on the
+                // instance, so only the first instance builds them.
+                std::string acceleratorKey = fullFilePath + ":" + accelerator;
+                auto cachedAccelerator = scene.meshAcceleratorCache.find(acceleratorKey);
+                TraceablePtr meshAccelerator;
 
-                if(!loadTriangleMesh(*mesh, scene.materials, scene.meshDataCache, scene.textureCache, fullFilePath)) {
-                    throw std::runtime_error("Error loading mesh");
+                if(cachedAccelerator != scene.meshAcceleratorCache.end()) {
+                    std::cout << "Reusing " << accelerator << " accelerator" << std::endl;
+                    meshAccelerator = cachedAccelerator->second;
+                }
+                else {
+                    // Mesh data is in the cache by now
+                    auto mesh = std::make_shared<TriangleMesh>();
+
+                    if(!loadTriangleMesh(*mesh, scene.materials, scene.meshDataCache, scene.textureCache, fullFilePath)) {
+                        throw std::runtime_error("Error loading mesh");
+                    }
+
+                    if(accelerator == "octree") {
+                        std::cout << "Building octree" << std::endl;
+                        auto meshOctree = std::make_shared<TriangleMeshOctree>(mesh);
+                        acceleratorBuilds.push_back(getThreadPool().submit([meshOctree]() {
+                            auto buildTimer = WallClockTimer::makeRunningTimer();
+                            meshOctree->build();
+                            auto buildTime = buildTimer.elapsed();
+                            printf("Octree built in %f sec\n", buildTime);
+                            //meshOctree->printNodes();
+                        }));
+                        meshAccelerator = meshOctree;
+                    }
+                    else if(accelerator == "bvh") {
+                        std::cout << "Building BVH" << std::endl;
+                        auto meshBVH = std::make_shared<TriangleMeshBVH>(mesh);
+                        acceleratorBuilds.push_back(getThreadPool().submit([meshBVH]() {
+                            auto buildTimer = WallClockTimer::makeRunningTimer();
+                            meshBVH->build();
+                            auto buildTime = buildTimer.elapsed();
+                            printf("BVH built in %f sec\n", buildTime);
+                        }));
+                        meshAccelerator = meshBVH;
+                    }
+                    else {
+                        std::cout << "No accelerator" << std::endl;
+                        mesh->buildPackets();
+                        meshAccelerator = mesh;
+                    }
+
+                    scene.meshAcceleratorCache[acceleratorKey] = meshAccelerator;
                 }
 
-                loadMaterialForObject(meshTable, *mesh, scene, namedMaterials, texturePath);
+                auto instance = std::make_shared<TraceableInstance>(meshAccelerator);
+                loadMaterialForObject(meshTable, *instance, scene, namedMaterials, texturePath);
 
                 auto scaletocube = meshTable->get_as<double>("scaletocube");
                 if(scaletocube) {
-                    mesh->scaleToFit(Slab::centeredCube(*scaletocube));
+                    const auto & meshData = *scene.meshDataCache.fileToMeshData.at(fullFilePath);
+                    instance->transform = scaleToFitTransform(meshData.bounds, Slab::centeredCube(*scaletocube));
                 }
 
-                auto accelerator = meshTable->get_as<std::string>("accelerator").value_or("octree");
+                scene.objects.push_back(instance);
+                loadTransformsForObject(meshTable, *instance, scene);
+            }
 
-                if(accelerator == "octree") {
-                    std::cout << "Building octree" << std::endl;
-                    auto meshOctree = std::make_shared<TriangleMeshOctree>(mesh);
-                    auto writeTimer = WallClockTimer::makeRunningTimer();
-                    meshOctree->build();
-                    auto writeTime = writeTimer.elapsed();
-                    printf("Octree built in %f sec\n", writeTime);
-                    //meshOctree->printNodes();
-                    scene.objects.push_back(meshOctree);
-                    loadTransformsForObject(meshTable, *meshOctree, scene);
-                }
-                else {
-                    std::cout << "No accelerator" << std::endl;
-                    scene.objects.push_back(mesh);
-                    loadTransformsForObject(meshTable, *mesh, scene);
-                }
+            // Rethrows any build failure
+            for(auto & build : acceleratorBuilds) {
+                build.get();
             }
         }
 
@@ -456,6 +593,11 @@ bool loadSceneFromParsedTOML(Scene & scene, std::shared_ptr<cpptoml::table> & to
             }
         }
 
+        if(tasks.environmentMapLoaded.valid()) {
+            tasks.environmentMapLoaded.get();
+            scene.environmentMap = std::move(tasks.environmentMap);
+        }
+
         scene.print();
     }
     catch(cpptoml::parse_exception & e) {
@@ -7,6 +7,7 @@
 #include "filesystem.h"
 #include "constants.h"
 #include "Logger.h"
+#include "ThreadPool.h"
 
 Scene::Scene()
     : environmentMap(std::make_unique<EnvironmentMap>())
@@ -15,7 +16,17 @@ Scene::Scene()
 
 void Scene::buildAccelerators()
 {
-    objectsKDTree.build(objects);
+    // The two top level structures are independent, so build them concurrently
+    std::future<void> kdtreeBuild;
+    if(useKDTreeAccelerator) {
+        kdtreeBuild = getThreadPool().submit([this]() { objectsKDTree.build(objects); });
+    }
+    objectsBVH.build(objects, diskLights);
+    gatherTriangleLights(objects, materials, triangleLights);
+    lightSampler.build(pointLights, diskLights, triangleLights, materials, textureCache.textures);
+    if(kdtreeBuild.valid()) {
+        kdtreeBuild.get();
+    }
 }
 
 void Scene::print() const
@@ -32,11 +43,14 @@ void Scene::logSummary(Logger & logger) const
     logger.normal() << "Scene: ";
     logger.normal() << "Number of objects: " << objects.size();
     logger.normal() << "Use objects KD-tree accelerator: " << Logger::yesno(useKDTreeAccelerator);
+    logger.normal() << "Mesh accelerator cache size: " << meshAcceleratorCache.size();
     logger.normal() << "Number of point lights: " << pointLights.size();
     logger.normal() << "Number of disk lights: " << diskLights.size();
+    logger.normal() << "Number of triangle lights: " << triangleLights.size();
     logger.normal() << "Has environment map: " << Logger::yesno(bool(environmentMap));
     logger.normal() << "Number of materials: " << materials.size();
     logger.normal() << "Number of textures: " << textureCache.textures.size();
+    logger.normalf("Texture memory: %.1f MB", float(textureCache.residentBytes()) / (1024.0f * 1024.0f));
     logger.normal() << "Mesh data cache size: " << meshDataCache.fileToMeshData.size();
 
     sensor.logSummary(logger);
@@ -7,14 +7,19 @@
 #include "slab.h"
 #include "TriangleMesh.h"
 #include "TriangleMeshOctree.h"
+#include "TriangleMeshBVH.h"
 #include "PointLight.h"
 #include "DiskLight.h"
+#include "TriangleLight.h"
+#include "LightSampler.h"
 #include "EnvironmentMap.h"
 #include "sensor.h"
 #include "camera.h"
 #include "Ray.h"
 #include "traceable.h"
 #include "TraceableKDTree.h"
+#include "TraceableBVH.h"
+#include "TraceableInstance.h"
 
 class Logger;
 
@@ -35,10 +40,24 @@ struct Scene
     // Lights
     std::vector<PointLight> pointLights;
     std::vector<DiskLight> diskLights;
+    // Emissive mesh triangles. Gathered with the accelerators.
+    std::vector<TriangleLight> triangleLights;
+    // Chooses lights by power. Built with the accelerators.
+    LightSampler lightSampler;
+
+    // Point, disk, and triangle lights, numbered in that order
+    size_t numLights() const { return pointLights.size() + diskLights.size() + triangleLights.size(); }
 
     // Accelerators
     TraceableKDTree objectsKDTree;
     bool useKDTreeAccelerator = false;
+    // Top level BVH over objects and disk lights. Used once built.
+    TraceableBVH objectsBVH;
+
+    // Bottom level mesh accelerators, shared by all instances of the same
+    // mesh file. Keyed by "<mesh file>:<accelerator type>". Material
+    // overrides and placement are per instance.
+    std::map<std::string, TraceablePtr> meshAcceleratorCache;
 
     // Always points to a valid environment map
     std::unique_ptr<EnvironmentMap> environmentMap;
@@ -65,6 +84,9 @@ bool loadSceneFromTOMLFile(Scene & scene, const std::string & filename,
 // Ray intersection
 inline bool intersectsWorldRay(const Ray & rayWorld, const Scene & scene, float minDistance, float maxDistance = std::numeric_limits<float>::max());
 inline bool findIntersectionWorldRay(const Ray & rayWorld, const Sphere & sphere, float minDistance, RayIntersection & intersection);
+// Closest hit, with the object hit. The surface at the hit can be evaluated
+// later with hit.object->fillIntersectionWorldRay().
+inline bool findHitWorldRay(const Ray & rayWorld, const Scene & scene, float minDistance, RayHit & hit);
 
 #include "scene.hpp"
 #endif
@@ -2,11 +2,24 @@
 inline bool intersectsWorldRay(const Ray & rayWorld, const Scene & scene,
                                float minDistance, float maxDistance)
 {
-    for(const auto & o : scene.objects) {
-        if(o->intersectsWorldRay(rayWorld, minDistance, maxDistance)) {
+    // The top level BVH covers both the objects and the disk lights
+    if(scene.objectsBVH.isBuilt() && !scene.useKDTreeAccelerator) {
+        return scene.objectsBVH.intersects(rayWorld, minDistance, maxDistance);
+    }
+
+    if(scene.useKDTreeAccelerator) {
+        // The KD tree is built in world space
+        if(scene.objectsKDTree.intersects(rayWorld, minDistance, maxDistance)) {
             return true;
         }
     }
+    else {
+        for(const auto & o : scene.objects) {
+            if(o->intersectsWorldRay(rayWorld, minDistance, maxDistance)) {
+                return true;
+            }
+        }
+    }
 
     for(const auto & o : scene.diskLights) {
         if(o.intersectsWorldRay(rayWorld, minDistance, maxDistance)) {
@@ -17,45 +30,64 @@ inline bool intersectsWorldRay(const Ray & rayWorld, const Scene & scene,
     return false;
 }
 
-inline bool findIntersectionWorldRay(const Ray & rayWorld, const Scene & scene,
-                                     float minDistance, RayIntersection & intersection)
+inline bool findHitWorldRay(const Ray & rayWorld, const Scene & scene,
+                            float minDistance, RayHit & hit)
 {
-    RayIntersection nextIntersection;
-    bool hit = false;
-
-    const auto updateBestHit = [&]() {
-        if(!hit || nextIntersection.distance < intersection.distance) {
-            intersection = nextIntersection;
-            hit = true;
-            assert(intersection.distance >= minDistance);
+    RayHit nextHit;
+    bool anyHit = false;
+
+    const auto updateBestHit = [&](const Traceable * object) {
+        if(!anyHit || nextHit.distance < hit.distance) {
+            hit = nextHit;
+            hit.object = object;
+            anyHit = true;
+            assert(hit.distance >= minDistance);
         }
     };
 
+    // The top level BVH covers both the objects and the disk lights
+    if(scene.objectsBVH.isBuilt() && !scene.useKDTreeAccelerator) {
+        return scene.objectsBVH.findHit(rayWorld, minDistance, hit);
+    }
+
     // Iterate over scene objects
 
     if(scene.useKDTreeAccelerator) {
-        if(scene.objectsKDTree.findIntersectionWorldRay(rayWorld, minDistance, nextIntersection)) {
-            updateBestHit();
+        // The KD tree is built in world space and sets the object hit
+        if(scene.objectsKDTree.findHit(rayWorld, minDistance, nextHit)) {
+            updateBestHit(nextHit.object);
         }
     }
     else {
         for(const auto & o : scene.objects) {
-            if(o->findIntersectionWorldRay(rayWorld, minDistance, nextIntersection)) {
-                updateBestHit();
+            if(o->findHitWorldRay(rayWorld, minDistance, nextHit)) {
+                updateBestHit(o.get());
             }
         }
     }
 
     for(const auto & o : scene.diskLights) {
-        if(o.findIntersectionWorldRay(rayWorld, minDistance, nextIntersection)) {
-            updateBestHit();
+        if(o.findHitWorldRay(rayWorld, minDistance, nextHit)) {
+            updateBestHit(&o);
         }
     }
 
-    if(hit) {
-        intersection.ray = rayWorld;
+    return anyHit;
+}
+
+inline bool findIntersectionWorldRay(const Ray & rayWorld, const Scene & scene,
+                                     float minDistance, RayIntersection & intersection)
+{
+    // Only the closest hit has its surface evaluated
+    RayHit hit;
+    if(!findHitWorldRay(rayWorld, scene, minDistance, hit)) {
+        return false;
     }
 
-    return hit;
-}
+    hit.object->fillIntersectionWorldRay(rayWorld, hit, intersection);
+    intersection.ray = rayWorld;
+    intersection.object = hit.object;
+    intersection.primitive = hit.primitive;
 
+    return true;
+}
@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <algorithm>
 #include "sensor.h"
 #include "Logger.h"
 
@@ -37,23 +38,22 @@ void Sensor::forEachPixelInRect(const PixelFunction & fn,
     }
 }
 
-void Sensor::forEachPixelTiled(const PixelFunction & fn, uint32_t tileSize)
+void Sensor::forEachPixelInTile(const Tile & tile, ThreadIndex tid,
+                                const PixelFunction & fn)
 {
-    // Walk pixels within tile, taking care not to overstep the bounds
-    // of the range for imperfect tilings.
-    auto walkTile = [&](uint32_t starty, uint32_t startx) {
-        auto n = nest(range(starty, std::min(pixelheight, starty + tileSize)),
-                      range(startx, std::min(pixelwidth, startx + tileSize)));
+    auto n = nest(range(tile.ymin, tile.ymax),
+                  range(tile.xmin, tile.xmax));
 
-        n.for_each<uint32_t, uint32_t>([&](uint32_t y, uint32_t x) {
-            fn(x, y, 0);
-        });
-    };
-
-    auto n = nest(range(0u, tileSize, pixelheight),
-                  range(0u, tileSize, pixelwidth));
+    n.for_each<uint32_t, uint32_t>([&](uint32_t y, uint32_t x) {
+        fn(x, y, tid);
+    });
+}
 
-    n.for_each<uint32_t, uint32_t>(walkTile);
+void Sensor::forEachPixelTiled(const PixelFunction & fn, uint32_t tileSize, TileOrder order)
+{
+    for(const auto & tile : tiles(tileSize, order)) {
+        forEachPixelInTile(tile, 0, fn);
+    }
 }
 
 void Sensor::forEachPixelThreaded(const PixelFunction & fn, uint32_t numThreads)
@@ -63,82 +63,146 @@ void Sensor::forEachPixelThreaded(const PixelFunction & fn, uint32_t numThreads)
         return;
     }
 
-    auto rowFn = [&](int y, ThreadIndex tid) {
-        for(size_t x = 0; x < pixelwidth; x++) {
-            fn(x, y, tid);
-        }
-    };
-
-    auto threadFn = [&](ThreadIndex tid) {
-        for(size_t y = tid; y < pixelheight; y += numThreads) {
-            rowFn(y, tid);
-        }
-    };
-
-    std::list<std::future<void>> futures;
-
-    for(ThreadIndex tid = 0; tid < numThreads; ++tid) {
-        auto fn = [=]() { threadFn(tid); };
-        futures.push_back(std::async(std::launch::async, fn));
+    // Hand out rows dynamically
+    std::vector<Tile> rows;
+    rows.reserve(pixelheight);
+    for(uint32_t y = 0; y < pixelheight; ++y) {
+        rows.push_back({ 0, y, pixelwidth, y + 1 });
     }
 
-    for(auto & future : futures) {
-        future.wait();
-    }
+    forEachTileThreaded(rows,
+                        [&](const Tile & row, ThreadIndex tid) { forEachPixelInTile(row, tid, fn); },
+                        numThreads);
 }
 
-void Sensor::forEachPixelTiledThreaded(const PixelFunction & fn, uint32_t tileSize, uint32_t numThreads)
+void Sensor::forEachPixelTiledThreaded(const PixelFunction & fn, uint32_t tileSize, uint32_t numThreads,
+                                       TileOrder order)
 {
     if(numThreads == 1) {
-        forEachPixelTiled(fn, tileSize);
+        forEachPixelTiled(fn, tileSize, order);
         return;
     }
 
-    struct Tile {
-        uint32_t ymin, xmin, ymax, xmax;
-    };
+    forEachTileThreaded(tiles(tileSize, order),
+                        [&](const Tile & tile, ThreadIndex tid) { forEachPixelInTile(tile, tid, fn); },
+                        numThreads);
+}
 
-    auto threadFn = [&](ThreadIndex tid) {
-        std::vector<Tile> tiles;
-        uint32_t counter = 0;
-
-        // Create a list of tiles assigned to this thread
-        auto walkTile = [&](uint32_t starty, uint32_t startx) {
-            if(counter % numThreads == tid) {
-                tiles.push_back({
-                    starty, startx,
-                    std::min(pixelheight, starty + tileSize),
-                    std::min(pixelwidth, startx + tileSize)
-                });
-            }
-            ++counter;
-        };
+void Sensor::forEachTileThreaded(const std::vector<Tile> & tiles,
+                                 const TileFunction & fn,
+                                 uint32_t numThreads)
+{
+    if(numThreads <= 1) {
+        for(const auto & tile : tiles) {
+            fn(tile, 0);
+        }
+        return;
+    }
 
-        auto n = nest(range(0u, tileSize, pixelheight),
-                      range(0u, tileSize, pixelwidth));
+    getThreadPool().parallelFor(tiles.size(),
+                                [&](size_t ti, ThreadIndex tid) { fn(tiles[ti], tid); },
+                                numThreads);
+}
 
-        n.for_each<uint32_t, uint32_t>(walkTile);
+// Map a distance along a Hilbert curve covering an n x n grid
+// (n a power of two) to grid coordinates.
+static void hilbertIndexToXY(uint32_t n, uint32_t d, uint32_t & x, uint32_t & y)
+{
+    x = y = 0;
+    for(uint32_t s = 1; s < n; s *= 2) {
+        uint32_t rx = 1 & (d / 2);
+        uint32_t ry = 1 & (d ^ rx);
+        if(ry == 0) {
+            if(rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+        x += s * rx;
+        y += s * ry;
+        d /= 4;
+    }
+}
 
-        // Walk each tile's pixels in raster order
-        for(auto & tile : tiles) {
-            auto n = nest(range(tile.ymin, tile.ymax),
-                          range(tile.xmin, tile.xmax));
+std::vector<Sensor::Tile> Sensor::tiles(uint32_t tileSize, TileOrder order) const
+{
+    tileSize = std::max(tileSize, 1u);
+
+    const uint32_t tilesX = (pixelwidth + tileSize - 1) / tileSize;
+    const uint32_t tilesY = (pixelheight + tileSize - 1) / tileSize;
+    const size_t numTiles = size_t(tilesX) * size_t(tilesY);
+
+    std::vector<Tile> result;
+    result.reserve(numTiles);
+
+    // Add the tile at the given tile grid coordinates, taking care not to
+    // overstep the bounds of the sensor for imperfect tilings.
+    auto addTile = [&](uint32_t tx, uint32_t ty) {
+        result.push_back({
+            tx * tileSize, ty * tileSize,
+            std::min(pixelwidth, (tx + 1) * tileSize),
+            std::min(pixelheight, (ty + 1) * tileSize)
+        });
+    };
 
-            n.for_each<uint32_t, uint32_t>([&](uint32_t y, uint32_t x) {
-                fn(x, y, 0);
-            });
+    if(order == TileOrder::Spiral) {
+        // Walk outward from the center tile in legs of increasing length
+        const int dx[4] = { 1, 0, -1, 0 };
+        const int dy[4] = { 0, 1, 0, -1 };
+        int x = int(tilesX - 1) / 2, y = int(tilesY - 1) / 2;
+        if(numTiles > 0) {
+            addTile(x, y);
         }
-    };
+        for(unsigned int leg = 0; result.size() < numTiles; ++leg) {
+            const unsigned int direction = leg % 4, length = leg / 2 + 1;
+            for(unsigned int step = 0; step < length; ++step) {
+                x += dx[direction];
+                y += dy[direction];
+                if(x >= 0 && y >= 0 && x < int(tilesX) && y < int(tilesY)) {
+                    addTile(x, y);
+                }
+            }
+        }
+    }
+    else if(order == TileOrder::Hilbert) {
+        uint32_t n = 1;
+        while(n < tilesX || n < tilesY) {
+            n *= 2;
+        }
+        for(uint32_t d = 0; d < n * n; ++d) {
+            uint32_t x, y;
+            hilbertIndexToXY(n, d, x, y);
+            if(x < tilesX && y < tilesY) {
+                addTile(x, y);
+            }
+        }
+    }
+    else {
+        for(uint32_t y = 0; y < tilesY; ++y) {
+            for(uint32_t x = 0; x < tilesX; ++x) {
+                addTile(x, y);
+            }
+        }
+    }
 
-    std::list<std::future<void>> futures;
+    return result;
+}
 
-    for(ThreadIndex tid = 0; tid < numThreads; ++tid) {
-        auto fn = [=]() { threadFn(tid); };
-        futures.push_back(std::async(std::launch::async, fn));
-    }
+bool Sensor::parseTileOrder(const std::string & name, TileOrder & order)
+{
+    if(name == "raster")       { order = TileOrder::Raster;  return true; }
+    else if(name == "spiral")  { order = TileOrder::Spiral;  return true; }
+    else if(name == "hilbert") { order = TileOrder::Hilbert; return true; }
+    return false;
+}
 
-    for(auto & future : futures) {
-        future.wait();
+const char * Sensor::tileOrderString(TileOrder order)
+{
+    switch(order) {
+        case TileOrder::Raster:  return "raster";
+        case TileOrder::Spiral:  return "spiral";
+        case TileOrder::Hilbert: return "hilbert";
+        default:                 return "unknown";
     }
 }
-
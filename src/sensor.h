@@ -4,20 +4,17 @@
 #include <cstdint>
 #include <functional>
 #include <vector>
-#include <thread>
-#include <list>
-#include <future>
+#include <string>
 
 #include <generator.h>
 
 #include "interpolation.h"
 #include "vectortypes.h"
 #include "vec2.h"
+#include "ThreadPool.h"
 
 class Logger;
 
-using ThreadIndex = uint32_t;
-
 struct Sensor
 {
 	inline Sensor() = default;
@@ -26,15 +23,47 @@ struct Sensor
 
     using PixelFunction = std::function<void(size_t /*x*/, size_t /*y*/, ThreadIndex)>;
 
+    // Rectangular block of pixels [xmin, xmax) x [ymin, ymax)
+    struct Tile {
+        uint32_t xmin, ymin, xmax, ymax;
+    };
+
+    using TileFunction = std::function<void(const Tile &, ThreadIndex)>;
+
+    // Order in which tiles are handed out to threads
+    enum class TileOrder {
+        Raster,     // row by row
+        Spiral,     // outward from the center of the image
+        Hilbert     // along a Hilbert curve, keeping neighboring tiles close in time
+    };
+
     // Call a function for every pixel on the sensor
     void forEachPixel(const PixelFunction & fn);
     void forEachPixelInRect(const PixelFunction & fn,
                             size_t xmin, size_t ymin,
                             size_t xdim, size_t ydim);
-    void forEachPixelTiled(const PixelFunction & fn, uint32_t tileSize);
+    void forEachPixelTiled(const PixelFunction & fn, uint32_t tileSize,
+                           TileOrder order = TileOrder::Raster);
     void forEachPixelThreaded(const PixelFunction & fn, uint32_t numThreads);
     void forEachPixelTiledThreaded(const PixelFunction & fn, uint32_t tileSize,
-                                   uint32_t numThreads);
+                                   uint32_t numThreads,
+                                   TileOrder order = TileOrder::Spiral);
+
+    // Split the sensor into tiles of at most tileSize x tileSize pixels
+    std::vector<Tile> tiles(uint32_t tileSize, TileOrder order = TileOrder::Raster) const;
+
+    // Call a function for each tile on the shared thread pool, using at
+    // most numThreads threads. Threads pull the next tile from a shared
+    // queue as they finish, so expensive regions of the image do not hold
+    // up the other threads. ThreadIndex is less than numThreads.
+    static void forEachTileThreaded(const std::vector<Tile> & tiles,
+                                    const TileFunction & fn,
+                                    uint32_t numThreads);
+    static void forEachPixelInTile(const Tile & tile, ThreadIndex tid,
+                                   const PixelFunction & fn);
+
+    static bool parseTileOrder(const std::string & name, TileOrder & order);
+    static const char * tileOrderString(TileOrder order);
 
     // Standard image location ranges from x in [-1,+1], y in [-1,+1],
     // regardless of actual aspect ratio.
@@ -101,7 +101,7 @@ const int LOOK_NEGATIVE_NORMAL_OFFSET = 1;
 // Reference: http://www.scratchapixel.com/lessons/3d-basic-lessons/lesson-7-intersecting-simple-shapes/ray-box-intersection/
 //
 // Note: This method assumes that slab min/max values are ordered correctly.
-inline bool Slab::findIntersection(const Ray & ray, float minDistance, RayIntersection & intersection) const
+inline bool Slab::findHit(const Ray & ray, float minDistance, RayHit & hit) const
 {
     float xn, xf, yn, yf, zn, zf;       // near and far planes for the box
     int nin, nif, nix, niy, niz;        // indices into normal table (near plane, far plane, x, y, z)
@@ -189,23 +189,29 @@ inline bool Slab::findIntersection(const Ray & ray, float minDistance, RayInters
         return false;
     }
 
+    // The primitive is the index of the face hit in the normal table
     if(tn > minDistance) {
-        intersection.normal = boxNormals[nin];
-        intersection.tangent = boxTangents[nin];
-        intersection.bitangent = boxBitangents[nin];
-        intersection.distance = tn;
+        hit.distance = tn;
+        hit.primitive = nin;
     }
     else {
-        intersection.normal = boxNormals[nif];
-        intersection.tangent = boxTangents[nif];
-        intersection.bitangent = boxBitangents[nif];
-        intersection.distance = tf;
+        hit.distance = tf;
+        hit.primitive = nif;
     }
+
+    return true;
+}
+
+inline void Slab::fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const
+{
+    intersection.normal = boxNormals[hit.primitive];
+    intersection.tangent = boxTangents[hit.primitive];
+    intersection.bitangent = boxBitangents[hit.primitive];
+    intersection.distance = hit.distance;
     intersection.position = add(ray.origin, scale(ray.direction, intersection.distance));
     intersection.texcoord.u = dot(Direction3(intersection.position), intersection.tangent);
     intersection.texcoord.v = dot(Direction3(intersection.position), intersection.bitangent);
+    intersection.texcoordScale = 1.0f;
     intersection.material = material;
-
-    return true;
 }
 
@@ -10,34 +10,130 @@ std::ostream & operator<<(std::ostream & os, const TextureCoordinate & texcoord)
 
 TextureID TextureCache::loadTextureFromFile(const std::string & path,
                                             const std::string & filename)
+{
+    return loadTexture(path, filename, false);
+}
+
+TextureID TextureCache::loadNormalMapFromFile(const std::string & path,
+                                              const std::string & filename)
+{
+    return loadTexture(path, filename, true);
+}
+
+MipTexturePtr TextureCache::texture(TextureID id)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    auto p = pending.find(id);
+    if(p != pending.end()) {
+        auto loaded = p->second;
+        lock.unlock();
+        loaded.get();
+        lock.lock();
+    }
+    return textures.at(id);
+}
+
+TextureID TextureCache::loadTexture(const std::string & path,
+                                    const std::string & filename,
+                                    bool normalMap)
 {
     auto & logger = getLogger();
 
     // Fix separators to ensure Unix-style paths
     std::string texname = filename;
     std::replace(texname.begin(), texname.end(), '\\', '/');
-    auto ft = fileToTextureID.find(texname);
+    if(!path.empty()) {
+        texname = path + '/' + texname;
+    }
+    // The same file loaded as a normal map is a different texture
+    const std::string key = normalMap ? "normalmap:" + texname : texname;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    auto ft = fileToTextureID.find(key);
 
-    TextureID textureID = NoTexture;
     if(ft != fileToTextureID.end()) {
-        // Texture is in the cache
+        // Texture is in the cache, or being loaded by another thread
         logger.debugf("Texture in cache '%s'", texname.c_str());
-        textureID = ft->second;
-    }
-    else {
-        // Cache miss. Load the texture and update the cache.
-        textureID = textures.size();
-        std::shared_ptr<Texture> texture;
-        if(!path.empty()) {
-            texname = path + '/' + texname;
+        TextureID textureID = ft->second;
+        auto p = pending.find(textureID);
+        if(p != pending.end()) {
+            auto loaded = p->second;
+            lock.unlock();
+            loaded.get();
         }
+        return textureID;
+    }
+
+    // Cache miss. Reserve an ID, then decode without holding the lock so
+    // other textures can load at the same time.
+    TextureID textureID = textures.size();
+    textures.push_back(nullptr);
+    fileToTextureID[key] = textureID;
+    std::promise<void> loaded;
+    pending[textureID] = loaded.get_future().share();
+    auto cache = tileCache;
+    lock.unlock();
+
+    MipTexturePtr texture;
+    try {
         logger.debugf("Reading image file '%s'", texname.c_str());
-        texture = readImage<float>(texname);
-        texture->outOfBoundsBehavior = Image<float>::Repeat;
-        textures.push_back(texture);
-        fileToTextureID[texname] = textureID;
+        auto image = readImage<float>(texname);
+        auto format = MipTexture::compactFormat(*image);
+        if(normalMap) {
+            // Convert normal map color to normal [0, 1] -> [-1, 1]
+            texture = std::make_shared<MipTexture>(*image, format, -1.0f, 2.0f);
+        }
+        else {
+            texture = std::make_shared<MipTexture>(*image, format);
+        }
+        if(cache) {
+            texture->pageOut(cache);
+        }
+        logger.debugf("Texture '%s' %u x %u, %d channels, %s, %u MIP levels, %.1f MB",
+                      texname.c_str(), (unsigned int) texture->width, (unsigned int) texture->height,
+                      texture->numChannels,
+                      format == MipTexture::UInt8 ? "8-bit" : format == MipTexture::Half ? "half" : "float",
+                      (unsigned int) texture->numLevels(),
+                      float(texture->storageBytes()) / (1024.0f * 1024.0f));
     }
+    catch(...) {
+        // Fail this and any waiting loads, and let a later load try again
+        lock.lock();
+        fileToTextureID.erase(key);
+        pending.erase(textureID);
+        lock.unlock();
+        loaded.set_exception(std::current_exception());
+        throw;
+    }
+
+    lock.lock();
+    textures[textureID] = texture;
+    pending.erase(textureID);
+    lock.unlock();
+    loaded.set_value();
 
     return textureID;
 }
 
+void TextureCache::setTileCacheBudget(size_t maxBytes, const std::string & directory)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(maxBytes > 0) {
+        tileCache = std::make_shared<TextureTileCache>(maxBytes, directory);
+    }
+    else {
+        tileCache = nullptr;
+    }
+}
+
+size_t TextureCache::residentBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t bytes = tileCache ? tileCache->stats().residentBytes : 0;
+    for(const auto & texture : textures) {
+        if(texture) {
+            bytes += texture->residentBytes();
+        }
+    }
+    return bytes;
+}
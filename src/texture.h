@@ -5,8 +5,11 @@
 #include <limits>
 #include <memory>
 #include <map>
+#include <mutex>
+#include <future>
 
 #include "image.h"
+#include "MipTexture.h"
 
 struct TextureCoordinate
 {
@@ -21,15 +24,54 @@ static const TextureID NoTexture = std::numeric_limits<TextureID>::max();
 
 using Texture = Image<float>;
 using TexturePtr = std::shared_ptr<Texture>;
-using TextureArray = std::vector<TexturePtr>;
 
+// Material textures
+using MipTexturePtr = std::shared_ptr<MipTexture>;
+using TextureArray = std::vector<MipTexturePtr>;
+
+// Loads each texture file once. Loading is thread safe, so meshes and
+// materials can load their textures in parallel. The first thread to ask for
+// a file decodes it, and other threads asking for the same file wait for it.
+//
+// Textures are stored in the smallest format that fits the file (8-bit,
+// exact for LDR files; half for most HDR files, see
+// MipTexture::compactFormat()). With a tile cache
+// budget, textures are paged out as they load, and only the most recently
+// used tiles stay in memory.
 struct TextureCache
 {
     TextureID loadTextureFromFile(const std::string & path,
                                   const std::string & filename);
 
+    // Load a normal map, converting colors in [0,1] to normals in [-1,1]
+    TextureID loadNormalMapFromFile(const std::string & path,
+                                    const std::string & filename);
+
+    // Texture for an ID returned by one of the loaders. Safe to call while
+    // other threads are loading. Once loading is done, textures can be
+    // used directly.
+    MipTexturePtr texture(TextureID id);
+
+    // Page textures out to scratch files in the directory (or the system
+    // temp directory if empty), keeping at most maxBytes of tiles in memory.
+    // Only applies to textures loaded afterwards.
+    void setTileCacheBudget(size_t maxBytes, const std::string & directory = "");
+
+    // Bytes of texture tiles in memory
+    size_t residentBytes() const;
+
     std::map<std::string, TextureID> fileToTextureID;
     TextureArray textures;
+    std::shared_ptr<TextureTileCache> tileCache;
+
+    protected:
+        TextureID loadTexture(const std::string & path,
+                              const std::string & filename,
+                              bool normalMap);
+
+        mutable std::mutex mutex;
+        // Textures that are still being decoded
+        std::map<TextureID, std::shared_future<void>> pending;
 };
 
 
@@ -4,6 +4,7 @@
 #include <chrono>
 #include <ctime>
 #include <string>
+#include <time.h>
 
 class ProcessorTimer {
 public:
@@ -23,6 +24,30 @@ protected:
     bool valid   = false;
 };
 
+// CPU time of the calling thread. Unlike ProcessorTimer, which measures the
+// whole process, it only counts the work of the thread it runs on, so it
+// stays meaningful while other threads are busy. Start and read it on the
+// same thread.
+class ThreadTimer {
+public:
+    ThreadTimer() = default;
+    ~ThreadTimer() = default;
+
+    static inline ThreadTimer makeRunningTimer();
+
+    inline void start();
+    inline void stop();
+    inline double elapsed();
+
+protected:
+    static inline double now();
+
+    double start_time = 0.0;
+    double end_time = 0.0;
+    bool running = false;
+    bool valid   = false;
+};
+
 class WallClockTimer {
 public:
     WallClockTimer() = default;
@@ -82,6 +107,46 @@ inline double ProcessorTimer::elapsed()
     return (double) (end_time - start_time) / CLOCKS_PER_SEC;
 }
 
+inline ThreadTimer ThreadTimer::makeRunningTimer()
+{
+    ThreadTimer timer;
+    timer.start();
+    return timer;
+}
+
+inline double ThreadTimer::now()
+{
+    struct timespec ts = {};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1.0e-9;
+}
+
+inline void ThreadTimer::start()
+{
+    start_time = now();
+    running = true;
+    valid = true;
+}
+
+inline void ThreadTimer::stop()
+{
+    end_time = now();
+    running = false;
+}
+
+inline double ThreadTimer::elapsed()
+{
+    if(!valid) {
+        return 0.0;
+    }
+
+    if(running) {
+        end_time = now();
+    }
+
+    return end_time - start_time;
+}
+
 inline WallClockTimer WallClockTimer::makeRunningTimer()
 {
     WallClockTimer timer;
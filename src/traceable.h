@@ -16,10 +16,19 @@ struct Traceable
     // Ray intersection interface
     inline bool intersectsWorldRay(const Ray & rayWorld, float minDistanceWorld, float maxDistanceWorld) const;
     inline bool findIntersectionWorldRay(const Ray & rayWorld, float minDistanceWorld, RayIntersection & intersection) const;
+    // Closest hit, with the distance in world space
+    inline bool findHitWorldRay(const Ray & rayWorld, float minDistanceWorld, RayHit & hit) const;
+    inline void fillIntersectionWorldRay(const Ray & rayWorld, const RayHit & hit, RayIntersection & intersection) const;
+
+    // Closest hit and the surface there
+    inline bool findIntersection(const Ray & ray, float minDistance, RayIntersection & intersection) const;
 
     // Ray intersection implementation
     virtual bool intersects(const Ray & ray, float minDistance, float maxDistance) const = 0;
-    virtual bool findIntersection(const Ray & ray, float minDistance, RayIntersection & intersection) const = 0;
+    // Find the closest hit without evaluating the surface there
+    virtual bool findHit(const Ray & ray, float minDistance, RayHit & hit) const = 0;
+    // Evaluate the surface at a hit that findHit() found for the same ray
+    virtual void fillIntersection(const Ray & ray, const RayHit & hit, RayIntersection & intersection) const = 0;
 
     // Bounding volume
     virtual Slab boundingBox() = 0;
@@ -54,36 +63,70 @@ inline bool Traceable::intersectsWorldRay(const Ray & rayWorld, float minDistanc
 
 inline bool Traceable::findIntersectionWorldRay(const Ray & rayWorld, float minDistanceWorld, RayIntersection & intersection) const
 {
-    // Transform the ray into object space
+    RayHit hit;
+    if(!findHitWorldRay(rayWorld, minDistanceWorld, hit)) {
+        return false;
+    }
+    fillIntersectionWorldRay(rayWorld, hit, intersection);
+    return true;
+}
+
+inline bool Traceable::findHitWorldRay(const Ray & rayWorld, float minDistanceWorld, RayHit & hit) const
+{
+    // Transform the ray into object space. The direction is normalized, so
+    // object space distances are world distances scaled by its length.
+    Direction3 directionObj = transform.rev * rayWorld.direction;
+    float scaleObj = directionObj.magnitude();
     Ray rayObj = Ray{
         transform.rev * rayWorld.origin,
-        (transform.rev * rayWorld.direction).normalized()
+        directionObj / scaleObj
     };
 
-    // Calculate the minimum distance along the ray in object space
-    Position3 minPositionWorld = rayWorld.pointAt(minDistanceWorld);
-    Position3 minPositionObj = transform.rev * minPositionWorld;
-    float minDistanceObj = (minPositionObj - rayObj.origin).magnitude();
-
     // Do intersection in object space
-    bool hit = findIntersection(rayObj, minDistanceObj, intersection);
-
-    if(hit) {
-        // Transform hit back to world space
-        intersection.ray = rayWorld;
-        intersection.position = transform.fwd * intersection.position;
-        // Normals and the like transform as the inverse transpose
-        intersection.normal = multTranspose(transform.rev, intersection.normal).normalized();
-        intersection.tangent = multTranspose(transform.rev, intersection.tangent).normalized();
-        intersection.bitangent = multTranspose(transform.rev, intersection.bitangent).normalized();
-        // Get distance in world space
-        intersection.distance = (intersection.position - rayWorld.origin).magnitude();
-        // Ensure the distance returned is at least the minimum distance
-        intersection.distance = std::max(intersection.distance, minDistanceWorld);
-        //assert(intersection.distance >= minDistanceWorld);
+    if(!findHit(rayObj, minDistanceWorld * scaleObj, hit)) {
+        return false;
     }
 
-    return hit;
+    // Get distance in world space
+    hit.distance = hit.distance / scaleObj;
+    // Ensure the distance returned is at least the minimum distance
+    hit.distance = std::max(hit.distance, minDistanceWorld);
+
+    return true;
+}
+
+inline void Traceable::fillIntersectionWorldRay(const Ray & rayWorld, const RayHit & hit, RayIntersection & intersection) const
+{
+    Direction3 directionObj = transform.rev * rayWorld.direction;
+    float scaleObj = directionObj.magnitude();
+    Ray rayObj = Ray{
+        transform.rev * rayWorld.origin,
+        directionObj / scaleObj
+    };
+
+    RayHit hitObj = hit;
+    hitObj.distance = hit.distance * scaleObj;
+    fillIntersection(rayObj, hitObj, intersection);
+
+    // Transform hit back to world space
+    intersection.ray = rayWorld;
+    intersection.position = transform.fwd * intersection.position;
+    // Normals and the like transform as the inverse transpose
+    intersection.normal = multTranspose(transform.rev, intersection.normal).normalized();
+    intersection.tangent = multTranspose(transform.rev, intersection.tangent).normalized();
+    intersection.bitangent = multTranspose(transform.rev, intersection.bitangent).normalized();
+    intersection.distance = hit.distance;
+    intersection.texcoordScale *= scaleObj;
+}
+
+inline bool Traceable::findIntersection(const Ray & ray, float minDistance, RayIntersection & intersection) const
+{
+    RayHit hit;
+    if(!findHit(ray, minDistance, hit)) {
+        return false;
+    }
+    fillIntersection(ray, hit, intersection);
+    return true;
 }
 
 #endif
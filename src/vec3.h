@@ -8,7 +8,7 @@
 struct vec3
 {
     inline vec3() = default;
-    inline vec3(const vec3 & a) : x(a.x), y(a.y), z(a.z) {}
+    inline vec3(const vec3 & a) = default;
 	inline vec3(float xn, float yn, float zn) : x(xn), y(yn), z(zn) {}
     inline vec3(float v[3]) : x(v[0]), y(v[1]), z(v[2]) {}
     inline ~vec3() = default;
@@ -0,0 +1,205 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include "artifacts.h"
+#include "rng.h"
+#include "FilmTile.h"
+#include "ThreadPool.h"
+
+namespace {
+
+TEST(ArtifactsTest, RelativeErrorNeedsTwoSamples) {
+    Artifacts artifacts(4, 4);
+    EXPECT_TRUE(std::isinf(artifacts.relativeError(1, 1)));
+    artifacts.accumPixelColor(1, 1, ColorRGB(0.5f, 0.5f, 0.5f));
+    EXPECT_TRUE(std::isinf(artifacts.relativeError(1, 1)));
+    artifacts.accumPixelColor(1, 1, ColorRGB(0.5f, 0.5f, 0.5f));
+    EXPECT_FLOAT_EQ(artifacts.relativeError(1, 1), 0.0f);
+    EXPECT_EQ(artifacts.numSamples(1, 1), 2u);
+}
+
+TEST(ArtifactsTest, RelativeErrorOfTwoValues) {
+    Artifacts artifacts(4, 4);
+    artifacts.accumPixelColor(2, 3, ColorRGB(1.0f, 1.0f, 1.0f));
+    artifacts.accumPixelColor(2, 3, ColorRGB(3.0f, 3.0f, 3.0f));
+    // Sample variance 2, standard error 1, mean 2 per channel
+    EXPECT_FLOAT_EQ(artifacts.relativeError(2, 3), 0.5f);
+}
+
+// Standard error falls as 1/sqrt(N)
+TEST(ArtifactsTest, RelativeErrorFallsWithSamples) {
+    Artifacts artifacts(2, 1);
+    RNG rng(7);
+    for(int i = 0; i < 4096; ++i) {
+        float v = rng.uniform01();
+        artifacts.accumPixelColor(0, 0, ColorRGB(v, v, v));
+        if(i < 1024) {
+            artifacts.accumPixelColor(1, 0, ColorRGB(v, v, v));
+        }
+    }
+    // Uniform values have mean 1/2 and standard deviation 1/sqrt(12)
+    const float expected = 1.0f / std::sqrt(12.0f) / 0.5f;
+    EXPECT_NEAR(artifacts.relativeError(0, 0), expected / 64.0f, 0.1f * expected / 64.0f);
+    EXPECT_NEAR(artifacts.relativeError(1, 0), expected / 32.0f, 0.1f * expected / 32.0f);
+    EXPECT_NEAR(artifacts.relativeError(0, 0, 2, 1),
+                0.5f * (artifacts.relativeError(0, 0) + artifacts.relativeError(1, 0)), 1.0e-6f);
+}
+
+TEST(ArtifactsTest, RelativeErrorOfBlackPixelsIsBounded) {
+    Artifacts artifacts(1, 1);
+    for(int i = 0; i < 16; ++i) {
+        float v = (i % 2) ? 1.0e-4f : 0.0f;
+        artifacts.accumPixelColor(0, 0, ColorRGB(v, 0.0f, 0.0f));
+    }
+    EXPECT_LT(artifacts.relativeError(0, 0), 0.01f);
+}
+
+TEST(ArtifactsTest, CheckpointRoundTrip) {
+    const std::string filename = "artifacts_test_checkpoint.bin";
+    Artifacts artifacts(3, 2);
+    RNG rng(3);
+    for(int i = 0; i < 10; ++i) {
+        artifacts.accumPixelColor(i % 3, i % 2, ColorRGB(rng.uniform01(), rng.uniform01(), rng.uniform01()));
+    }
+    artifacts.accumTime(2, 1, 0.25f);
+    artifacts.writeCheckpoint(filename, 1234);
+
+    Artifacts resumed(3, 2);
+    resumed.readCheckpoint(filename, 1234);
+    for(int y = 0; y < 2; ++y) {
+        for(int x = 0; x < 3; ++x) {
+            EXPECT_EQ(resumed.numSamples(x, y), artifacts.numSamples(x, y));
+            EXPECT_EQ(resumed.relativeError(x, y), artifacts.relativeError(x, y));
+        }
+    }
+
+    // Accumulation continues where it left off
+    artifacts.accumPixelColor(1, 1, ColorRGB(0.5f, 0.5f, 0.5f));
+    resumed.accumPixelColor(1, 1, ColorRGB(0.5f, 0.5f, 0.5f));
+    EXPECT_EQ(resumed.relativeError(1, 1), artifacts.relativeError(1, 1));
+
+    std::remove(filename.c_str());
+}
+
+TEST(ArtifactsTest, CheckpointRejectsMismatch) {
+    const std::string filename = "artifacts_test_checkpoint_mismatch.bin";
+    Artifacts artifacts(3, 2);
+    artifacts.writeCheckpoint(filename, 1234);
+
+    Artifacts otherScene(3, 2);
+    EXPECT_THROW(otherScene.readCheckpoint(filename, 4321), std::runtime_error);
+    Artifacts otherSize(2, 3);
+    EXPECT_THROW(otherSize.readCheckpoint(filename, 1234), std::runtime_error);
+    Artifacts missing(3, 2);
+    EXPECT_THROW(missing.readCheckpoint(filename + ".missing", 1234), std::runtime_error);
+
+    std::remove(filename.c_str());
+}
+
+// Merging the samples of a tile gives the same result as accumulating them
+// one at a time
+TEST(ArtifactsTest, MergedTileMatchesDirectAccumulation) {
+    Artifacts direct(4, 4), merged(4, 4);
+    RNG rng(5);
+    Sensor::Tile tile = { 1, 1, 3, 4 };
+
+    for(int pass = 0; pass < 3; ++pass) {
+        FilmTile film;
+        film.reset(tile);
+        for(int i = 0; i < 50; ++i) {
+            int x = tile.xmin + i % 2, y = tile.ymin + i % 3;
+            ColorRGB color(rng.uniform01(), 2.0f * rng.uniform01(), 0.5f);
+            direct.accumPixelColor(x, y, color);
+            film.accumPixelColor(x, y, color);
+        }
+        merged.mergeTile(film);
+    }
+
+    for(int y = 0; y < 4; ++y) {
+        for(int x = 0; x < 4; ++x) {
+            EXPECT_EQ(merged.numSamples(x, y), direct.numSamples(x, y));
+            if(direct.numSamples(x, y) > 1) {
+                EXPECT_NEAR(merged.relativeError(x, y), direct.relativeError(x, y), 1.0e-5f);
+            }
+        }
+    }
+}
+
+TEST(ArtifactsTest, InvalidSamplesAreCounted) {
+    FilmTile film;
+    film.reset(Sensor::Tile{ 0, 0, 2, 2 });
+    film.accumPixelColor(0, 0, ColorRGB(std::nanf(""), 0.0f, 0.0f));
+    film.accumPixelColor(0, 1, ColorRGB(0.0f, INFINITY, 0.0f));
+    film.accumPixelColor(1, 0, ColorRGB(0.0f, 0.0f, -1.0f));
+    film.accumPixelColor(1, 1, ColorRGB(1.0f, 1.0f, 1.0f));
+    EXPECT_EQ(film.invalidSamples.nan, 1u);
+    EXPECT_EQ(film.invalidSamples.inf, 1u);
+    EXPECT_EQ(film.invalidSamples.negative, 1u);
+    // Replaced with black, but still a sample of the pixel
+    EXPECT_EQ(film.pixel(0, 0).numSamples, 1u);
+    EXPECT_EQ(film.pixel(0, 0).sum.x, 0.0f);
+
+    Artifacts artifacts(2, 2);
+    artifacts.mergeTile(film);
+    artifacts.mergeTile(film);
+    EXPECT_EQ(artifacts.invalidSamples.total(), 6u);
+    EXPECT_EQ(artifacts.numSamples(1, 0), 2u);
+}
+
+// Tiles merged concurrently, overlapping one another, lose no samples
+TEST(ArtifactsTest, ConcurrentOverlappingMerges) {
+    Artifacts artifacts(8, 8);
+    const int numTiles = 200;
+    getThreadPool().parallelFor(numTiles, [&](size_t index, ThreadIndex) {
+        FilmTile film;
+        film.reset(Sensor::Tile{ uint32_t(index % 4), uint32_t(index % 3), 8, 8 });
+        for(uint32_t y = film.tile.ymin; y < film.tile.ymax; ++y) {
+            for(uint32_t x = film.tile.xmin; x < film.tile.xmax; ++x) {
+                film.accumPixelColor(x, y, ColorRGB(1.0f, 1.0f, 1.0f));
+            }
+        }
+        artifacts.mergeTile(film);
+    });
+
+    // Every tile covers the far corner, every 12th the origin
+    EXPECT_EQ(artifacts.numSamples(7, 7), uint32_t(numTiles));
+    EXPECT_EQ(artifacts.numSamples(0, 0), uint32_t((numTiles + 11) / 12));
+}
+
+// Snapshots taken while tiles merge never see part of a tile. Every tile
+// covers the whole image, so each pixel of a snapshot has the same count.
+TEST(ArtifactsTest, SnapshotDuringMergesHasWholeTiles) {
+    Artifacts artifacts(8, 8);
+    const int numTiles = 200;
+    getThreadPool().parallelFor(numTiles, [&](size_t index, ThreadIndex) {
+        if(index % 10 == 0) {
+            Artifacts snapshot = artifacts.snapshot();
+            const uint32_t numSamples = snapshot.numSamples(0, 0);
+            for(int y = 0; y < 8; ++y) {
+                for(int x = 0; x < 8; ++x) {
+                    EXPECT_EQ(snapshot.numSamples(x, y), numSamples);
+                }
+            }
+            return;
+        }
+        FilmTile film;
+        film.reset(Sensor::Tile{ 0, 0, 8, 8 });
+        for(uint32_t y = 0; y < 8; ++y) {
+            for(uint32_t x = 0; x < 8; ++x) {
+                film.accumPixelColor(x, y, ColorRGB(1.0f, 1.0f, 1.0f));
+            }
+        }
+        artifacts.mergeTile(film);
+    });
+
+    EXPECT_EQ(artifacts.snapshot().numSamples(7, 7), uint32_t(numTiles - numTiles / 10));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    setThreadPoolSize(4);
+    return RUN_ALL_TESTS();
+}
@@ -4,6 +4,7 @@
 #include "coordinate.h"
 #include "vectortypes.h"
 #include "brdf.h"
+#include "rng.h"
 
 namespace {
 
@@ -144,6 +145,62 @@ TEST(BrdfTest, HelmholtzReciprocity_LambertianBrdf) {
     }, thetaSteps, phiSteps);
 }
 
+//
+// Sampling PDFs
+//
+
+// The pdf of every BRDF integrates to 1 over the sphere, and matches the
+// pdf of the samples it draws
+template<typename B>
+void checkBrdfPdf(const B & brdf, const Direction3 & wi, const Direction3 & N)
+{
+    const unsigned int thetaSteps = 256, phiSteps = 512;
+
+    float I = integrate::overUnitSphere(
+        [&](float theta, float phi) {
+            auto wo = Direction3(coordinate::polarToEuclidean(theta, phi, 1.0f));
+            return brdf.pdf(wi, wo, N);
+        }, thetaSteps, phiSteps);
+    EXPECT_NEAR(I, 1.0f, 0.01f);
+
+    RNG rng;
+    for(int i = 0; i < 1000; ++i) {
+        brdfSample S = brdf.sample(rng.uniform2DRange01(), wi, N);
+        EXPECT_NEAR(S.pdf, brdf.pdf(wi, S.W, N), 1.0e-3f * S.pdf);
+    }
+}
+
+TEST(BrdfTest, Pdf_LambertianBrdf) {
+    Direction3 N(0, 0, 1);
+    LambertianBRDF brdf;
+    checkBrdfPdf(brdf, Direction3(0, 0, 1), N);
+    checkBrdfPdf(brdf, Direction3(0.3, -0.5, 0.4).normalized(), N);
+    brdf.importanceSample = false;
+    checkBrdfPdf(brdf, Direction3(0.3, -0.5, 0.4).normalized(), N);
+}
+
+TEST(BrdfTest, Pdf_PhongBrdf) {
+    Direction3 N(0, 0, 1);
+    for(float a : { 1.0f, 10.0f, 40.0f }) {
+        PhongBRDF brdf(a);
+        checkBrdfPdf(brdf, Direction3(0, 0, 1), N);
+        checkBrdfPdf(brdf, Direction3(0.3, -0.5, 0.4).normalized(), N);
+        brdf.importanceSample = false;
+        checkBrdfPdf(brdf, Direction3(0.3, -0.5, 0.4).normalized(), N);
+    }
+}
+
+TEST(BrdfTest, Pdf_MirrorBrdf) {
+    Direction3 N(0, 0, 1);
+    MirrorBRDF brdf;
+    Direction3 wi = Direction3(0.3, -0.5, 0.4).normalized();
+    brdfSample S = brdf.sample(vec2(0.5f, 0.5f), wi, N);
+    EXPECT_TRUE(S.isDelta());
+    EXPECT_EQ(S.pdf, 1.0f);
+    // No direction is found by evaluating the pdf
+    EXPECT_EQ(brdf.pdf(wi, S.W, N), 0.0f);
+}
+
 } // namespace
 
 int main(int argc, char **argv) {
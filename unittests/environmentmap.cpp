@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "AliasTable.h"
+#include "LatLonEnvironmentMap.h"
+#include "CubeMapEnvironmentMap.h"
+#include "constants.h"
+#include "Ray.h"
+
+namespace {
+
+// Fraction of a regular grid of (e1, e2) that draws each index
+std::vector<double> drawFrequencies(const AliasTable & table, int n)
+{
+    std::vector<double> counts(table.size(), 0.0);
+    for(int i = 0; i < n; ++i) {
+        for(int j = 0; j < n; ++j) {
+            counts[table.sample((float(i) + 0.5f) / float(n), (float(j) + 0.5f) / float(n))] += 1.0;
+        }
+    }
+    for(auto & c : counts) {
+        c /= double(n) * double(n);
+    }
+    return counts;
+}
+
+TEST(AliasTableTest, DrawsInProportionToWeights) {
+    std::vector<float> weights = { 1.0f, 0.0f, 3.0f, 6.0f, 0.5f, 2.5f, 0.0f };
+    AliasTable table;
+    table.build(weights);
+    ASSERT_EQ(table.size(), weights.size());
+
+    auto freq = drawFrequencies(table, 700);
+    for(size_t i = 0; i < weights.size(); ++i) {
+        EXPECT_FLOAT_EQ(table.probability(i), weights[i] / 13.0f);
+        EXPECT_NEAR(freq[i], weights[i] / 13.0, 2.0e-3) << i;
+    }
+    // Zero weights are never drawn
+    EXPECT_EQ(freq[1], 0.0);
+    EXPECT_EQ(freq[6], 0.0);
+}
+
+TEST(AliasTableTest, ZeroWeightsAreUniform) {
+    AliasTable table;
+    table.build(std::vector<float>(4, 0.0f));
+    auto freq = drawFrequencies(table, 100);
+    for(size_t i = 0; i < 4; ++i) {
+        EXPECT_FLOAT_EQ(table.probability(i), 0.25f);
+        EXPECT_NEAR(freq[i], 0.25, 1.0e-9);
+    }
+}
+
+TEST(AliasTableTest, Empty) {
+    AliasTable table;
+    EXPECT_TRUE(table.empty());
+    table.build({});
+    EXPECT_TRUE(table.empty());
+}
+
+// Draws directions, checking each pdf against the pdf evaluated from the
+// direction, then integrates the pdf over the sphere, which should be 1
+float checkSampledDirections(const EnvironmentMap & envmap)
+{
+    std::mt19937 engine(3);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    const int numDrawn = 10000;
+    int mismatched = 0;
+    for(int i = 0; i < numDrawn; ++i) {
+        auto sample = envmap.importanceSampleDirection(uniform(engine), uniform(engine));
+        EXPECT_NEAR(sample.direction.magnitude(), 1.0f, 1.0e-5f);
+        EXPECT_GT(sample.pdf, 0.0f);
+        // Samples on pixel edges can round into the neighboring pixel
+        if(std::abs(envmap.importanceSamplePdf(sample.direction) - sample.pdf) > sample.pdf * 1.0e-3f) {
+            ++mismatched;
+        }
+    }
+    EXPECT_LT(mismatched, numDrawn / 1000);
+
+    // Uniformly distributed directions
+    const int numSamples = 200000;
+    double sum = 0.0;
+    for(int i = 0; i < numSamples; ++i) {
+        float z = 1.0f - 2.0f * uniform(engine);
+        float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        float phi = float(constants::TWO_PI) * uniform(engine);
+        sum += envmap.importanceSamplePdf(Direction3(r * std::cos(phi), r * std::sin(phi), z));
+    }
+    return float(sum / numSamples * constants::FOUR_PI);
+}
+
+TEST(LatLonEnvironmentMapTest, ImportanceSamplePdf) {
+    std::mt19937 engine(1);
+    std::uniform_real_distribution<float> value(0.0f, 4.0f);
+    Image<float> image(64, 32, 3);
+    for(auto & v : image.data) {
+        v = value(engine);
+    }
+    // A bright spot, and a black region that is never sampled
+    image.set3(40, 10, 500.0f, 400.0f, 300.0f);
+    for(size_t x = 0; x < 8; ++x) {
+        image.set3(x, 20, 0.0f, 0.0f, 0.0f);
+    }
+
+    LatLonEnvironmentMap envmap;
+    envmap.loadFromImage(image);
+    ASSERT_TRUE(envmap.canImportanceSample());
+
+    EXPECT_NEAR(checkSampledDirections(envmap), 1.0f, 0.02f);
+
+    // Pixels are drawn in proportion to radiance times solid angle, and
+    // directions are uniform in longitude and polar angle within a pixel
+    const double PI = constants::PI;
+    auto rowSolidAngle = [&](size_t y) {
+        return constants::TWO_PI / image.width
+            * (std::cos(PI * y / image.height) - std::cos(PI * (y + 1) / image.height));
+    };
+    double total = 0.0;
+    image.forEachPixel([&](Image<float> & img, size_t x, size_t y) {
+        total += img.channelSum(x, y) * rowSolidAngle(y);
+    });
+    auto expectedPdf = [&](const vec2 & pixel) {
+        size_t x = size_t(pixel.x), y = size_t(pixel.y);
+        double probability = image.channelSum(x, y) * rowSolidAngle(y) / total;
+        double pixelSize = (constants::TWO_PI / image.width) * (PI / image.height);
+        return probability / (pixelSize * std::sin(pixel.y / image.height * PI));
+    };
+
+    float pdf;
+    std::mt19937 engine2(2);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    for(int i = 0; i < 10000; ++i) {
+        vec2 pixel = envmap.importanceSample(uniform(engine2), uniform(engine2), pdf);
+        EXPECT_FALSE(size_t(pixel.y) == 20 && pixel.x < 8.0f);
+        EXPECT_NEAR(pdf, expectedPdf(pixel), pdf * 1.0e-3f);
+    }
+}
+
+TEST(CubeMapEnvironmentMapTest, ImportanceSamplePdf) {
+    CubeMapEnvironmentMap envmap;
+    envmap.loadFromDirectionFiles("grayramp", "grayramp", "grayramp",
+                                  "grayramp", "grayramp", "grayramp");
+    ASSERT_TRUE(envmap.canImportanceSample());
+
+    EXPECT_NEAR(checkSampledDirections(envmap), 1.0f, 0.02f);
+}
+
+TEST(CubeMapEnvironmentMapTest, SampledDirectionsLandOnTheirTexel) {
+    CubeMapEnvironmentMap envmap;
+    envmap.loadFromDirectionFiles("grayramp", "grayramp", "grayramp",
+                                  "grayramp", "grayramp", "grayramp");
+
+    // Each face has a ramp brightening along u, so the sampled directions
+    // should favor the bright half of every face
+    std::mt19937 engine(4);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    int bright = 0;
+    const int numSamples = 10000;
+    for(int i = 0; i < numSamples; ++i) {
+        auto sample = envmap.importanceSampleDirection(uniform(engine), uniform(engine));
+        Ray ray(Position3(0.0f, 0.0f, 0.0f), sample.direction);
+        if(envmap.sampleRay(ray).r > 0.25f) {
+            ++bright;
+        }
+    }
+    EXPECT_GT(bright, numSamples * 3 / 4);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
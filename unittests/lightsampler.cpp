@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "LightSampler.h"
+#include "TriangleLight.h"
+#include "scene.h"
+#include "constants.h"
+
+namespace {
+
+TEST(LightSamplerTest, ChoosesLightsByPower) {
+    MaterialArray materials;
+    materials.push_back(Material::makeEmissive(RadianceRGB(1.0f, 1.0f, 1.0f)));
+    materials.push_back(Material::makeEmissive(RadianceRGB(6.0f, 3.0f, 0.0f)));
+    TextureArray textures;
+
+    std::vector<PointLight> pointLights;
+    pointLights.emplace_back(Position3(0.0f, 0.0f, 0.0f), RadianceRGB(1.0f, 1.0f, 1.0f));
+    pointLights.emplace_back(Position3(1.0f, 0.0f, 0.0f), RadianceRGB(0.0f, 0.0f, 0.0f));
+    pointLights.emplace_back(Position3(2.0f, 0.0f, 0.0f), RadianceRGB(2.0f, 2.0f, 2.0f));
+
+    std::vector<DiskLight> diskLights;
+    diskLights.emplace_back(Position3(0.0f, 1.0f, 0.0f), Direction3(0.0f, -1.0f, 0.0f), 0.5f, 0);
+    diskLights.emplace_back(Position3(0.0f, 2.0f, 0.0f), Direction3(0.0f, -1.0f, 0.0f), 2.0f, 1);
+
+    std::vector<TriangleLight> triangleLights(1);
+    triangleLights[0].area = 3.0f;
+    triangleLights[0].material = 1;
+
+    LightSampler sampler;
+    sampler.build(pointLights, diskLights, triangleLights, materials, textures);
+    ASSERT_EQ(sampler.size(), 6u);
+
+    const float PI = float(constants::PI);
+    std::vector<float> power = {
+        4.0f * PI * 3.0f,
+        0.0f,
+        4.0f * PI * 6.0f,
+        2.0f * PI * (PI * 0.25f) * 3.0f,
+        2.0f * PI * (PI * 4.0f) * 9.0f,
+        2.0f * PI * 3.0f * 9.0f
+    };
+    float total = 0.0f;
+    for(float p : power) {
+        total += p;
+    }
+
+    EXPECT_FLOAT_EQ(LightSampler::power(pointLights[0]), power[0]);
+    EXPECT_FLOAT_EQ(LightSampler::power(diskLights[1], materials, textures), power[4]);
+
+    std::vector<double> counts(sampler.size(), 0.0);
+    const int n = 400;
+    for(int i = 0; i < n; ++i) {
+        for(int j = 0; j < n; ++j) {
+            counts[sampler.sample((i + 0.5f) / n, (j + 0.5f) / n)] += 1.0;
+        }
+    }
+    for(uint32_t i = 0; i < sampler.size(); ++i) {
+        EXPECT_NEAR(sampler.probability(i), power[i] / total, 1.0e-6f) << i;
+        EXPECT_NEAR(counts[i] / (double(n) * n), power[i] / total, 2.0e-3) << i;
+    }
+    // Lights without power are never chosen
+    EXPECT_EQ(counts[1], 0.0);
+}
+
+TEST(LightSamplerTest, BuiltWithSceneAccelerators) {
+    Scene scene;
+    scene.materials.push_back(Material::makeEmissive(RadianceRGB(1.0f, 1.0f, 1.0f)));
+    scene.pointLights.emplace_back(Position3(0.0f, 0.0f, 0.0f), RadianceRGB(1.0f, 1.0f, 1.0f));
+    scene.diskLights.emplace_back(Position3(0.0f, 1.0f, 0.0f), Direction3(0.0f, -1.0f, 0.0f), 1.0f, 0);
+    EXPECT_TRUE(scene.lightSampler.empty());
+
+    scene.buildAccelerators();
+    EXPECT_EQ(scene.lightSampler.size(), 2u);
+}
+
+// Mesh of three triangles in the z = 0 plane, the first and last emissive
+std::shared_ptr<TriangleMesh> makeMesh(MaterialID emissive, MaterialID diffuse)
+{
+    auto mesh = std::make_shared<TriangleMesh>();
+    auto & data = *mesh->meshData;
+    data.vertices = {
+        Position3(0.0f, 0.0f, 0.0f), Position3(1.0f, 0.0f, 0.0f), Position3(0.0f, 1.0f, 0.0f),
+        Position3(2.0f, 0.0f, 0.0f), Position3(3.0f, 0.0f, 0.0f), Position3(2.0f, 2.0f, 0.0f)
+    };
+    data.indices.vertex = { 0, 1, 2, 3, 4, 5, 0, 2, 5 };
+    data.indices.texcoord.assign(9, TriangleMeshData::NoTexCoord);
+    data.faces.material = { emissive, diffuse, emissive };
+    data.bounds = Slab(Position3(0.0f, 0.0f, 0.0f), Position3(3.0f, 2.0f, 0.0f));
+    return mesh;
+}
+
+TEST(TriangleLightTest, GathersEmissiveTrianglesOfPlacedMeshes) {
+    Scene scene;
+    scene.materials.push_back(Material::makeEmissive(RadianceRGB(1.0f, 1.0f, 1.0f)));
+    scene.materials.push_back(Material::makeDiffuse(ReflectanceRGB(0.5f, 0.5f, 0.5f)));
+
+    // Placed directly
+    auto mesh = makeMesh(0, 1);
+    mesh->transform = Transform::translation(vec3(0.0f, 0.0f, 5.0f));
+    scene.objects.push_back(mesh);
+
+    // Instanced through an accelerator
+    auto bvh = std::make_shared<TriangleMeshBVH>(mesh);
+    bvh->build();
+    auto instance = std::make_shared<TraceableInstance>(bvh);
+    instance->transform = Transform::translation(vec3(10.0f, 0.0f, 0.0f));
+    scene.objects.push_back(instance);
+
+    // Non-emissive override
+    auto overridden = makeMesh(0, 1);
+    overridden->material = 1;
+    scene.objects.push_back(overridden);
+
+    scene.buildAccelerators();
+    ASSERT_EQ(scene.triangleLights.size(), 4u);
+    EXPECT_EQ(scene.lightSampler.size(), 4u);
+    EXPECT_EQ(scene.numLights(), 4u);
+
+    uint32_t index;
+    ASSERT_TRUE(findTriangleLight(scene.triangleLights, instance.get(), 2, index));
+    const auto & light = scene.triangleLights[index];
+    EXPECT_EQ(light.object, instance.get());
+    EXPECT_EQ(light.triangle, 2u);
+    EXPECT_EQ(light.material, 0u);
+    EXPECT_FLOAT_EQ(light.vertices[2].x, 12.0f);
+    EXPECT_FLOAT_EQ(light.vertices[2].y, 2.0f);
+    EXPECT_FLOAT_EQ(light.area, 1.0f);
+    EXPECT_NEAR(std::abs(light.normal.z), 1.0f, 1.0e-6f);
+    EXPECT_FALSE(light.hasTexCoords);
+
+    ASSERT_TRUE(findTriangleLight(scene.triangleLights, mesh.get(), 0, index));
+    EXPECT_FLOAT_EQ(scene.triangleLights[index].vertices[0].z, 5.0f);
+    EXPECT_FLOAT_EQ(scene.triangleLights[index].area, 0.5f);
+
+    EXPECT_FALSE(findTriangleLight(scene.triangleLights, instance.get(), 1, index));
+    EXPECT_FALSE(findTriangleLight(scene.triangleLights, overridden.get(), 0, index));
+}
+
+TEST(TriangleLightTest, InstanceMaterialOverridesSharedMesh) {
+    Scene scene;
+    scene.materials.push_back(Material::makeEmissive(RadianceRGB(1.0f, 1.0f, 1.0f)));
+    scene.materials.push_back(Material::makeDiffuse(ReflectanceRGB(0.5f, 0.5f, 0.5f)));
+
+    auto mesh = makeMesh(0, 1);
+    auto bvh = std::make_shared<TriangleMeshBVH>(mesh);
+    bvh->build();
+
+    auto emissive = std::make_shared<TraceableInstance>(bvh);
+    emissive->material = 0;
+    scene.objects.push_back(emissive);
+
+    auto diffuse = std::make_shared<TraceableInstance>(bvh);
+    diffuse->material = 1;
+    diffuse->transform = Transform::translation(vec3(10.0f, 0.0f, 0.0f));
+    scene.objects.push_back(diffuse);
+
+    scene.buildAccelerators();
+    ASSERT_EQ(scene.triangleLights.size(), 3u);
+    for(const auto & light : scene.triangleLights) {
+        EXPECT_EQ(light.object, emissive.get());
+        EXPECT_EQ(light.material, 0u);
+    }
+
+    // Hits take the material of the instance, not of the face
+    const Direction3 down(0.0f, 0.0f, -1.0f);
+    RayIntersection intersection;
+    ASSERT_TRUE(findIntersectionWorldRay(Ray(Position3(2.3f, 0.5f, 1.0f), down), scene, 0.0f, intersection));
+    EXPECT_EQ(intersection.object, emissive.get());
+    EXPECT_EQ(intersection.material, 0u);
+    ASSERT_TRUE(findIntersectionWorldRay(Ray(Position3(10.2f, 0.2f, 1.0f), down), scene, 0.0f, intersection));
+    EXPECT_EQ(intersection.object, diffuse.get());
+    EXPECT_EQ(intersection.material, 1u);
+}
+
+TEST(TriangleLightTest, EmissionTextureScalesPower) {
+    // Left half dark, right half bright
+    Image<float> image(16, 16, 3);
+    image.forEachPixel([](Image<float> & img, size_t x, size_t y) {
+        float v = x < 8 ? 0.0f : 1.0f;
+        img.set3(x, y, v, v, v);
+    });
+    TextureArray textures;
+    textures.push_back(std::make_shared<MipTexture>(image, MipTexture::Float));
+
+    MaterialArray materials;
+    materials.push_back(Material::makeEmissive(RadianceRGB(2.0f, 2.0f, 2.0f)));
+    materials[0].emissionTexture = 0;
+
+    EXPECT_FLOAT_EQ(materials[0].emission(textures, TextureCoordinate{ 0.25f, 0.5f }).r, 0.0f);
+    EXPECT_FLOAT_EQ(materials[0].emission(textures, TextureCoordinate{ 0.75f, 0.5f }).g, 2.0f);
+
+    // Triangle covering the whole texture averages it
+    TriangleLight light;
+    light.area = 1.0f;
+    light.material = 0;
+    light.hasTexCoords = true;
+    light.texcoords[0] = { 0.0f, 0.0f };
+    light.texcoords[1] = { 1.0f, 0.0f };
+    light.texcoords[2] = { 0.5f, 1.0f };
+
+    const float PI = float(constants::PI);
+    EXPECT_NEAR(LightSampler::power(light, materials, textures), 2.0f * PI * 3.0f, 0.2f * 2.0f * PI * 3.0f);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+#include "MipTexture.h"
+#include "half.h"
+
+namespace {
+
+Image<float> randomImage(size_t w, size_t h, int channels, float scale, uint32_t seed)
+{
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<float> value(0.0f, scale);
+    Image<float> image(w, h, channels);
+    for(auto & v : image.data) {
+        v = value(engine);
+    }
+    return image;
+}
+
+TEST(HalfTest, RoundTrip) {
+    const float exact[] = { 0.0f, 1.0f, -2.5f, 0.5f, 1024.0f, 65504.0f, -65504.0f, 6.103515625e-05f, 5.9604644775390625e-08f };
+    for(float f : exact) {
+        EXPECT_EQ(halfToFloat(floatToHalf(f)), f) << f;
+    }
+    for(float f : { 0.1f, 3.14159f, -123.456f, 1.0e-4f, 40000.0f }) {
+        EXPECT_NEAR(halfToFloat(floatToHalf(f)), f, std::abs(f) * 1.0e-3f) << f;
+    }
+    EXPECT_TRUE(std::isinf(halfToFloat(floatToHalf(1.0e6f))));
+    // Ties round to even
+    EXPECT_EQ(floatToHalf(1.0f + 1.0f / 2048.0f), floatToHalf(1.0f));
+}
+
+TEST(MipTextureTest, CompactFormat) {
+    auto ramp = testpattern::grayRamp<float>(256, 16);
+    EXPECT_EQ(MipTexture::compactFormat(ramp), MipTexture::UInt8);
+    EXPECT_EQ(MipTexture::compactFormat(randomImage(8, 8, 3, 10.0f, 1)), MipTexture::Half);
+    auto huge = randomImage(8, 8, 3, 1.0f, 2);
+    huge.data[5] = 1.0e6f;
+    EXPECT_EQ(MipTexture::compactFormat(huge), MipTexture::Float);
+}
+
+TEST(MipTextureTest, FinestLevelMatchesImageLookup) {
+    auto image = randomImage(37, 21, 3, 1.0f, 3);
+    image.outOfBoundsBehavior = Image<float>::Repeat;
+    MipTexture texture(image, MipTexture::Float);
+
+    std::mt19937 engine(4);
+    std::uniform_real_distribution<float> coord(-2.0f, 3.0f);
+    for(int i = 0; i < 1000; ++i) {
+        float u = coord(engine), v = coord(engine);
+        auto expected = image.lerpUV3(u, v);
+        auto actual = texture.lerpUV3(u, v);
+        EXPECT_NEAR(actual.r, expected.r, 1.0e-4f) << u << ", " << v;
+        EXPECT_NEAR(actual.g, expected.g, 1.0e-4f) << u << ", " << v;
+        EXPECT_NEAR(actual.b, expected.b, 1.0e-4f) << u << ", " << v;
+        EXPECT_NEAR(texture.lerpUV(u, v, 1), expected.g, 1.0e-4f);
+    }
+    EXPECT_FLOAT_EQ(texture.get(3, 4, 2), image.get(3, 4, 2));
+}
+
+TEST(MipTextureTest, LevelsAverageTheFinestLevel) {
+    auto image = randomImage(16, 8, 1, 1.0f, 5);
+    MipTexture texture(image, MipTexture::Float);
+    ASSERT_EQ(texture.numLevels(), 5u);
+    EXPECT_EQ(texture.levels[1].width, 8u);
+    EXPECT_EQ(texture.levels[3].height, 1u);
+    EXPECT_EQ(texture.levels[4].width, 1u);
+
+    double mean = 0.0;
+    for(float v : image.data) {
+        mean += v;
+    }
+    mean /= image.data.size();
+
+    // A footprint covering the whole texture reads the 1x1 level
+    EXPECT_FLOAT_EQ(texture.mipLevel(1.0f), 4.0f);
+    EXPECT_NEAR(texture.lerpUV(0.3f, 0.7f, 0, 1.0f), mean, 1.0e-5);
+    EXPECT_FLOAT_EQ(texture.mipLevel(0.0f), 0.0f);
+    EXPECT_FLOAT_EQ(texture.mipLevel(2.0f / 16.0f), 1.0f);
+}
+
+TEST(MipTextureTest, CompactStorage) {
+    auto image = testpattern::grayRamp<float>(256, 256);
+    MipTexture full(image, MipTexture::Float);
+    MipTexture half(image, MipTexture::Half);
+    MipTexture bytes(image, MipTexture::UInt8);
+    EXPECT_EQ(full.storageBytes(), 4 * bytes.storageBytes());
+    EXPECT_EQ(half.storageBytes(), 2 * bytes.storageBytes());
+    // The pyramid adds about a third
+    EXPECT_LT(bytes.storageBytes(), size_t(256 * 256 * 3 * 4 / 3 + 4096));
+
+    // 8-bit values decode exactly
+    for(size_t x = 0; x < 256; x += 17) {
+        EXPECT_FLOAT_EQ(bytes.get(x, 9, 0), image.get(x, 9, 0));
+    }
+
+    // Decoding applies the offset and scale
+    MipTexture normals(image, MipTexture::UInt8, -1.0f, 2.0f);
+    EXPECT_FLOAT_EQ(normals.get(0, 0, 0), -1.0f);
+    EXPECT_FLOAT_EQ(normals.get(255, 0, 0), 1.0f);
+}
+
+TEST(MipTextureTest, PagedTextureMatchesResident) {
+    auto image = randomImage(100, 60, 4, 1.0f, 6);
+    MipTexture resident(image, MipTexture::Half);
+    MipTexture paged(image, MipTexture::Half);
+
+    // Budget for a few tiles per shard, far less than the texture
+    auto cache = std::make_shared<TextureTileCache>(64 * paged.tileSizeInBytes());
+    paged.pageOut(cache);
+    ASSERT_TRUE(paged.isPagedOut());
+    EXPECT_EQ(paged.residentBytes(), 0u);
+
+    const int numThreads = 4;
+    std::vector<std::thread> threads;
+    for(int t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            std::mt19937 engine(7 + t);
+            std::uniform_real_distribution<float> coord(0.0f, 1.0f);
+            std::uniform_real_distribution<float> footprint(0.0f, 0.2f);
+            for(int i = 0; i < 5000; ++i) {
+                float u = coord(engine), v = coord(engine), f = footprint(engine);
+                float expected[MipTexture::MAX_CHANNELS], actual[MipTexture::MAX_CHANNELS];
+                resident.lookupUV(u, v, f, expected);
+                paged.lookupUV(u, v, f, actual);
+                for(int c = 0; c < 4; ++c) {
+                    ASSERT_EQ(actual[c], expected[c]);
+                }
+            }
+        });
+    }
+    for(auto & thread : threads) {
+        thread.join();
+    }
+
+    auto stats = cache->stats();
+    EXPECT_GT(stats.misses, 0u);
+    EXPECT_GT(stats.evictions, 0u);
+    EXPECT_LE(stats.residentBytes, cache->maxBytes);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
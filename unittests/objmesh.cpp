@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include "TriangleMesh.h"
+#include "texture.h"
+
+namespace {
+
+class OBJMeshTest : public ::testing::Test {
+    protected:
+        virtual void TearDown() {
+            std::remove(objFile.c_str());
+            std::remove(mtlFile.c_str());
+            std::remove((objFile + ".fluxmesh").c_str());
+        }
+
+        void writeFile(const std::string & filename, const std::string & contents) {
+            std::ofstream out(filename);
+            out << contents;
+        }
+
+        bool load() {
+            return loadTriangleMeshFromOBJ(mesh, materials, meshDataCache, textureCache, ".", objFile);
+        }
+
+        // Two triangles, with a line per face material (empty for none)
+        std::string twoTriangles(const std::string & header,
+                                 const std::string & firstMaterial,
+                                 const std::string & secondMaterial) {
+            return header +
+                "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\n"
+                "vn 0 0 1\n" +
+                firstMaterial +
+                "f 1//1 2//1 3//1\n" +
+                secondMaterial +
+                "f 2//1 4//1 3//1\n";
+        }
+
+        TriangleMesh mesh;
+        MaterialArray materials;
+        TriangleMeshDataCache meshDataCache;
+        TextureCache textureCache;
+        const std::string objFile = "objmesh_test.obj";
+        const std::string mtlFile = "objmesh_test.mtl";
+};
+
+} // namespace
+
+TEST_F(OBJMeshTest, NoMaterialLibrary) {
+    // Materials already in the array must not be picked up by the mesh
+    materials.push_back(Material::makeMirror());
+    writeFile(objFile, twoTriangles("", "", ""));
+    ASSERT_TRUE(load());
+
+    const auto & faceMaterials = mesh.meshData->faces.material;
+    ASSERT_EQ(faceMaterials.size(), 2u);
+    EXPECT_EQ(faceMaterials[0], NoMaterial);
+    EXPECT_EQ(faceMaterials[1], NoMaterial);
+}
+
+TEST_F(OBJMeshTest, FacesWithAndWithoutMaterial) {
+    writeFile(mtlFile, "newmtl red\nillum 1\nKd 1 0 0\n");
+    writeFile(objFile, twoTriangles("mtllib " + mtlFile + "\n", "", "usemtl red\n"));
+    ASSERT_TRUE(load());
+
+    const auto & faceMaterials = mesh.meshData->faces.material;
+    ASSERT_EQ(faceMaterials.size(), 2u);
+    EXPECT_EQ(faceMaterials[0], NoMaterial);
+    ASSERT_NE(faceMaterials[1], NoMaterial);
+    ASSERT_LT(faceMaterials[1], materials.size());
+
+    auto D = materials[faceMaterials[1]].diffuse(textureCache.textures, TextureCoordinate{ 0.0f, 0.0f });
+    EXPECT_EQ(D.r, 1.0f);
+    EXPECT_EQ(D.g, 0.0f);
+    EXPECT_EQ(D.b, 0.0f);
+}
+
+TEST_F(OBJMeshTest, EditedMaterialLibraryInvalidatesCache) {
+    meshDataCache.diskCache = true;
+    writeFile(mtlFile, "newmtl red\nillum 1\nKd 1 0 0\n");
+    writeFile(objFile, twoTriangles("mtllib " + mtlFile + "\n", "usemtl red\n", ""));
+    ASSERT_TRUE(load());
+
+    // Only the material library changes
+    writeFile(mtlFile, "newmtl red\nillum 1\nKd 0 0.5 0\n");
+    mesh = TriangleMesh();
+    materials.clear();
+    ASSERT_TRUE(load());
+
+    const MaterialID material = mesh.meshData->faces.material[0];
+    ASSERT_LT(material, materials.size());
+    auto D = materials[material].diffuse(textureCache.textures, TextureCoordinate{ 0.0f, 0.0f });
+    EXPECT_EQ(D.r, 0.0f);
+    EXPECT_EQ(D.g, 0.5f);
+    EXPECT_EQ(D.b, 0.0f);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
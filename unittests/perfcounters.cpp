@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "PerfCounters.h"
+#include "scene.h"
+#include "Sampler.h"
+#include "Renderer.h"
+#include "WavefrontRenderer.h"
+#include "TriangleMesh.h"
+#include "TriangleMeshBVH.h"
+
+namespace {
+
+TEST(PerfCountersTest, CountsOfThreadsAddUp) {
+    perf::reset();
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 8; ++t) {
+        threads.emplace_back([]() {
+            for(int i = 0; i < 1000; ++i) {
+                perf::count(perf::ShadowRays);
+                perf::count(perf::NodesVisited, 3);
+            }
+        });
+    }
+    for(auto & thread : threads) {
+        thread.join();
+    }
+    perf::count(perf::CameraRays, 5);
+
+    auto report = perf::report();
+    EXPECT_EQ(report[perf::ShadowRays], 8000u);
+    EXPECT_EQ(report[perf::NodesVisited], 24000u);
+    EXPECT_EQ(report[perf::CameraRays], 5u);
+    EXPECT_EQ(report.rays(), 8005u);
+
+    perf::reset();
+    report = perf::report();
+    for(auto n : report.counts) {
+        EXPECT_EQ(n, 0u);
+    }
+}
+
+// Threads that exit free their blocks for later threads, and their counts
+// are kept
+TEST(PerfCountersTest, ExitedThreadsFreeTheirBlocks) {
+    perf::reset();
+    // Many more threads than blocks, one after another
+    for(int t = 0; t < 1000; ++t) {
+        std::thread([]() {
+            perf::count(perf::ShadowRays);
+            EXPECT_FALSE(perf::threadBlock().shared);
+        }).join();
+    }
+    EXPECT_EQ(perf::report()[perf::ShadowRays], 1000u);
+}
+
+TEST(PerfCountersTest, PhasesAddUp) {
+    perf::reset();
+    perf::recordPhase(perf::LoadPhase, 1.0);
+    perf::recordPhase(perf::TracePhase, 2.0);
+    perf::recordPhase(perf::TracePhase, 2.0);
+    perf::count(perf::CameraRays, 3000000);
+    perf::count(perf::BounceRays, 1000000);
+
+    auto report = perf::report();
+    ASSERT_EQ(report.phases.size(), 2u);
+    EXPECT_EQ(report.phases[0].first, perf::LoadPhase);
+    EXPECT_DOUBLE_EQ(report.phaseTime(perf::TracePhase), 4.0);
+    EXPECT_DOUBLE_EQ(report.phaseTime(perf::OutputPhase), 0.0);
+    EXPECT_DOUBLE_EQ(report.megaRaysPerSecond(), 1.0);
+
+    const std::string json = report.json();
+    for(unsigned int counter = 0; counter < perf::NumCounters; ++counter) {
+        EXPECT_NE(json.find(perf::counterName(perf::Counter(counter))), std::string::npos);
+    }
+    EXPECT_NE(json.find("\"load\""), std::string::npos);
+    EXPECT_NE(json.find("3000000"), std::string::npos);
+    perf::reset();
+}
+
+// Diffuse floor of two triangles in a BVH, lit from above
+void makeScene(Scene & scene)
+{
+    scene.materials.push_back(Material::makeDiffuse(ReflectanceRGB(0.5f, 0.5f, 0.5f)));
+    auto mesh = std::make_shared<TriangleMesh>();
+    auto & data = *mesh->meshData;
+    data.vertices = {
+        Position3(-5.0f, 0.0f, -5.0f), Position3(5.0f, 0.0f, -5.0f),
+        Position3(5.0f, 0.0f, 5.0f), Position3(-5.0f, 0.0f, 5.0f)
+    };
+    data.indices.vertex = { 0, 2, 1, 0, 3, 2 };
+    data.indices.texcoord.assign(6, TriangleMeshData::NoTexCoord);
+    data.faces.material = { 0, 0 };
+    data.bounds = Slab(Position3(-5.0f, 0.0f, -5.0f), Position3(5.0f, 0.0f, 5.0f));
+    auto bvh = std::make_shared<TriangleMeshBVH>(mesh);
+    bvh->build();
+    scene.objects.push_back(bvh);
+    scene.pointLights.emplace_back(Position3(0.0f, 3.0f, 0.0f), RadianceRGB(1.0f, 1.0f, 1.0f));
+    scene.buildAccelerators();
+}
+
+TEST(PerfCountersTest, RenderersCountTheirWork) {
+    Scene scene;
+    makeScene(scene);
+    Renderer renderer;
+    renderer.maxDepth = 2;
+    renderer.russianRouletteChance = 0.0f;
+    WavefrontRenderer wavefrontRenderer(renderer);
+    RandomSampler sampler(5);
+
+    const Ray ray(Position3(0.0f, 2.0f, 0.0f), Direction3(0.1f, -1.0f, 0.2f).normalized());
+    const uint32_t numRays = 100;
+
+    for(bool wavefront : { false, true }) {
+        perf::reset();
+        WavefrontRenderer::CameraRayBatch batch;
+        for(uint32_t si = 0; si < numRays; ++si) {
+            if(wavefront) {
+                batch.rays.push_back(ray);
+                continue;
+            }
+            RayIntersection intersection;
+            RadianceRGB Lo;
+            sampler.startPixelSample(PixelSample{ 0, 0, si });
+            renderer.traceCameraRay(scene, sampler, ray, 0.0f, 1, { VaccuumMedium }, intersection, Lo);
+        }
+        if(wavefront) {
+            wavefrontRenderer.traceCameraRays(scene, sampler, 0.0f, 1, { VaccuumMedium }, batch);
+        }
+
+        auto report = perf::report();
+        EXPECT_EQ(report[perf::CameraRays], numRays) << wavefront;
+        // Every camera ray hits the floor and is shaded and lit
+        EXPECT_GE(report[perf::ShadingCalls], numRays) << wavefront;
+        EXPECT_GE(report[perf::ShadowRays], numRays) << wavefront;
+        // Paths continue past the floor
+        EXPECT_GT(report[perf::BounceRays], 0u) << wavefront;
+        EXPECT_EQ(report[perf::EnvMapRays], 0u) << wavefront;
+        EXPECT_GE(report[perf::NodesVisited], numRays) << wavefront;
+        EXPECT_GE(report[perf::TriangleTests], numRays) << wavefront;
+    }
+    perf::reset();
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,4 +1,7 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
+#include <cmath>
 #include "rng.h"
 
 namespace {
@@ -62,6 +65,92 @@ TEST(RandomTest, UniformUnitSurfaceUnitSphere) {
     }
 }
 
+TEST(RandomTest, Uniform01IsHalfOpen) {
+    RNG rng;
+    double sum = 0.0;
+    const int n = 100000;
+    for(int i = 0; i < n; ++i) {
+        float e = rng.uniform01();
+        ASSERT_GE(e, 0.0f);
+        ASSERT_LT(e, 1.0f);
+        sum += e;
+    }
+    EXPECT_NEAR(sum / n, 0.5, 0.01);
+}
+
+TEST(RandomTest, GaussianMeanAndDeviation) {
+    RNG rng;
+    double sum = 0.0, sumSq = 0.0;
+    const int n = 100000;
+    for(int i = 0; i < n; ++i) {
+        float e = rng.gaussian(2.0f, 3.0f);
+        ASSERT_TRUE(std::isfinite(e));
+        sum += e;
+        sumSq += e * e;
+    }
+    double mean = sum / n;
+    double variance = sumSq / n - mean * mean;
+    EXPECT_NEAR(mean, 2.0, 0.05);
+    EXPECT_NEAR(std::sqrt(variance), 3.0, 0.05);
+}
+
+TEST(RandomTest, SameSeedSameSequence) {
+    RNG a(1234, 5), b(1234, 5), c(1234, 6), d(1235, 5);
+    int sameAsC = 0, sameAsD = 0;
+    for(int i = 0; i < 100; ++i) {
+        uint32_t va = a.next32();
+        EXPECT_EQ(va, b.next32());
+        sameAsC += va == c.next32();
+        sameAsD += va == d.next32();
+    }
+    EXPECT_LT(sameAsC, 2);
+    EXPECT_LT(sameAsD, 2);
+}
+
+TEST(RandomTest, DefaultConstructedIsReproducible) {
+    RNG a, b;
+    for(int i = 0; i < 100; ++i) {
+        EXPECT_EQ(a.next32(), b.next32());
+    }
+}
+
+TEST(RandomTest, ReseedRestartsSequence) {
+    RNG rng(99);
+    uint32_t first = rng.next32();
+    rng.next32();
+    rng.seed(99);
+    EXPECT_EQ(first, rng.next32());
+}
+
+TEST(RandomTest, PixelSamplesAreReproducibleAndDistinct) {
+    // Same pixel sample gives the same sequence no matter what else was drawn
+    RNG a = RNG::forPixelSample(10, 20, 3);
+    RNG other = RNG::forPixelSample(11, 20, 3);
+    other.uniform01();
+    RNG b = RNG::forPixelSample(10, 20, 3);
+    for(int i = 0; i < 20; ++i) {
+        EXPECT_EQ(a.next32(), b.next32());
+    }
+
+    // Neighboring pixels, samples and seeds start differently
+    std::vector<uint32_t> firsts;
+    for(uint32_t y = 0; y < 8; ++y) {
+        for(uint32_t x = 0; x < 8; ++x) {
+            for(uint32_t s = 0; s < 4; ++s) {
+                for(uint64_t seed = 0; seed < 2; ++seed) {
+                    firsts.push_back(RNG::forPixelSample(x, y, s, seed).next32());
+                }
+            }
+        }
+    }
+    std::sort(firsts.begin(), firsts.end());
+    EXPECT_EQ(std::unique(firsts.begin(), firsts.end()), firsts.end());
+}
+
+TEST(RandomTest, StateIsSmall) {
+    EXPECT_LE(sizeof(RNG), 16u);
+}
+
 } // namespace
 
 int main(int argc, char **argv) {
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "vectortypes.h"
+#include "scene.h"
+#include "SyntheticMeshes.h"
+
+namespace {
+
+// Scene with spheres, slabs, disk lights, and many instances of one shared mesh BVH
+class RayTraceableBVHTest : public ::testing::Test {
+    protected:
+        virtual void SetUp() {
+            std::mt19937 engine(1234);
+            std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+            std::uniform_real_distribution<float> size(0.1f, 1.0f);
+            std::uniform_real_distribution<float> angle(0.0f, 6.0f);
+
+            for(int i = 0; i < 50; ++i) {
+                auto sphere = std::make_shared<Sphere>(Position3(position(engine), position(engine), position(engine)), size(engine));
+                scene.objects.push_back(sphere);
+            }
+
+            for(int i = 0; i < 20; ++i) {
+                Position3 p(position(engine), position(engine), position(engine));
+                auto slab = std::make_shared<Slab>(p, p + Direction3(size(engine), size(engine), size(engine)));
+                slab->transform = Transform::rotation(vec3(0.0f, 1.0f, 0.0f), angle(engine));
+                scene.objects.push_back(slab);
+            }
+
+            auto mesh = makeRandomSoup(500, 0.2f, 99);
+            auto meshBVH = std::make_shared<TriangleMeshBVH>(mesh);
+            meshBVH->build();
+
+            for(int i = 0; i < 40; ++i) {
+                auto instance = std::make_shared<TraceableInstance>(meshBVH);
+                instance->transform = compose(Transform::translation(vec3(position(engine), position(engine), position(engine))),
+                                              compose(Transform::rotation(vec3(1.0f, 0.0f, 0.0f), angle(engine)),
+                                                      Transform::scale(2.0f, 1.0f, 0.5f)));
+                scene.objects.push_back(instance);
+            }
+
+            for(int i = 0; i < 10; ++i) {
+                scene.diskLights.emplace_back(Position3(position(engine), position(engine), position(engine)),
+                                              Direction3(0.3f, -1.0f, 0.2f).normalized(), size(engine));
+            }
+        }
+
+        Ray randomRay(std::mt19937 & engine) {
+            std::uniform_real_distribution<float> position(-12.0f, 12.0f);
+            std::normal_distribution<float> direction;
+            return Ray(Position3(position(engine), position(engine), position(engine)),
+                       Direction3(direction(engine), direction(engine), direction(engine)).normalized());
+        }
+
+        Scene scene;
+};
+
+TEST_F(RayTraceableBVHTest, ClosestHitMatchesLinearSearch) {
+    std::mt19937 engine(5);
+    std::vector<Ray> rays;
+    for(int i = 0; i < 2000; ++i) {
+        rays.push_back(randomRay(engine));
+    }
+
+    // Reference results before the accelerators are built
+    ASSERT_FALSE(scene.objectsBVH.isBuilt());
+    std::vector<RayIntersection> expected(rays.size());
+    std::vector<bool> expectedHit(rays.size());
+    for(size_t i = 0; i < rays.size(); ++i) {
+        expectedHit[i] = findIntersectionWorldRay(rays[i], scene, 0.0f, expected[i]);
+    }
+
+    scene.buildAccelerators();
+    ASSERT_TRUE(scene.objectsBVH.isBuilt());
+    EXPECT_TRUE(scene.objectsBVH.bvh.nodesCoverAllPrimitives(scene.objects.size() + scene.diskLights.size()));
+
+    unsigned int numHits = 0;
+    for(size_t i = 0; i < rays.size(); ++i) {
+        RayIntersection actual;
+        bool hit = findIntersectionWorldRay(rays[i], scene, 0.0f, actual);
+        ASSERT_EQ(expectedHit[i], hit);
+        if(hit) {
+            EXPECT_NEAR(expected[i].distance, actual.distance, 1.0e-4f * expected[i].distance);
+            numHits++;
+        }
+    }
+    EXPECT_GT(numHits, 100u);
+}
+
+TEST_F(RayTraceableBVHTest, AnyHitMatchesLinearSearch) {
+    std::mt19937 engine(6);
+    std::vector<Ray> rays;
+    std::vector<bool> expected;
+    for(int i = 0; i < 2000; ++i) {
+        rays.push_back(randomRay(engine));
+        expected.push_back(intersectsWorldRay(rays.back(), scene, 0.0f, 8.0f));
+    }
+
+    scene.buildAccelerators();
+
+    for(size_t i = 0; i < rays.size(); ++i) {
+        EXPECT_EQ(expected[i], intersectsWorldRay(rays[i], scene, 0.0f, 8.0f));
+    }
+}
+
+// The hit records the object hit, and evaluating the surface afterwards gives
+// the same result as intersecting that object alone
+TEST_F(RayTraceableBVHTest, DeferredFillMatchesObjectIntersection) {
+    EXPECT_LE(sizeof(RayHit), 16u);
+
+    scene.buildAccelerators();
+
+    std::mt19937 engine(7);
+    unsigned int numHits = 0;
+    for(int i = 0; i < 2000; ++i) {
+        Ray ray = randomRay(engine);
+        RayHit hit;
+        if(!findHitWorldRay(ray, scene, 0.0f, hit)) {
+            continue;
+        }
+        ASSERT_TRUE(hit.object != nullptr);
+
+        RayIntersection deferred, direct;
+        hit.object->fillIntersectionWorldRay(ray, hit, deferred);
+        ASSERT_TRUE(hit.object->findIntersectionWorldRay(ray, 0.0f, direct));
+        EXPECT_FLOAT_EQ(hit.distance, direct.distance);
+        EXPECT_FLOAT_EQ(deferred.distance, direct.distance);
+        EXPECT_NEAR(deferred.position.x, direct.position.x, 1.0e-4f);
+        EXPECT_NEAR(deferred.position.y, direct.position.y, 1.0e-4f);
+        EXPECT_NEAR(deferred.position.z, direct.position.z, 1.0e-4f);
+        EXPECT_NEAR(dot(deferred.normal, direct.normal), 1.0f, 1.0e-4f);
+        EXPECT_EQ(deferred.material, direct.material);
+        numHits++;
+    }
+    EXPECT_GT(numHits, 100u);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
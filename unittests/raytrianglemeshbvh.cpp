@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "vectortypes.h"
+#include "Ray.h"
+#include "TriangleMesh.h"
+#include "TriangleMeshBVH.h"
+#include "SyntheticMeshes.h"
+
+namespace {
+
+Ray randomRay(std::mt19937 & engine)
+{
+    std::uniform_real_distribution<float> position(-2.0f, 2.0f);
+    std::normal_distribution<float> direction;
+    return Ray(Position3(position(engine), position(engine), position(engine)),
+               Direction3(direction(engine), direction(engine), direction(engine)).normalized());
+}
+
+class RayTriangleMeshBVHTest : public ::testing::Test {
+    protected:
+        virtual void SetUp() {
+            mesh = makeRandomSoup(2000, 0.1f, 12345);
+            bvh = std::make_shared<TriangleMeshBVH>(mesh);
+            bvh->build();
+        }
+
+        std::shared_ptr<TriangleMesh> mesh;
+        std::shared_ptr<TriangleMeshBVH> bvh;
+};
+
+TEST_F(RayTriangleMeshBVHTest, NodesAreCompact) {
+    EXPECT_EQ(sizeof(BVH::Node), 32u);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(bvh->bvh.nodes.data()) % 64, 0u);
+}
+
+TEST_F(RayTriangleMeshBVHTest, EveryTriangleReferencedOnce) {
+    EXPECT_TRUE(bvh->nodesCoverAllTriangles());
+    // Released once the triangles are packed
+    EXPECT_TRUE(bvh->bvh.primitives.empty());
+    EXPECT_LE(bvh->bvh.depth(), BVH::MAX_DEPTH);
+}
+
+TEST_F(RayTriangleMeshBVHTest, LeavesContainTheirTriangles) {
+    for(const auto & node : bvh->bvh.nodes) {
+        if(!node.isLeaf())
+            continue;
+        for(uint32_t pi = 0; pi < node.numPrimitives; ++pi) {
+            // Leaf offsets index the leaf's triangle packets
+            const auto & packet = bvh->packets[node.offset + pi / TrianglePacket::WIDTH];
+            auto tri = packet.triangle[pi % TrianglePacket::WIDTH];
+            for(uint32_t vi = 0; vi < 3; ++vi) {
+                const auto & v = mesh->triangleVertex(tri, vi);
+                EXPECT_GE(v.x, node.min[0]); EXPECT_LE(v.x, node.max[0]);
+                EXPECT_GE(v.y, node.min[1]); EXPECT_LE(v.y, node.max[1]);
+                EXPECT_GE(v.z, node.min[2]); EXPECT_LE(v.z, node.max[2]);
+            }
+        }
+    }
+}
+
+TEST_F(RayTriangleMeshBVHTest, ClosestHitMatchesBruteForce) {
+    std::mt19937 engine(42);
+    unsigned int numHits = 0;
+
+    for(int i = 0; i < 2000; ++i) {
+        Ray ray = randomRay(engine);
+        RayIntersection expected, actual;
+        bool expectedHit = mesh->findIntersection(ray, 0.0f, expected);
+        bool actualHit = bvh->findIntersection(ray, 0.0f, actual);
+        ASSERT_EQ(expectedHit, actualHit);
+        if(expectedHit) {
+            EXPECT_FLOAT_EQ(expected.distance, actual.distance);
+            numHits++;
+        }
+    }
+
+    // Make sure the test exercises hits
+    EXPECT_GT(numHits, 100u);
+}
+
+TEST_F(RayTriangleMeshBVHTest, AnyHitMatchesBruteForce) {
+    std::mt19937 engine(43);
+
+    for(int i = 0; i < 2000; ++i) {
+        Ray ray = randomRay(engine);
+        float maxDistance = 1.5f;
+        EXPECT_EQ(mesh->intersects(ray, 0.0f, maxDistance),
+                  bvh->intersects(ray, 0.0f, maxDistance));
+    }
+}
+
+TEST_F(RayTriangleMeshBVHTest, ParallelBuildMatchesSerialBuild) {
+    // Small enough to bin in parallel chunks and build subtrees in parallel
+    TriangleMeshBVH parallel(mesh);
+    parallel.bvh.parallelBuildThreshold = 64;
+    parallel.build();
+
+    ASSERT_EQ(parallel.bvh.nodes.size(), bvh->bvh.nodes.size());
+    ASSERT_EQ(parallel.packets.size(), bvh->packets.size());
+    for(size_t pi = 0; pi < bvh->packets.size(); ++pi) {
+        EXPECT_TRUE(std::equal(parallel.packets[pi].triangle, parallel.packets[pi].triangle + TrianglePacket::WIDTH,
+                               bvh->packets[pi].triangle)) << "packet " << pi;
+    }
+    for(size_t ni = 0; ni < bvh->bvh.nodes.size(); ++ni) {
+        const auto & a = parallel.bvh.nodes[ni];
+        const auto & b = bvh->bvh.nodes[ni];
+        EXPECT_EQ(a.offset, b.offset) << "node " << ni;
+        EXPECT_EQ(a.numPrimitives, b.numPrimitives) << "node " << ni;
+        EXPECT_EQ(a.axis, b.axis) << "node " << ni;
+        for(int axis = 0; axis < 3; ++axis) {
+            EXPECT_EQ(a.min[axis], b.min[axis]) << "node " << ni;
+            EXPECT_EQ(a.max[axis], b.max[axis]) << "node " << ni;
+        }
+    }
+    EXPECT_TRUE(parallel.nodesCoverAllTriangles());
+}
+
+TEST(RayTriangleMeshBVH, CoincidentTrianglesBuildValidTree) {
+    // Many triangles sharing a centroid cannot be separated by SAH binning
+    auto mesh = makeRandomSoup(1, 0.1f, 7);
+    auto & data = *mesh->meshData;
+    for(uint32_t tri = 1; tri < 100; ++tri) {
+        for(uint32_t vi = 0; vi < 3; ++vi) {
+            data.indices.vertex.push_back(data.indices.vertex[vi]);
+            data.indices.texcoord.push_back(TriangleMeshData::NoTexCoord);
+        }
+        data.faces.material.push_back(NoMaterial);
+    }
+    TriangleMeshBVH bvh(mesh);
+    bvh.build();
+    EXPECT_TRUE(bvh.nodesCoverAllTriangles());
+    for(const auto & node : bvh.bvh.nodes) {
+        if(node.isLeaf()) {
+            EXPECT_LE(node.numPrimitives, bvh.bvh.maxPrimitivesPerLeaf);
+        }
+    }
+}
+
+TEST(RayTriangleMeshBVH, EmptyMesh) {
+    auto mesh = std::make_shared<TriangleMesh>();
+    TriangleMeshBVH bvh(mesh);
+    bvh.build();
+    RayIntersection isect;
+    Ray ray(Position3(0, 0, 0), Direction3(0, 0, 1));
+    EXPECT_FALSE(bvh.intersects(ray, 0.0f, 100.0f));
+    EXPECT_FALSE(bvh.findIntersection(ray, 0.0f, isect));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
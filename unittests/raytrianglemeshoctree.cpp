@@ -1,6 +1,10 @@
 #include <gtest/gtest.h>
+#include <random>
 #include "vectortypes.h"
+#include "Ray.h"
+#include "TriangleMesh.h"
 #include "TriangleMeshOctree.h"
+#include "SyntheticMeshes.h"
 
 namespace {
 
@@ -79,6 +83,113 @@ TEST(RayTriangleMeshOctreeTraversal, GeneralDirections_ProperChildTraversalOrder
 
 }
 
+// ---------------------- Octree Build Tests ------------------------
+
+Ray randomRay(std::mt19937 & engine)
+{
+    std::uniform_real_distribution<float> position(-2.0f, 2.0f);
+    std::normal_distribution<float> direction;
+    return Ray(Position3(position(engine), position(engine), position(engine)),
+               Direction3(direction(engine), direction(engine), direction(engine)).normalized());
+}
+
+TEST(RayTriangleMeshOctreeBuild, TriangleBoxOverlap) {
+    Slab box(0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
+    // Inside
+    EXPECT_TRUE(TriangleMeshOctree::triangleOverlapsBox(vec3(0.2f, 0.2f, 0.2f), vec3(0.8f, 0.2f, 0.2f), vec3(0.2f, 0.8f, 0.2f), box));
+    // Crossing the box with no vertex inside
+    EXPECT_TRUE(TriangleMeshOctree::triangleOverlapsBox(vec3(-5.0f, -5.0f, 0.5f), vec3(5.0f, -5.0f, 0.5f), vec3(0.0f, 5.0f, 0.5f), box));
+    // Off to one side
+    EXPECT_FALSE(TriangleMeshOctree::triangleOverlapsBox(vec3(2.0f, 0.0f, 0.0f), vec3(3.0f, 0.0f, 0.0f), vec3(2.0f, 1.0f, 0.0f), box));
+    // Bounds overlap the box, but the triangle passes by a corner
+    EXPECT_FALSE(TriangleMeshOctree::triangleOverlapsBox(vec3(0.9f, 1.5f, 0.5f), vec3(1.5f, 0.9f, 0.5f), vec3(1.5f, 1.5f, 0.5f), box));
+    // Plane of the triangle misses the box
+    EXPECT_FALSE(TriangleMeshOctree::triangleOverlapsBox(vec3(-1.0f, -1.0f, 1.5f), vec3(2.0f, -1.0f, 1.5f), vec3(-1.0f, 2.0f, 1.5f), box));
+    // Degenerate triangle (a line) through the box
+    EXPECT_TRUE(TriangleMeshOctree::triangleOverlapsBox(vec3(-1.0f, 0.5f, 0.5f), vec3(2.0f, 0.5f, 0.5f), vec3(0.5f, 0.5f, 0.5f), box));
+}
+
+class RayTriangleMeshOctreeBuildTest : public ::testing::Test {
+    protected:
+        virtual void SetUp() {
+            mesh = makeRandomSoup(3000, 0.1f, 12345);
+            octree = std::make_shared<TriangleMeshOctree>(mesh);
+            octree->build();
+        }
+
+        std::shared_ptr<TriangleMesh> mesh;
+        std::shared_ptr<TriangleMeshOctree> octree;
+};
+
+TEST_F(RayTriangleMeshOctreeBuildTest, EveryTriangleClaimed) {
+    EXPECT_TRUE(octree->nodesCoverAllTriangles());
+}
+
+TEST_F(RayTriangleMeshOctreeBuildTest, NodeTrianglesOverlapNode) {
+    for(const auto & node : octree->nodes) {
+        for(uint32_t ti = 0; ti < node.numTriangles; ++ti) {
+            auto tri = octree->nodeTriangle(node, ti);
+            // Allow the same round off margin as the build
+            const auto & b = node.bounds;
+            const float epsilon = 1.0e-4f;
+            Slab bounds(b.xmin - epsilon, b.ymin - epsilon, b.zmin - epsilon,
+                        b.xmax + epsilon, b.ymax + epsilon, b.zmax + epsilon);
+            EXPECT_TRUE(TriangleMeshOctree::triangleOverlapsBox(mesh->triangleVertex(tri, 0),
+                                                                mesh->triangleVertex(tri, 1),
+                                                                mesh->triangleVertex(tri, 2),
+                                                                bounds));
+        }
+    }
+}
+
+TEST_F(RayTriangleMeshOctreeBuildTest, ParallelBuildMatchesSerialBuild) {
+    TriangleMeshOctree serial(mesh);
+    serial.buildParallelLevels = 0;
+    serial.build();
+
+    ASSERT_EQ(serial.nodes.size(), octree->nodes.size());
+    ASSERT_EQ(serial.packets.size(), octree->packets.size());
+
+    // Nodes are numbered differently, so compare the trees from the root
+    std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } };
+    while(!stack.empty()) {
+        auto a = serial.nodes[stack.back().first];
+        auto b = octree->nodes[stack.back().second];
+        stack.pop_back();
+        ASSERT_EQ(a.numTriangles, b.numTriangles);
+        for(uint32_t ti = 0; ti < a.numTriangles; ++ti) {
+            EXPECT_EQ(serial.nodeTriangle(a, ti), octree->nodeTriangle(b, ti));
+        }
+        for(uint32_t ci = 0; ci < TriangleMeshOctree::MAX_CHILDREN; ++ci) {
+            ASSERT_EQ(a.children[ci] == TriangleMeshOctree::NO_CHILD, b.children[ci] == TriangleMeshOctree::NO_CHILD);
+            if(a.children[ci] != TriangleMeshOctree::NO_CHILD) {
+                stack.emplace_back(a.children[ci], b.children[ci]);
+            }
+        }
+    }
+}
+
+TEST_F(RayTriangleMeshOctreeBuildTest, ClosestHitMatchesBruteForce) {
+    std::mt19937 engine(42);
+    unsigned int numHits = 0;
+
+    for(int i = 0; i < 2000; ++i) {
+        Ray ray = randomRay(engine);
+        RayIntersection expected, actual;
+        bool expectedHit = mesh->findIntersection(ray, 0.0f, expected);
+        bool actualHit = octree->findIntersection(ray, 0.0f, actual);
+        ASSERT_EQ(expectedHit, actualHit);
+        if(expectedHit) {
+            EXPECT_FLOAT_EQ(expected.distance, actual.distance);
+            numHits++;
+        }
+        EXPECT_EQ(expectedHit, octree->intersects(ray, 0.0f, std::numeric_limits<float>::max()));
+    }
+
+    // Make sure the test exercises hits
+    EXPECT_GT(numHits, 100u);
+}
+
 } // namespace
 
 int main(int argc, char **argv) {
@@ -0,0 +1,513 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <ostream>
+#include <string>
+#include "vectortypes.h"
+#include "scene.h"
+#include "Sampler.h"
+#include "Renderer.h"
+#include "WavefrontRenderer.h"
+#include "LatLonEnvironmentMap.h"
+#include "GradientEnvironmentMap.h"
+#include "PathStatistics.h"
+
+namespace {
+
+TEST(PowerHeuristicTest, Weights) {
+    EXPECT_FLOAT_EQ(powerHeuristic(1.0f, 1.0f, 1.0f, 1.0f), 0.5f);
+    EXPECT_FLOAT_EQ(powerHeuristic(1.0f, 3.0f, 1.0f, 1.0f), 0.9f);
+    EXPECT_FLOAT_EQ(powerHeuristic(1.0f, 1.0f, 1.0f, 3.0f), 0.1f);
+    // Sample counts scale the pdfs
+    EXPECT_FLOAT_EQ(powerHeuristic(3.0f, 1.0f, 1.0f, 1.0f), 0.9f);
+    EXPECT_FLOAT_EQ(powerHeuristic(1.0f, 0.0f, 1.0f, 1.0f), 0.0f);
+    EXPECT_FLOAT_EQ(powerHeuristic(1.0f, 1.0f, 1.0f, 0.0f), 1.0f);
+}
+
+TEST(MediumStackTest, PushAndPopInPlace) {
+    Medium glass;
+    glass.indexOfRefraction = 1.5f;
+
+    MediumStack stack = { VaccuumMedium };
+    ASSERT_EQ(stack.size(), 1u);
+    EXPECT_FLOAT_EQ(stack.back().indexOfRefraction, 1.0f);
+
+    MediumStack inside = stack;
+    inside.push_back(glass);
+    ASSERT_EQ(inside.size(), 2u);
+    EXPECT_FLOAT_EQ(inside.back().indexOfRefraction, 1.5f);
+    EXPECT_FLOAT_EQ(inside[0].indexOfRefraction, 1.0f);
+    // Copies are independent
+    EXPECT_EQ(stack.size(), 1u);
+
+    inside.pop_back();
+    EXPECT_EQ(inside.size(), 1u);
+    EXPECT_FLOAT_EQ(inside.back().indexOfRefraction, 1.0f);
+    inside.pop_back();
+    EXPECT_TRUE(inside.empty());
+}
+
+struct Estimate {
+    double mean = 0.0;
+    double variance = 0.0;
+};
+
+// Mean and variance of the sum of the channels of numSamples samples,
+// where sample(si) returns the radiance of sample si
+template<typename SampleFunction>
+Estimate estimate(unsigned int numSamples, SampleFunction && sample)
+{
+    double sum = 0.0, sumSq = 0.0;
+    for(unsigned int si = 0; si < numSamples; ++si) {
+        const RadianceRGB Lo = sample(si);
+        double v = Lo.r + Lo.g + Lo.b;
+        sum += v;
+        sumSq += v * v;
+    }
+    Estimate e;
+    e.mean = sum / numSamples;
+    e.variance = sumSq / numSamples - e.mean * e.mean;
+    return e;
+}
+
+Estimate estimate(const Scene & scene, const Renderer & renderer, const Ray & ray, uint32_t rayIndex, unsigned int numSamples)
+{
+    RandomSampler sampler(7);
+    return estimate(numSamples, [&](unsigned int si) {
+        RayIntersection intersection;
+        RadianceRGB Lo;
+        sampler.startPixelSample(PixelSample{ rayIndex, 0, si });
+        renderer.traceCameraRay(scene, sampler, ray, 0.0f, 1, { VaccuumMedium }, intersection, Lo);
+        return Lo;
+    });
+}
+
+// Expect the mean of n samples of the given per-sample variance to be
+// within 5 standard errors of the expected value. When comparing two
+// estimates, the variance is that of their difference.
+void expectEstimateWithin(double mean, double variance, double expected, unsigned int n)
+{
+    EXPECT_NEAR(mean, expected, 5.0 * std::sqrt(variance / n) + 1.0e-3);
+}
+
+// Scene seen by a few camera rays from the origin
+struct TestScene {
+    const char * name;
+    void (*build)(Scene & scene);
+    std::vector<Direction3> rayDirections;
+};
+
+void PrintTo(const TestScene & testScene, std::ostream * os)
+{
+    *os << testScene.name;
+}
+
+// Glossy and diffuse floor lit by a disk light and an environment map with
+// a bright spot
+void buildMISScene(Scene & scene)
+{
+    Image<float> sky(32, 16, 3);
+    sky.forEachPixel([](Image<float> & img, size_t x, size_t y) {
+        img.set3(x, y, 0.05f, 0.05f, 0.1f);
+    });
+    for(size_t y = 3; y < 5; ++y) {
+        for(size_t x = 14; x < 17; ++x) {
+            sky.set3(x, y, 40.0f, 35.0f, 30.0f);
+        }
+    }
+    auto envmap = std::make_unique<LatLonEnvironmentMap>();
+    envmap->loadFromImage(sky);
+    scene.environmentMap = std::move(envmap);
+
+    Material glossy = Material::makeDiffuseSpecular(ReflectanceRGB(0.4f, 0.4f, 0.4f),
+                                                    ReflectanceRGB(0.5f, 0.5f, 0.5f));
+    glossy.specularExponentParam = { 40.0f };
+    scene.materials.push_back(glossy);
+    scene.materials.push_back(Material::makeDiffuse(ReflectanceRGB(0.7f, 0.6f, 0.5f)));
+    scene.materials.push_back(Material::makeEmissive(RadianceRGB(6.0f, 6.0f, 6.0f)));
+
+    auto floor = std::make_shared<Slab>(Position3(-10.0f, -2.0f, -20.0f), Position3(0.0f, -1.0f, 2.0f));
+    floor->material = 0;
+    scene.objects.push_back(floor);
+    auto floor2 = std::make_shared<Slab>(Position3(0.0f, -2.0f, -20.0f), Position3(10.0f, -1.0f, 2.0f));
+    floor2->material = 1;
+    scene.objects.push_back(floor2);
+
+    scene.diskLights.emplace_back(Position3(0.0f, 1.5f, -6.0f), Direction3(0.0f, -1.0f, 0.0f), 1.0f, 2);
+}
+
+// Diffuse floor lit by many lights of very different power
+void buildManyLightsScene(Scene & scene)
+{
+    scene.materials.push_back(Material::makeDiffuse(ReflectanceRGB(0.7f, 0.7f, 0.7f)));
+    auto floor = std::make_shared<Slab>(Position3(-20.0f, -2.0f, -30.0f), Position3(20.0f, -1.0f, 2.0f));
+    floor->material = 0;
+    scene.objects.push_back(floor);
+
+    for(int i = 0; i < 16; ++i) {
+        const float brightness = 0.2f + 0.6f * float(i * i);
+        scene.materials.push_back(Material::makeEmissive(RadianceRGB(brightness, brightness, 0.5f * brightness)));
+        scene.diskLights.emplace_back(Position3(float(i % 4) * 4.0f - 6.0f, 2.0f, -2.0f - float(i / 4) * 4.0f),
+                                      Direction3(0.0f, -1.0f, 0.0f), 0.5f,
+                                      MaterialID(scene.materials.size() - 1));
+    }
+    for(int i = 0; i < 8; ++i) {
+        const float intensity = 0.5f + float(i);
+        scene.pointLights.emplace_back(Position3(float(i) * 2.0f - 7.0f, 0.5f, -8.0f),
+                                       RadianceRGB(intensity, 0.5f * intensity, intensity));
+    }
+}
+
+// Glossy floor lit by a quad mesh with an emission texture
+void buildEmissiveMeshScene(Scene & scene)
+{
+    Image<float> image(8, 8, 3);
+    image.forEachPixel([](Image<float> & img, size_t x, size_t y) {
+        img.set3(x, y, 0.2f + float(x), 1.0f, 0.5f + float(y));
+    });
+    scene.textureCache.textures.push_back(std::make_shared<MipTexture>(image, MipTexture::Float));
+
+    Material glossy = Material::makeDiffuseSpecular(ReflectanceRGB(0.4f, 0.4f, 0.4f),
+                                                    ReflectanceRGB(0.5f, 0.5f, 0.5f));
+    glossy.specularExponentParam = { 20.0f };
+    scene.materials.push_back(glossy);
+    Material emissive = Material::makeEmissive(RadianceRGB(0.5f, 0.6f, 0.4f));
+    emissive.emissionTexture = 0;
+    scene.materials.push_back(emissive);
+
+    auto floor = std::make_shared<Slab>(Position3(-10.0f, -2.0f, -20.0f), Position3(10.0f, -1.0f, 2.0f));
+    floor->material = 0;
+    scene.objects.push_back(floor);
+
+    auto mesh = std::make_shared<TriangleMesh>();
+    auto & data = *mesh->meshData;
+    data.vertices = {
+        Position3(-1.5f, 1.0f, -7.0f), Position3(1.5f, 1.0f, -7.0f),
+        Position3(1.5f, 1.0f, -4.0f), Position3(-1.5f, 1.0f, -4.0f)
+    };
+    data.texcoords = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+    data.indices.vertex = { 0, 1, 2, 0, 2, 3 };
+    data.indices.texcoord = { 0, 1, 2, 0, 2, 3 };
+    data.faces.material = { 1, 1 };
+    data.bounds = Slab(Position3(-1.5f, 1.0f, -7.0f), Position3(1.5f, 1.0f, -4.0f));
+    scene.objects.push_back(mesh);
+}
+
+// Diffuse floor lit by a point light and a gradient sky, seen through an
+// absorbing glass sphere
+void buildRefractionScene(Scene & scene)
+{
+    scene.environmentMap = std::make_unique<GradientEnvironmentMap>(RadianceRGB(0.1f, 0.1f, 0.2f),
+                                                                    RadianceRGB(0.8f, 0.9f, 1.0f));
+
+    scene.materials.push_back(Material::makeDiffuse(ReflectanceRGB(0.7f, 0.6f, 0.5f)));
+    Material glass = Material::makeRefractive(1.5f);
+    glass.innerMedium.beersLawAttenuation = { 0.2f, 0.5f, 0.8f };
+    scene.materials.push_back(glass);
+
+    auto floor = std::make_shared<Slab>(Position3(-10.0f, -2.0f, -20.0f), Position3(10.0f, -1.0f, 2.0f));
+    floor->material = 0;
+    scene.objects.push_back(floor);
+
+    auto sphere = std::make_shared<Sphere>(Position3(0.0f, 0.0f, -3.0f), 0.9f);
+    sphere->material = 1;
+    scene.objects.push_back(sphere);
+
+    scene.pointLights.emplace_back(Position3(0.0f, 4.0f, -2.0f), RadianceRGB(20.0f, 20.0f, 20.0f));
+}
+
+const TestScene misScene = {
+    "MIS", buildMISScene,
+    { Direction3(-0.3f, -0.35f, -1.0f), Direction3(0.3f, -0.35f, -1.0f),
+      Direction3(-0.05f, -0.2f, -1.0f), Direction3(0.1f, -0.6f, -1.0f) }
+};
+const TestScene manyLightsScene = {
+    "ManyLights", buildManyLightsScene,
+    { Direction3(-0.3f, -0.35f, -1.0f), Direction3(0.3f, -0.15f, -1.0f), Direction3(0.0f, -0.6f, -1.0f) }
+};
+const TestScene emissiveMeshScene = {
+    "EmissiveMesh", buildEmissiveMeshScene,
+    { Direction3(-0.3f, -0.35f, -1.0f), Direction3(0.3f, -0.2f, -1.0f), Direction3(0.0f, -0.15f, -1.0f) }
+};
+const TestScene refractionScene = {
+    "Refraction", buildRefractionScene,
+    { Direction3(0.0f, 0.0f, -1.0f), Direction3(0.1f, -0.1f, -1.0f),
+      Direction3(-0.2f, 0.15f, -1.0f), Direction3(0.27f, 0.0f, -1.0f) }
+};
+
+class RendererSceneTest : public ::testing::Test {
+    protected:
+        void load(const TestScene & testScene) {
+            testScene.build(scene);
+            scene.buildAccelerators();
+            for(const auto & direction : testScene.rayDirections) {
+                rays.emplace_back(Position3(0.0f, 0.0f, 0.0f), direction.normalized());
+            }
+        }
+
+        // Direct lighting only
+        static Renderer makeDirectRenderer() {
+            Renderer renderer;
+            renderer.maxDepth = 2;
+            renderer.russianRouletteChance = 0.0f;
+            return renderer;
+        }
+
+        Scene scene;
+        std::vector<Ray> rays;
+};
+
+// Fixtures of the parameterized tests, each instantiated with the scenes
+// it applies to
+class RendererSceneParamTest : public RendererSceneTest,
+                               public ::testing::WithParamInterface<TestScene> {
+    protected:
+        virtual void SetUp() { load(GetParam()); }
+};
+class RendererLightSamplingTest : public RendererSceneParamTest {};
+class RendererLightChoiceTest : public RendererSceneParamTest {};
+class RendererWavefrontTest : public RendererSceneParamTest {};
+
+class RendererRefractionTest : public RendererSceneTest {
+    protected:
+        virtual void SetUp() { load(refractionScene); }
+};
+
+std::string sceneName(const ::testing::TestParamInfo<TestScene> & info)
+{
+    return info.param.name;
+}
+
+} // namespace
+
+// Sampling lights combined with BRDF sampling converges to the same result
+// as BRDF sampling alone, with less noise
+TEST_P(RendererLightSamplingTest, MatchesBRDFSamplingWithLessNoise) {
+    auto makeRenderer = [](bool sampleLights) {
+        Renderer renderer = makeDirectRenderer();
+        renderer.shadeDiffuseParams.sampleLights = sampleLights;
+        renderer.shadeDiffuseParams.numEnvMapSamples = sampleLights ? 4 : 0;
+        renderer.shadeSpecularParams.sampleLights = sampleLights;
+        renderer.shadeSpecularParams.numEnvMapSamples = sampleLights ? 4 : 0;
+        return renderer;
+    };
+    Renderer lights = makeRenderer(true);
+    Renderer brdfOnly = makeRenderer(false);
+
+    const unsigned int numSamples = 40000;
+    double lightsVariance = 0.0, brdfVariance = 0.0;
+
+    for(size_t ri = 0; ri < rays.size(); ++ri) {
+        SCOPED_TRACE("ray " + std::to_string(ri));
+        auto a = estimate(scene, lights, rays[ri], uint32_t(ri), numSamples);
+        auto b = estimate(scene, brdfOnly, rays[ri], uint32_t(ri), numSamples);
+        expectEstimateWithin(a.mean, a.variance + b.variance, b.mean, numSamples);
+        EXPECT_GT(a.mean, 0.0);
+        lightsVariance += a.variance;
+        brdfVariance += b.variance;
+    }
+
+    EXPECT_LT(lightsVariance, 0.5 * brdfVariance);
+}
+
+INSTANTIATE_TEST_SUITE_P(Scenes, RendererLightSamplingTest,
+                         ::testing::Values(misScene, emissiveMeshScene), sceneName);
+
+// Choosing a light by power converges to the same result as sampling every
+// light
+TEST_P(RendererLightChoiceTest, ChoosingLightsMatchesSamplingEveryLight) {
+    Renderer everyLight = makeDirectRenderer();
+    everyLight.numLightSamples = 100;
+    Renderer oneLight = makeDirectRenderer();
+    oneLight.numLightSamples = 1;
+
+    const unsigned int numSamples = 40000;
+    for(size_t ri = 0; ri < rays.size(); ++ri) {
+        SCOPED_TRACE("ray " + std::to_string(ri));
+        auto a = estimate(scene, oneLight, rays[ri], uint32_t(ri), numSamples);
+        auto b = estimate(scene, everyLight, rays[ri], uint32_t(ri), numSamples);
+        expectEstimateWithin(a.mean, a.variance + b.variance, b.mean, numSamples);
+        EXPECT_GT(a.mean, 0.0);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Scenes, RendererLightChoiceTest,
+                         ::testing::Values(manyLightsScene, emissiveMeshScene), sceneName);
+
+TEST_F(RendererSceneTest, EmissiveTrianglesAreLights) {
+    load(emissiveMeshScene);
+    EXPECT_EQ(scene.triangleLights.size(), 2u);
+}
+
+TEST_P(RendererWavefrontTest, MatchesRecursive) {
+    Renderer renderer = makeDirectRenderer();
+    renderer.numLightSamples = 2;
+    WavefrontRenderer wavefront(renderer);
+
+    const unsigned int numSamples = 20000;
+    RandomSampler sampler(7);
+    WavefrontRenderer::CameraRayBatch batch;
+    for(size_t ri = 0; ri < rays.size(); ++ri) {
+        for(unsigned int si = 0; si < numSamples; ++si) {
+            batch.rays.push_back(rays[ri]);
+            batch.pixelSamples.push_back(PixelSample{ uint32_t(ri), 0, si });
+        }
+    }
+    wavefront.traceCameraRays(scene, sampler, 0.0f, 1, { VaccuumMedium }, batch);
+
+    for(size_t ri = 0; ri < rays.size(); ++ri) {
+        SCOPED_TRACE("ray " + std::to_string(ri));
+        auto a = estimate(scene, renderer, rays[ri], uint32_t(ri), numSamples);
+        auto b = estimate(numSamples, [&](unsigned int si) { return batch.radiance[ri * numSamples + si]; });
+        expectEstimateWithin(b.mean, a.variance + b.variance, a.mean, numSamples);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Scenes, RendererWavefrontTest,
+                         ::testing::Values(misScene, manyLightsScene, emissiveMeshScene, refractionScene),
+                         sceneName);
+
+// Tracing both rays at refraction boundaries converges to the same result
+// as choosing one by Fresnel. The paths are deep enough that the paths set
+// aside overflow and some boundaries fall back to choosing.
+TEST_F(RendererRefractionTest, TracingBothRaysMatchesChoosingOne) {
+    Renderer choose;
+    choose.maxDepth = 40;
+    choose.russianRouletteChance = 0.0f;
+    Renderer both = choose;
+    both.monteCarloRefraction = false;
+
+    const unsigned int numChooseSamples = 40000, numBothSamples = 4000;
+    for(size_t ri = 0; ri < rays.size(); ++ri) {
+        SCOPED_TRACE("ray " + std::to_string(ri));
+        auto a = estimate(scene, choose, rays[ri], uint32_t(ri), numChooseSamples);
+        auto b = estimate(scene, both, rays[ri], uint32_t(ri), numBothSamples);
+        // Variance of the difference, per sample of b
+        const double variance = b.variance + a.variance * numBothSamples / numChooseSamples;
+        expectEstimateWithin(b.mean, variance, a.mean, numBothSamples);
+        EXPECT_GT(b.mean, 0.0);
+    }
+}
+
+// Throughput based Russian roulette converges to the same result as
+// following every path to the maximum depth
+TEST_F(RendererRefractionTest, RussianRouletteIsUnbiased) {
+    Renderer full;
+    full.russianRouletteChance = 0.0f;
+    Renderer roulette;
+    roulette.russianRouletteMinDepth = 1;
+
+    const unsigned int numSamples = 40000;
+    for(size_t ri = 0; ri < rays.size(); ++ri) {
+        SCOPED_TRACE("ray " + std::to_string(ri));
+        auto a = estimate(scene, full, rays[ri], uint32_t(ri), numSamples);
+        auto b = estimate(scene, roulette, rays[ri], uint32_t(ri), numSamples);
+        expectEstimateWithin(a.mean, a.variance + b.variance, b.mean, numSamples);
+    }
+}
+
+// Camera inside a closed sphere of the given material, and inside
+// numCutouts fully transparent spheres that every ray crosses
+void pathStatistics(const Material & material, const Renderer & renderer,
+                    PathStatistics & recursive, PathStatistics & wavefront,
+                    unsigned int numCutouts = 0)
+{
+    Scene scene;
+    scene.environmentMap = std::make_unique<GradientEnvironmentMap>(RadianceRGB(0.1f, 0.1f, 0.2f),
+                                                                    RadianceRGB(0.8f, 0.9f, 1.0f));
+    scene.materials.push_back(material);
+    auto sphere = std::make_shared<Sphere>(Position3(0.0f, 0.0f, 0.0f), 5.0f);
+    sphere->material = 0;
+    scene.objects.push_back(sphere);
+    Material cutout = Material::makeDiffuse(ReflectanceRGB(0.5f, 0.5f, 0.5f));
+    cutout.opacity = 0.0f;
+    scene.materials.push_back(cutout);
+    for(unsigned int ci = 0; ci < numCutouts; ++ci) {
+        auto cutoutSphere = std::make_shared<Sphere>(Position3(0.0f, 0.0f, 0.0f), float(ci + 1));
+        cutoutSphere->material = 1;
+        scene.objects.push_back(cutoutSphere);
+    }
+    scene.pointLights.emplace_back(Position3(0.0f, 2.0f, 0.0f), RadianceRGB(1.0f, 1.0f, 1.0f));
+
+    const Ray ray(Position3(0.0f, 0.0f, 0.0f), Direction3(0.3f, 0.2f, -1.0f).normalized());
+    WavefrontRenderer wavefrontRenderer(renderer);
+    WavefrontRenderer::CameraRayBatch batch;
+    RandomSampler sampler(3);
+
+    for(uint32_t si = 0; si < 1000; ++si) {
+        RayIntersection intersection;
+        RadianceRGB Lo;
+        sampler.startPixelSample(PixelSample{ 0, 0, si });
+        renderer.traceCameraRay(scene, sampler, ray, 0.0f, 1, { VaccuumMedium }, intersection, Lo, &recursive);
+        batch.rays.push_back(ray);
+    }
+    wavefrontRenderer.traceCameraRays(scene, sampler, 0.0f, 1, { VaccuumMedium }, batch, &wavefront);
+}
+
+// Paths that keep all their light are never ended by Russian roulette
+TEST(PathStatisticsTest, BrightPathsReachMaxDepth) {
+    Renderer renderer;
+    PathStatistics recursive, wavefront;
+    pathStatistics(Material::makeMirror(), renderer, recursive, wavefront);
+
+    for(const auto & statistics : { recursive, wavefront }) {
+        EXPECT_EQ(statistics.numPaths(), 1000u);
+        ASSERT_EQ(statistics.pathsEnded.size(), renderer.maxDepth + 2);
+        EXPECT_EQ(statistics.pathsEnded[renderer.maxDepth + 1], 1000u);
+        ASSERT_EQ(statistics.russianRouletteTests.size(), renderer.maxDepth + 1);
+        EXPECT_EQ(statistics.russianRouletteTests[renderer.russianRouletteMinDepth], 1000u);
+        for(auto n : statistics.russianRouletteTerminations) {
+            EXPECT_EQ(n, 0u);
+        }
+    }
+}
+
+// Rays continued through cutouts keep their depth, and play Russian
+// roulette only once for it
+TEST(PathStatisticsTest, CutoutsPlayRouletteOncePerDepth) {
+    Renderer renderer;
+    PathStatistics recursive, wavefront;
+    pathStatistics(Material::makeMirror(), renderer, recursive, wavefront, 3);
+
+    for(const auto & statistics : { recursive, wavefront }) {
+        ASSERT_EQ(statistics.russianRouletteTests.size(), renderer.maxDepth + 1);
+        for(unsigned int depth = renderer.russianRouletteMinDepth; depth <= renderer.maxDepth; ++depth) {
+            EXPECT_EQ(statistics.russianRouletteTests[depth], 1000u) << "depth " << depth;
+        }
+    }
+}
+
+// Dim paths are ended early, more often the dimmer they get
+TEST(PathStatisticsTest, DimPathsEndEarly) {
+    Renderer renderer;
+    renderer.shadeDiffuseParams.sampleLights = false;
+    PathStatistics recursive, wavefront;
+    pathStatistics(Material::makeDiffuse(ReflectanceRGB(0.5f, 0.5f, 0.5f)), renderer, recursive, wavefront);
+
+    for(const auto & statistics : { recursive, wavefront }) {
+        EXPECT_EQ(statistics.numPaths(), 1000u);
+        const unsigned int depth = renderer.russianRouletteMinDepth;
+        ASSERT_GT(statistics.russianRouletteTests.size(), depth + 1);
+        // Throughput is 1/4 at the first test, and 1/2 after surviving one
+        EXPECT_NEAR(double(statistics.russianRouletteTerminations[depth])
+                    / statistics.russianRouletteTests[depth], 0.75, 0.05);
+        EXPECT_NEAR(double(statistics.russianRouletteTerminations[depth + 1])
+                    / statistics.russianRouletteTests[depth + 1], 0.5, 0.1);
+        // Few are still going at the maximum depth
+        const uint64_t cutOff = statistics.pathsEnded.size() > renderer.maxDepth + 1
+            ? statistics.pathsEnded[renderer.maxDepth + 1] : 0;
+        EXPECT_LT(cutOff, 10u);
+    }
+
+    // Counts from several threads add up
+    PathStatistics total;
+    total += recursive;
+    total += wavefront;
+    EXPECT_EQ(total.numPaths(), 2000u);
+    EXPECT_EQ(total.pathsEnded[1], recursive.pathsEnded[1] + wavefront.pathsEnded[1]);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
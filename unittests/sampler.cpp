@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
+#include <cmath>
+#include "Sampler.h"
+
+namespace {
+
+const char * samplerNames[] = { "random", "halton", "sobol", "bluenoise" };
+
+TEST(SamplerTest, MakeSamplerByName) {
+    for(auto name : samplerNames) {
+        auto sampler = makeSampler(name, 3);
+        ASSERT_TRUE(sampler != nullptr) << name;
+        EXPECT_STREQ(sampler->name(), name);
+        EXPECT_EQ(sampler->seed, 3u);
+        EXPECT_STREQ(sampler->clone()->name(), name);
+    }
+    EXPECT_TRUE(makeSampler("nonsense") == nullptr);
+}
+
+TEST(SamplerTest, ValuesInUnitInterval) {
+    for(auto name : samplerNames) {
+        auto sampler = makeSampler(name);
+        for(uint32_t index = 0; index < 64; ++index) {
+            sampler->startPixelSample(PixelSample{ 5, 7, index });
+            for(unsigned int depth = 0; depth < 4; ++depth) {
+                sampler->startBounce(depth);
+                // Runs past the end of the block into the random stream
+                for(uint32_t d = 0; d < Sampler::BOUNCE_DIMENSIONS + 4; ++d) {
+                    float e = sampler->get1D();
+                    ASSERT_GE(e, 0.0f) << name;
+                    ASSERT_LT(e, 1.0f) << name;
+                    vec2 e2 = sampler->get2D();
+                    ASSERT_GE(e2.x, 0.0f) << name;
+                    ASSERT_LT(e2.x, 1.0f) << name;
+                    ASSERT_GE(e2.y, 0.0f) << name;
+                    ASSERT_LT(e2.y, 1.0f) << name;
+                }
+            }
+        }
+    }
+}
+
+TEST(SamplerTest, ValuesDependOnlyOnPixelSample) {
+    for(auto name : samplerNames) {
+        auto a = makeSampler(name);
+        auto b = makeSampler(name);
+
+        // Draw some unrelated values from b first
+        b->startPixelSample(PixelSample{ 1, 1, 9 });
+        b->get2D();
+        b->startBounce(3);
+        b->get1D();
+
+        a->startPixelSample(PixelSample{ 12, 34, 5 });
+        b->startPixelSample(PixelSample{ 12, 34, 5 });
+        for(unsigned int depth = 1; depth < 3; ++depth) {
+            a->startBounce(depth);
+            b->startBounce(depth);
+            for(int i = 0; i < 20; ++i) {
+                EXPECT_EQ(a->get1D(), b->get1D()) << name;
+            }
+        }
+    }
+}
+
+TEST(SamplerTest, SplitStateStartsBounce) {
+    SobolSampler sampler;
+    sampler.startPixelSample(PixelSample{ 2, 3, 4 });
+    sampler.startBounce(2);
+    Sampler::State split = sampler.splitState(3);
+    EXPECT_EQ(split.dimension, Sampler::CAMERA_DIMENSIONS + 3 * Sampler::BOUNCE_DIMENSIONS);
+
+    SobolSampler other;
+    other.startPixelSample(PixelSample{ 2, 3, 4 });
+    other.startBounce(3);
+
+    sampler.setState(split);
+    for(int i = 0; i < 8; ++i) {
+        EXPECT_EQ(sampler.get1D(), other.get1D());
+    }
+}
+
+// 2^k Sobol points of a pixel fall one in each cell of any 2^k elementary
+// grid, so 16 samples cover a 4x4 grid exactly
+TEST(SamplerTest, SobolIsStratifiedIn2D) {
+    SobolSampler sampler(11);
+    for(uint32_t dimension = 0; dimension < 4; ++dimension) {
+        std::vector<int> cells(16, 0), rows(16, 0);
+        for(uint32_t index = 0; index < 16; ++index) {
+            sampler.startPixelSample(PixelSample{ 3, 4, index });
+            sampler.startBounce(dimension);
+            vec2 e = sampler.get2D();
+            cells[int(e.y * 4.0f) * 4 + int(e.x * 4.0f)]++;
+            rows[int(e.y * 16.0f)]++;
+        }
+        for(int c = 0; c < 16; ++c) {
+            EXPECT_EQ(cells[c], 1) << "dimension " << dimension;
+            EXPECT_EQ(rows[c], 1) << "dimension " << dimension;
+        }
+    }
+}
+
+// Shifted radical inverse base 2 is equally spaced for 2^k samples
+TEST(SamplerTest, HaltonIsStratifiedIn1D) {
+    HaltonSampler sampler;
+    std::vector<int> bins(16, 0);
+    for(uint32_t index = 0; index < 16; ++index) {
+        sampler.startPixelSample(PixelSample{ 8, 1, index });
+        bins[int(sampler.get1D() * 16.0f)]++;
+    }
+    for(int b = 0; b < 16; ++b) {
+        EXPECT_EQ(bins[b], 1);
+    }
+}
+
+// Low discrepancy samplers estimate a smooth integral far better than random
+TEST(SamplerTest, LowDiscrepancyConvergesFaster) {
+    auto error = [](Sampler & sampler) {
+        double total = 0.0;
+        const uint32_t numPixels = 32, numSamples = 64;
+        for(uint32_t pixel = 0; pixel < numPixels; ++pixel) {
+            double sum = 0.0;
+            for(uint32_t index = 0; index < numSamples; ++index) {
+                sampler.startPixelSample(PixelSample{ pixel, 0, index });
+                sampler.startBounce(1);
+                vec2 e = sampler.get2D();
+                sum += e.x * e.y;
+            }
+            total += std::abs(sum / numSamples - 0.25);
+        }
+        return total / numPixels;
+    };
+
+    RandomSampler random;
+    SobolSampler sobol;
+    HaltonSampler halton;
+    BlueNoiseSampler blueNoise;
+    const double randomError = error(random);
+    EXPECT_LT(error(sobol), 0.5 * randomError);
+    EXPECT_LT(error(halton), 0.5 * randomError);
+    EXPECT_LT(error(blueNoise), 0.5 * randomError);
+}
+
+TEST(SamplerTest, BlueNoiseMaskIsPermutationOfRanks) {
+    const uint32_t size = BlueNoiseSampler::MASK_SIZE;
+    const float * mask = BlueNoiseSampler::mask();
+    std::vector<float> values(mask, mask + size * size);
+    std::sort(values.begin(), values.end());
+    for(uint32_t i = 0; i < size * size; ++i) {
+        EXPECT_FLOAT_EQ(values[i], (float(i) + 0.5f) / float(size * size));
+    }
+}
+
+// Neighbors in a blue noise mask differ more than independent values, which
+// differ by 1/3 on average
+TEST(SamplerTest, BlueNoiseMaskNeighborsDiffer) {
+    const uint32_t size = BlueNoiseSampler::MASK_SIZE;
+    const float * mask = BlueNoiseSampler::mask();
+    double sum = 0.0;
+    for(uint32_t y = 0; y < size; ++y) {
+        for(uint32_t x = 0; x < size; ++x) {
+            sum += std::abs(mask[y * size + x] - mask[y * size + (x + 1) % size]);
+            sum += std::abs(mask[y * size + x] - mask[((y + 1) % size) * size + x]);
+        }
+    }
+    EXPECT_GT(sum / (2.0 * size * size), 0.4);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <vector>
+#include <cstdlib>
+#include "sensor.h"
+
+namespace {
+
+using TileOrder = Sensor::TileOrder;
+
+const TileOrder allOrders[] = { TileOrder::Raster, TileOrder::Spiral, TileOrder::Hilbert };
+
+// Count visits to each pixel with atomics so threaded traversals can be checked
+struct VisitCounter {
+    VisitCounter(const Sensor & sensor)
+        : width(sensor.pixelwidth), counts(sensor.pixelwidth * sensor.pixelheight) {
+        for(auto & c : counts) { c = 0; }
+    }
+    void visit(size_t x, size_t y) { counts[y * width + x]++; }
+    bool allVisitedOnce() const {
+        for(const auto & c : counts) { if(c != 1) return false; }
+        return true;
+    }
+    size_t width;
+    std::vector<std::atomic<unsigned int>> counts;
+};
+
+TEST(Sensor, TilesCoverSensorExactlyOnce) {
+    Sensor sensor(37, 23);
+    for(auto order : allOrders) {
+        for(uint32_t tileSize : { 1u, 4u, 8u, 16u, 64u }) {
+            VisitCounter counter(sensor);
+            auto tiles = sensor.tiles(tileSize, order);
+            EXPECT_EQ(tiles.size(), size_t((37 + tileSize - 1) / tileSize) * size_t((23 + tileSize - 1) / tileSize));
+            for(const auto & tile : tiles) {
+                EXPECT_LE(tile.xmax - tile.xmin, tileSize);
+                EXPECT_LE(tile.ymax - tile.ymin, tileSize);
+                Sensor::forEachPixelInTile(tile, 0, [&](size_t x, size_t y, ThreadIndex) { counter.visit(x, y); });
+            }
+            EXPECT_TRUE(counter.allVisitedOnce()) << Sensor::tileOrderString(order) << " tile size " << tileSize;
+        }
+    }
+}
+
+TEST(Sensor, SpiralStartsAtCenter) {
+    Sensor sensor(80, 80);
+    auto tiles = sensor.tiles(8, TileOrder::Spiral);
+    ASSERT_FALSE(tiles.empty());
+    EXPECT_EQ(tiles[0].xmin, 32u);
+    EXPECT_EQ(tiles[0].ymin, 32u);
+}
+
+TEST(Sensor, HilbertTilesAreAdjacent) {
+    // On a power of two grid, consecutive tiles along a Hilbert curve share an edge
+    Sensor sensor(64, 64);
+    auto tiles = sensor.tiles(8, TileOrder::Hilbert);
+    ASSERT_EQ(tiles.size(), 64u);
+    for(size_t i = 1; i < tiles.size(); ++i) {
+        int dx = std::abs(int(tiles[i].xmin) - int(tiles[i - 1].xmin));
+        int dy = std::abs(int(tiles[i].ymin) - int(tiles[i - 1].ymin));
+        EXPECT_EQ(dx + dy, 8);
+    }
+}
+
+TEST(Sensor, ThreadedTiledVisitsAllPixelsWithValidThreadIndex) {
+    Sensor sensor(61, 47);
+    for(auto order : allOrders) {
+        for(uint32_t numThreads : { 1u, 2u, 7u }) {
+            VisitCounter counter(sensor);
+            std::atomic<bool> badThreadIndex(false);
+            sensor.forEachPixelTiledThreaded([&](size_t x, size_t y, ThreadIndex tid) {
+                counter.visit(x, y);
+                if(tid >= numThreads) { badThreadIndex = true; }
+            }, 8, numThreads, order);
+            EXPECT_TRUE(counter.allVisitedOnce());
+            EXPECT_FALSE(badThreadIndex);
+        }
+    }
+}
+
+TEST(Sensor, ThreadedTiledUsesEveryThread) {
+    // Give every thread a reason to claim work by making pixels slow
+    Sensor sensor(32, 32);
+    const uint32_t numThreads = 4;
+    setThreadPoolSize(numThreads);
+    std::vector<std::atomic<unsigned int>> pixelsPerThread(numThreads);
+    for(auto & c : pixelsPerThread) { c = 0; }
+    sensor.forEachPixelTiledThreaded([&](size_t, size_t, ThreadIndex tid) {
+        pixelsPerThread[tid]++;
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }, 4, numThreads);
+    unsigned int total = 0;
+    for(auto & c : pixelsPerThread) {
+        EXPECT_GT(c.load(), 0u);
+        total += c;
+    }
+    EXPECT_EQ(total, 32u * 32u);
+}
+
+TEST(Sensor, ThreadedRasterVisitsAllPixels) {
+    Sensor sensor(29, 31);
+    VisitCounter counter(sensor);
+    sensor.forEachPixelThreaded([&](size_t x, size_t y, ThreadIndex) { counter.visit(x, y); }, 3);
+    EXPECT_TRUE(counter.allVisitedOnce());
+}
+
+TEST(Sensor, ParseTileOrder) {
+    TileOrder order;
+    EXPECT_TRUE(Sensor::parseTileOrder("hilbert", order));
+    EXPECT_EQ(order, TileOrder::Hilbert);
+    EXPECT_TRUE(Sensor::parseTileOrder("spiral", order));
+    EXPECT_EQ(order, TileOrder::Spiral);
+    EXPECT_TRUE(Sensor::parseTileOrder("raster", order));
+    EXPECT_EQ(order, TileOrder::Raster);
+    EXPECT_FALSE(Sensor::parseTileOrder("zigzag", order));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
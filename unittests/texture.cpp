@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "texture.h"
+
+namespace {
+
+// "grayramp" is a built in test pattern, so no image file is needed
+
+TEST(TextureCacheTest, LoadsFileOnce) {
+    TextureCache cache;
+    TextureID a = cache.loadTextureFromFile("", "grayramp");
+    TextureID b = cache.loadTextureFromFile("", "grayramp");
+    EXPECT_EQ(a, b);
+    ASSERT_EQ(cache.textures.size(), 1u);
+    ASSERT_TRUE(cache.textures[a] != nullptr);
+    EXPECT_EQ(cache.texture(a), cache.textures[a]);
+    EXPECT_EQ(cache.textures[a]->width, 256u);
+}
+
+TEST(TextureCacheTest, NormalMapIsConvertedOnce) {
+    TextureCache cache;
+    TextureID color = cache.loadTextureFromFile("", "grayramp");
+    TextureID normal = cache.loadNormalMapFromFile("", "grayramp");
+    EXPECT_NE(color, normal);
+    EXPECT_EQ(cache.loadNormalMapFromFile("", "grayramp"), normal);
+
+    auto & c = *cache.texture(color);
+    auto & n = *cache.texture(normal);
+    for(size_t x = 0; x < c.width; x += 37) {
+        EXPECT_FLOAT_EQ(n.get(x, 5, 0), c.get(x, 5, 0) * 2.0f - 1.0f);
+    }
+}
+
+TEST(TextureCacheTest, ConcurrentLoadsShareTexture) {
+    TextureCache cache;
+    const int numThreads = 8;
+    std::vector<TextureID> ids(numThreads, NoTexture);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&cache, &ids, t]() {
+            ids[t] = (t % 2 == 0) ? cache.loadTextureFromFile("", "grayramp")
+                                  : cache.loadNormalMapFromFile("", "grayramp");
+            // Every load returns a finished texture
+            EXPECT_TRUE(cache.texture(ids[t]) != nullptr);
+        });
+    }
+    for(auto & thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(cache.textures.size(), 2u);
+    for(int t = 2; t < numThreads; ++t) {
+        EXPECT_EQ(ids[t], ids[t % 2]);
+    }
+}
+
+TEST(TextureCacheTest, FailedLoadThrowsAndIsNotCached) {
+    TextureCache cache;
+    EXPECT_THROW(cache.loadTextureFromFile("", "no-such-texture.png"), std::runtime_error);
+    EXPECT_THROW(cache.loadTextureFromFile("", "no-such-texture.png"), std::runtime_error);
+    EXPECT_EQ(cache.fileToTextureID.count("no-such-texture.png"), 0u);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+#include "ThreadPool.h"
+
+namespace {
+
+TEST(ThreadPool, SubmitRunsTask) {
+    ThreadPool pool(2);
+    std::atomic<int> value(0);
+    auto future = pool.submit([&]() { value = 42; });
+    future.get();
+    EXPECT_EQ(value.load(), 42);
+}
+
+TEST(ThreadPool, SubmitPropagatesException) {
+    ThreadPool pool(1);
+    auto future = pool.submit([]() { throw std::runtime_error("task failed"); });
+    EXPECT_THROW(future.get(), std::runtime_error);
+}
+
+TEST(ThreadPool, DestructorDrainsQueuedTasks) {
+    std::atomic<int> count(0);
+    {
+        ThreadPool pool(2);
+        for(int i = 0; i < 100; ++i) {
+            pool.submit([&]() { count++; });
+        }
+    }
+    EXPECT_EQ(count.load(), 100);
+}
+
+TEST(ThreadPool, ParallelForVisitsEveryIndexOnce) {
+    ThreadPool pool(4);
+    for(size_t count : { size_t(0), size_t(1), size_t(3), size_t(1000) }) {
+        std::vector<std::atomic<int>> visits(count);
+        for(auto & v : visits) { v = 0; }
+        pool.parallelFor(count, [&](size_t index, ThreadIndex) { visits[index]++; });
+        for(auto & v : visits) {
+            EXPECT_EQ(v.load(), 1);
+        }
+    }
+}
+
+TEST(ThreadPool, ParallelForThreadIndexBelowMaxThreads) {
+    ThreadPool pool(6);
+    for(unsigned int maxThreads : { 0u, 1u, 3u, 6u, 10u }) {
+        const unsigned int limit = maxThreads == 0 ? pool.numThreads() : maxThreads;
+        std::atomic<bool> badThreadIndex(false);
+        pool.parallelFor(200, [&](size_t, ThreadIndex tid) {
+            if(tid >= limit) { badThreadIndex = true; }
+        }, maxThreads);
+        EXPECT_FALSE(badThreadIndex);
+    }
+}
+
+TEST(ThreadPool, ParallelForUsesEveryThread) {
+    const unsigned int numThreads = 4;
+    ThreadPool pool(numThreads);
+    std::vector<std::atomic<unsigned int>> itemsPerThread(numThreads);
+    for(auto & c : itemsPerThread) { c = 0; }
+    pool.parallelFor(64, [&](size_t, ThreadIndex tid) {
+        itemsPerThread[tid]++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    });
+    for(auto & c : itemsPerThread) {
+        EXPECT_GT(c.load(), 0u);
+    }
+}
+
+TEST(ThreadPool, NestedParallelForDoesNotDeadlock) {
+    // Every worker is busy in the outer loop when the inner loops start
+    ThreadPool pool(2);
+    std::atomic<int> count(0);
+    pool.parallelFor(8, [&](size_t, ThreadIndex) {
+        pool.parallelFor(16, [&](size_t, ThreadIndex) { count++; });
+    });
+    EXPECT_EQ(count.load(), 8 * 16);
+}
+
+TEST(ThreadPool, ParallelForRethrowsAndStops) {
+    ThreadPool pool(3);
+    std::atomic<int> count(0);
+    EXPECT_THROW(pool.parallelFor(1000, [&](size_t index, ThreadIndex) {
+        if(index == 10) { throw std::runtime_error("item failed"); }
+        count++;
+    }), std::runtime_error);
+    EXPECT_LT(count.load(), 999);
+
+    // The pool is still usable afterwards
+    count = 0;
+    pool.parallelFor(10, [&](size_t, ThreadIndex) { count++; });
+    EXPECT_EQ(count.load(), 10);
+}
+
+TEST(ThreadPool, IsWorkerThread) {
+    ThreadPool pool(1);
+    EXPECT_FALSE(pool.isWorkerThread());
+    bool inWorker = false;
+    pool.submit([&]() { inWorker = pool.isWorkerThread(); }).get();
+    EXPECT_TRUE(inWorker);
+}
+
+TEST(ThreadPool, GlobalPoolResize) {
+    setThreadPoolSize(3);
+    EXPECT_EQ(getThreadPool().numThreads(), 3u);
+    setThreadPoolSize(1);
+    EXPECT_EQ(getThreadPool().numThreads(), 1u);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
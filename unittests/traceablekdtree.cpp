@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "vectortypes.h"
+#include "Ray.h"
+#include "Sphere.h"
+#include "TraceableKDTree.h"
+
+namespace {
+
+// Spaced out spheres, enough for several levels of splits
+class TraceableKDTreeTest : public ::testing::Test {
+    protected:
+        virtual void SetUp() {
+            for(int x = 0; x < 4; ++x) {
+                for(int y = 0; y < 4; ++y) {
+                    for(int z = 0; z < 4; ++z) {
+                        Position3 center(float(x) * 3.0f, float(y) * 3.0f, float(z) * 3.0f);
+                        objects.push_back(std::make_shared<Sphere>(center, 0.5f));
+                    }
+                }
+            }
+            kdtree.build(objects);
+        }
+
+        bool bruteForceIntersects(const Ray & ray, float minDistance, float maxDistance) const {
+            for(const auto & object : objects) {
+                if(object->intersects(ray, minDistance, maxDistance)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        std::vector<TraceablePtr> objects;
+        TraceableKDTree kdtree;
+};
+
+} // namespace
+
+// A ray between the spheres reaches leaves without hitting any of their
+// objects, and must not descend further
+TEST_F(TraceableKDTreeTest, AnyHitMissesLeafObjects) {
+    const Ray ray(Position3(-1.0f, 1.5f, 1.5f), Direction3(1.0f, 0.0f, 0.0f));
+    EXPECT_FALSE(kdtree.intersects(ray, 0.0f, 100.0f));
+    RayIntersection intersection;
+    EXPECT_FALSE(kdtree.findIntersection(ray, 0.0f, intersection));
+}
+
+TEST_F(TraceableKDTreeTest, AnyHitMatchesBruteForce) {
+    std::mt19937 engine(5);
+    std::uniform_real_distribution<float> position(-1.0f, 10.0f);
+    std::normal_distribution<float> direction;
+    unsigned int numHits = 0;
+
+    for(int i = 0; i < 2000; ++i) {
+        Ray ray(Position3(position(engine), position(engine), position(engine)),
+                Direction3(direction(engine), direction(engine), direction(engine)).normalized());
+        const float maxDistance = 6.0f;
+        const bool expected = bruteForceIntersects(ray, 0.0f, maxDistance);
+        EXPECT_EQ(kdtree.intersects(ray, 0.0f, maxDistance), expected) << "ray " << i;
+        numHits += expected ? 1 : 0;
+    }
+
+    // Make sure the test exercises hits and misses
+    EXPECT_GT(numHits, 100u);
+    EXPECT_LT(numHits, 1900u);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
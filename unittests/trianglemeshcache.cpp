@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include "TriangleMeshCache.h"
+
+namespace {
+
+class TriangleMeshCacheTest : public ::testing::Test {
+    protected:
+        virtual void SetUp() {
+            meshData.vertices = { Position3(0.0f, 0.0f, 0.0f), Position3(1.0f, 0.0f, 0.0f),
+                                  Position3(0.0f, 1.0f, 0.0f), Position3(1.0f, 1.0f, 2.0f) };
+            meshData.normals = { Direction3(0.0f, 0.0f, 1.0f) };
+            meshData.texcoords = { TextureCoordinate{ 0.25f, 0.5f } };
+            meshData.indices.vertex = { 0, 1, 2, 1, 3, 2 };
+            meshData.indices.normal = { 0, 0, 0, 0, 0, 0 };
+            meshData.indices.texcoord = { 0, 0, 0, TriangleMeshData::NoTexCoord, 0, 0 };
+            meshData.faces.material = { 3, NoMaterial };
+            meshData.bounds = boundingBox(meshData.vertices);
+        }
+        virtual void TearDown() {
+            std::remove(cacheFile.c_str());
+        }
+
+        void writeCache(uint64_t key) {
+            MeshCacheWriter writer(cacheFile, key);
+            writer.writeMeshData(meshData);
+            writer.writeString("extra");
+            writer.writeValue(42);
+            writer.close();
+        }
+
+        TriangleMeshData meshData;
+        const std::string cacheFile = "trianglemeshcache_test.fluxmesh";
+};
+
+} // namespace
+
+TEST_F(TriangleMeshCacheTest, RoundTrip) {
+    writeCache(1234);
+
+    MeshCacheReader reader(cacheFile, 1234);
+    ASSERT_TRUE(reader.isValid());
+    TriangleMeshData loaded;
+    reader.readMeshData(loaded);
+    EXPECT_EQ(reader.readString(), "extra");
+    EXPECT_EQ(reader.readValue<int>(), 42);
+
+    ASSERT_EQ(loaded.vertices.size(), meshData.vertices.size());
+    for(size_t vi = 0; vi < meshData.vertices.size(); ++vi) {
+        EXPECT_EQ(loaded.vertices[vi], meshData.vertices[vi]);
+    }
+    EXPECT_EQ(loaded.normals[0], meshData.normals[0]);
+    EXPECT_EQ(loaded.texcoords[0].u, 0.25f);
+    EXPECT_EQ(loaded.texcoords[0].v, 0.5f);
+    EXPECT_EQ(loaded.indices.vertex, meshData.indices.vertex);
+    EXPECT_EQ(loaded.indices.normal, meshData.indices.normal);
+    EXPECT_EQ(loaded.indices.texcoord, meshData.indices.texcoord);
+    EXPECT_EQ(loaded.faces.material, meshData.faces.material);
+    EXPECT_EQ(loaded.bounds.xmax, 1.0f);
+    EXPECT_EQ(loaded.bounds.zmax, 2.0f);
+}
+
+TEST_F(TriangleMeshCacheTest, StaleOrMissingCacheIsNotValid) {
+    EXPECT_FALSE(MeshCacheReader(cacheFile, 1234).isValid());
+    writeCache(1234);
+    EXPECT_FALSE(MeshCacheReader(cacheFile, 4321).isValid());
+    // Unknown source
+    EXPECT_FALSE(MeshCacheReader(cacheFile, 0).isValid());
+}
+
+TEST_F(TriangleMeshCacheTest, TruncatedCacheThrows) {
+    writeCache(1234);
+    std::string contents;
+    {
+        std::ifstream in(cacheFile, std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(cacheFile, std::ios::binary | std::ios::trunc);
+        out.write(contents.data(), contents.size() / 2);
+    }
+    MeshCacheReader reader(cacheFile, 1234);
+    ASSERT_TRUE(reader.isValid());
+    TriangleMeshData loaded;
+    EXPECT_THROW(reader.readMeshData(loaded), std::runtime_error);
+}
+
+TEST_F(TriangleMeshCacheTest, SourceKeyTracksFile) {
+    const std::string source = "trianglemeshcache_test_source.obj";
+    EXPECT_EQ(meshSourceKey(source), 0u);
+    {
+        std::ofstream out(source);
+        out << "v 0 0 0\n";
+    }
+    const uint64_t key = meshSourceKey(source);
+    EXPECT_NE(key, 0u);
+    EXPECT_EQ(meshSourceKey(source), key);
+    {
+        std::ofstream out(source, std::ios::app);
+        out << "v 1 0 0\n";
+    }
+    EXPECT_NE(meshSourceKey(source), key);
+    std::remove(source.c_str());
+}
+
+TEST_F(TriangleMeshCacheTest, CacheFileNames) {
+    EXPECT_EQ(meshCacheFile("", "models/a/mesh.obj"), "models/a/mesh.obj.fluxmesh");
+    // Same file name in different directories
+    EXPECT_NE(meshCacheFile("cache", "models/a/mesh.obj"), meshCacheFile("cache", "models/b/mesh.obj"));
+    EXPECT_EQ(meshCacheFile("cache", "models/a/mesh.obj").substr(0, 15), "cache/mesh.obj.");
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
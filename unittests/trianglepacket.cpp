@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <limits>
+#include "vectortypes.h"
+#include "Ray.h"
+#include "Triangle.h"
+#include "TriangleMesh.h"
+#include "TrianglePacket.h"
+#include "SyntheticMeshes.h"
+
+namespace {
+
+const TriangleKernel allKernels[] = { TriangleKernel::Scalar, TriangleKernel::SSE, TriangleKernel::AVX2 };
+
+Ray randomRay(std::mt19937 & engine)
+{
+    std::uniform_real_distribution<float> position(-2.0f, 2.0f);
+    std::normal_distribution<float> direction;
+    return Ray(Position3(position(engine), position(engine), position(engine)),
+               Direction3(direction(engine), direction(engine), direction(engine)).normalized());
+}
+
+class TrianglePacketTest : public ::testing::Test {
+    protected:
+        virtual void SetUp() {
+            // Not a multiple of the packet width, so the last packet is padded
+            mesh = makeRandomSoup(203, 0.3f, 321);
+            buildTrianglePackets(packets, *mesh);
+            savedKernel = triangleKernel();
+        }
+        virtual void TearDown() {
+            setTriangleKernel(savedKernel);
+        }
+
+        std::shared_ptr<TriangleMesh> mesh;
+        TrianglePacketArray packets;
+        TriangleKernel savedKernel;
+};
+
+TEST_F(TrianglePacketTest, PacketLayout) {
+    EXPECT_EQ(packets.size(), TrianglePacket::numPacketsFor(203));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(packets.data()) % 32, 0u);
+    for(uint32_t tri = 0; tri < mesh->numTriangles(); ++tri) {
+        const auto & packet = packets[tri / TrianglePacket::WIDTH];
+        auto lane = tri % TrianglePacket::WIDTH;
+        EXPECT_EQ(packet.triangle[lane], tri);
+        EXPECT_EQ(packet.v0[0][lane], mesh->triangleVertex(tri, 0).x);
+        EXPECT_EQ(packet.e1[1][lane], mesh->triangleVertex(tri, 1).y - mesh->triangleVertex(tri, 0).y);
+        EXPECT_EQ(packet.e2[2][lane], mesh->triangleVertex(tri, 2).z - mesh->triangleVertex(tri, 0).z);
+    }
+}
+
+TEST_F(TrianglePacketTest, ScalarAlwaysSupported) {
+    EXPECT_TRUE(triangleKernelSupported(TriangleKernel::Scalar));
+    EXPECT_TRUE(triangleKernelSupported(bestTriangleKernel()));
+}
+
+TEST_F(TrianglePacketTest, ClosestHitMatchesUnpacked) {
+    for(auto kernel : allKernels) {
+        if(!setTriangleKernel(kernel)) {
+            continue;
+        }
+        SCOPED_TRACE(triangleKernelString(kernel));
+        std::mt19937 engine(42);
+        unsigned int numHits = 0;
+
+        for(int i = 0; i < 2000; ++i) {
+            Ray ray = randomRay(engine);
+
+            // Reference: one triangle at a time
+            float expectedDistance = std::numeric_limits<float>::max(), t;
+            bool expectedHit = false;
+            for(uint32_t tri = 0; tri < mesh->numTriangles(); ++tri) {
+                if(intersectsTriangle(ray, mesh->triangleVertex(tri, 0), mesh->triangleVertex(tri, 1),
+                                      mesh->triangleVertex(tri, 2), 0.0f, std::numeric_limits<float>::max(), &t)
+                   && t < expectedDistance) {
+                    expectedDistance = t;
+                    expectedHit = true;
+                }
+            }
+
+            float actualDistance = std::numeric_limits<float>::max();
+            uint32_t triangle = 0;
+            bool actualHit = findClosestTriangle(ray, packets.data(), uint32_t(packets.size()),
+                                                 0.0f, actualDistance, triangle);
+            ASSERT_EQ(expectedHit, actualHit);
+            if(expectedHit) {
+                EXPECT_EQ(expectedDistance, actualDistance);
+                EXPECT_LT(triangle, mesh->numTriangles());
+                numHits++;
+            }
+        }
+
+        EXPECT_GT(numHits, 100u);
+    }
+}
+
+TEST_F(TrianglePacketTest, AnyHitMatchesUnpacked) {
+    for(auto kernel : allKernels) {
+        if(!setTriangleKernel(kernel)) {
+            continue;
+        }
+        SCOPED_TRACE(triangleKernelString(kernel));
+        std::mt19937 engine(43);
+
+        for(int i = 0; i < 2000; ++i) {
+            Ray ray = randomRay(engine);
+            const float minDistance = 0.5f, maxDistance = 1.5f;
+            bool expected = false;
+            for(uint32_t tri = 0; tri < mesh->numTriangles() && !expected; ++tri) {
+                expected = intersectsTriangle(ray, mesh->triangleVertex(tri, 0), mesh->triangleVertex(tri, 1),
+                                              mesh->triangleVertex(tri, 2), minDistance, maxDistance);
+            }
+            EXPECT_EQ(expected, intersectsAnyTriangle(ray, packets.data(), uint32_t(packets.size()),
+                                                      minDistance, maxDistance));
+        }
+    }
+}
+
+TEST_F(TrianglePacketTest, PaddedLanesNeverHit) {
+    // A ray through the origin along z hits the zeroed lanes' v0
+    TrianglePacket packet;
+    packet.clear();
+    packet.set(0, vec3(-1, -1, 5), vec3(1, -1, 5), vec3(0, 1, 5), 17);
+    Ray ray(Position3(0, 0, -1), Direction3(0, 0, 1));
+
+    for(auto kernel : allKernels) {
+        if(!setTriangleKernel(kernel)) {
+            continue;
+        }
+        float distance = std::numeric_limits<float>::max();
+        uint32_t triangle = 0;
+        EXPECT_TRUE(findClosestTriangle(ray, &packet, 1, 0.0f, distance, triangle));
+        EXPECT_EQ(triangle, 17u);
+        EXPECT_FLOAT_EQ(distance, 6.0f);
+        EXPECT_FALSE(intersectsAnyTriangle(ray, &packet, 1, 0.0f, 5.0f));
+    }
+}
+
+TEST_F(TrianglePacketTest, MeshWithPacketsMatchesUnpacked) {
+    auto packed = std::make_shared<TriangleMesh>();
+    packed->meshData = mesh->meshData;
+    packed->buildPackets();
+    std::mt19937 engine(44);
+
+    for(int i = 0; i < 1000; ++i) {
+        Ray ray = randomRay(engine);
+        RayIntersection expected, actual;
+        bool expectedHit = mesh->findIntersection(ray, 0.0f, expected);
+        ASSERT_EQ(expectedHit, packed->findIntersection(ray, 0.0f, actual));
+        if(expectedHit) {
+            EXPECT_EQ(expected.distance, actual.distance);
+        }
+        EXPECT_EQ(mesh->intersects(ray, 0.0f, 1.0f), packed->intersects(ray, 0.0f, 1.0f));
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
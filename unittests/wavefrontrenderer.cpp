@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+#include "vectortypes.h"
+#include "scene.h"
+#include "Sampler.h"
+#include "Renderer.h"
+#include "WavefrontRenderer.h"
+#include "GradientEnvironmentMap.h"
+
+namespace {
+
+// Small scene with diffuse, mirror and glass objects lit by a point light
+// and a gradient sky
+class WavefrontRendererTest : public ::testing::Test {
+    protected:
+        virtual void SetUp() {
+            scene.environmentMap = std::make_unique<GradientEnvironmentMap>(RadianceRGB(0.1f, 0.1f, 0.2f),
+                                                                            RadianceRGB(0.8f, 0.9f, 1.0f));
+
+            scene.materials.push_back(Material::makeDiffuse(ReflectanceRGB(0.7f, 0.6f, 0.5f)));
+            scene.materials.push_back(Material::makeMirror());
+            scene.materials.push_back(Material::makeRefractive(1.5f));
+            scene.materials.push_back(Material::makeDiffuseSpecular(ReflectanceRGB(0.2f, 0.5f, 0.2f),
+                                                                    ReflectanceRGB(0.3f, 0.3f, 0.3f)));
+
+            auto floor = std::make_shared<Slab>(Position3(-5.0f, -2.0f, -8.0f), Position3(5.0f, -1.0f, 2.0f));
+            floor->material = 0;
+            scene.objects.push_back(floor);
+
+            auto mirror = std::make_shared<Sphere>(Position3(1.2f, 0.0f, -4.0f), 0.8f);
+            mirror->material = 1;
+            scene.objects.push_back(mirror);
+
+            auto glass = std::make_shared<Sphere>(Position3(0.0f, 0.2f, -2.5f), 0.5f);
+            glass->material = 2;
+            scene.objects.push_back(glass);
+
+            auto plastic = std::make_shared<Sphere>(Position3(-1.2f, 0.0f, -4.0f), 0.8f);
+            plastic->material = 3;
+            scene.objects.push_back(plastic);
+
+            scene.pointLights.emplace_back(Position3(0.0f, 4.0f, -2.0f), RadianceRGB(20.0f, 20.0f, 20.0f));
+
+            for(int y = 0; y < 4; ++y) {
+                for(int x = 0; x < 6; ++x) {
+                    Direction3 direction(-0.5f + 0.2f * x, -0.4f + 0.2f * y, -1.0f);
+                    rays.emplace_back(Position3(0.0f, 0.0f, 0.0f), direction.normalized());
+                }
+            }
+        }
+
+        // Mean radiance of each ray, traced samplesPerRay times with each renderer
+        void meanRadiance(const Renderer & renderer, const WavefrontRenderer & wavefront,
+                          unsigned int samplesPerRay,
+                          std::vector<RadianceRGB> & recursiveMean,
+                          std::vector<RadianceRGB> & wavefrontMean) {
+            SobolSampler sampler;
+            WavefrontRenderer::CameraRayBatch batch;
+
+            recursiveMean.assign(rays.size(), RadianceRGB());
+            wavefrontMean.assign(rays.size(), RadianceRGB());
+
+            for(size_t ri = 0; ri < rays.size(); ++ri) {
+                for(unsigned int si = 0; si < samplesPerRay; ++si) {
+                    RayIntersection intersection;
+                    RadianceRGB Lo;
+                    PixelSample pixelSample{ uint32_t(ri), 0, si };
+                    sampler.startPixelSample(pixelSample);
+                    renderer.traceCameraRay(scene, sampler, rays[ri], 0.0f, 1, { VaccuumMedium }, intersection, Lo);
+                    recursiveMean[ri] += Lo / float(samplesPerRay);
+                    batch.rays.push_back(rays[ri]);
+                    batch.pixelSamples.push_back(pixelSample);
+                }
+            }
+
+            wavefront.traceCameraRays(scene, sampler, 0.0f, 1, { VaccuumMedium }, batch);
+
+            for(size_t index = 0; index < batch.rays.size(); ++index) {
+                wavefrontMean[index / samplesPerRay] += batch.radiance[index] / float(samplesPerRay);
+            }
+        }
+
+        void expectMeansMatch(const std::vector<RadianceRGB> & a, const std::vector<RadianceRGB> & b) {
+            ASSERT_EQ(a.size(), b.size());
+            auto tolerance = [](float v) { return 0.02f + 0.05f * v; };
+            for(size_t ri = 0; ri < a.size(); ++ri) {
+                EXPECT_NEAR(a[ri].r, b[ri].r, tolerance(a[ri].r)) << "ray " << ri;
+                EXPECT_NEAR(a[ri].g, b[ri].g, tolerance(a[ri].g)) << "ray " << ri;
+                EXPECT_NEAR(a[ri].b, b[ri].b, tolerance(a[ri].b)) << "ray " << ri;
+            }
+        }
+
+        Scene scene;
+        std::vector<Ray> rays;
+};
+
+} // namespace
+
+TEST_F(WavefrontRendererTest, FirstHitsMatchRecursiveRenderer) {
+    Renderer renderer;
+    WavefrontRenderer wavefront(renderer);
+    RandomSampler sampler;
+
+    WavefrontRenderer::CameraRayBatch batch;
+    batch.rays = rays;
+    wavefront.traceCameraRays(scene, sampler, 0.0f, 1, { VaccuumMedium }, batch);
+
+    ASSERT_EQ(batch.radiance.size(), rays.size());
+    ASSERT_EQ(batch.hit.size(), rays.size());
+
+    unsigned int numHits = 0;
+    for(size_t ri = 0; ri < rays.size(); ++ri) {
+        RayIntersection intersection;
+        RadianceRGB Lo;
+        sampler.startPixelSample(PixelSample{ uint32_t(ri), 0, 0 });
+        bool hit = renderer.traceCameraRay(scene, sampler, rays[ri], 0.0f, 1, { VaccuumMedium }, intersection, Lo);
+        EXPECT_EQ(hit, bool(batch.hit[ri])) << "ray " << ri;
+        if(hit && batch.hit[ri]) {
+            EXPECT_FLOAT_EQ(intersection.distance, batch.intersections[ri].distance) << "ray " << ri;
+            EXPECT_EQ(intersection.material, batch.intersections[ri].material) << "ray " << ri;
+            ++numHits;
+        }
+    }
+    // Make sure the scene is being tested, not the sky
+    EXPECT_GT(numHits, rays.size() / 2);
+}
+
+TEST_F(WavefrontRendererTest, MeanRadianceMatchesRecursiveRenderer) {
+    Renderer renderer;
+    WavefrontRenderer wavefront(renderer);
+    wavefront.maxBatchSize = 1000;
+
+    std::vector<RadianceRGB> recursiveMean, wavefrontMean;
+    meanRadiance(renderer, wavefront, 4000, recursiveMean, wavefrontMean);
+    expectMeansMatch(recursiveMean, wavefrontMean);
+}
+
+TEST_F(WavefrontRendererTest, MeanRadianceMatchesWithoutMonteCarloRefraction) {
+    Renderer renderer;
+    renderer.monteCarloRefraction = false;
+    WavefrontRenderer wavefront(renderer);
+    wavefront.sortByMaterial = false;
+
+    std::vector<RadianceRGB> recursiveMean, wavefrontMean;
+    meanRadiance(renderer, wavefront, 2000, recursiveMean, wavefrontMean);
+    expectMeansMatch(recursiveMean, wavefrontMean);
+}
+
+// Shadow rays test transparent surfaces with the sample dimensions of the
+// path that cast them, so a pixel sample finds the same light wherever it
+// is in the batch
+TEST_F(WavefrontRendererTest, ShadowRaysUseTheirPathsSamples) {
+    // Half transparent sheet between the floor and the light
+    Material screen = Material::makeDiffuse(ReflectanceRGB(0.5f, 0.5f, 0.5f));
+    screen.opacity = 0.5f;
+    scene.materials.push_back(screen);
+    auto sheet = std::make_shared<Slab>(Position3(-5.0f, 2.0f, -8.0f), Position3(5.0f, 2.1f, 2.0f));
+    sheet->material = MaterialID(scene.materials.size() - 1);
+    scene.objects.push_back(sheet);
+
+    Renderer renderer;
+    renderer.maxDepth = 1;
+    WavefrontRenderer wavefront(renderer);
+    RandomSampler sampler;
+
+    // One pixel sample of a ray to the floor, between other samples
+    const Ray floorRay(Position3(0.0f, 0.0f, 0.0f), Direction3(-0.6f, -0.4f, -1.0f).normalized());
+    WavefrontRenderer::CameraRayBatch batch;
+    for(uint32_t si = 0; si < 64; ++si) {
+        batch.rays.push_back(floorRay);
+        batch.pixelSamples.push_back(PixelSample{ 0, 0, 0 });
+        batch.rays.push_back(floorRay);
+        batch.pixelSamples.push_back(PixelSample{ 0, 0, si + 1 });
+    }
+    wavefront.traceCameraRays(scene, sampler, 0.0f, 1, { VaccuumMedium }, batch);
+
+    ASSERT_TRUE(batch.hit[0]);
+    EXPECT_EQ(batch.intersections[0].material, 0u);
+    for(size_t index = 2; index < batch.radiance.size(); index += 2) {
+        EXPECT_FLOAT_EQ(batch.radiance[index].r, batch.radiance[0].r) << "ray " << index;
+        EXPECT_FLOAT_EQ(batch.radiance[index].g, batch.radiance[0].g) << "ray " << index;
+        EXPECT_FLOAT_EQ(batch.radiance[index].b, batch.radiance[0].b) << "ray " << index;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}